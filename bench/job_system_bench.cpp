@@ -0,0 +1,78 @@
+#include "core/job_system.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Measures how parallelFor scales with the amount of threads.
+// Each element runs a short, purely ALU bound kernel, so that memory bandwidth doesn't hide the scheduler's overhead.
+
+static const uint32_t elementCount = 1u << 22;
+static const uint32_t grainSize = 1024;
+static const int repetitions = 5;
+
+static inline float kernel(uint32_t i) {
+    float x = float(i) * 0.001f;
+    for (int k = 0; k < 32; ++k) {
+        x = std::sin(x) * 1.0001f + std::cos(x * 0.5f);
+    }
+    return x;
+}
+
+template<typename Function>
+static double bestOf(Function &&function) {
+    double best = 1e30;
+    for (int r = 0; r < repetitions; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+int main() {
+    std::vector<float> output(elementCount);
+
+    double serialTime = bestOf([&]() {
+        for (uint32_t i = 0; i < elementCount; ++i) {
+            output[i] = kernel(i);
+        }
+    });
+
+    uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::printf("parallelFor over %u elements, grain %u, %u hardware threads\n", elementCount, grainSize, hardwareThreads);
+    std::printf("%8s %12s %10s %12s\n", "threads", "time [ms]", "speedup", "efficiency");
+    std::printf("%8u %12.2f %10.2f %11.0f%%\n", 1u, serialTime, 1.0, 100.0);
+
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 2; threads < hardwareThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    if (hardwareThreads > 1) {
+        threadCounts.push_back(hardwareThreads);
+    }
+
+    for (uint32_t threads : threadCounts) {
+        // The calling thread takes part in parallelFor, so it counts as one of the threads
+        JobSystem jobSystem(threads - 1);
+        double time = bestOf([&]() {
+            jobSystem.parallelFor(elementCount, grainSize, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; ++i) {
+                    output[i] = kernel(i);
+                }
+            });
+        });
+        double speedup = serialTime / time;
+        std::printf("%8u %12.2f %10.2f %11.0f%%\n", threads, time, speedup, 100.0 * speedup / threads);
+    }
+
+    // Keep the results alive so the kernel isn't optimized away
+    float checksum = 0.0f;
+    for (uint32_t i = 0; i < elementCount; i += grainSize) {
+        checksum += output[i];
+    }
+    std::printf("checksum: %f\n", checksum);
+    return 0;
+}
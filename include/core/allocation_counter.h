@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations are counted per thread by replacing the global operator new, in debug builds or with
+// ASTERISM_COUNT_ALLOCATIONS. Allocations that bypass operator new (malloc, drivers) aren't seen.
+#if !defined(NDEBUG) && !defined(ASTERISM_COUNT_ALLOCATIONS)
+#define ASTERISM_COUNT_ALLOCATIONS
+#endif
+
+// Allocations made by the calling thread so far, outside of AllowAllocationScopes. Always 0 when they aren't counted
+uint64_t getThreadAllocationCount();
+
+// Reports, and asserts in debug builds, if the calling thread allocates from the heap while the scope exists.
+// Does nothing when allocations aren't counted
+class NoAllocationScope {
+public:
+    // 'what' names the scope in the report
+    explicit NoAllocationScope(const char *what, bool isEnabled = true);
+
+    ~NoAllocationScope();
+
+    NoAllocationScope(const NoAllocationScope &) = delete;
+
+    NoAllocationScope &operator=(const NoAllocationScope &) = delete;
+
+private:
+    const char *what;
+    bool isEnabled;
+    uint64_t startCount;
+};
+
+// Allocations that are expected inside a NoAllocationScope, e.g. caches filled on a miss or a swapchain recreation,
+// aren't counted while this exists
+class AllowAllocationScope {
+public:
+    AllowAllocationScope();
+
+    ~AllowAllocationScope();
+
+    AllowAllocationScope(const AllowAllocationScope &) = delete;
+
+    AllowAllocationScope &operator=(const AllowAllocationScope &) = delete;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Linear allocator for the transient CPU data of a frame (barrier lists, sort keys, draw lists, ...).
+// Allocating bumps a pointer and deallocating does nothing: everything allocated during a frame is freed at once when
+// its frame slot is reused, once the frame that last used it is done. There is one block per frame slot, so data can
+// be handed to work that outlives the recording of its frame (jobs, the GPU timeline).
+//
+// A memory_resource, so that standard containers use it through std::pmr:
+//     std::pmr::vector<VkBufferMemoryBarrier> barriers(&frameArena);
+// When a frame needs more than its block, the rest comes from the heap and the block grows to the peak usage when the
+// slot is reused: the steady state never touches the heap.
+// Not thread-safe: meant to be used by the render thread only.
+class FrameArena : public std::pmr::memory_resource {
+public:
+    void initialize(uint32_t slotCount, size_t blockSize);
+
+    // Frees what the previous frame of the slot allocated, and makes the slot current
+    void beginFrame(uint32_t slot);
+
+    template<typename T>
+    T *allocateArray(size_t count) {
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Of the current frame, overflow included
+    size_t getUsedSize() const;
+
+    void cleanup();
+
+protected:
+    void *do_allocate(size_t size, size_t alignment) override;
+
+    void do_deallocate(void * /*pointer*/, size_t /*size*/, size_t /*alignment*/) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+private:
+    struct Overflow {
+        void *pointer;
+        size_t size;
+        size_t alignment;
+    };
+
+    struct Slot {
+        std::unique_ptr<std::byte[]> block;
+        size_t capacity = 0;
+        size_t used = 0;
+        // Allocations that didn't fit in the block
+        std::vector<Overflow> overflows;
+        size_t overflowSize = 0;
+    };
+
+    std::vector<Slot> slots;
+    uint32_t currentSlot = 0;
+
+    void freeOverflows(Slot &slot);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+// Caps the frame rate by blocking until the next frame is due.
+// OS sleeps can overshoot by up to a scheduler tick, so the thread only sleeps until shortly before the deadline and
+// spins for the rest, which keeps frame times within a few microseconds of the target.
+class FrameLimiter {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // 0 disables the limiter
+    void setTargetFrameRate(double framesPerSecond);
+
+    double getTargetFrameRate() const { return targetFrameRate; }
+
+    // Blocks until the next frame is due, returns immediately if the limiter is disabled
+    void wait();
+
+private:
+    double targetFrameRate = 0.0;
+    clock::duration framePeriod = clock::duration::zero();
+    clock::time_point nextFrame;
+
+    // Remaining time that is spun instead of slept
+    const clock::duration spinThreshold = std::chrono::microseconds(1500);
+};
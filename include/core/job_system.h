@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Job = std::function<void()>;
+
+class JobSystem;
+
+// Counts the jobs that have been started with it and haven't finished yet.
+// Jobs can be made to depend on a counter (JobSystem::runAfter), and any thread can wait for it to reach zero.
+class JobCounter {
+public:
+    // Only use this for polling: before destroying a counter always go through JobSystem::wait()
+    bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    struct Continuation {
+        Job job;
+        JobCounter *counter;
+    };
+
+    std::atomic<uint32_t> pending = {0};
+    // Guards the decrement to zero together with the continuations, so that a finishing job never touches the
+    // counter after a waiter was released
+    std::mutex continuationsMutex;
+    // Jobs that were scheduled with runAfter() while this counter was still pending
+    std::vector<Continuation> continuations;
+};
+
+
+// Work-stealing scheduler shared by the whole engine.
+// Every worker owns a deque: it pushes and pops its own jobs at the back (LIFO, cache friendly) while idle workers
+// steal from the front of the others (FIFO, takes the oldest and usually biggest chunks of work).
+// Threads that are not workers (e.g. the main thread) push into the worker deques round-robin, and help executing
+// jobs while they wait on a counter, so waiting never wastes a core.
+class JobSystem {
+public:
+    // Process-wide instance, with one worker per hardware thread minus the calling one
+    static JobSystem &instance();
+
+    // 'workerCount' == 0 picks one worker per hardware thread minus the calling one
+    explicit JobSystem(uint32_t workerCount = 0);
+
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // Schedules a job, if 'counter' is given it's incremented now and decremented when the job is done
+    void run(Job job, JobCounter *counter = nullptr);
+
+    // Schedules a job that only starts once 'dependency' has reached zero
+    void runAfter(JobCounter &dependency, Job job, JobCounter *counter = nullptr);
+
+    // Blocks until 'counter' reaches zero, executing other jobs in the meantime
+    void wait(JobCounter &counter);
+
+    // Splits [0, count) into chunks of at most 'grainSize' elements and calls function(begin, end) for each chunk in
+    // parallel. Returns once all chunks are done
+    template<typename Function>
+    void parallelFor(uint32_t count, uint32_t grainSize, Function &&function);
+
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+    struct Task {
+        Job job;
+        JobCounter *counter;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        // Recycles the blocks of the deque, which it would otherwise allocate and free as jobs go through. Guarded by
+        // the mutex like the deque
+        std::pmr::unsynchronized_pool_resource pool;
+        std::pmr::deque<Task> tasks{&pool};
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    // Round-robin target for jobs pushed from outside of the workers
+    std::atomic<uint32_t> nextExternalQueue = {0};
+
+    // Sleeping: workers only block when there's nothing queued anywhere
+    std::atomic<uint32_t> queuedTasks = {0};
+    std::atomic<uint32_t> sleepingWorkers = {0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<bool> isRunning = {true};
+
+    void push(Task task);
+
+    bool tryPop(uint32_t queueIndex, Task &task);
+
+    bool trySteal(uint32_t thiefIndex, Task &task);
+
+    // Runs a single queued job on the calling thread, returns false if there was nothing to run
+    bool tryRunOne();
+
+    void execute(Task &task);
+
+    void workerLoop(uint32_t workerIndex);
+};
+
+
+template<typename Function>
+void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, Function &&function) {
+    if (count == 0) {
+        return;
+    }
+    if (grainSize == 0) {
+        grainSize = 1;
+    }
+    // A single chunk isn't worth the scheduling overhead
+    if (count <= grainSize) {
+        function(0u, count);
+        return;
+    }
+
+    JobCounter counter;
+    // The calling thread takes the first chunk itself
+    for (uint32_t begin = grainSize; begin < count; begin += grainSize) {
+        uint32_t end = std::min(begin + grainSize, count);
+        run([&function, begin, end]() { function(begin, end); }, &counter);
+    }
+    function(0u, grainSize);
+    wait(counter);
+}
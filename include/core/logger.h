@@ -0,0 +1,371 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "allocation_counter.h"
+
+enum LogLevel : uint8_t {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR,
+};
+
+// Messages below this level are compiled out (they are still type-checked)
+#ifndef ASTERISM_LOG_LEVEL
+#ifdef NDEBUG
+#define ASTERISM_LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define ASTERISM_LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// How a message is laid out by the writer
+enum LogStyle : uint8_t {
+    // Time, level and thread, then the message
+    LOG_STYLE_RECORD,
+    // The message alone (print())
+    LOG_STYLE_PLAIN,
+    // Centered on 80 columns (log())
+    LOG_STYLE_CENTERED,
+    // Centered between '=' (logTitle())
+    LOG_STYLE_TITLE,
+};
+
+// Lets one message through per interval, and counts the ones it holds back. One per call site (see LOG_EVERY)
+class LogRateLimiter {
+public:
+    explicit LogRateLimiter(uint32_t intervalMilliseconds);
+
+    // True if the message can be written, 'suppressed' is then the amount of messages dropped since the last one
+    bool allow(uint32_t &suppressed);
+
+private:
+    const int64_t interval;
+    std::atomic<int64_t> nextTime = {0};
+    std::atomic<uint32_t> suppressedCount = {0};
+};
+
+
+// Asynchronous logger: formatting and output happen on a background writer thread, so that logging costs a copy of
+// the arguments on the calling thread.
+//
+// Every thread gets its own single producer, single consumer ring buffer on its first message. Messages are encoded
+// in place: a header with a pointer to the format string literal, then the arguments in binary (strings are copied).
+// Nothing is allocated and no lock is taken after the first message of a thread. The writer wakes up periodically,
+// or at once for errors, drains all the rings, orders their messages by time and writes them in one batch.
+// The output is stdout, or the file named by the ASTERISM_LOG_FILE environment variable.
+//
+// Format strings are literals where "{}" is replaced by the next argument ("{:.N}" for N decimals), their placeholders
+// are checked against the arguments at compile time. Arguments are numbers, booleans, characters, strings and pointers.
+// A full ring blocks its thread until the writer catches up: messages are never dropped, except by LOG_EVERY.
+class Logger {
+public:
+    // Constructed on first use. Main constructs it first, so that it outlives the other singletons that log
+    static Logger &instance();
+
+    Logger();
+
+    ~Logger();
+
+    Logger(const Logger &) = delete;
+
+    Logger &operator=(const Logger &) = delete;
+
+    template<typename... Arguments>
+    void write(LogLevel level, LogStyle style, const char *format, uint32_t suppressed,
+               const Arguments &...arguments);
+
+    // Blocks until the messages written before the call are output
+    void flush();
+
+    // Compile-time checks of the format strings, -1 for malformed ones
+    static constexpr int countPlaceholders(const char *format);
+
+    template<typename... Arguments>
+    struct ArgumentList {
+        static constexpr int size = sizeof...(Arguments);
+    };
+
+    // Only used in unevaluated contexts, to count the arguments of the macros
+    template<typename... Arguments>
+    static ArgumentList<Arguments...> listArguments(const Arguments &...arguments);
+
+private:
+    // Ring size of each thread, messages bigger than half of it are formatted and written on the calling thread
+    static const uint32_t QUEUE_CAPACITY = 64 * 1024;
+    static const uint32_t MAX_RECORD_SIZE = QUEUE_CAPACITY / 2;
+    // Threads that log at the same time
+    static const uint32_t MAX_THREADS = 256;
+    // Latency of the messages that don't wake the writer
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL = std::chrono::milliseconds(20);
+
+    enum ArgumentType : uint8_t {
+        INT_ARGUMENT,
+        UINT_ARGUMENT,
+        DOUBLE_ARGUMENT,
+        BOOL_ARGUMENT,
+        CHAR_ARGUMENT,
+        STRING_ARGUMENT,
+        POINTER_ARGUMENT,
+    };
+
+    // Followed by the encoded arguments, each one is its ArgumentType then its value. Strings are their uint32_t length
+    // then their characters
+    struct RecordHeader {
+        // Of the whole record, rounded to the alignment of the headers
+        uint32_t size;
+        // Messages the rate limiter dropped before this one
+        uint32_t suppressed;
+        int64_t time;
+        // nullptr for the padding that skips the end of the ring
+        const char *format;
+        uint32_t threadIndex;
+        LogLevel level;
+        LogStyle style;
+    };
+
+    struct ThreadQueue {
+        // Written by the producer thread only
+        alignas(64) std::atomic<uint64_t> head = {0};
+        // Written by the writer thread only
+        alignas(64) std::atomic<uint64_t> tail = {0};
+        // Head of the record being written
+        uint64_t reservedHead = 0;
+        std::unique_ptr<char[]> buffer;
+        // Released when its thread exits, then reused by a new thread once drained
+        std::atomic<bool> isOwned = {false};
+        uint32_t threadIndex = 0;
+    };
+
+    // Releases the queue of a thread when it exits
+    struct QueueOwner {
+        ThreadQueue *queue = nullptr;
+
+        ~QueueOwner();
+    };
+
+    const std::chrono::steady_clock::time_point startTime;
+    FILE *output = nullptr;
+    bool isOutputOwned = false;
+    // Serializes the writer and the messages written on their thread
+    std::mutex outputMutex;
+
+    // Queues are never moved nor destroyed before the logger, so the writer reads the first 'queueCount' ones without
+    // holding the mutex
+    std::mutex queuesMutex;
+    std::unique_ptr<ThreadQueue> queues[MAX_THREADS];
+    std::atomic<uint32_t> queueCount = {0};
+    uint32_t nextThreadIndex = 0;
+
+    std::thread writer;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable drainCondition;
+    bool isWakeRequested = false;
+    bool isStopping = false;
+    bool isDraining = false;
+    uint64_t drainCount = 0;
+
+    // Reused by the writer
+    std::vector<const RecordHeader *> batch;
+    std::string message;
+    std::string text;
+
+    ThreadQueue &getThreadQueue();
+
+    ThreadQueue *acquireQueue();
+
+    // Space for a record of 'size' bytes, waits for the writer if the ring is full
+    char *reserve(ThreadQueue &queue, uint32_t size);
+
+    void commit(ThreadQueue &queue, uint32_t size);
+
+    // Formats and outputs a message that doesn't fit in a ring
+    void writeNow(const char *record);
+
+    void wake();
+
+    void writerLoop();
+
+    // Outputs all the committed records, writer thread only
+    void drain();
+
+    // Appends the laid out message to 'destination', 'message' is a scratch string
+    static void format(const RecordHeader &header, std::string &message, std::string &destination);
+
+    static void appendArgument(const char *&argument, std::string_view specification, std::string &destination);
+
+    static void appendCentered(std::string_view content, std::string &destination);
+
+    int64_t now() const;
+
+    template<typename T>
+    static uint32_t getEncodedSize(const T &argument);
+
+    template<typename T>
+    static char *encode(char *destination, const T &argument);
+
+    static uint32_t align(uint32_t size) {
+        return (size + alignof(RecordHeader) - 1) & ~uint32_t(alignof(RecordHeader) - 1);
+    }
+};
+
+constexpr int Logger::countPlaceholders(const char *format) {
+    int count = 0;
+    for (const char *character = format; *character != '\0'; ++character) {
+        if (*character == '{') {
+            // Up to the closing brace, with an optional specification in between
+            for (++character; *character != '}'; ++character) {
+                if (*character == '\0' || *character == '{') {
+                    return -1;
+                }
+            }
+            ++count;
+        } else if (*character == '}') {
+            return -1;
+        }
+    }
+    return count;
+}
+
+template<typename T>
+uint32_t Logger::getEncodedSize(const T &argument) {
+    if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+        return 1 + sizeof(uint64_t);
+    } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        if constexpr (std::is_pointer_v<T>) {
+            if (argument == nullptr) {
+                return 1 + sizeof(uint32_t);
+            }
+        }
+        return 1 + sizeof(uint32_t) + static_cast<uint32_t>(std::string_view(argument).size());
+    } else if constexpr (std::is_pointer_v<T>) {
+        return 1 + sizeof(uint64_t);
+    } else {
+        static_assert(std::is_pointer_v<T>, "Unsupported log argument type");
+        return 0;
+    }
+}
+
+template<typename T>
+char *Logger::encode(char *destination, const T &argument) {
+    auto encodeValue = [&destination](ArgumentType type, auto value) {
+        *destination++ = static_cast<char>(type);
+        memcpy(destination, &value, sizeof(value));
+        destination += sizeof(value);
+    };
+
+    if constexpr (std::is_same_v<T, bool>) {
+        encodeValue(BOOL_ARGUMENT, uint64_t(argument));
+    } else if constexpr (std::is_same_v<T, char>) {
+        encodeValue(CHAR_ARGUMENT, uint64_t(static_cast<unsigned char>(argument)));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        encodeValue(DOUBLE_ARGUMENT, double(argument));
+    } else if constexpr (std::is_enum_v<T>) {
+        encodeValue(INT_ARGUMENT, int64_t(argument));
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        encodeValue(INT_ARGUMENT, int64_t(argument));
+    } else if constexpr (std::is_integral_v<T>) {
+        encodeValue(UINT_ARGUMENT, uint64_t(argument));
+    } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        std::string_view string;
+        if constexpr (std::is_pointer_v<T>) {
+            string = argument != nullptr ? std::string_view(argument) : std::string_view();
+        } else {
+            string = std::string_view(argument);
+        }
+        *destination++ = static_cast<char>(STRING_ARGUMENT);
+        auto length = static_cast<uint32_t>(string.size());
+        memcpy(destination, &length, sizeof(length));
+        destination += sizeof(length);
+        memcpy(destination, string.data(), length);
+        destination += length;
+    } else {
+        encodeValue(POINTER_ARGUMENT, uint64_t(reinterpret_cast<uintptr_t>(argument)));
+    }
+    return destination;
+}
+
+template<typename... Arguments>
+void Logger::write(LogLevel level, LogStyle style, const char *format, uint32_t suppressed,
+                   const Arguments &...arguments) {
+    uint32_t size = align(sizeof(RecordHeader) + (getEncodedSize(arguments) + ... + 0));
+
+    // Oversized messages (e.g. shader compilation logs) are rare, they are encoded on the heap instead
+    std::unique_ptr<char[]> oversizedRecord;
+    ThreadQueue *queue = nullptr;
+    char *record;
+    if (size > MAX_RECORD_SIZE) {
+        AllowAllocationScope allowAllocations;
+        oversizedRecord = std::make_unique<char[]>(size);
+        record = oversizedRecord.get();
+    } else {
+        queue = &getThreadQueue();
+        record = reserve(*queue, size);
+    }
+
+    auto *header = new(record) RecordHeader();
+    header->size = size;
+    header->suppressed = suppressed;
+    header->time = now();
+    header->format = format;
+    header->threadIndex = queue ? queue->threadIndex : 0;
+    header->level = level;
+    header->style = style;
+    [[maybe_unused]] char *destination = record + sizeof(RecordHeader);
+    ((destination = encode(destination, arguments)), ...);
+
+    if (!queue) {
+        writeNow(record);
+        return;
+    }
+    commit(*queue, size);
+    if (level >= LOG_LEVEL_ERROR) {
+        wake();
+    }
+}
+
+// Formatted messages, e.g. LOG_INFO("{} particles in {:.2} ms", count, time)
+#define ASTERISM_LOG_WRITE(level, suppressed, format, ...)                                                          \
+    static_assert(Logger::countPlaceholders(format) ==                                                              \
+                  decltype(Logger::listArguments(__VA_ARGS__))::size, "Log format doesn't match its arguments");    \
+    Logger::instance().write(level, LOG_STYLE_RECORD, "" format, suppressed, ##__VA_ARGS__)
+
+#define LOG_AT(level, format, ...)                                                                                  \
+    do {                                                                                                            \
+        if constexpr ((level) >= ASTERISM_LOG_LEVEL) {                                                              \
+            ASTERISM_LOG_WRITE(level, 0, format, ##__VA_ARGS__);                                                    \
+        }                                                                                                           \
+    } while (false)
+
+#define LOG_DEBUG(format, ...) LOG_AT(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOG_WARNING(format, ...) LOG_AT(LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+
+// At most one message per interval from this call site, for messages that could be written every frame. The next
+// message that goes through reports how many were dropped
+#define LOG_EVERY(level, intervalMilliseconds, format, ...)                                                         \
+    do {                                                                                                            \
+        if constexpr ((level) >= ASTERISM_LOG_LEVEL) {                                                              \
+            static LogRateLimiter logRateLimiter(intervalMilliseconds);                                             \
+            uint32_t logSuppressed = 0;                                                                             \
+            if (logRateLimiter.allow(logSuppressed)) {                                                              \
+                ASTERISM_LOG_WRITE(level, logSuppressed, format, ##__VA_ARGS__);                                    \
+            }                                                                                                       \
+        }                                                                                                           \
+    } while (false)
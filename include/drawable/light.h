@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstdint>
+
+enum LightType {
+    POINT_LIGHT,
+    SPOT_LIGHT
+};
+
+// Point or spot light, a plain value so that it can travel in a FrameState
+struct Light {
+    LightType type = POINT_LIGHT;
+    glm::vec3 position = glm::vec3(0.0f);
+    // Distance at which the light fades out completely, lights only affect the clusters within it
+    float range = 1.0f;
+
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+
+    // Spot lights only
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    // Half angles of the cone in radians: full intensity inside the inner one, none outside of the outer one
+    float innerConeAngle = 0.3f;
+    float outerConeAngle = 0.5f;
+    // Spot lights only, see ShadowSettings::maxShadowedSpotLights
+    bool castsShadows = false;
+};
+
+// Light infinitely far away (e.g. the sun), lighting the whole scene outside of the clusters
+struct DirectionalLight {
+    // Direction the light travels in
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 color = glm::vec3(1.0f);
+    // 0 turns it off
+    float intensity = 0.0f;
+    bool castsShadows = true;
+};
+
+const uint32_t MAX_SHADOW_CASCADES = 4;
+const uint32_t MAX_SHADOWED_SPOT_LIGHTS = 4;
+
+// Settings of the shadow maps, fixed once they're created
+struct ShadowSettings {
+    // Texels per side of every shadow map, 0 disables the shadows
+    uint32_t resolution = 0;
+    // Cascades of the directional light, up to MAX_SHADOW_CASCADES
+    uint32_t cascadeCount = 3;
+    // The first spot lights casting shadows get a shadow map, in the order of the lights. Up to
+    // MAX_SHADOWED_SPOT_LIGHTS
+    uint32_t maxShadowedSpotLights = 4;
+    // Blend between logarithmic (1) and uniform (0) cascade splits
+    float cascadeSplitLambda = 0.75f;
+    // Depth bias of the casters, against shadow acne
+    float depthBiasConstant = 1.25f;
+    float depthBiasSlope = 1.75f;
+
+    uint32_t getCascadeCount() const { return resolution > 0 ? std::min(cascadeCount, MAX_SHADOW_CASCADES) : 0; }
+
+    uint32_t getSpotLightCapacity() const {
+        return resolution > 0 ? std::min(maxShadowedSpotLights, MAX_SHADOWED_SPOT_LIGHTS) : 0;
+    }
+};
+
+// Settings of the clustered lighting, fixed once it's created
+struct LightingSettings {
+    // Maximum amount of lights per frame, the ones after are ignored. 0 disables the lighting: surfaces are unlit
+    uint32_t capacity = 0;
+    // Lights a cluster can hold, the ones after are dropped
+    uint32_t maxLightsPerCluster = 128;
+    glm::vec3 ambient = glm::vec3(0.05f);
+    ShadowSettings shadows;
+};
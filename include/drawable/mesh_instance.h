@@ -0,0 +1,12 @@
+#pragma once
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Additional instance of the demo mesh, drawn in the main pass after the one of FrameState::model
+struct MeshInstance {
+    glm::mat4 model = glm::mat4(1.0f);
+    // Static instances are expected to rarely move: the shadow maps cache them, and only render them again when they
+    // or the lights move. Dynamic ones are drawn over the cached shadow maps every frame
+    bool isStatic = true;
+    bool castsShadows = true;
+};
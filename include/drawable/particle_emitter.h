@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
+
+// Most emitters a particle system takes per frame, the ones after are ignored
+const uint32_t MAX_PARTICLE_EMITTERS = 16;
+
+// Spawns particles into a particle system, a plain value so that it can travel in a FrameState.
+// Everything happens on the GPU: the CPU only says where to emit and how many particles per second.
+struct ParticleEmitter {
+    glm::vec3 position = glm::vec3(0.0f);
+    // Particles start at a random point of this sphere
+    float radius = 0.0f;
+
+    glm::vec3 velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+    // Magnitude of a random velocity added to each particle
+    float spread = 0.5f;
+
+    glm::vec4 color = glm::vec4(1.0f);
+
+    // Particles per second
+    float rate = 1000.0f;
+    // In seconds, randomized by +- lifetimeVariance
+    float lifetime = 2.0f;
+    float lifetimeVariance = 0.5f;
+    // Half extent of the particle billboards
+    float size = 0.01f;
+};
+
+// Settings of a particle system, fixed once it's created
+struct ParticleSystemSettings {
+    // Maximum amount of live particles, 0 disables the particle system
+    uint32_t capacity = 0;
+    glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+    // Fraction of the velocity lost per second
+    float drag = 0.1f;
+};
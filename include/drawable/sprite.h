@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <array>
+#include <cstdint>
+
+#include "renderer/pipeline_manager.h"
+
+// A colored and optionally textured quad of a 2D scene
+struct Sprite {
+    // Center, in world units
+    glm::vec2 position = glm::vec2(0.0f);
+    glm::vec2 size = glm::vec2(0.1f);
+    // Counterclockwise, in radians
+    float rotation = 0.0f;
+    glm::vec4 color = glm::vec4(1.0f);
+
+    // Texture array of the sprite (0 for none) and layer in it. Sprites only break batches when their texture or
+    // their blend mode changes, so atlases and arrays keep many different images in one draw
+    uint32_t texture = 0;
+    uint32_t textureLayer = 0;
+    BlendMode blendMode = ALPHA_BLENDING;
+};
+
+// Per instance vertex data of a sprite, as read by shaders/sprites/sprite.vert. Plain floats keep it packed in 28
+// bytes whatever the glm alignment settings
+struct SpriteInstance {
+    float position[2];
+    float size[2];
+    float rotation;
+    // RGBA8
+    uint32_t color;
+    uint32_t textureLayer;
+
+    static SpriteInstance fromSprite(const Sprite &sprite);
+
+    static VkVertexInputBindingDescription getBindingDescription();
+
+    static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions();
+};
+
+static_assert(sizeof(SpriteInstance) == 28, "SpriteInstance must match the vertex input layout");
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <vector>
+
+#include "queue_manager.h"
+#include "renderer_utility.h"
+#include "core/frame_arena.h"
+
+// Compute work (culling, simulation, ...) submitted to the compute queue ahead of the graphics work of the same frame.
+// Frame N's compute is submitted as soon as its frame slot is free, so on GPUs with a dedicated compute family (or a
+// second queue) it runs while the graphics queue is still busy with frame N - 1. The graphics submission of frame N
+// waits on the compute timeline, only at the stages that consume the compute results.
+//
+// Buffers written by compute and read by graphics are declared as outputs. When the two queues belong to different
+// families, their ownership is released and acquired on both sides (buffers are VK_SHARING_MODE_EXCLUSIVE).
+class AsyncCompute {
+public:
+    // Records the compute work of a frame, 'slot' selects the per frame slot resources
+    using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t slot)>;
+
+    // Barrier lists are allocated in the current frame of 'arena'
+    void initialize(VkDevice vkDevice, QueueManager &queueManager, uint32_t slotCount, FrameArena &arena);
+
+    // 'graphicsFrameDistance' > 0 makes the compute work of frame N wait for the graphics work of frame
+    // N - graphicsFrameDistance, for resources that compute overwrites while older frames may still read them (e.g.
+    // ping-pong buffers use 2). Free when the frame slot wait already covers it
+    void addWork(RecordFunction record, uint32_t graphicsFrameDistance = 0);
+
+    // A buffer written by the compute work of the frames using 'slot' and read by their graphics work, at the given
+    // stages. A buffer shared by every frame is declared for every slot, compute then also waits for the graphics
+    // work of the previous frame to be done with it.
+    // Returned outputs go back to the compute family at the end of each graphics frame, for compute to write them
+    // again. Outputs that aren't returned are only written once
+    void addOutput(uint32_t slot, VkBuffer buffer, VkPipelineStageFlags graphicsStages, VkAccessFlags graphicsAccess,
+                   bool isReturned = true);
+
+    // Graphics stages consuming compute results from buffers shared with VK_SHARING_MODE_CONCURRENT, which need the
+    // semaphore wait but no ownership transfers
+    void addGraphicsWaitStages(VkPipelineStageFlags stages) { sharedWaitStages |= stages; }
+
+    bool hasWork() const { return !works.empty(); }
+
+    // Records and submits the compute work of a frame, which signals the compute timeline with 'frameNumber' + 1.
+    // 'frameTimeline' is the graphics timeline (signaled with N + 1 once frame N is done). A frame is only submitted
+    // once, even if its graphics submission is skipped (e.g. on an out of date swapchain) and drawn again
+    void submit(uint64_t frameNumber, uint32_t slot, VkSemaphore frameTimeline);
+
+    // Graphics side of the ownership transfers, recorded at the start and at the end of the graphics command buffer
+    void recordAcquire(VkCommandBuffer graphicsCommandBuffer, uint32_t slot);
+
+    void recordRelease(VkCommandBuffer graphicsCommandBuffer, uint32_t slot, uint64_t frameNumber);
+
+    // What the graphics submission of a frame must wait on, if hasWork()
+    VkSemaphore getTimeline() const { return computeTimeline; }
+
+    VkPipelineStageFlags getGraphicsWaitStages(uint32_t slot) const;
+
+    void cleanup();
+
+private:
+    // Queue family owning an output. A release on one side is always followed by the acquire on the other
+    enum Ownership {
+        COMPUTE_OWNED,
+        RELEASED_TO_GRAPHICS,
+        GRAPHICS_OWNED,
+        RELEASED_TO_COMPUTE
+    };
+
+    struct Output {
+        VkBuffer buffer;
+        VkPipelineStageFlags graphicsStages;
+        VkAccessFlags graphicsAccess;
+        bool isReturned;
+        Ownership ownership;
+        // Value of the frame timeline once the last graphics frame using the buffer is done
+        uint64_t lastGraphicsUse;
+    };
+
+    struct Slot {
+        VkCommandBuffer commandBuffer;
+        // Indices in 'outputs', a buffer used by several slots is only tracked once
+        std::vector<size_t> outputs;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    FrameArena *frameArena = nullptr;
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    uint32_t computeFamily = 0;
+    uint32_t graphicsFamily = 0;
+    bool isOwnershipTransferred = false;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<Slot> slots;
+    std::vector<Output> outputs;
+    std::vector<RecordFunction> works;
+    uint32_t graphicsFrameDistance = 0;
+    VkPipelineStageFlags sharedWaitStages = 0;
+
+    VkSemaphore computeTimeline = VK_NULL_HANDLE;
+    // Last frame that was submitted, + 1
+    uint64_t submittedFrames = 0;
+
+    static VkBufferMemoryBarrier ownershipBarrier(VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+                                                  VkAccessFlags srcAccess, VkAccessFlags dstAccess);
+};
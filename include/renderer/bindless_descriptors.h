@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+#include "renderer_utility.h"
+
+// Graphics pipelines of the scene share one pipeline layout: set 0 holds the frame uniforms, set 1 the bindless
+// arrays, and each draw selects its resources with push constants. Sets are bound once per pass, pipelines can be
+// switched without rebinding them. The push constant range is reflected from the scene shaders, and always covers
+// these stages: push constants must be updated with all the stages of the range they overlap
+const VkShaderStageFlags SCENE_PUSH_CONSTANT_STAGES = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+// Index of a resource in the bindless arrays
+using BindlessIndex = uint32_t;
+
+// One descriptor set with large arrays of every resource type, built on descriptor indexing (core in Vulkan 1.2):
+//  - binding 0: combined image samplers (sampler2DArray textures[] in shaders/bindless.glsl)
+//  - binding 1: storage buffers
+// Bindings are partially bound and update-after-bind: registering a resource writes an unused element of the arrays,
+// which is allowed while frames using the set are in flight. Resources stay registered until cleanup.
+// Not thread-safe: meant to be used by the render thread only.
+class BindlessDescriptors {
+public:
+    void initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice);
+
+    BindlessIndex addTexture(VkImageView imageView, VkSampler sampler);
+
+    BindlessIndex addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+
+    VkDescriptorSet getSet() const { return descriptorSet; }
+
+    void cleanup();
+
+private:
+    // Upper bounds of the arrays, lowered to the device limits
+    static const uint32_t MAX_TEXTURES = 4096;
+    static const uint32_t MAX_STORAGE_BUFFERS = 1024;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    uint32_t textureCapacity = 0;
+    uint32_t storageBufferCapacity = 0;
+    uint32_t textureCount = 0;
+    uint32_t storageBufferCount = 0;
+};
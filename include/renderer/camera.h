@@ -31,6 +31,23 @@ public:
     Camera(ViewParams viewParams, PerspectiveParams perspectiveParams);
     Camera(ViewParams viewParams, OrthogonalParams orthogonalParams);
 
+    // The aspect ratio follows the swapchain extent
+    void setScreenSize(glm::vec2 size);
+
+    const glm::mat4 &getView() const { return view; }
+
+    // Already flipped for the Vulkan clip space
+    const glm::mat4 &getProjection() const { return proj; }
+
+    glm::mat4 getViewProjection() const { return proj * view; }
+
+    ProjType getProjType() const { return projType; }
+
+    // Distances to the clipping planes, along the view direction
+    float getNearPlane() const { return nearPlane; }
+
+    float getFarPlane() const { return farPlane; }
+
 private:
     glm::vec3 position;
     glm::vec3 target;
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+#include "bindless_descriptors.h"
+#include "camera.h"
+#include "gpu_buffer.h"
+#include "gpu_timer.h"
+#include "memory_budget.h"
+#include "pipeline_manager.h"
+#include "queue_manager.h"
+#include "renderer_utility.h"
+#include "drawable/light.h"
+
+// Lighting data of the frame uniforms (std140), must match frame_uniforms.glsl
+struct LightingUniforms {
+    // x, y, z: clusters along each axis, w: amount of lights
+    glm::uvec4 clusterCounts;
+    // x, y: pixels per cluster tile, z and w: scale and bias of the depth slices (slice = log(depth) * z + w)
+    glm::vec4 clusterScale;
+    glm::vec4 ambient;
+    // Bindless storage buffers of the slot, x: lights, y: cluster ranges, z: light indices
+    glm::uvec4 buffers;
+    // Directional light, xyz: direction it travels in, in view space
+    glm::vec4 directionalDirection;
+    // rgb: color times intensity
+    glm::vec4 directionalColor;
+};
+
+// Clustered forward lighting: the view frustum is cut into a grid of clusters (screen tiles, and depth slices that
+// grow exponentially with the distance), a compute pass lists the lights touching each cluster, and the fragment
+// shader only loops over the lights of its cluster. The cost follows the lights per pixel, not the lights per frame.
+//
+// The CPU uploads the lights of the frame in view space. The binning is a pass of the render graph, recorded on the
+// graphics queue right before the main pass which reads its lists through the bindless storage buffers.
+class ClusteredLighting {
+public:
+    void initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, MemoryBudget &budget, QueueManager &queues,
+                    PipelineManager &pipelines, BindlessDescriptors &bindless,
+                    const LightingSettings &lightingSettings, uint32_t slotCount);
+
+    bool isEnabled() const { return capacity > 0; }
+
+    // Binning compute shader
+    static std::string getShaderPath();
+
+    // Uploads the lights of the frame to the slot, in the view space of 'camera', and returns the uniforms the
+    // fragment shader needs to find them and the directional light
+    LightingUniforms update(uint32_t slot, const std::vector<Light> &frameLights,
+                            const DirectionalLight &directionalLight, const Camera &camera, VkExtent2D extent);
+
+    // Lists the lights of every cluster, outside of a render pass
+    void recordBinning(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    // Written by the binning of a slot, imported into the render graph
+    VkBuffer getClusterBuffer(uint32_t slot) const { return slots[slot].clusters.buffer; }
+
+    VkBuffer getLightIndexBuffer(uint32_t slot) const { return slots[slot].lightIndices.buffer; }
+
+    VkDeviceSize getClusterBufferSize() const;
+
+    VkDeviceSize getLightIndexBufferSize() const;
+
+    uint32_t getCapacity() const { return capacity; }
+
+    // Lights of the last updated frame, at most the capacity
+    uint32_t getLightCount() const { return lightCount; }
+
+    // GPU time of the binning of the last completed frame, in milliseconds. 0 if the graphics queue doesn't support
+    // timestamps
+    double getBinningTime() const { return binningTime; }
+
+    void cleanup();
+
+private:
+    // Cluster grid: 16:9 tiles, the usual aspect ratio of the screen
+    static const uint32_t CLUSTER_COUNT_X = 16;
+    static const uint32_t CLUSTER_COUNT_Y = 9;
+    static const uint32_t CLUSTER_COUNT_Z = 24;
+    static const uint32_t CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+
+    // Storage buffer layout of a light, in view space, must match light_binning.comp and clustered_lighting.glsl
+    struct LightData {
+        // xyz: position, w: range
+        glm::vec4 positionRange;
+        // rgb: color times intensity, w: cosine of the inner cone angle
+        glm::vec4 colorInner;
+        // xyz: direction, w: cosine of the outer cone angle (below -1 for point lights)
+        glm::vec4 directionOuter;
+        // x: layer of its shadow map (see ShadowMaps), negative without
+        glm::vec4 shadow;
+    };
+
+    // Push constants of the binning, must match light_binning.comp
+    struct BinningConstants {
+        // x: proj[0][0], y: proj[1][1], z: near plane, w: far plane
+        glm::vec4 projection;
+        // x, y, z: clusters along each axis, w: amount of lights
+        glm::uvec4 clusterCounts;
+        uint32_t maxLightsPerCluster;
+    };
+
+    struct Slot {
+        // Written by the CPU
+        GpuBuffer lights;
+        // Written by the binning: first index and amount of lights per cluster, and the indices themselves
+        GpuBuffer clusters;
+        GpuBuffer lightIndices;
+        VkDescriptorSet descriptorSet;
+        // Bindless indices, read by the fragment shader
+        glm::uvec4 bindlessBuffers;
+        BinningConstants constants;
+        bool isBinned;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryBudget *memoryBudget = nullptr;
+    PipelineManager *pipelineManager = nullptr;
+
+    uint32_t capacity = 0;
+    LightingSettings settings;
+    std::vector<Slot> slots;
+
+    // Layouts reflected from the binning shader, owned by the pipeline manager
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    std::string binningShaderPath;
+
+    // Statistics:
+    GpuTimer timer;
+    uint32_t lightCount = 0;
+    double binningTime = 0.0;
+
+    void createDescriptorSets();
+
+    // Collects the statistics of the last frame binned with the slot, which is done
+    void readStatistics(uint32_t slotIndex);
+};
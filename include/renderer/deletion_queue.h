@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "memory_budget.h"
+
+// Vulkan handles that were retired while the GPU may still use them, destroyed once the frame timeline reaches the
+// value they were retired with. A handle last recorded in frame N is safe once N is done, i.e. at value N + 1: handles
+// retired between two frames use the amount of frames submitted so far. The compute and upload work of a frame is
+// waited on by its graphics work, so the frame timeline covers it too.
+//
+// Replaces waiting for the device to be idle: resizes and shader reloads retire what they replace and carry on.
+// Not thread-safe: used by the render thread.
+class DeletionQueue {
+public:
+    // Memory is given back to 'budget', which allocated it
+    void initialize(VkDevice vkDevice, MemoryBudget &budget);
+
+    void retireBuffer(VkBuffer buffer, uint64_t timelineValue);
+
+    void retireMemory(VkDeviceMemory memory, uint64_t timelineValue);
+
+    void retireImage(VkImage image, uint64_t timelineValue);
+
+    void retireImageView(VkImageView imageView, uint64_t timelineValue);
+
+    void retireFramebuffer(VkFramebuffer framebuffer, uint64_t timelineValue);
+
+    void retireRenderPass(VkRenderPass renderPass, uint64_t timelineValue);
+
+    void retirePipeline(VkPipeline pipeline, uint64_t timelineValue);
+
+    void retireSemaphore(VkSemaphore semaphore, uint64_t timelineValue);
+
+    void retireSwapchain(VkSwapchainKHR swapchain, uint64_t timelineValue);
+
+    // Destroys the handles retired with a value up to 'completedValue'
+    void collect(uint64_t completedValue);
+
+    // Destroys everything, the device must be idle
+    void flush();
+
+    void cleanup() { flush(); }
+
+private:
+    enum HandleType {
+        BUFFER_HANDLE,
+        MEMORY_HANDLE,
+        IMAGE_HANDLE,
+        IMAGE_VIEW_HANDLE,
+        FRAMEBUFFER_HANDLE,
+        RENDER_PASS_HANDLE,
+        PIPELINE_HANDLE,
+        SEMAPHORE_HANDLE,
+        SWAPCHAIN_HANDLE
+    };
+
+    // Non-dispatchable handles are pointers or 64-bit integers depending on the platform, both fit in a uint64_t
+    struct RetiredHandle {
+        HandleType type;
+        uint64_t handle;
+        uint64_t timelineValue;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryBudget *memoryBudget = nullptr;
+    // Mostly in retirement order, so mostly sorted by value
+    std::vector<RetiredHandle> retiredHandles;
+
+    void retire(HandleType type, uint64_t handle, uint64_t timelineValue);
+
+    void destroy(const RetiredHandle &retired);
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "gpu_timer.h"
+#include "queue_manager.h"
+#include "renderer_utility.h"
+
+// Settings of the dynamic resolution, fixed once the renderer is initialized
+struct DynamicResolutionSettings {
+    // GPU time budget of the scene in milliseconds, 0 (the default) disables the scaling: the scene is rendered
+    // straight into the swapchain, at its resolution
+    double targetFrameTime = 0.0;
+    // Bounds of the render scale, per axis and relative to the swapchain extent. The offscreen target is allocated
+    // for the maximum, up to 2 (supersampling)
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+};
+
+// Dynamic resolution: the scene is rendered into an offscreen target, in a render area that follows the GPU time of
+// the previous frames, and blitted to the swapchain with a bilinear filter. The frame rate holds under heavy load,
+// the resolution drops instead.
+//
+// The GPU time of the scene (from the start of the frame to the end of the main pass) is measured with timestamps.
+// The cost of a frame roughly follows its amount of pixels, the square of the scale: the scale is moved towards the
+// one that would fit the budget, but only once the frames rendered at the current scale have been measured, and only
+// if they're off the budget by more than a margin, so that the resolution doesn't flicker.
+class DynamicResolution {
+public:
+    // Disabled if the settings don't set a budget, if the graphics queue doesn't support timestamps, or if the
+    // swapchain images can't be blitted to (they need VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+    void initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, QueueManager &queues,
+                    const DynamicResolutionSettings &resolutionSettings, uint32_t slotCount,
+                    VkFormat swapchainFormat, VkImageUsageFlags swapchainUsage);
+
+    bool isEnabled() const { return timer.isAvailable(); }
+
+    // Extent of the offscreen target: the swapchain extent at the maximum scale
+    VkExtent2D getTargetExtent(VkExtent2D swapchainExtent) const;
+
+    // Measures the last completed frame of the slot, updates the scale, and returns the render area of the frame
+    VkExtent2D update(uint32_t slot, VkExtent2D swapchainExtent);
+
+    // Brackets the measured GPU work of the frame of the slot. The end may be recorded inside a render pass
+    void recordStart(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    void recordEnd(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    // Blits the render area of the target to the whole swapchain image, outside of a render pass. The target must be
+    // in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL and the swapchain image in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+    void recordUpscale(VkCommandBuffer commandBuffer, VkImage target, VkImage swapchainImage,
+                       VkExtent2D swapchainExtent) const;
+
+    float getScale() const { return scale; }
+
+    VkExtent2D getRenderExtent() const { return renderExtent; }
+
+    // Smoothed GPU time of the scene, in milliseconds
+    double getFrameTime() const { return frameTime; }
+
+    void cleanup();
+
+private:
+    struct Slot {
+        // Scale the frame of the slot was rendered at, its time is ignored once the scale changed
+        float scale;
+        bool isMeasured;
+    };
+
+    // Relative distance to the budget that is tolerated without changing the scale
+    static constexpr double BUDGET_MARGIN = 0.1;
+    // Measured frames at the current scale before it can change again
+    static const uint32_t SETTLE_FRAMES = 8;
+    // Weight of a new measure in the smoothed time
+    static constexpr double SMOOTHING = 0.2;
+    // Scales are rounded to this step
+    static constexpr float SCALE_STEP = 1.0f / 64.0f;
+
+    DynamicResolutionSettings settings;
+    std::vector<Slot> slots;
+
+    GpuTimer timer;
+
+    float scale = 1.0f;
+    VkExtent2D renderExtent = {0, 0};
+    double frameTime = 0.0;
+    uint32_t settledFrames = 0;
+
+    // Moves the scale towards the budget, once the current one is settled
+    void adjustScale();
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "drawable/light.h"
+#include "drawable/mesh_instance.h"
+#include "drawable/particle_emitter.h"
+
+// Immutable snapshot of everything the renderer needs to draw one frame.
+// Produced by the simulation thread at a fixed tick rate and handed over to the render thread.
+struct FrameState {
+    // Simulation tick that produced this snapshot
+    uint64_t tick = 0;
+    // Simulated time in seconds
+    double simulationTime = 0.0;
+
+    // Transform of the drawn object
+    glm::mat4 model = glm::mat4(1.0f);
+    // More instances of it, which can cast shadows. Reuses its storage like the particle emitters
+    std::vector<MeshInstance> meshInstances;
+
+    // Emitters of the particle system (see ParticleSystemSettings). Copying a snapshot into a slot that already holds
+    // one reuses its storage, so this doesn't allocate once the amount of emitters is stable
+    std::vector<ParticleEmitter> particleEmitters;
+
+    // Lights of the clustered lighting (see LightingSettings), in world space. Same storage reuse as the emitters
+    std::vector<Light> lights;
+    DirectionalLight directionalLight;
+};
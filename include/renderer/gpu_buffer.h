@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "memory_budget.h"
+#include "renderer_utility.h"
+
+// Buffer with its own allocation from the MemoryBudget (BUFFER_MEMORY). Host visible buffers are persistently mapped
+struct GpuBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *data = nullptr;
+
+    // Device local unless 'isHostVisible'. Shared concurrently by 'queueFamilies' when there are several of them,
+    // exclusive otherwise
+    static GpuBuffer create(VkDevice device, MemoryBudget &budget, VkDeviceSize size, VkBufferUsageFlags usage,
+                            bool isHostVisible, const std::vector<uint32_t> &queueFamilies = {});
+
+    // Leaves the buffer empty
+    void destroy(VkDevice device, MemoryBudget &budget);
+};
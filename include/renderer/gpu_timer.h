@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "renderer_utility.h"
+
+// GPU time of a span of commands, measured with a pair of timestamps per frame slot. Unavailable when the queue
+// family doesn't support timestamps: recording does nothing then, and no time is ever read
+class GpuTimer {
+public:
+    // 'queueFamily' is the family of the queue the spans are submitted to
+    void initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t slotCount);
+
+    bool isAvailable() const { return queryPool != VK_NULL_HANDLE; }
+
+    // Before and after the commands of the slot, in the same command buffer
+    void recordStart(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    void recordEnd(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    // Milliseconds between the timestamps of the slot, once its commands are done. False if they aren't available
+    bool readTime(uint32_t slot, double &milliseconds) const;
+
+    void cleanup();
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    // Nanoseconds per tick
+    float period = 0.0f;
+};
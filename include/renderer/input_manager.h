@@ -1,11 +1,31 @@
 #pragma once
 
 #include <GLFW/glfw3.h>
+#include <chrono>
 #include <iostream>
 #include <vector>
 
 #include "renderer_utility.h"
 
+enum InputEventType {
+    KEY_EVENT,
+    MOUSE_POSITION_EVENT,
+    MOUSE_BUTTON_EVENT,
+    MOUSE_SCROLL_EVENT
+};
+
+struct InputEvent {
+    InputEventType type;
+    // Key or mouse button, and GLFW action (press, release, repeat)
+    int code;
+    int action;
+    // Mouse position or scroll offset
+    double x;
+    double y;
+    // When GLFW delivered the event, which is the closest to when it happened that can be known
+    std::chrono::steady_clock::time_point timestamp;
+};
+
 class InputManager {
 public:
 
@@ -39,8 +59,8 @@ public:
     }
 
     // Mouse position
-    double posX;
-    double posY;
+    double posX = 0.0;
+    double posY = 0.0;
 
     // Mouse Clicks
     bool isMouseLeftPressed = false;
@@ -48,8 +68,14 @@ public:
     bool isMouseMiddlePressed = false;
 
     // Mouse scroll
-    double offsetX;
-    double offsetY;
+    double offsetX = 0.0;
+    double offsetY = 0.0;
+
+    // Events of the last poll, in the order they were received
+    const std::vector<InputEvent> &getEvents() const { return events; }
+
+    // Called right before polling, the events of the previous poll are dropped
+    void clearEvents() { events.clear(); }
 
 private:
     // Fullscreen functionality
@@ -61,6 +87,10 @@ private:
 
     void toggleFullscreen(GLFWwindow *window);
 
+    std::vector<InputEvent> events;
+
+    void recordEvent(InputEventType type, int code, int action, double x, double y);
+
 
 
     // Member functions that are called from the dispatchers with the proper InputManager handling instance
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "renderer_utility.h"
+
+// What device memory is used for, accounted separately
+enum MemoryCategory {
+    MESH_MEMORY,
+    TEXTURE_MEMORY,
+    // Transient attachments of the render graph
+    RENDER_TARGET_MEMORY,
+    STAGING_MEMORY,
+    UNIFORM_MEMORY,
+    // Other buffers (particles, sprite instances, ...)
+    BUFFER_MEMORY,
+    MEMORY_CATEGORY_COUNT
+};
+
+// Device memory allocations go through here, so that their size is known per heap and per category.
+//
+// The budget of a heap is what the driver reports through VK_EXT_memory_budget when the device supports it (it
+// accounts for the other processes), 80% of the heap size otherwise. ASTERISM_VRAM_LIMIT_MB adds a hard limit on what
+// the renderer allocates from device local heaps.
+// Streaming systems register pressure callbacks, asked to release memory when a heap is over its budget: at update(),
+// and before an allocation that doesn't fit. Memory that is released goes through the DeletionQueue, it counts as
+// freed from then on since it's returned within a few frames.
+// Not thread-safe: used by the render thread.
+class MemoryBudget {
+public:
+    // Releases memory from 'heapIndex' (e.g. by evicting resources), about 'size' bytes. Returns the released size
+    using PressureCallback = std::function<VkDeviceSize(uint32_t heapIndex, VkDeviceSize size)>;
+
+    // 'hasBudgetExtension' if VK_EXT_memory_budget is enabled on the device
+    void initialize(VkPhysicalDevice vkPhysicalDevice, VkDevice vkDevice, bool hasBudgetExtension);
+
+    void addPressureCallback(PressureCallback callback) { pressureCallbacks.push_back(std::move(callback)); }
+
+    // Allocates from a memory type with 'properties', preferring the ones that also have 'preferredProperties'.
+    // Types whose heap is over its budget come last, and one that runs out of memory falls back to the next one.
+    // Throws if nothing fits, or if the allocation would go past the hard limit
+    VkDeviceMemory allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                            MemoryCategory category, VkMemoryPropertyFlags preferredProperties = 0);
+
+    void free(VkDeviceMemory memory);
+
+    // Frame boundary: refreshes the budgets, and asks the callbacks to release memory from the heaps over theirs
+    void update();
+
+    VkDeviceSize getCategoryUsage(MemoryCategory category) const { return categoryUsage[category]; }
+
+    // Allocated by the renderer from device local heaps
+    VkDeviceSize getDeviceLocalUsage() const;
+
+    // Per heap and per category usage
+    void report() const;
+
+private:
+    struct Heap {
+        VkDeviceSize size = 0;
+        VkDeviceSize budget = 0;
+        // Of the whole process according to the driver, or allocated by the renderer without the extension
+        VkDeviceSize usage = 0;
+        // Allocated by the renderer
+        VkDeviceSize allocated = 0;
+        // Released by the pressure callbacks, but not freed yet
+        VkDeviceSize releasing = 0;
+        bool isDeviceLocal = false;
+    };
+
+    struct Allocation {
+        VkDeviceSize size;
+        uint32_t memoryType;
+        MemoryCategory category;
+    };
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+    bool isBudgetReported = false;
+    // 0 if there is none
+    VkDeviceSize deviceLocalLimit = 0;
+
+    std::vector<Heap> heaps;
+    VkDeviceSize categoryUsage[MEMORY_CATEGORY_COUNT] = {};
+    std::unordered_map<VkDeviceMemory, Allocation> allocations;
+    std::vector<PressureCallback> pressureCallbacks;
+
+    void updateBudgets();
+
+    VkDeviceSize getReleasingDeviceLocalSize() const;
+
+    // Room left in the heap before it goes over its budget or the hard limit
+    VkDeviceSize getAvailableSize(uint32_t heapIndex) const;
+
+    // Calls the callbacks until 'size' bytes are released from the heap or none of them has anything left
+    VkDeviceSize relievePressure(uint32_t heapIndex, VkDeviceSize size);
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "bindless_descriptors.h"
+#include "gpu_buffer.h"
+#include "gpu_timer.h"
+#include "memory_budget.h"
+#include "queue_manager.h"
+#include "pipeline_manager.h"
+#include "renderer_utility.h"
+#include "vulkan_core.h"
+#include "drawable/particle_emitter.h"
+
+// GPU particle system: emission, simulation and compaction are compute passes over structure of arrays storage
+// buffers, and the live particles are drawn indirectly from a count written by the GPU (with vkCmdDrawIndirectCount
+// when the device supports it, so that frames without live particles skip the draw). The CPU never touches
+// per-particle data, it only uploads the emitters of the frame.
+//
+// Particles live in two pools that swap roles every frame: the live particles of the source pool are simulated and
+// the survivors are compacted into the destination pool, which is drawn. The compute work is recorded on the async
+// compute queue (see AsyncCompute), the pools are shared concurrently with the graphics queue. The draw reads the
+// pools through the bindless storage buffers, with the scene pipeline layout.
+class ParticleSystem {
+public:
+    void initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, const DeviceFeatures &deviceFeatures,
+                    MemoryBudget &budget, QueueManager &queues,
+                    PipelineManager &pipelines, BindlessDescriptors &bindless,
+                    VkPipelineLayout scenePipelineLayout, VkRenderPass renderPass,
+                    const ParticleSystemSettings &particleSettings, uint32_t slotCount);
+
+    bool isEnabled() const { return capacity > 0; }
+
+    // For hot reload
+    std::vector<std::string> getShaderPaths() const;
+
+    // Shaders of the draw, for the reflection of the scene pipeline layout
+    static std::vector<std::string> getDrawShaderPaths();
+
+    // Emission, preparation, simulation and finalization
+    static std::vector<std::string> getComputeShaderPaths();
+
+    // Emitters of the next simulated frame
+    void setEmitters(const std::vector<ParticleEmitter> &frameEmitters);
+
+    // Emission, simulation and compaction of a frame, recorded on the compute queue
+    void recordCompute(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    // Pipelines are created for this render pass from now on
+    void setRenderPass(VkRenderPass renderPass);
+
+    // Draws the particles simulated by the last recordCompute() of the slot, inside a render pass where the sets of
+    // the scene pipeline layout are bound
+    void recordDraw(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    uint32_t getCapacity() const { return capacity; }
+
+    // Live particles after the last completed frame
+    uint32_t getAliveCount() const { return aliveCount; }
+
+    // GPU time of the compute passes of the last completed frame, in milliseconds. 0 if the compute queue doesn't
+    // support timestamps
+    double getSimulationTime() const { return simulationTime; }
+
+    void cleanup();
+
+private:
+    // Work group sizes of the compute shaders
+    static const uint32_t EMIT_GROUP_SIZE = 64;
+    static const uint32_t SIMULATION_GROUP_SIZE = 256;
+
+    // Uniform buffer layouts (std140), must match particle_common.glsl
+    struct EmitterData {
+        glm::vec4 position;
+        glm::vec4 velocity;
+        glm::vec4 color;
+        glm::vec4 properties;
+        glm::uvec4 emission;
+    };
+
+    struct ParameterData {
+        glm::vec4 gravity;
+        float deltaTime;
+        float time;
+        uint32_t capacity;
+        uint32_t sourcePool;
+        uint32_t emitCount;
+        uint32_t emitterCount;
+        uint32_t seed;
+        uint32_t padding;
+        EmitterData emitters[MAX_PARTICLE_EMITTERS];
+    };
+
+    // Storage buffer layout of the counters, must match particle_common.glsl
+    struct CounterData {
+        uint32_t aliveCounts[2];
+        VkDispatchIndirectCommand dispatch;
+    };
+
+    // Storage buffer layout of the draw command, must match particle_common.glsl
+    struct DrawData {
+        VkDrawIndirectCommand command;
+        // 1 when particles are alive, 0 otherwise: the draw count of vkCmdDrawIndirectCount
+        uint32_t drawCount;
+    };
+
+    // Push constants of the draw, must match particle.vert
+    struct PoolIndices {
+        BindlessIndex positions;
+        BindlessIndex velocities;
+        BindlessIndex appearances;
+    };
+
+    struct Slot {
+        GpuBuffer parameters;
+        // Read back once the frame using the slot is done
+        GpuBuffer drawCommand;
+        // One per source pool
+        VkDescriptorSet descriptorSets[2];
+        // Source pool of the last frame simulated with this slot
+        uint32_t sourcePool;
+        bool isSimulated;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryBudget *memoryBudget = nullptr;
+    PipelineManager *pipelineManager = nullptr;
+    std::vector<uint32_t> queueFamilies;
+
+    uint32_t capacity = 0;
+    ParticleSystemSettings settings;
+    bool hasDrawIndirectCount = false;
+
+    // Structure of arrays: positions and ages, velocities and lifetimes, colors and sizes
+    GpuBuffer positions[2];
+    GpuBuffer velocities[2];
+    GpuBuffer appearances[2];
+    PoolIndices bindlessPools[2];
+    GpuBuffer counters;
+    bool isCleared = false;
+    std::vector<Slot> slots;
+
+    // Layouts reflected from the compute shaders, owned by the pipeline manager
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    // Set 0: unused by the compute passes, set 1: particles
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    // Owned by the renderer
+    VkPipelineLayout drawPipelineLayout = VK_NULL_HANDLE;
+    PipelineKey drawPipelineKey;
+
+    std::string emitShaderPath;
+    std::string prepareShaderPath;
+    std::string simulateShaderPath;
+    std::string finalizeShaderPath;
+
+    // Emission:
+    std::vector<ParticleEmitter> emitters;
+    // Fractional particles carried over to the next frame, per emitter
+    std::vector<double> emissionRemainders;
+    uint64_t simulatedFrames = 0;
+    std::chrono::steady_clock::time_point lastSimulation;
+    double elapsedTime = 0.0;
+
+    // Statistics:
+    GpuTimer timer;
+    uint32_t aliveCount = 0;
+    double simulationTime = 0.0;
+
+    // Shared concurrently by the compute and graphics queues when they're of different families
+    GpuBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool isHostVisible);
+
+    void createDescriptorSets(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
+    // Fills the parameters of the slot, returns the amount of particles to emit
+    uint32_t updateParameters(Slot &slot, uint32_t sourcePool);
+
+    // Collects the statistics of the last frame simulated with the slot, which is done
+    void readStatistics(Slot &slot, uint32_t slotIndex);
+
+    static void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                               VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+};
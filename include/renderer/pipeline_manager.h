@@ -0,0 +1,169 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+
+#include "shader_manager.h"
+#include "renderer_utility.h"
+#include "drawable/vertex.h"
+
+// How vertices are fed to the vertex shader
+enum VertexLayout {
+    // No vertex buffers, the vertex shader generates or fetches its own data (e.g. from storage buffers)
+    NO_VERTEX_LAYOUT,
+    // Interleaved Vertex structs (see drawable/vertex.h)
+    VERTEX_LAYOUT,
+    // One SpriteInstance per instance (see drawable/sprite.h)
+    SPRITE_INSTANCE_LAYOUT
+};
+
+enum BlendMode {
+    OPAQUE_BLENDING,
+    ALPHA_BLENDING,
+    ADDITIVE_BLENDING
+};
+
+// A 32 bit specialization constant (bool, int, uint or the bits of a float), matched by 'constant_id' in the shaders
+struct SpecializationConstant {
+    uint32_t id;
+    uint32_t value;
+
+    bool operator==(const SpecializationConstant &other) const { return id == other.id && value == other.value; }
+};
+
+// Everything that makes a graphics pipeline unique. Two equal keys always share the same VkPipeline.
+// Feature toggles should be expressed as specialization constants: each combination becomes its own specialized
+// pipeline instead of a runtime branch in the shader.
+struct PipelineKey {
+    std::string vertexShaderPath;
+    // Empty for depth-only pipelines, which have no color attachment (e.g. shadow maps)
+    std::string fragmentShaderPath;
+    // Applied to all stages, keep them sorted by id so that equal sets compare equal
+    std::vector<SpecializationConstant> specializationConstants;
+
+    VertexLayout vertexLayout = VERTEX_LAYOUT;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    BlendMode blendMode = OPAQUE_BLENDING;
+    bool isDepthTested = false;
+    bool isDepthWritten = false;
+    // Depth bias is dynamic state, set with vkCmdSetDepthBias
+    bool hasDepthBias = false;
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    // Pipelines can be used with any render pass compatible with this one
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+
+    bool operator==(const PipelineKey &other) const;
+
+    // Replaces or adds a specialization constant, keeping them sorted
+    void specialize(uint32_t constantId, uint32_t value);
+};
+
+struct PipelineKeyHash {
+    size_t operator()(const PipelineKey &key) const;
+};
+
+// Everything that makes a descriptor set layout unique
+struct DescriptorSetLayoutKey {
+    // Sorted by binding
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+    bool operator==(const DescriptorSetLayoutKey &other) const;
+};
+
+struct DescriptorSetLayoutKeyHash {
+    size_t operator()(const DescriptorSetLayoutKey &key) const;
+};
+
+// Everything that makes a pipeline layout unique
+struct PipelineLayoutKey {
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    // Size 0 without push constants
+    VkPushConstantRange pushConstantRange = {};
+
+    bool operator==(const PipelineLayoutKey &other) const;
+};
+
+struct PipelineLayoutKeyHash {
+    size_t operator()(const PipelineLayoutKey &key) const;
+};
+
+// Creates graphics pipeline variants lazily, the first time their key is requested, and deduplicates them.
+// Variants sharing the same shaders are created as derivatives of the first one, and every pipeline goes through a
+// VkPipelineCache, so that drivers can reuse what they compiled for similar variants.
+//
+// Layouts are generated from the reflection of the shaders (see ShaderReflection) and deduplicated the same way:
+// equal layouts are a single Vulkan object, owned by the manager. The vertex input of a pipeline is made of the
+// attributes of its VertexLayout that the vertex shader reads, which must match their reflected types.
+// Not thread-safe: meant to be used by the render thread only.
+class PipelineManager {
+public:
+    void initialize(VkDevice vkDevice);
+
+    // Returns the pipeline for the key, creating it if needed
+    VkPipeline getPipeline(const PipelineKey &key);
+
+    // Returns the compute pipeline of a shader, creating it if needed. Also goes through the pipeline cache
+    VkPipeline getComputePipeline(const std::string &shaderPath, VkPipelineLayout pipelineLayout);
+
+    // Compiles the shader modules that aren't loaded yet, all concurrently
+    void loadShaders(const std::vector<std::string> &shaderPaths);
+
+    // Layout of a descriptor set, reflected from the shaders that use it. Shaders are loaded if needed
+    VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<std::string> &shaderPaths, uint32_t set);
+
+    // Returns the layout for the bindings, creating it if needed
+    VkDescriptorSetLayout getDescriptorSetLayout(const DescriptorSetLayoutKey &key);
+
+    // Layout reflected from all the shaders of the pipelines that share it. 'fixedSetLayouts' replaces the reflected
+    // layout of some sets, e.g. bindless sets whose arrays are sized at runtime. Sets no shader uses get an empty
+    // layout. Push constants get one range covering all the blocks, extended to 'pushConstantStages'.
+    // Layouts are kept when shaders are reloaded: a reload can't change the interface of a shader
+    VkPipelineLayout getPipelineLayout(const std::vector<std::string> &shaderPaths,
+                                       const std::map<uint32_t, VkDescriptorSetLayout> &fixedSetLayouts = {},
+                                       VkShaderStageFlags pushConstantStages = 0);
+
+    // Swaps the module of a shader, the pipelines that used it are forgotten and returned so that the caller can
+    // destroy them once no frame in flight uses them anymore
+    std::vector<VkPipeline> reloadShader(const std::string &shaderPath, const std::vector<uint32_t> &spirv);
+
+    // Forgets the pipelines created for a render pass that's being destroyed and returns them
+    std::vector<VkPipeline> releaseRenderPass(VkRenderPass renderPass);
+
+    size_t getPipelineCount() const { return pipelines.size() + computePipelines.size(); }
+
+    void cleanup();
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    std::unordered_map<PipelineKey, VkPipeline, PipelineKeyHash> pipelines;
+    // First pipeline created for a pair of shaders, the following variants derive from it
+    std::map<std::pair<std::string, std::string>, VkPipeline> basePipelines;
+    // (Normalized shader path, layout) -> compute pipeline
+    std::map<std::pair<std::string, VkPipelineLayout>, VkPipeline> computePipelines;
+    // Normalized shader path -> module
+    std::map<std::string, VkShaderModule> shaderModules;
+
+    std::unordered_map<DescriptorSetLayoutKey, VkDescriptorSetLayout, DescriptorSetLayoutKeyHash> setLayouts;
+    std::unordered_map<PipelineLayoutKey, VkPipelineLayout, PipelineLayoutKeyHash> pipelineLayouts;
+
+    VkPipeline createPipeline(const PipelineKey &key);
+
+    VkShaderModule getShaderModule(const std::string &shaderPath);
+
+    // Attributes of the vertex layout read by the vertex shader, throws if they don't match its inputs
+    static std::vector<VkVertexInputAttributeDescription> getVertexAttributes(
+            const std::string &vertexShaderPath, const std::vector<VkVertexInputAttributeDescription> &layoutAttributes);
+
+    // Removes all pipelines matching the predicate and returns them
+    std::vector<VkPipeline> releasePipelines(const std::function<bool(const PipelineKey &)> &predicate);
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <algorithm>
+#include <string>
 #include <vector>
 #include <stdexcept>
 #include <iostream>
@@ -18,12 +20,23 @@ public:
 
     void retrieveAvailableQueueIndices(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 
+    // One entry per distinct family, with one queue per type using it (present shares the graphics one)
+    std::vector<VkDeviceQueueCreateInfo> getQueueCreateInfos() const;
+
     void setQueues(VkDevice device);
 
     uint32_t getFamilyIndex(QueueType flag);
 
     VkQueue *getQueue(QueueType flag);
 
+    // True if the compute queue can run concurrently with graphics (a different family, or a different queue of the
+    // same family)
+    bool hasAsyncCompute();
+
+    // Resources with exclusive sharing must be released by one family and acquired by the other when they are used
+    // by both
+    bool needsOwnershipTransfer(QueueType source, QueueType destination);
+
 
 private:
     const uint32_t invalidQueueIndex = 999;
@@ -31,6 +44,11 @@ private:
     std::vector<QueueType> queueFlags;
     size_t numOfQueues;
     std::vector<uint32_t> families;
+    // Index of the queue of each type within its family
+    std::vector<uint32_t> queueIndices;
+    // Amount of queues created per family
+    std::vector<uint32_t> familyQueueCounts;
+    std::vector<float> queuePriorities;
     std::vector<VkQueue> vkQueues;
 
     uint32_t getFlagIndex(QueueType flag);
@@ -38,5 +56,3 @@ private:
     void printQueueInfo();
 
 };
-
-
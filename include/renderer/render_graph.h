@@ -0,0 +1,267 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "deletion_queue.h"
+#include "memory_budget.h"
+#include "renderer_utility.h"
+
+// Handle to a texture or buffer declared in a RenderGraph
+using RenderResource = uint32_t;
+
+enum PassType {
+    // Recorded inside a render pass created by the graph from the pass attachments
+    GRAPHICS_PASS,
+    // Recorded outside of any render pass (compute dispatches, copies, blits)
+    COMPUTE_PASS
+};
+
+// How a pass uses a resource, besides being an attachment (see writeColor/writeDepth)
+enum ResourceAccess {
+    // Sampled image or read-only texel access in shaders
+    SAMPLED_ACCESS,
+    // Storage image or storage buffer
+    STORAGE_ACCESS,
+    UNIFORM_ACCESS,
+    VERTEX_ACCESS,
+    INDEX_ACCESS,
+    // Arguments of indirect draws and dispatches
+    INDIRECT_ACCESS,
+    // Source (read) or destination (write) of copies, blits and clears
+    TRANSFER_ACCESS,
+    // Depth attachment that is tested against but not written
+    DEPTH_READ_ACCESS
+};
+
+class RenderGraph;
+
+// A node of the graph: declares what it reads and writes, and records its commands once the graph is compiled.
+class RenderGraphPass {
+public:
+    // Color attachment that keeps the previous content of the texture
+    RenderGraphPass &writeColor(RenderResource texture);
+
+    // Color attachment cleared at the start of the pass
+    RenderGraphPass &writeColor(RenderResource texture, VkClearColorValue clearColor);
+
+    RenderGraphPass &writeDepth(RenderResource texture);
+
+    RenderGraphPass &writeDepth(RenderResource texture, float clearDepth);
+
+    RenderGraphPass &read(RenderResource resource, ResourceAccess access);
+
+    RenderGraphPass &write(RenderResource resource, ResourceAccess access);
+
+    // Passes with side effects (e.g. reading back to the CPU) are never culled
+    RenderGraphPass &setSideEffects();
+
+    // Graphics passes are recorded with their render pass begun, and the viewport and scissor set to its extent
+    RenderGraphPass &setRecord(std::function<void(VkCommandBuffer)> recordFunction);
+
+private:
+    friend class RenderGraph;
+
+    struct Access {
+        RenderResource resource;
+        ResourceAccess access;
+        bool isWrite;
+    };
+
+    struct Attachment {
+        RenderResource texture;
+        bool isDepth;
+        bool isCleared;
+        VkClearValue clearValue;
+    };
+
+    std::string name;
+    PassType type;
+    std::vector<Access> accesses;
+    std::vector<Attachment> attachments;
+    bool hasSideEffects = false;
+    std::function<void(VkCommandBuffer)> record;
+
+    RenderGraphPass(std::string name, PassType type) : name(std::move(name)), type(type) {}
+};
+
+
+// Frame graph: passes declare the resources they read and write, and the graph takes care of everything in between.
+// compile() culls the passes whose results are never used, places the minimal set of barriers (one batch per pass,
+// only for hazards and layout changes), creates the render passes and the transient resources. Transient resources
+// whose lifetimes don't overlap share the same memory.
+// Resources owned by someone else (e.g. the swapchain images) are imported, their handles can change every frame.
+//
+// Usage: declare resources and passes, compile() once, then execute() every frame. Everything is declared again
+// after reset() (e.g. when the swapchain is recreated).
+class RenderGraph {
+public:
+    // Transient memory is allocated from 'budget'
+    void initialize(VkDevice vkDevice, MemoryBudget &budget);
+
+    // Texture created and owned by the graph, only valid during the frame
+    RenderResource createTexture(const std::string &name, VkFormat format, VkExtent2D extent);
+
+    // Buffer created and owned by the graph, only valid during the frame
+    RenderResource createBuffer(const std::string &name, VkDeviceSize size);
+
+    // External image. Its layout is 'initialLayout' when the frame starts, and is transitioned to 'finalLayout' once
+    // the last pass using it is done. Imported images are outputs of the graph, the passes writing them are never
+    // culled
+    RenderResource importImage(const std::string &name, VkFormat format, VkExtent2D extent,
+                               VkImageLayout initialLayout, VkImageLayout finalLayout);
+
+    // External buffer, also an output of the graph
+    RenderResource importBuffer(const std::string &name, VkDeviceSize size);
+
+    // Handles of imported resources, must be set before every execute()
+    void setImportedImage(RenderResource resource, VkImage image, VkImageView imageView);
+
+    void setImportedBuffer(RenderResource resource, VkBuffer buffer);
+
+    // Restricts the render area, viewport and scissor of a compiled graphics pass to the top left corner of its
+    // attachments (e.g. for dynamic resolution), clamped to their extent. Kept until it's set again
+    void setRenderArea(const std::string &passName, VkExtent2D extent);
+
+    // Marks a transient resource as output, so that the passes producing it are kept
+    void markOutput(RenderResource resource);
+
+    // The returned reference stays valid until reset()
+    RenderGraphPass &addPass(const std::string &name, PassType type);
+
+    void compile();
+
+    void execute(VkCommandBuffer commandBuffer);
+
+    // Render pass of a compiled graphics pass, pipelines used in the pass must be compatible with it.
+    // Returns VK_NULL_HANDLE if the pass was culled
+    VkRenderPass getRenderPass(const std::string &passName) const;
+
+    // Handles of transient resources, valid after compile()
+    VkImage getImage(RenderResource resource) const { return resources[resource].image; }
+
+    VkImageView getImageView(RenderResource resource) const { return resources[resource].imageView; }
+
+    VkBuffer getBuffer(RenderResource resource) const { return resources[resource].buffer; }
+
+    // Forgets all declarations. What was compiled is retired to 'deletionQueue', since frames in flight may still use
+    // it
+    void reset(DeletionQueue &deletionQueue, uint64_t timelineValue);
+
+    // Destroys everything right away, the device must be idle
+    void cleanup();
+
+private:
+    struct Resource {
+        std::string name;
+        bool isImage;
+        bool isImported;
+        bool isOutput;
+
+        // Image:
+        VkFormat format;
+        VkExtent2D extent;
+        VkImageUsageFlags imageUsage;
+        VkImageLayout initialLayout;
+        VkImageLayout finalLayout;
+        VkImage image;
+        VkImageView imageView;
+
+        // Buffer:
+        VkDeviceSize size;
+        VkBufferUsageFlags bufferUsage;
+        VkBuffer buffer;
+
+        // Transient resources: index of the memory block and first/last compiled pass using it
+        uint32_t memoryBlock;
+        int32_t firstPass;
+        int32_t lastPass;
+    };
+
+    // Memory shared by transient resources with disjoint lifetimes
+    struct MemoryBlock {
+        VkDeviceSize size;
+        uint32_t memoryTypeBits;
+        VkDeviceMemory memory;
+        // Stages and writes of all the resources in the block, the first use of a resource must wait for them since
+        // the memory may still be in use by a previous resource (or by the previous frame)
+        VkPipelineStageFlags stages;
+        VkAccessFlags writeAccess;
+        std::vector<RenderResource> resources;
+    };
+
+    // Synchronization state of a resource while walking the passes
+    struct ResourceState {
+        VkImageLayout layout;
+        // Stages and accesses of the last write, and the stages that read since then
+        VkPipelineStageFlags writeStages;
+        VkAccessFlags writeAccess;
+        VkPipelineStageFlags readStages;
+        VkAccessFlags readAccess;
+        bool isUsed;
+    };
+
+    struct CompiledPass {
+        uint32_t pass;
+        VkPipelineStageFlags srcStages;
+        VkPipelineStageFlags dstStages;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        // Resource of each image barrier, imported images are patched in at execution
+        std::vector<RenderResource> imageBarrierResources;
+        // Buffers don't have layouts, a global memory barrier covers all of them
+        VkMemoryBarrier memoryBarrier;
+        bool hasMemoryBarrier;
+
+        VkRenderPass renderPass;
+        VkExtent2D extent;
+        // Within the extent, the whole extent by default
+        VkExtent2D renderArea;
+        std::vector<VkClearValue> clearValues;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryBudget *memoryBudget = nullptr;
+
+    std::vector<Resource> resources;
+    // Pointers are handed out to the users, so passes must not move
+    std::vector<std::unique_ptr<RenderGraphPass>> passes;
+
+    bool isCompiled = false;
+    std::vector<CompiledPass> compiledPasses;
+    std::vector<MemoryBlock> memoryBlocks;
+    // Final transitions of the imported images
+    std::vector<VkImageMemoryBarrier> finalBarriers;
+    std::vector<RenderResource> finalBarrierResources;
+    VkPipelineStageFlags finalSrcStages = 0;
+    // Framebuffers are created on demand, since imported images change from frame to frame
+    std::map<std::pair<VkRenderPass, std::vector<VkImageView>>, VkFramebuffer> framebuffers;
+    // Reused by every lookup, so that finding an existing framebuffer doesn't allocate
+    std::pair<VkRenderPass, std::vector<VkImageView>> framebufferKey;
+
+    RenderResource addResource(const Resource &resource);
+
+    // Keeps the passes contributing to an output, returns their indices in declaration order
+    std::vector<uint32_t> cullPasses() const;
+
+    void createTransientResources();
+
+    void computeBarriers();
+
+    // Load and store operations follow from the states before the pass and the later uses of the attachments
+    VkRenderPass createRenderPass(const RenderGraphPass &pass, int32_t compiledIndex, const std::vector<ResourceState> &states);
+
+    VkFramebuffer getFramebuffer(const CompiledPass &compiledPass);
+
+    // Stage, access and layout of a resource access in a pass of the given type
+    static void getAccessInfo(ResourceAccess access, bool isWrite, PassType passType, bool isImage,
+                              VkPipelineStageFlags &stages, VkAccessFlags &accessFlags, VkImageLayout &layout);
+
+    static bool isDepthFormat(VkFormat format);
+
+    static VkImageAspectFlags getAspectMask(VkFormat format);
+};
@@ -11,6 +11,7 @@
 #include <array>
 #include <chrono>
 #include <memory>
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 
 #define GLM_FORCE_RADIANS
@@ -18,11 +19,54 @@
 
 #include "vulkan_core.h"
 #include "queue_manager.h"
+#include "async_compute.h"
+#include "bindless_descriptors.h"
+#include "particle_system.h"
+#include "clustered_lighting.h"
+#include "dynamic_resolution.h"
+#include "shadow_maps.h"
+#include "camera.h"
+#include "sprite_batch.h"
+#include "texture_manager.h"
 #include "drawable/vertex.h"
 #include "shader_manager.h"
+#include "shader_watcher.h"
+#include "pipeline_manager.h"
+#include "render_graph.h"
+#include "deletion_queue.h"
+#include "memory_budget.h"
 #include "swapchain_support_details.h"
 #include "renderer_utility.h"
 #include "input_manager.h"
+#include "frame_state.h"
+#include "core/frame_limiter.h"
+#include "core/frame_arena.h"
+
+// How frames are handed to the display
+enum PresentPolicy {
+    // FIFO, never tears and never renders frames that won't be shown. Best for power and frame pacing
+    VSYNC_PRESENT,
+    // MAILBOX (FIFO with the shortest queue if unavailable) and low-latency frame pacing: input is sampled as late as
+    // possible and frames don't queue up behind each other
+    LOW_LATENCY_PRESENT,
+    // IMMEDIATE (MAILBOX if unavailable), renders as fast as possible. For benchmarks
+    UNCAPPED_PRESENT
+};
+
+// Latency of the last presented frame, in milliseconds
+struct FrameLatency {
+    // From the end of input polling to the return of vkQueuePresentKHR
+    double inputSampleToPresent;
+    // From the oldest input event consumed by the frame to the return of vkQueuePresentKHR (0 without events)
+    double oldestEventToPresent;
+};
+
+// A step of initializeRenderer()
+struct StartupPhase {
+    const char *name;
+    // Milliseconds
+    double duration;
+};
 
 
 class Renderer {
@@ -31,9 +75,82 @@ public:
 
     bool checkLoop();
 
-    static void rendererPollEvents();
+    void rendererPollEvents();
+
+    // Blocks until the next frame can be recorded. Called before input is polled, so that in low-latency mode input
+    // is sampled as late as possible
+    void waitForFrame();
+
+    void drawFrame(const FrameState &frameState);
+
+    // Amount of frames the CPU may record ahead of the GPU, clamped to [1, MAX_FRAMES_IN_FLIGHT].
+    // Can be changed at any time, the frames that are in flight are finished first
+    void setFramesInFlight(uint32_t count);
+
+    uint32_t getFramesInFlight() const { return framesInFlight; }
+
+    // Transient CPU data of the frame being recorded, freed once its frame slot is reused
+    FrameArena &getFrameArena() { return frameArena; }
+
+    // Low-latency mode waits for the GPU to finish the previous frame before input is polled, trading throughput
+    // for input-to-photon latency
+    void setLowLatencyMode(bool isEnabled) { isLowLatencyMode = isEnabled; }
+
+    // Recreates the swapchain with the present mode and image count of the policy, and sets the low-latency mode
+    // accordingly
+    void setPresentPolicy(PresentPolicy policy);
+
+    PresentPolicy getPresentPolicy() const { return presentPolicy; }
+
+    // Caps the frame rate independently of the present mode, 0 disables the cap
+    void setFrameRateLimit(double framesPerSecond) { frameLimiter.setTargetFrameRate(framesPerSecond); }
+
+    const FrameLatency &getLastFrameLatency() const { return lastFrameLatency; }
+
+    // Logs the average and worst latencies about once per second
+    void setLatencyReport(bool isEnabled) { isLatencyReported = isEnabled; }
+
+    // In order, available once the renderer is initialized
+    const std::vector<StartupPhase> &getStartupPhases() const { return startupPhases; }
 
-    void drawFrame();
+    // Milliseconds from the start of initializeRenderer() to the return of the first vkQueuePresentKHR, 0 until then
+    double getTimeToFirstFrame() const { return timeToFirstFrame; }
+
+    // checkLoop() returns false from now on
+    void requestClose() { glfwSetWindowShouldClose(window, GLFW_TRUE); }
+
+    // Must be set before initializeRenderer(), a capacity of 0 (the default) disables the particles
+    void setParticleSettings(const ParticleSystemSettings &settings) { particleSettings = settings; }
+
+    const ParticleSystem &getParticleSystem() const { return particleSystem; }
+
+    // Must be set before initializeRenderer(), a capacity of 0 (the default) leaves the scene unlit. Shadows need the
+    // lighting and a shadow resolution
+    void setLightingSettings(const LightingSettings &settings) { lightingSettings = settings; }
+
+    const ClusteredLighting &getLighting() const { return lighting; }
+
+    const ShadowMaps &getShadowMaps() const { return shadowMaps; }
+
+    // Must be set before initializeRenderer(), a target frame time of 0 (the default) renders the scene at the
+    // resolution of the swapchain
+    void setDynamicResolutionSettings(const DynamicResolutionSettings &settings) { resolutionSettings = settings; }
+
+    const DynamicResolution &getDynamicResolution() const { return dynamicResolution; }
+
+    // Must be set before initializeRenderer(), a capacity of 0 (the default) disables the sprites
+    void setSpriteCapacity(uint32_t capacity) { spriteCapacity = capacity; }
+
+    // Sprites are recorded between begin() and the next drawFrame(), which uploads and draws them
+    SpriteBatch &getSpriteBatch() { return spriteBatch; }
+
+    // The demo mesh of the main pass, 2D scenes turn it off
+    void setMeshDrawing(bool isEnabled) { isMeshDrawn = isEnabled; }
+
+    VkExtent2D getExtent() const { return swapchainExtent; }
+
+    // Textures of the scene, e.g. for sprites. Available once the renderer is initialized
+    TextureManager &getTextureManager() { return textureManager; }
 
     void afterLoop();
 
@@ -68,49 +185,174 @@ private:
     VkInstance instance = nullptr;
     VkSurfaceKHR surface = nullptr;
     VkPhysicalDevice physicalDevice = nullptr;
+    DeviceFeatures deviceFeatures;
     VkDevice device = nullptr;
 
     // QueueManager:
     QueueManager queues = QueueManager(requiredQueues);
 
+    // Per frame slot scratch memory, so that recording a frame doesn't touch the heap
+    FrameArena frameArena;
+
+    // Compute work of each frame, overlapping the graphics work of the previous one
+    AsyncCompute asyncCompute;
+
+    // GPU particles, simulated on the compute queue and drawn in the main pass
+    ParticleSystemSettings particleSettings;
+    ParticleSystem particleSystem;
+
+    // Lights of the scene, binned per cluster before the main pass
+    LightingSettings lightingSettings;
+    ClusteredLighting lighting;
+    RenderResource clusterResource = 0;
+    RenderResource lightIndexResource = 0;
+    // Rendered before the main pass, only when their casters or their view change
+    ShadowMaps shadowMaps;
+
+    // View and projection of the scene, its aspect ratio follows the swapchain
+    std::unique_ptr<Camera> camera;
+
+    // Textures and storage buffers of the scene, indexed by the draws
+    BindlessDescriptors bindless;
+
+    // Textures, loaded in the background
+    TextureManager textureManager;
+    // Procedural texture of the demo mesh, generated on the JobSystem while the device is created
+    TextureHandle meshTexture = WHITE_TEXTURE;
+    TextureData meshTextureData;
+    JobCounter assetLoads;
+    // Transform of the demo mesh in the frame being recorded, and of its other instances
+    glm::mat4 meshModel = glm::mat4(1.0f);
+    std::vector<glm::mat4> instanceModels;
+
+    // Batched 2D sprites, drawn in the main pass
+    uint32_t spriteCapacity = 0;
+    SpriteBatch spriteBatch;
+    bool isMeshDrawn = true;
+
 
     VkSwapchainKHR swapchain = nullptr;
 
     std::vector<VkImage> swapchainImages;
     VkFormat swapchainImageFormat = VK_FORMAT_UNDEFINED;
     VkExtent2D swapchainExtent = {0, 0};
+    VkImageUsageFlags swapchainImageUsage = 0;
 
     std::vector<VkImageView> swapchainImageViews;
 
+    // Frame passes:
+    RenderGraph renderGraph;
+    RenderResource swapchainResource = 0;
+    // Scene rendered offscreen in a render area that follows the GPU time, then blitted to the swapchain
+    DynamicResolutionSettings resolutionSettings;
+    DynamicResolution dynamicResolution;
+    RenderResource sceneColorResource = 0;
+    // Render area of the main pass in the frame being recorded
+    VkExtent2D renderExtent = {0, 0};
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    // Render pass of the main pass, the scene pipelines must be compatible with it
     VkRenderPass renderPass = nullptr;
+    // Layout of the frame uniforms (set 0), owned by the PipelineManager
     VkDescriptorSetLayout descriptorSetLayout = nullptr;
+    // Scene pipeline layout, shared by the mesh, sprite and particle pipelines: set 0 is the frame uniforms, set 1 the
+    // bindless arrays, per-draw data are push constants
     VkPipelineLayout pipelineLayout = nullptr;
 
-    VkPipeline graphicsPipeline = nullptr;
-
-    std::vector<VkFramebuffer> swapchainFrameBuffers;
+    // Pipeline variants:
+    PipelineManager pipelineManager;
+    PipelineKey mainPipelineKey;
+
+    // Shaders and hot-reload:
+    // Development only: release builds don't run the watcher thread
+    const bool enableShaderHotReload = isDebug;
+    std::string vertexShaderPath;
+    std::string fragmentShaderPath;
+    std::unique_ptr<ShaderWatcher> shaderWatcher;
+
+    // Every device memory allocation, per heap and per category
+    MemoryBudget memoryBudget;
+
+    // Handles replaced by a reload or a resize, kept alive until the frames in flight that use them are done
+    DeletionQueue deletionQueue;
+
+    // Copies from staging buffers, recorded at the start of the next frame
+    struct PendingCopy {
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingMemory;
+        VkBuffer buffer;
+        VkDeviceSize size;
+    };
+    std::vector<PendingCopy> pendingCopies;
 
     VkCommandPool commandPool = nullptr;
 
     VkDescriptorPool descriptorPool = nullptr;
-    std::vector<VkDescriptorSet> descriptorSets;
-
-    std::vector<VkCommandBuffer> commandBuffers;
 
-
-    std::vector<VkSemaphore> imageAvailableSemaphores;
+    //###################################################
+    // Frame pacing:
+    // Frame N is recorded with the resources of slot N % framesInFlight. Everything the CPU writes while recording a
+    // frame lives in its slot, so a slot can be reused as soon as the frame that last used it is done on the GPU,
+    // independently of which swapchain image gets presented.
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+    struct FrameSlot {
+        VkCommandBuffer commandBuffer;
+        // Signaled by vkAcquireNextImageKHR (binary, swapchains don't support timeline semaphores)
+        VkSemaphore imageAvailableSemaphore;
+        VkBuffer uniformBuffer;
+        VkDeviceMemory uniformBufferMemory;
+        // Persistently mapped
+        void *uniformData;
+        VkDescriptorSet descriptorSet;
+    };
+    std::vector<FrameSlot> frameSlots;
+    uint32_t framesInFlight = 2;
+    bool isLowLatencyMode = false;
+
+    // Signaled with N + 1 once frame N is done on the GPU, so its value is the amount of completed frames
+    VkSemaphore frameTimeline = nullptr;
+    // Amount of frames submitted so far
+    uint64_t frameNumber = 0;
+
+    PresentPolicy presentPolicy = VSYNC_PRESENT;
+    FrameLimiter frameLimiter;
+
+    // Input latency:
+    std::chrono::steady_clock::time_point inputSampleTime;
+    // Oldest event of the last poll, equal to inputSampleTime if there was none
+    std::chrono::steady_clock::time_point oldestEventTime;
+    FrameLatency lastFrameLatency = {0.0, 0.0};
+    bool isLatencyReported = false;
+    struct LatencyReport {
+        std::chrono::steady_clock::time_point start;
+        uint32_t frameCount = 0;
+        double inputSampleToPresentSum = 0.0;
+        double inputSampleToPresentMax = 0.0;
+        double oldestEventToPresentMax = 0.0;
+    } latencyReport;
+
+    void recordPresentLatency();
+
+    // Startup:
+    std::chrono::steady_clock::time_point startupTime;
+    std::chrono::steady_clock::time_point startupPhaseTime;
+    std::vector<StartupPhase> startupPhases;
+    double timeToFirstFrame = 0.0;
+
+    // Records and logs the time since the end of the previous phase
+    void endStartupPhase(const char *name);
+
+    // Starts the work that doesn't need a device on the JobSystem
+    void startAssetLoading();
+
+    // Signaled when rendering to a swapchain image is done, waited on by its presentation. One per image: an image
+    // is only acquired again once its previous presentation has consumed the semaphore
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    const int MAX_FRAMES_IN_FLIGHT = 2; // Todo: this should actually be the amount of images in the swapchain - 1?
-    size_t currentFrame = 0;
-    std::vector<VkFence> inFlightFences;
 
     // Buffers:
     VkBuffer vertexBuffer = nullptr;
     VkDeviceMemory vertexBufferMemory = nullptr;
     VkBuffer indexBuffer = nullptr;
     VkDeviceMemory indexBufferMemory = nullptr;
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
 
     bool frameBufferResized = false;
 
@@ -123,38 +365,47 @@ private:
 
     static VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
 
-    static VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes);
+    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes) const;
+
+    uint32_t chooseSwapImageCount(const VkSurfaceCapabilitiesKHR &capabilities, VkPresentModeKHR presentMode) const;
 
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
-    void createSwapchain();
+    // 'oldSwapchain' is the one being replaced, if any
+    void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 
     void createImageViews();
 
-    void createRenderPass();
+    VkFormat findDepthFormat();
+
+    void createRenderGraph();
 
-    void createDescriptorSetLayout();
+    // Shaders of every pipeline using the scene pipeline layout
+    std::vector<std::string> getSceneShaderPaths() const;
 
 //    static std::vector<char> readFile(const std::string &filename);
 
 //    VkShaderModule createShaderModule(const std::vector<char> &code);
 
+    void createPipelineLayout();
+
     void createGraphicsPipeline();
 
-    void createFramebuffers();
+    void reloadShaders();
 
     void createCommandPool();
 
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-
-
     void createBuffer(VkDeviceSize size,
                       VkBufferUsageFlags usage,
                       VkMemoryPropertyFlags properties,
                       VkBuffer &buffer,
-                      VkDeviceMemory &bufferMemory);
+                      VkDeviceMemory &bufferMemory,
+                      MemoryCategory category);
+
+    // The copy is recorded by the next frame, ahead of its passes. The staging buffer is then retired
+    void copyBuffer(VkBuffer stagingBuffer, VkDeviceMemory stagingMemory, VkBuffer dstBuffer, VkDeviceSize size);
 
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    void recordPendingCopies(VkCommandBuffer commandBuffer);
 
     void createVertexBuffer();
 
@@ -168,21 +419,44 @@ private:
 
     void createCommandBuffers();
 
+    void recordCommandBuffer(const FrameSlot &frameSlot, uint32_t imageIndex);
+
+    void recordMainPass(VkCommandBuffer commandBuffer);
+
+    void recordMesh(VkCommandBuffer commandBuffer);
+
     void createSyncObjects();
 
+    void createParticleSystem();
+
+    void createClusteredLighting();
+
+    void createSpriteBatch();
+
+    void createTextures();
+
+    void createRenderFinishedSemaphores();
+
+    // Blocks until at least 'completedFrames' frames are done on the GPU
+    void waitForCompletedFrames(uint64_t completedFrames);
+
+    uint64_t getCompletedFrames();
+
+    void waitForFrameSlot();
+
     void recreateSwapchain();
 
     void cleanupSwapchain();
 
-    void updateUniformBuffer(uint32_t currentImageIndex);
+    void updateUniformBuffer(const FrameSlot &frameSlot, const FrameState &frameState);
 
 
-// This is called 'interleaving' vertex attributes (position and color are interleaved together)
+// This is called 'interleaving' vertex attributes (position, color and texture coordinates are interleaved together)
     const std::vector<Vertex> vertices = {
-            {{-0.5f, 0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-            {{0.5f,  0.0f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-            {{0.5f,  0.0f, 0.5f},  {0.0f, 0.0f, 1.0f}},
-            {{-0.5f, 0.0f, 0.5f},  {1.0f, 1.0f, 1.0f}}
+            {{-0.5f, 0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
+            {{0.5f,  0.0f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+            {{0.5f,  0.0f, 0.5f},  {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+            {{-0.5f, 0.0f, 0.5f},  {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}
     };
 
 // Vertex indices for the index buffer
@@ -195,10 +469,23 @@ private:
 };
 
 
-struct UniformBufferObject {
+// Per-frame data, in the uniform buffer of the frame slot (set 0), must match frame_uniforms.glsl. Per-draw data are
+// push constants
+struct FrameUniforms {
     // Uniforms must be properly aligned!
-    glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
+    glm::mat4 viewProjection;
+    LightingUniforms lighting;
+    ShadowUniforms shadows;
+};
+
+// Push constants of the mesh draws, must match shader.vert and shader.frag
+struct MeshConstants {
+    glm::mat4 model;
+    BindlessIndex textureIndex;
+
+    // Bytes actually pushed: the struct is padded to the alignment of the matrix, the GLSL block isn't
+    static const uint32_t SIZE = sizeof(glm::mat4) + sizeof(BindlessIndex);
 };
 
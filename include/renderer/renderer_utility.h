@@ -4,11 +4,14 @@
 #include <iostream>
 #include <cstring>
 
+#include "core/logger.h"
+
 void VK_CHECK(VkResult result);
 
 void VK_CHECK(VkResult result, const char *message);
 
 
+// Asynchronous, through the Logger. Prefer the LOG_* macros for messages with values: they don't build strings
 void print(const char *message);
 
 void print(const std::string& message);
@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 
 #include <glslang/Public/ShaderLang.h>
+#include <glslang/Include/Types.h>
 #include <SPIRV/GlslangToSpv.h>
 #include <StandAlone/DirStackFileIncluder.h>
 
@@ -10,8 +11,17 @@
 #include <vector>
 #include <fstream> // used to read shader source
 #include <cstdlib>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <map>
 
 #include"renderer_utility.h"
+#include "core/job_system.h"
+
+#ifdef ASTERISM_SPIRV_OPTIMIZER
+#include <spirv-tools/optimizer.hpp>
+#endif
 
 
 enum ShaderType {
@@ -23,19 +33,182 @@ enum ShaderType {
     COMPUTE_SHADER = VK_SHADER_STAGE_COMPUTE_BIT,
 };
 
+enum ShaderOptimization {
+    NO_OPTIMIZATION,
+    // spirv-opt's performance recipe: inlining, scalar replacement, dead code elimination, etc...
+    PERFORMANCE_OPTIMIZATION,
+    // spirv-opt's size recipe: same passes but favouring smaller binaries
+    SIZE_OPTIMIZATION
+};
+
+// Descriptor used by a shader
+struct ShaderBinding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    // Array size, 0 for runtime sized arrays
+    uint32_t count;
+};
+
+// Input of a vertex shader
+struct ShaderInput {
+    uint32_t location;
+    // 32 bit format matching the GLSL type (e.g. vec3 -> R32G32B32_SFLOAT)
+    VkFormat format;
+};
+
+// Interface of a compiled shader, from glslang's reflection. Only what the shader actually uses is reflected
+struct ShaderReflection {
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    // Size of the push constant block in bytes, 0 without one
+    uint32_t pushConstantSize = 0;
+    std::vector<ShaderBinding> bindings;
+    // Vertex shaders only, sorted by location
+    std::vector<ShaderInput> inputs;
+};
+
+// Resolves #include directives like DirStackFileIncluder, and additionally records every file that got included.
+class DependencyIncluder : public DirStackFileIncluder {
+public:
+    IncludeResult *includeLocal(const char *headerName, const char *includerName, size_t inclusionDepth) override;
+
+    IncludeResult *includeSystem(const char *headerName, const char *includerName, size_t inclusionDepth) override;
+
+    const std::vector<std::string> &getIncludedFiles() const { return includedFiles; }
+
+private:
+    std::vector<std::string> includedFiles;
+
+    IncludeResult *record(IncludeResult *result);
+};
+
+// Process-wide shader compiler service.
+// glslang is initialized once for the whole process, after that every compilation uses its own glslang objects, so
+// any amount of shaders can be compiled concurrently on the JobSystem.
 class ShaderManager {
 public:
+    static ShaderManager &instance();
+
+    ShaderManager(const ShaderManager &) = delete;
+
+    ShaderManager &operator=(const ShaderManager &) = delete;
 
+    // Compiles the GLSL file to SPIR-V, doesn't need a device. Thread-safe
+    // Throws if the shader fails to preprocess, parse or link.
+    std::vector<uint32_t> compileToSpirv(const std::string &filePath);
+
+    // Compiles the GLSL file and wraps it into a shader module on the calling thread. Thread-safe
     VkShaderModule createShaderModule(const std::string &filePath, VkDevice device);
 
+    // Wraps already compiled SPIR-V into a shader module. Thread-safe
+    static VkShaderModule createShaderModule(const std::vector<uint32_t> &spirv, VkDevice device);
+
+    // Compiles the GLSL file on the JobSystem
+    std::future<VkShaderModule> createShaderModuleAsync(const std::string &filePath, VkDevice device);
+
+    // Compiles a batch of GLSL files concurrently, the futures are in the same order as 'filePaths'
+    std::vector<std::future<VkShaderModule>> createShaderModules(const std::vector<std::string> &filePaths, VkDevice device);
+
+    // Starts compiling GLSL files on the JobSystem ahead of time, e.g. while the device is created at startup. The
+    // next createShaderModule() of each file takes its SPIR-V instead of compiling it again. Thread-safe
+    void precompile(const std::vector<std::string> &filePaths);
+
+    // Files that the shader #included the last time it was compiled (normalized paths)
+    std::vector<std::string> getDependencies(const std::string &filePath);
+
+    // Reflection of the last compilation of the shader, throws if it was never compiled. Thread-safe
+    ShaderReflection getReflection(const std::string &filePath);
+
+    // Smallest push constant range covering the push constant blocks of all the shaders, which must have been
+    // compiled. Pipelines sharing a layout must share its range
+    VkPushConstantRange getPushConstantRange(const std::vector<std::string> &filePaths);
+
+    // Bindings of a descriptor set used by any of the shaders, which must have been compiled, sorted by binding.
+    // Throws if two shaders disagree on a descriptor, or if the set has runtime sized arrays (their size isn't known
+    // to the shaders)
+    std::vector<VkDescriptorSetLayoutBinding> getSetLayoutBindings(const std::vector<std::string> &filePaths,
+                                                                   uint32_t set);
+
+    // Normalized form of a path, used to compare shader and include paths
+    static std::string normalizePath(const std::string &path);
+
+    // Must be set before compiling, changing it invalidates the cached binaries
+    void setOptimization(ShaderOptimization shaderOptimization, bool isStrippingDebugInfo);
+
+    // Amount of SPIR-V instructions in a binary
+    static size_t countInstructions(const std::vector<uint32_t> &spirv);
+
 private:
+    ShaderManager();
+
+    // Bump this whenever the compilation settings change in a way the cache key doesn't capture
+    static const uint32_t shaderCacheVersion = 2;
+
+#ifndef NDEBUG
+    ShaderOptimization optimization = NO_OPTIMIZATION;
+    bool stripDebugInfo = false;
+#else
+    ShaderOptimization optimization = PERFORMANCE_OPTIMIZATION;
+    bool stripDebugInfo = true;
+#endif
+
+    // Runs the optimizer (if available) and the debug info stripping, and reports the size difference
+    std::vector<uint32_t> optimizeSpirv(const std::string &filePath, std::vector<uint32_t> spirv) const;
+
+    // Removes debug instructions (names, source, line info), doesn't need the optimizer
+    static std::vector<uint32_t> removeDebugInstructions(const std::vector<uint32_t> &spirv);
+
+    // Optimized binaries are persisted with their reflection, one file per shader that every compilation overwrites.
+    // The file stores the key it was compiled for, a hash of the preprocessed source and the compilation settings
+    static std::string getCachePath(const std::string &filePath);
+
+    uint64_t getCacheKey(const std::string &filePath, const std::string &preprocessedGLSL) const;
+
+    // False if the file is missing, malformed, or was written for another key
+    static bool readCache(const std::string &cachePath, uint64_t key, ShaderReflection &reflection,
+                          std::vector<uint32_t> &spirv);
+
+    static void writeCache(const std::string &cachePath, uint64_t key, const ShaderReflection &reflection,
+                           const std::vector<uint32_t> &spirv);
+
+    // 64 bit FNV-1a: stable across runs and platforms, unlike std::hash
+    static uint64_t hashBytes(const std::string &bytes, uint64_t hash = 14695981039346656037ull);
+
+    // Compiled by precompile(), until a createShaderModule() takes it
+    struct PrecompiledShader {
+        JobCounter compilation;
+        std::vector<uint32_t> spirv;
+        std::exception_ptr error;
+    };
+
+    // Normalized path -> SPIR-V compiled ahead
+    std::mutex precompiledMutex;
+    std::map<std::string, std::unique_ptr<PrecompiledShader>> precompiledShaders;
+
+    // Waits for the precompiled SPIR-V of the file if there is one (running other jobs meanwhile), returns false
+    // otherwise. Rethrows the compilation errors
+    bool takePrecompiled(const std::string &filePath, std::vector<uint32_t> &spirv);
+
+    std::mutex dependenciesMutex;
+    std::map<std::string, std::vector<std::string>> dependencies;
+    // Normalized path -> reflection, guarded by dependenciesMutex
+    std::map<std::string, ShaderReflection> reflections;
+
+    static ShaderReflection reflect(glslang::TProgram &program, EShLanguage shaderType);
+
+    static void addBinding(ShaderReflection &reflection, const glslang::TObjectReflection &object, VkDescriptorType type);
+
+    static VkFormat getInputFormat(const glslang::TType &type);
+
+    ~ShaderManager();
+
     static std::string readShaderFile(const std::string &filename);
 
     static std::string getSuffix(const std::string &name);
 
     static EShLanguage getShaderStage(const std::string &stage);
 
-    bool glslangInitialized = false;
+    static ShaderType getVulkanStage(EShLanguage shaderType);
 
 
     const TBuiltInResource DefaultTBuiltInResource = {
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shader_manager.h"
+#include "renderer_utility.h"
+#include "core/job_system.h"
+
+struct ReloadedShader {
+    std::string filePath;
+    std::vector<uint32_t> spirv;
+};
+
+// Watches shader sources and everything they #include, and recompiles shaders in the background when any of those
+// files change. The renderer collects the results at a frame boundary and swaps the affected pipelines itself.
+// On Linux changes are reported by inotify, elsewhere the modification times are polled.
+class ShaderWatcher {
+public:
+    explicit ShaderWatcher(const std::string &directory);
+
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher &) = delete;
+
+    ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+    // Starts watching a shader that's in use, its includes are taken from its last compilation
+    void track(const std::string &shaderPath);
+
+    // Shaders that were successfully recompiled since the last call. Shaders that failed to compile are not returned,
+    // so the previous pipelines keep running until the error is fixed
+    std::vector<ReloadedShader> takeReloadedShaders();
+
+private:
+    std::string directory;
+
+    std::thread watcherThread;
+    std::atomic<bool> isWatching = {true};
+
+    std::mutex mutex;
+    // Normalized shader paths that are in use
+    std::set<std::string> trackedShaders;
+    // Watched file -> shaders that need to be recompiled when it changes
+    std::map<std::string, std::set<std::string>> dependents;
+    // Shaders whose recompilation is queued on the JobSystem
+    std::set<std::string> compilingShaders;
+    // Shaders that changed again while they were being recompiled
+    std::set<std::string> outdatedShaders;
+    JobCounter compilations;
+    // Recompiled shaders waiting for the next frame boundary
+    std::map<std::string, std::vector<uint32_t>> reloadedShaders;
+
+    void watchLoop();
+
+    // Rebuilds 'dependents' from the last compilation of every tracked shader. Needs 'mutex'
+    void updateDependents();
+
+    void onFilesChanged(const std::set<std::string> &changedFiles);
+
+    void recompile(const std::string &shaderPath);
+
+#ifdef __linux__
+    int inotifyDescriptor = -1;
+    // inotify watch descriptor -> watched directory
+    std::map<int, std::string> watchedDirectories;
+
+    void watchDirectory(const std::string &path);
+#else
+    // Polling fallback: last seen modification time of every watched file
+    std::map<std::string, std::filesystem::file_time_type> modificationTimes;
+#endif
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+#include "bindless_descriptors.h"
+#include "camera.h"
+#include "memory_budget.h"
+#include "pipeline_manager.h"
+#include "renderer_utility.h"
+#include "frame_state.h"
+
+const uint32_t MAX_SHADOW_LAYERS = MAX_SHADOW_CASCADES + MAX_SHADOWED_SPOT_LIGHTS;
+
+// Shadow data of the frame uniforms (std140), must match frame_uniforms.glsl
+struct ShadowUniforms {
+    // From the view space of the camera to the shadow map of each layer: the cascades, then the spot lights
+    glm::mat4 matrices[MAX_SHADOW_LAYERS];
+    // Farthest view depth of each cascade
+    glm::vec4 cascadeSplits;
+    // x: bindless index of the shadow maps, y: amount of cascades (0 without directional shadows)
+    glm::uvec4 info;
+};
+
+// Shadow maps of the directional light (cascades splitting the view frustum of the camera) and of the first spot
+// lights casting shadows, one layer of a depth array each.
+//
+// Static casters are rendered into a cache once, and again only when the view of their layer or the static casters
+// change. Every frame that has dynamic casters, the cached layers are copied into the sampled array and the dynamic
+// casters are drawn over them. A scene where nothing moves renders no shadows at all.
+//
+// Recorded as a pass of the render graph on the graphics queue, with its own render passes and barriers: the main pass
+// samples the array through the bindless textures.
+class ShadowMaps {
+public:
+    // Needs the clustered lighting: a capacity of 0, or a shadow resolution of 0, disables the shadows
+    void initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, MemoryBudget &budget,
+                    PipelineManager &pipelines, BindlessDescriptors &bindless,
+                    const LightingSettings &lightingSettings);
+
+    bool isEnabled() const { return layerCount > 0; }
+
+    static std::string getShaderPath();
+
+    // Geometry of the casters: the demo mesh, drawn once per MeshInstance
+    void setMesh(VkBuffer meshVertexBuffer, VkBuffer meshIndexBuffer, uint32_t meshIndexCount);
+
+    // Fits the layers to the lights and the camera of the frame, and finds the ones that must be rendered again
+    ShadowUniforms update(const FrameState &frameState, const Camera &camera);
+
+    // Renders what the last update() found outdated, outside of a render pass. Leaves the array ready to be sampled by
+    // the fragment shaders
+    void record(VkCommandBuffer commandBuffer);
+
+    // Layers rendered by the last record(): static casters into the cache, and copies of the cache with the dynamic
+    // casters over them
+    uint32_t getCachedRenderCount() const { return cachedRenderCount; }
+
+    uint32_t getCompositeCount() const { return compositeCount; }
+
+    void cleanup();
+
+private:
+    struct Layer {
+        // From world space to the clip space of the shadow map, with depths in [0, 1]
+        glm::mat4 lightMatrix;
+        bool isActive;
+
+        // The cache holds the static casters for this matrix and version of the static casters
+        bool isCached;
+        glm::mat4 cachedMatrix;
+        uint64_t cachedVersion;
+        // The sampled layer holds exactly the cache
+        bool isCacheCopied;
+
+        // Decided by update(), done by record()
+        bool needsCachedRender;
+        bool needsComposite;
+
+        VkImageView cacheView;
+        VkImageView shadowView;
+        VkFramebuffer cacheFramebuffer;
+        VkFramebuffer shadowFramebuffer;
+    };
+
+    struct Image {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryBudget *memoryBudget = nullptr;
+    PipelineManager *pipelineManager = nullptr;
+
+    ShadowSettings settings;
+    uint32_t lightCapacity = 0;
+    uint32_t cascadeCount = 0;
+    uint32_t spotLightCapacity = 0;
+    uint32_t layerCount = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+
+    // Static casters only, and the array sampled by the shaders
+    Image cache;
+    Image shadows;
+    VkImageView shadowArrayView = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    BindlessIndex bindlessShadows = 0;
+    std::vector<Layer> layers;
+    bool isInitialized = false;
+
+    // Same attachment, cleared for the cache and loaded for the dynamic casters. Compatible, so they share the pipeline
+    VkRenderPass clearRenderPass = VK_NULL_HANDLE;
+    VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    PipelineKey pipelineKey;
+
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    uint32_t indexCount = 0;
+
+    // Model matrices of the casters of the frame
+    std::vector<glm::mat4> staticCasters;
+    std::vector<glm::mat4> dynamicCasters;
+    // Incremented whenever a static caster moves, appears or disappears
+    uint64_t staticVersion = 0;
+
+    // Statistics:
+    uint32_t cachedRenderCount = 0;
+    uint32_t compositeCount = 0;
+
+    static VkFormat findFormat(VkPhysicalDevice physicalDevice, bool &isFilterable);
+
+    Image createImage(VkImageUsageFlags usage);
+
+    VkImageView createView(VkImage image, VkImageViewType type, uint32_t firstLayer, uint32_t count);
+
+    VkRenderPass createRenderPass(VkAttachmentLoadOp loadOp);
+
+    VkFramebuffer createFramebuffer(VkRenderPass renderPass, VkImageView view);
+
+    // Finds the static casters that changed since the last frame
+    void updateCasters(const std::vector<MeshInstance> &instances);
+
+    // Sphere around the slice of the view frustum between two depths, in a texel-snapped orthographic view: the
+    // matrix only changes when the slice moves by a whole texel
+    glm::mat4 fitCascade(const Camera &camera, const glm::vec3 &direction, float nearDepth, float farDepth) const;
+
+    void renderCasters(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer,
+                       const glm::mat4 &lightMatrix, const std::vector<glm::mat4> &casters);
+
+    void imageBarrier(VkImageMemoryBarrier &barrier, VkImage image, uint32_t layer, VkImageLayout oldLayout,
+                      VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess) const;
+};
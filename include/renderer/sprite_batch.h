@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "memory_budget.h"
+#include "pipeline_manager.h"
+#include "renderer_utility.h"
+#include "texture_manager.h"
+#include "core/frame_arena.h"
+#include "drawable/sprite.h"
+
+// Batched renderer of 2D sprites. Sprites are appended on the CPU during the frame, then sorted by state (blend mode,
+// then texture) into the persistently mapped instance buffer of the frame slot, and each state is drawn with a
+// single instanced draw: one draw per state, whatever the amount of sprites. Textures are bindless: a batch only
+// pushes the index of its texture, and the pipeline is only rebound when the blend mode changes.
+//
+// Sorting moves whole runs of consecutive sprites sharing a state, so the common case of long runs (e.g. allocate())
+// costs one memcpy per run. Within a state, sprites keep their submission order (painter's order); across states the
+// order is opaque first, then alpha blended, then additive.
+// Not thread-safe, except for filling the memory returned by allocate().
+class SpriteBatch {
+public:
+    // The sorting of upload() is allocated in the current frame of 'arena'
+    void initialize(VkDevice vkDevice, MemoryBudget &budget, PipelineManager &pipelines,
+                    TextureManager &textures, FrameArena &arena, VkPipelineLayout scenePipelineLayout,
+                    VkRenderPass renderPass, uint32_t spriteCapacity, uint32_t slotCount);
+
+    bool isEnabled() const { return capacity > 0; }
+
+    // For hot reload, and the reflection of the scene pipeline layout
+    static std::vector<std::string> getShaderPaths();
+
+    // Pipelines are created for this render pass from now on
+    void setRenderPass(VkRenderPass renderPass);
+
+    // Starts the sprites of a frame, seen through the camera
+    void begin(const Camera &camera);
+
+    // Sprites after the capacity of the frame are dropped
+    void draw(const Sprite &sprite);
+
+    // Reserves 'count' sprites sharing a state and returns them to be filled in place, e.g. in parallel. Returns the
+    // amount actually reserved in 'count', which is lower if the capacity is reached
+    SpriteInstance *allocate(uint32_t &count, uint32_t texture, BlendMode blendMode);
+
+    // Sorts the sprites of the frame into the instance buffer of the slot, which the GPU must be done with
+    void upload(uint32_t slot);
+
+    // Draws the sprites uploaded to the slot, inside a render pass where the sets of the scene pipeline layout are
+    // bound
+    void recordDraw(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    uint32_t getCapacity() const { return capacity; }
+
+    // Sprites and draw calls of the last upload
+    uint32_t getSpriteCount() const { return uploadedCount; }
+
+    uint32_t getDrawCount() const { return static_cast<uint32_t>(batches.size()); }
+
+    void cleanup();
+
+private:
+    struct State {
+        BlendMode blendMode;
+        uint32_t texture;
+
+        bool operator==(const State &other) const {
+            return blendMode == other.blendMode && texture == other.texture;
+        }
+
+        // Draw order of the states
+        bool operator<(const State &other) const {
+            return blendMode != other.blendMode ? blendMode < other.blendMode : texture < other.texture;
+        }
+    };
+
+    // Consecutive sprites of the frame sharing a state
+    struct Run {
+        uint32_t state;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // Instanced draw of a state
+    struct Batch {
+        State state;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    // Push constants of the draws, must match the sprite shaders
+    struct PushConstants {
+        glm::mat4 viewProjection;
+        BindlessIndex textureIndex;
+    };
+
+    struct Slot {
+        VkBuffer instanceBuffer;
+        VkDeviceMemory instanceMemory;
+        // Persistently mapped
+        void *instanceData;
+    };
+
+    // Copies of big runs are split in chunks of this many sprites, done in parallel
+    static const uint32_t COPY_GRAIN_SIZE = 1u << 16u;
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryBudget *memoryBudget = nullptr;
+    PipelineManager *pipelineManager = nullptr;
+    FrameArena *frameArena = nullptr;
+    TextureManager *textureManager = nullptr;
+
+    uint32_t capacity = 0;
+    std::vector<Slot> slots;
+
+    // Owned by the renderer
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    // The blend mode is set per batch
+    PipelineKey pipelineKey;
+
+    // Sprites of the frame being built, in submission order
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    // Allocated for the capacity, and not value initialized: allocate() doesn't clear what the caller overwrites
+    std::unique_ptr<SpriteInstance[]> instances;
+    uint32_t instanceCount = 0;
+    std::vector<State> states;
+    std::vector<Run> runs;
+
+    // Result of the last upload
+    std::vector<Batch> batches;
+    glm::mat4 uploadedViewProjection = glm::mat4(1.0f);
+    uint32_t uploadedCount = 0;
+
+    uint32_t findState(uint32_t texture, BlendMode blendMode);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Texture data in CPU memory, ready to be copied into an image
+struct TextureData {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t layerCount = 1;
+    // Mips stored in 'bytes', 1 if the chain is left to the GPU
+    uint32_t mipLevels = 1;
+    // Layer major: the mips of layer 0 from the largest, then the mips of layer 1, ...
+    std::vector<uint8_t> bytes;
+
+    // Offset of a mip of a layer in 'bytes'
+    size_t getOffset(uint32_t layer, uint32_t mipLevel) const;
+};
+
+// Reads and converts textures, on any thread. Failures throw std::runtime_error
+class TextureLoader {
+public:
+    // DDS files, with the legacy or the DX10 header: BC1-BC7, RGBA8 and BGRA8, arrays and mip chains.
+    // Legacy headers don't tell whether colors are sRGB, 'isSrgb' picks the sRGB variant of the format then. The
+    // format of DX10 headers is kept as declared, 'isSrgb' is ignored for them
+    static TextureData loadDDS(const std::string &path, bool isSrgb);
+
+    // Uncompressed RGBA8 pixels, rows from the top
+    static TextureData fromPixels(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height, bool isSrgb);
+
+    // Stacks textures of the same format, size and mips into the layers of an array
+    static TextureData stackLayers(const std::vector<TextureData> &layers);
+
+    // Decodes BC1-BC5 to RGBA8 (BC4 and BC5 go to the red and green channels), for devices without the
+    // textureCompressionBC feature. BC6H and BC7 are too costly to decode on the CPU and throw
+    static TextureData decompress(const TextureData &data);
+
+    static bool isBlockCompressed(VkFormat format);
+
+    // Bytes of a mip level of one layer
+    static size_t getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+private:
+    // Bytes per 4x4 block, or per pixel for uncompressed formats
+    static uint32_t getBlockSize(VkFormat format);
+
+    static VkFormat toSrgb(VkFormat format);
+};
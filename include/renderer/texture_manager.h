@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bindless_descriptors.h"
+#include "memory_budget.h"
+#include "queue_manager.h"
+#include "renderer_utility.h"
+#include "texture_loader.h"
+#include "vulkan_core.h"
+#include "core/job_system.h"
+
+// Identifies a texture of the TextureManager. 0 is a white texture, also drawn while a texture is loading
+using TextureHandle = uint32_t;
+
+const TextureHandle WHITE_TEXTURE = 0;
+
+struct SamplerSettings {
+    VkFilter filter = VK_FILTER_LINEAR;
+    VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    // Maximum anisotropy of the device, if it supports anisotropic filtering
+    bool isAnisotropic = true;
+
+    bool operator<(const SamplerSettings &other) const {
+        if (filter != other.filter) {
+            return filter < other.filter;
+        }
+        if (addressMode != other.addressMode) {
+            return addressMode < other.addressMode;
+        }
+        return isAnisotropic < other.isAnisotropic;
+    }
+};
+
+struct TextureSettings {
+    // Color textures are sRGB, data textures (normals, masks, ...) are not. Only for files that don't declare it
+    // (legacy DDS headers): DX10 headers keep their format
+    bool isSrgb = true;
+    // Generates the mip chain on the GPU when the texture doesn't bring its own
+    bool generateMips = true;
+    SamplerSettings sampler;
+};
+
+// Device local textures, always 2D arrays (a plain texture is an array of one layer) sampled as sampler2DArray, so
+// that atlases are simply layers. Ready textures are registered in the bindless texture array, shaders sample them at
+// getBindlessIndex().
+//
+// Files are read and decoded on the JobSystem, update() then uploads them on the render thread through a staging
+// buffer, generating the mips with blits. Block compressed formats (BC1-BC7) stay compressed when the device samples
+// them, and BC1-BC5 are decoded on the loader thread when it doesn't.
+// Samplers are deduplicated: textures with the same SamplerSettings share one VkSampler.
+// Not thread-safe: textures are created and bound by the render thread, only their loading runs in the background.
+class TextureManager {
+public:
+    void initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, const DeviceFeatures &deviceFeatures,
+                    QueueManager &queues, BindlessDescriptors &bindless, MemoryBudget &budget);
+
+    // Loads a DDS file in the background, the texture is white until it's uploaded (and stays white if the loading
+    // fails)
+    TextureHandle load(const std::string &path, const TextureSettings &settings = TextureSettings());
+
+    // Loads DDS files of the same format, size and mips as the layers of one texture array
+    TextureHandle loadArray(const std::vector<std::string> &layerPaths,
+                            const TextureSettings &settings = TextureSettings());
+
+    // Uploads texture data produced by the caller (e.g. procedural textures) at the next update()
+    TextureHandle create(TextureData data, const TextureSettings &settings = TextureSettings());
+
+    // Render thread, at frame boundaries: submits the uploads of the loaded textures and publishes the textures
+    // whose upload is done
+    void update();
+
+    bool isReady(TextureHandle texture) const;
+
+    // The index of the white texture until the texture is ready
+    BindlessIndex getBindlessIndex(TextureHandle texture) const;
+
+    VkSampler getSampler(const SamplerSettings &settings);
+
+    // Waits for the loads and uploads in progress, the device must be idle
+    void cleanup();
+
+private:
+    struct Texture {
+        TextureSettings settings;
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t layerCount = 1;
+        uint32_t mipLevels = 1;
+        BindlessIndex bindlessIndex = 0;
+        bool isReady = false;
+    };
+
+    struct LoadedTexture {
+        TextureHandle texture;
+        TextureData data;
+    };
+
+    // Uploads submitted together, done once the fence is signaled
+    struct Upload {
+        VkFence fence;
+        VkCommandBuffer commandBuffer;
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingMemory;
+        std::vector<TextureHandle> textures;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    MemoryBudget *memoryBudget = nullptr;
+    VkQueue queue = VK_NULL_HANDLE;
+    float maxAnisotropy = 0.0f;
+    bool hasTextureCompressionBC = false;
+
+    BindlessDescriptors *bindless = nullptr;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::map<SamplerSettings, VkSampler> samplers;
+
+    // Indexed by handle, only touched by the render thread
+    std::vector<Texture> textures;
+    std::vector<Upload> uploads;
+
+    // Filled by the loader jobs
+    std::mutex loadedMutex;
+    std::vector<LoadedTexture> loadedTextures;
+    JobCounter loads;
+
+    TextureHandle addTexture(const TextureSettings &settings);
+
+    // Converts the data to a format the device samples, on the loader thread
+    TextureData prepare(TextureData data) const;
+
+    bool isFormatSampled(VkFormat format) const;
+
+    bool canGenerateMips(VkFormat format) const;
+
+    // Records the copy of the data into a new image, and the generation of its mips
+    void recordUpload(VkCommandBuffer commandBuffer, Texture &texture, const TextureData &data, VkBuffer stagingBuffer,
+                      VkDeviceSize stagingOffset);
+
+    void publish(TextureHandle texture);
+
+    void destroyUpload(Upload &upload);
+};
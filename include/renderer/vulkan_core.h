@@ -2,12 +2,39 @@
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
+#include <string>
 #include <vector>
 #include <set>
 
 #include "renderer_utility.h"
 #include "queue_manager.h"
 
+// What the selected device supports beyond the requirements of the renderer. Optional features and extensions are
+// enabled on the logical device whenever they're supported, the subsystems using them are handed this struct
+struct DeviceFeatures {
+    // Required: devices without them aren't selected
+    bool hasTimelineSemaphores = false;
+    bool hasDescriptorIndexing = false;
+
+    // Optional
+    // Particles skip their draw on the GPU when no particle is alive
+    bool hasDrawIndirectCount = false;
+    // Anisotropic filtering of the textures asking for it
+    bool hasSamplerAnisotropy = false;
+    // BC textures are decoded on the CPU without it
+    bool hasTextureCompressionBC = false;
+    // VK_EXT_memory_budget
+    bool hasMemoryBudget = false;
+
+    // Queue families without graphics (async compute), and without graphics nor compute (copy engines)
+    bool hasDedicatedCompute = false;
+    bool hasDedicatedTransfer = false;
+    VkDeviceSize deviceLocalMemory = 0;
+
+    // Enabled on the logical device: the required ones, and the supported optional ones
+    std::vector<const char *> extensions;
+};
+
 class VulkanCore {
 public:
 
@@ -15,16 +42,26 @@ public:
 
     static VkSurfaceKHR createSurface(VkInstance instance, GLFWwindow *window);
 
-    static VkPhysicalDevice createPhysicalDevice(VkInstance instance);
+    // Picks the suitable device with the highest score (type, memory, queue families, optional features, limits).
+    // ASTERISM_DEVICE overrides the choice: the index of a device, its UUID, or part of its name
+    static VkPhysicalDevice createPhysicalDevice(VkInstance instance, VkSurfaceKHR surface,
+                                                 const std::vector<const char *> &requiredExtensions,
+                                                 DeviceFeatures &features);
+
+    static bool isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char *extensionName);
 
-    static VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice,
-                                        std::vector<const char *> deviceExtensions,
-                                        QueueManager queues);
+    static VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, const DeviceFeatures &features,
+                                        const QueueManager &queues);
 
 private:
 
-    static bool isDiscreteGPU(VkPhysicalDevice device);
+    // Negative if the device can't run the renderer, 'rejection' then says why
+    static int64_t scorePhysicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                       const std::vector<const char *> &requiredExtensions, DeviceFeatures &features,
+                                       std::string &rejection);
+
+    static bool matchesDeviceOverride(VkPhysicalDevice physicalDevice, uint32_t index, const std::string &override);
 
-    static bool isIntegratedGPU(VkPhysicalDevice device);
+    static std::string getDeviceUuid(VkPhysicalDevice physicalDevice);
 
 };
\ No newline at end of file
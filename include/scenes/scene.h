@@ -1,7 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+
 #include "renderer/renderer.h"
 #include "renderer/renderer_utility.h"
+#include "renderer/frame_state.h"
+#include "scenes/triple_buffer.h"
 
 class Scene {
 public:
@@ -9,16 +14,27 @@ public:
 
     std::shared_ptr<Renderer> renderer;
     uint32_t frameCount;
+    // Fixed simulation time step in seconds (1 / tickRate)
     double_t dt;
+    // Amount of update() calls per second, independent of the present rate
+    double_t tickRate = 60.0;
 
     void run();
 
     // Submits draw/other commands to the Renederer, maybe better in the subclasses
     //    virtual void submit(Camera c, Drawable d) = 0;
 
-private:
-
+protected:
+    // Written by update() on the simulation thread, published at the end of each tick
+    FrameState simulationState;
+    // Latest published snapshot, read by draw() on the render thread
+    FrameState renderState;
 
+private:
+    // Hands over snapshots from the simulation thread to the render thread without either of them waiting
+    TripleBuffer<FrameState> frameStates;
+    std::atomic<bool> isSimulating = {false};
+    std::thread simulationThread;
 
     // These functions differ for each type of scene (e.g 2D, 3D, etc...)
     virtual void initializeCore() = 0;
@@ -28,9 +44,13 @@ private:
     // These ones instead differ for each scene, independent of the type
     virtual void setup() = 0;
 
+    // Runs on the simulation thread, must only touch simulationState
     virtual void update() = 0;
 
+    // Runs on the render thread, must only read renderState
     virtual void draw() = 0;
 
     void core();
+
+    void simulationLoop();
 };
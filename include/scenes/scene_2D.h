@@ -1,10 +1,22 @@
 #pragma once
 
 #include "scenes/scene.h"
+#include "renderer/camera.h"
 
 class Scene2D : public virtual Scene {
 public:
 
+protected:
+    // Most sprites per frame, set in setup()
+    uint32_t spriteCapacity = 1u << 16u;
+
+    // Static orthographic camera looking down the z axis: the screen spans [-aspect ratio, aspect ratio] x [-1, 1]
+    // world units, y pointing up
+    std::unique_ptr<Camera> camera;
+
+    // Starts the sprites of the frame, to be called by draw() before drawing sprites and calling drawFrame()
+    SpriteBatch &beginSprites();
+
 private:
     void initializeCore() final;
 
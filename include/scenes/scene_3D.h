@@ -5,6 +5,14 @@
 class Scene3D : public virtual Scene {
 public:
 
+protected:
+    // Particle system of the scene, set in setup(). Its emitters are part of the simulation state
+    ParticleSystemSettings particleSettings;
+    // Clustered lighting of the scene, set in setup(). Its lights are part of the simulation state
+    LightingSettings lightingSettings;
+    // Dynamic resolution of the scene, set in setup(). Off by default
+    DynamicResolutionSettings resolutionSettings;
+
 private:
     void initializeCore() final;
 
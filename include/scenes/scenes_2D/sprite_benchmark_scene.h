@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "scenes/scene_2D.h"
+
+// Sizes the throughput of the sprite batch: up to a million sprites bounce around the screen, every one of them
+// rewritten each frame, in steps of increasing amount. The frame time and the CPU time spent writing the sprites are
+// logged. Presents uncapped.
+class SpriteBenchmarkScene : public virtual Scene2D {
+public:
+
+private:
+    // Seconds per step
+    static constexpr double STEP_DURATION = 5.0;
+
+    const std::vector<uint32_t> steps = {1u << 17u, 1u << 18u, 1u << 19u, 1u << 20u};
+
+    // Sprites are animated on the render thread, from the wall clock: going through the simulation snapshots would
+    // copy every sprite three times per tick
+    std::chrono::steady_clock::time_point start;
+
+    // Statistics of the current report
+    std::chrono::steady_clock::time_point reportStart;
+    uint32_t reportFrames = 0;
+    double reportWriteTime = 0.0;
+
+    void setup() final;
+
+    void update() final;
+
+    void draw() final;
+
+};
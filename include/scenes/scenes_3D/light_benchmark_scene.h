@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+
+#include "scenes/scene_3D.h"
+
+// Sizes the cost of the clustered lighting: the amount of small lights over the floor is raised in steps up to the
+// capacity, and the frame time and GPU binning time of each step are logged. Presents uncapped.
+class LightBenchmarkScene : public virtual Scene3D {
+public:
+
+private:
+    // Seconds per step
+    static constexpr double STEP_DURATION = 4.0;
+    // Half size of the floor, the lights are spread over it
+    const float floorExtent = 2.0f;
+    const float lightRange = 0.15f;
+
+    // Amount of lights of each step
+    const std::vector<uint32_t> steps = {1024, 2048, 4096, 8192, 16384};
+
+    // Statistics of the current report, on the render thread
+    std::chrono::steady_clock::time_point reportStart;
+    uint32_t reportFrames = 0;
+    double reportBinningTime = 0.0;
+
+    void setup() final;
+
+    void update() final;
+
+    void draw() final;
+
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+
+#include "scenes/scene_3D.h"
+
+// Sizes the throughput of the GPU particle system: the amount of live particles is raised in steps up to the
+// capacity, and the GPU simulation time and frame time of each step are logged. Presents uncapped.
+class ParticleBenchmarkScene : public virtual Scene3D {
+public:
+
+private:
+    static const uint32_t EMITTER_COUNT = 8;
+    // Seconds per step, the first one is spent reaching the target amount of particles
+    static constexpr double STEP_DURATION = 6.0;
+    const float particleLifetime = 2.0f;
+
+    // Amount of live particles aimed at by each step
+    const std::vector<uint32_t> steps = {1u << 18u, 1u << 20u, 1u << 21u, 1u << 22u};
+
+    // Statistics of the current report, on the render thread
+    std::chrono::steady_clock::time_point reportStart;
+    uint32_t reportFrames = 0;
+    double reportSimulationTime = 0.0;
+
+    void setup() final;
+
+    void update() final;
+
+    void draw() final;
+
+};
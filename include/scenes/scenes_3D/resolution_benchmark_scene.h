@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+
+#include "scenes/scene_3D.h"
+
+// Checks that the dynamic resolution holds the GPU budget: the fragment cost is raised in steps (more and larger
+// lights over the floor, so more lights per pixel) and then lowered again, and the GPU time, render scale and render
+// extent are logged. The scale should drop while the load is high and come back up after. Presents uncapped.
+class ResolutionBenchmarkScene : public virtual Scene3D {
+public:
+
+private:
+    // Seconds per step
+    static constexpr double STEP_DURATION = 4.0;
+    // GPU budget of the scene, in milliseconds
+    static constexpr double TARGET_FRAME_TIME = 4.0;
+    // Half size of the floor, the lights are spread over it
+    const float floorExtent = 2.0f;
+
+    // Range of the lights of each step, up then down
+    const std::vector<float> steps = {0.1f, 0.2f, 0.4f, 0.8f, 0.4f, 0.2f, 0.1f};
+    const uint32_t lightCount = 4096;
+
+    // Statistics of the current report, on the render thread
+    std::chrono::steady_clock::time_point reportStart;
+    uint32_t reportFrames = 0;
+
+    void setup() final;
+
+    void update() final;
+
+    void draw() final;
+
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+
+#include "scenes/scene_3D.h"
+
+// Measures the shadow map caching: a sun and a few spot lights over a floor covered with static casters. Phases
+// without and with moving casters alternate, and the frame time and the shadow map layers rendered per frame are
+// logged: without moving casters, nothing should be rendered once the cache is filled. Presents uncapped.
+class ShadowBenchmarkScene : public virtual Scene3D {
+public:
+
+private:
+    // Seconds per phase, the odd phases have moving casters
+    static constexpr double PHASE_DURATION = 4.0;
+    // Half size of the floor, the casters are spread over it
+    const float floorExtent = 2.0f;
+    const uint32_t staticCasterCount = 256;
+    const uint32_t dynamicCasterCount = 8;
+    const uint32_t spotLightCount = 4;
+
+    // Statistics of the current report, on the render thread
+    std::chrono::steady_clock::time_point reportStart;
+    uint32_t reportFrames = 0;
+    uint32_t reportCachedRenders = 0;
+    uint32_t reportComposites = 0;
+
+    void setup() final;
+
+    void update() final;
+
+    void draw() final;
+
+};
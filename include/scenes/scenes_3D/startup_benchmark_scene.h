@@ -0,0 +1,19 @@
+#pragma once
+
+#include "scenes/scene_3D.h"
+
+// Measures the time to first frame: the renderer is initialized, a single frame of the default content is presented,
+// then the phases of the startup and the time from its start to the first present are logged and the scene closes.
+// Every run is a new process, so that drivers and shaders start from the same state: the first run after clearing
+// the shader cache measures a cold start, the following ones a warm start.
+class StartupBenchmarkScene : public virtual Scene3D {
+public:
+
+private:
+    void setup() final;
+
+    void update() final;
+
+    void draw() final;
+
+};
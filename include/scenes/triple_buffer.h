@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer handoff of the latest value.
+// The producer always owns a 'back' slot and the consumer always owns a 'front' slot, the third slot sits in the middle.
+// Publishing swaps the back slot with the middle one, consuming swaps the front slot with the middle one if it's fresh.
+// Neither side ever waits on the other: the producer can overwrite unread values, the consumer can re-read old ones.
+template<typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+
+    explicit TripleBuffer(const T &initialValue) {
+        slots.fill(initialValue);
+    }
+
+    // Producer side: the slot that is currently being written
+    T &back() { return slots[backIndex]; }
+
+    // Producer side: hand the back slot over to the consumer, keep writing into a fresh one
+    void publish() {
+        uint8_t previousMiddle = middle.exchange(backIndex | freshBit, std::memory_order_acq_rel);
+        backIndex = previousMiddle & indexMask;
+    }
+
+    // Consumer side: grab the newest published value (if any) and return it
+    const T &acquire() {
+        if (middle.load(std::memory_order_relaxed) & freshBit) {
+            uint8_t previousMiddle = middle.exchange(frontIndex, std::memory_order_acq_rel);
+            frontIndex = previousMiddle & indexMask;
+        }
+        return slots[frontIndex];
+    }
+
+    // Consumer side: whether a value has been published since the last acquire()
+    bool hasFresh() const { return middle.load(std::memory_order_relaxed) & freshBit; }
+
+private:
+    static constexpr uint8_t freshBit = 0x4;
+    static constexpr uint8_t indexMask = 0x3;
+
+    std::array<T, 3> slots = {};
+    uint8_t backIndex = 0;
+    uint8_t frontIndex = 1;
+    std::atomic<uint8_t> middle = {2};
+};
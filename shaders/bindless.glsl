@@ -0,0 +1,12 @@
+// Bindless resources of the scene pipelines (see renderer/bindless_descriptors.h), indexed with push constants.
+// Storage buffers are aliased with every element type the shaders need, and read-only: graphics stages only read them
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 1, binding = 0) uniform sampler2DArray textures[];
+// Depth textures registered with a comparison sampler
+layout(set = 1, binding = 0) uniform sampler2DArrayShadow shadowTextures[];
+
+layout(std430, set = 1, binding = 1) readonly buffer Vec4Buffer { vec4 data[]; } vec4Buffers[];
+layout(std430, set = 1, binding = 1) readonly buffer UVec2Buffer { uvec2 data[]; } uvec2Buffers[];
+layout(std430, set = 1, binding = 1) readonly buffer UIntBuffer { uint data[]; } uintBuffers[];
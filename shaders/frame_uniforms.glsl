@@ -0,0 +1,28 @@
+// Per-frame data of the scene pipelines, in the uniform buffer of the frame slot (see FrameUniforms in renderer.h)
+
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProjection;
+
+    // Clustered lighting (see renderer/clustered_lighting.h)
+    // x, y, z: clusters along each axis, w: amount of lights
+    uvec4 clusterCounts;
+    // x, y: pixels per cluster tile, z and w: scale and bias of the depth slices (slice = log(depth) * z + w)
+    vec4 clusterScale;
+    vec4 ambient;
+    // Bindless storage buffers, x: lights, y: cluster ranges, z: light indices
+    uvec4 lightBuffers;
+    // Directional light, xyz: direction it travels in, in view space
+    vec4 directionalDirection;
+    // rgb: color times intensity
+    vec4 directionalColor;
+
+    // Shadow maps (see renderer/shadow_maps.h)
+    // From view space to the shadow map of each layer: the cascades, then the spot lights
+    mat4 shadowMatrices[8];
+    // Farthest view depth of each cascade
+    vec4 cascadeSplits;
+    // x: bindless index of the shadow maps, y: amount of cascades (0 without directional shadows)
+    uvec4 shadowInfo;
+} frame;
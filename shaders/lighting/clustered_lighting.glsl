@@ -0,0 +1,41 @@
+// Shading with the directional light and the lights of the cluster of the fragment, listed by light_binning.comp.
+// Needs bindless.glsl, frame_uniforms.glsl and shadows.glsl
+
+// Lights are 4 vec4 in view space: position and range, color and cosine of the inner cone angle, direction and
+// cosine of the outer cone angle, and the layer of their shadow map (negative without)
+vec3 shadeClustered(vec3 viewPosition, vec3 normal, vec3 albedo) {
+    uvec3 counts = frame.clusterCounts.xyz;
+    uvec2 tile = uvec2(gl_FragCoord.xy / frame.clusterScale.xy);
+    uint slice = uint(max(log(-viewPosition.z) * frame.clusterScale.z + frame.clusterScale.w, 0.0));
+    uvec3 cluster = min(uvec3(tile, slice), counts - 1u);
+    uint clusterIndex = cluster.x + counts.x * (cluster.y + counts.y * cluster.z);
+
+    // First index and amount of lights
+    uvec2 range = uvec2Buffers[frame.lightBuffers.y].data[clusterIndex];
+    vec3 color = frame.ambient.rgb * albedo;
+    float directionalLighting = max(dot(normal, -frame.directionalDirection.xyz), 0.0);
+    if (directionalLighting > 0.0) {
+        color += albedo * frame.directionalColor.rgb * directionalLighting * directionalShadow(viewPosition);
+    }
+    for (uint i = 0; i < range.y; ++i) {
+        uint light = uintBuffers[frame.lightBuffers.z].data[range.x + i];
+        vec4 positionRange = vec4Buffers[frame.lightBuffers.x].data[4 * light];
+        vec4 colorInner = vec4Buffers[frame.lightBuffers.x].data[4 * light + 1];
+        vec4 directionOuter = vec4Buffers[frame.lightBuffers.x].data[4 * light + 2];
+        float shadowLayer = vec4Buffers[frame.lightBuffers.x].data[4 * light + 3].x;
+
+        vec3 toLight = positionRange.xyz - viewPosition;
+        float distance = length(toLight);
+        vec3 lightDirection = toLight / max(distance, 1e-4);
+        // Inverse square falloff, windowed to reach 0 at the range so that the binning can ignore the lights past it
+        float window = clamp(1.0 - pow(distance / positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+        float cone = smoothstep(directionOuter.w, colorInner.w, dot(-lightDirection, directionOuter.xyz));
+        float lighting = max(dot(normal, lightDirection), 0.0) * attenuation * cone;
+        if (lighting > 0.0 && shadowLayer >= 0.0) {
+            lighting *= sampleShadow(uint(shadowLayer), viewPosition);
+        }
+        color += albedo * colorInner.rgb * lighting;
+    }
+    return color;
+}
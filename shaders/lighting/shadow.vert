@@ -0,0 +1,13 @@
+#version 450
+
+// Depth of the shadow casters, the pipeline has no fragment stage
+layout(push_constant) uniform ShadowConstants {
+    // From the model space of the caster to the clip space of the shadow map
+    mat4 modelLightMatrix;
+} constants;
+
+layout(location = 0) in vec3 inPosition;
+
+void main() {
+    gl_Position = constants.modelLightMatrix * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,28 @@
+// Shadow maps of the directional and spot lights, rendered by renderer/shadow_maps.h.
+// Needs bindless.glsl and frame_uniforms.glsl
+
+// Fraction of the fragment lit by the light of a layer, filtered by the comparison sampler
+float sampleShadow(uint layer, vec3 viewPosition) {
+    vec4 shadowPosition = frame.shadowMatrices[layer] * vec4(viewPosition, 1.0);
+    shadowPosition.xyz /= shadowPosition.w;
+    vec2 uv = shadowPosition.xy * 0.5 + 0.5;
+    // Outside of the shadow map: nothing casts there
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))) || shadowPosition.z > 1.0) {
+        return 1.0;
+    }
+    return texture(shadowTextures[frame.shadowInfo.x], vec4(uv, float(layer), shadowPosition.z));
+}
+
+float directionalShadow(vec3 viewPosition) {
+    uint cascadeCount = frame.shadowInfo.y;
+    if (cascadeCount == 0u) {
+        return 1.0;
+    }
+    // The first cascade that reaches the depth of the fragment
+    float depth = -viewPosition.z;
+    uint cascade = 0u;
+    while (cascade + 1u < cascadeCount && depth > frame.cascadeSplits[cascade]) {
+        cascade++;
+    }
+    return sampleShadow(cascade, viewPosition);
+}
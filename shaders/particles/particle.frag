@@ -0,0 +1,12 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragCorner;
+layout(location = 0) out vec4 outColor;
+
+// Soft round sprite, additively blended
+void main() {
+    float falloff = max(1.0 - dot(fragCorner, fragCorner), 0.0);
+    outColor = vec4(fragColor.rgb, fragColor.a * falloff * falloff);
+}
@@ -0,0 +1,39 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "../bindless.glsl"
+
+#include "../frame_uniforms.glsl"
+
+// Bindless indices of the destination pool, the one simulated last
+layout(push_constant) uniform ParticleConstants {
+    uint positions;
+    uint velocities;
+    uint appearances;
+} pool;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragCorner;
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+// One camera facing quad per instance, read from the destination pool
+void main() {
+    vec4 positionAge = vec4Buffers[pool.positions].data[gl_InstanceIndex];
+    float lifetime = vec4Buffers[pool.velocities].data[gl_InstanceIndex].w;
+    uvec2 appearance = uvec2Buffers[pool.appearances].data[gl_InstanceIndex];
+
+    vec2 corner = corners[gl_VertexIndex];
+    vec4 viewPosition = frame.view * vec4(positionAge.xyz, 1.0);
+    viewPosition.xy += corner * uintBitsToFloat(appearance.y);
+    gl_Position = frame.proj * viewPosition;
+
+    fragColor = unpackUnorm4x8(appearance.x);
+    // Fade out towards the end of the life
+    fragColor.a *= clamp(1.0 - positionAge.w / lifetime, 0.0, 1.0);
+    fragCorner = corner;
+}
@@ -0,0 +1,81 @@
+// Shared by the particle compute shaders. The rendering reads the destination pool through the bindless arrays.
+// Particles are stored as structures of arrays, in two pools: every frame the live particles of the source pool are
+// simulated and compacted into the destination pool, which is then drawn. The pools swap roles the next frame.
+
+#define MAX_PARTICLE_EMITTERS 16
+
+struct Emitter {
+    // xyz: position, w: radius of the emission sphere
+    vec4 position;
+    // xyz: initial velocity, w: random spread
+    vec4 velocity;
+    vec4 color;
+    // x: lifetime, y: lifetime variance, z: size
+    vec4 properties;
+    // x: first emitted particle of the frame, y: amount of emitted particles
+    uvec4 emission;
+};
+
+layout(set = 1, binding = 0) uniform ParticleParameters {
+    // xyz: gravity, w: drag
+    vec4 gravity;
+    float deltaTime;
+    float time;
+    uint capacity;
+    // Index of the source pool in aliveCounts
+    uint sourcePool;
+    uint emitCount;
+    uint emitterCount;
+    uint seed;
+    uint padding;
+    Emitter emitters[MAX_PARTICLE_EMITTERS];
+} parameters;
+
+// Source pool: xyz position and age, xyz velocity and lifetime, packed RGBA8 color and size
+layout(std430, set = 1, binding = 1) buffer SourcePositions { vec4 sourcePositions[]; };
+layout(std430, set = 1, binding = 2) buffer SourceVelocities { vec4 sourceVelocities[]; };
+layout(std430, set = 1, binding = 3) buffer SourceAppearances { uvec2 sourceAppearances[]; };
+
+// Destination pool, the one that gets drawn
+layout(std430, set = 1, binding = 4) buffer Positions { vec4 positions[]; };
+layout(std430, set = 1, binding = 5) buffer Velocities { vec4 velocities[]; };
+layout(std430, set = 1, binding = 6) buffer Appearances { uvec2 appearances[]; };
+
+// Live particles of both pools, and the arguments of the simulation dispatch
+layout(std430, set = 1, binding = 7) buffer Counters {
+    uint aliveCounts[2];
+    uint dispatchX;
+    uint dispatchY;
+    uint dispatchZ;
+};
+
+// Arguments of the indirect draw of this frame slot (VkDrawIndirectCommand), and its draw count
+layout(std430, set = 1, binding = 8) buffer DrawCommand {
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+    uint drawCount;
+};
+
+// PCG hash
+uint hash(uint value) {
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Uniform in [0, 1)
+float random(inout uint state) {
+    state = hash(state);
+    return float(state >> 8u) / 16777216.0;
+}
+
+// Uniform in the unit ball
+vec3 randomInSphere(inout uint state) {
+    float z = random(state) * 2.0 - 1.0;
+    float angle = random(state) * 6.2831853;
+    float radius = sqrt(max(1.0 - z * z, 0.0));
+    vec3 direction = vec3(radius * cos(angle), radius * sin(angle), z);
+    return direction * pow(random(state), 1.0 / 3.0);
+}
@@ -1,9 +1,35 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+#include "frame_uniforms.glsl"
+#include "lighting/shadows.glsl"
+#include "lighting/clustered_lighting.glsl"
+
+// Pipeline variant toggles (see PipelineKey::specialize)
+layout(constant_id = 0) const bool USE_VERTEX_COLOR = true;
+// Unlit when the renderer has no clustered lighting
+layout(constant_id = 1) const bool USE_CLUSTERED_LIGHTING = false;
+
+layout(push_constant) uniform MeshConstants {
+    mat4 model;
+    uint textureIndex;
+} constants;
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragViewPosition;
 layout(location = 0) out vec4 outColor;
 
 void main(){
-    outColor = vec4(fragColor, 1.0);
+    vec4 color = USE_VERTEX_COLOR ? vec4(fragColor, 1.0) : vec4(1.0);
+    color *= texture(textures[constants.textureIndex], vec3(fragTexCoord, 0.0));
+    if (USE_CLUSTERED_LIGHTING) {
+        // Vertices have no normals: faceted, from the derivatives of the position, facing the camera
+        vec3 normal = normalize(cross(dFdx(fragViewPosition), dFdy(fragViewPosition)));
+        normal = dot(normal, fragViewPosition) > 0.0 ? -normal : normal;
+        color.rgb = shadeClustered(fragViewPosition, normal, color.rgb);
+    }
+    outColor = color;
 }
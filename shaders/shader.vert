@@ -1,19 +1,29 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
-layout(binding = 0) uniform UniformBufferObject{
+// Per frame
+#include "frame_uniforms.glsl"
+
+// Per draw, shared with shader.frag
+layout(push_constant) uniform MeshConstants {
     mat4 model;
-    mat4 view;
-    mat4 proj;
-} ubo;
+    uint textureIndex;
+} constants;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+// For the lighting
+layout(location = 2) out vec3 fragViewPosition;
 
 void main(){
-    vec4 modelPos = vec4(inPosition, 1.0);
-    gl_Position = ubo.proj * ubo.view * ubo.model * modelPos;
+    vec4 worldPos = constants.model * vec4(inPosition, 1.0);
+    gl_Position = frame.viewProjection * worldPos;
+    fragViewPosition = vec3(frame.view * worldPos);
     fragColor = inColor;
-}
\ No newline at end of file
+    fragTexCoord = inTexCoord;
+}
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "../bindless.glsl"
+
+layout(push_constant) uniform SpriteConstants {
+    mat4 viewProjection;
+    uint textureIndex;
+} constants;
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTextureLayer;
+
+layout(location = 0) out vec4 outColor;
+
+// Untextured sprites sample the white texture
+void main() {
+    outColor = fragColor * texture(textures[constants.textureIndex], vec3(fragUV, float(fragTextureLayer)));
+}
@@ -0,0 +1,39 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Shared with sprite.frag, the texture of the batch is set per draw
+layout(push_constant) uniform SpriteConstants {
+    mat4 viewProjection;
+    uint textureIndex;
+} constants;
+
+// Per instance (see drawable/sprite.h)
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inSize;
+layout(location = 2) in float inRotation;
+layout(location = 3) in vec4 inColor;
+layout(location = 4) in uint inTextureLayer;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragTextureLayer;
+
+const vec2 corners[6] = vec2[](
+    vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(0.5, 0.5),
+    vec2(-0.5, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5)
+);
+
+// One quad per instance, its corners come from the vertex index
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    float cosine = cos(inRotation);
+    float sine = sin(inRotation);
+    vec2 offset = corner * inSize;
+    vec2 position = inPosition + vec2(cosine * offset.x - sine * offset.y, sine * offset.x + cosine * offset.y);
+    gl_Position = constants.viewProjection * vec4(position, 0.0, 1.0);
+
+    fragColor = inColor;
+    // Top left corner of the image at (0, 0)
+    fragUV = vec2(corner.x + 0.5, 0.5 - corner.y);
+    fragTextureLayer = inTextureLayer;
+}
@@ -1,12 +1,42 @@
 #include "renderer/renderer.h"
 #include "scenes/scenes_3D/default_scene.h"
+#include "scenes/scenes_3D/particle_benchmark_scene.h"
+#include "scenes/scenes_3D/startup_benchmark_scene.h"
+#include "scenes/scenes_3D/light_benchmark_scene.h"
+#include "scenes/scenes_3D/shadow_benchmark_scene.h"
+#include "scenes/scenes_3D/resolution_benchmark_scene.h"
+#include "scenes/scenes_2D/sprite_benchmark_scene.h"
 
 
 class Asterism {
 public:
-    static void run() {
+    static void run(const std::string &sceneName) {
 //        Renderer renderer;
 //        renderer.initializeRenderer();
+        if (sceneName == "particle-benchmark") {
+            std::make_shared<ParticleBenchmarkScene>()->run();
+            return;
+        }
+        if (sceneName == "startup-benchmark") {
+            std::make_shared<StartupBenchmarkScene>()->run();
+            return;
+        }
+        if (sceneName == "light-benchmark") {
+            std::make_shared<LightBenchmarkScene>()->run();
+            return;
+        }
+        if (sceneName == "shadow-benchmark") {
+            std::make_shared<ShadowBenchmarkScene>()->run();
+            return;
+        }
+        if (sceneName == "resolution-benchmark") {
+            std::make_shared<ResolutionBenchmarkScene>()->run();
+            return;
+        }
+        if (sceneName == "sprite-benchmark") {
+            std::make_shared<SpriteBenchmarkScene>()->run();
+            return;
+        }
         std::shared_ptr<DefaultScene> defaultScene = std::make_shared<DefaultScene>();
         defaultScene->run();
     }
@@ -14,10 +44,14 @@ public:
 private:
 };
 
-int main() {
+int main(int argc, char *argv[]) {
+    // First, so that it's destroyed last and flushes the messages of the other singletons
+    Logger::instance();
     try {
-        Asterism::run();
+        // Optional scene name, e.g. 'asterism particle-benchmark'
+        Asterism::run(argc > 1 ? argv[1] : "");
     } catch (const std::exception &e) {
+        Logger::instance().flush();
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
@@ -0,0 +1,108 @@
+#include "core/allocation_counter.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+#include "core/logger.h"
+
+#ifdef ASTERISM_COUNT_ALLOCATIONS
+
+// Plain integers: operator new can run during the construction and destruction of other thread_local objects
+static thread_local uint64_t allocationCount = 0;
+static thread_local uint32_t allowedDepth = 0;
+
+static void countAllocation() {
+    if (allowedDepth == 0) {
+        allocationCount++;
+    }
+}
+
+static void *allocateAligned(size_t size, size_t alignment) {
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+}
+
+static void freeAligned(void *pointer) {
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+// The array and nothrow forms forward to these ones
+void *operator new(size_t size) {
+    countAllocation();
+    void *pointer = std::malloc(size > 0 ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    countAllocation();
+    void *pointer = allocateAligned(size > 0 ? size : 1, static_cast<size_t>(alignment));
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+    freeAligned(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept {
+    freeAligned(pointer);
+}
+
+uint64_t getThreadAllocationCount() {
+    return allocationCount;
+}
+
+AllowAllocationScope::AllowAllocationScope() {
+    allowedDepth++;
+}
+
+AllowAllocationScope::~AllowAllocationScope() {
+    allowedDepth--;
+}
+
+#else
+
+uint64_t getThreadAllocationCount() {
+    return 0;
+}
+
+AllowAllocationScope::AllowAllocationScope() = default;
+
+AllowAllocationScope::~AllowAllocationScope() = default;
+
+#endif
+
+NoAllocationScope::NoAllocationScope(const char *what, bool isEnabled)
+        : what(what), isEnabled(isEnabled), startCount(getThreadAllocationCount()) {}
+
+NoAllocationScope::~NoAllocationScope() {
+    uint64_t allocations = getThreadAllocationCount() - startCount;
+    if (!isEnabled || allocations == 0) {
+        return;
+    }
+    LOG_ERROR("{} heap allocations in {}", allocations, what);
+    Logger::instance().flush();
+    assert(allocations == 0 && "Heap allocation in a NoAllocationScope");
+}
@@ -0,0 +1,65 @@
+#include "core/frame_arena.h"
+
+#include "core/allocation_counter.h"
+#include "core/logger.h"
+
+void FrameArena::initialize(uint32_t slotCount, size_t blockSize) {
+    slots.resize(slotCount);
+    for (Slot &slot : slots) {
+        slot.block = std::make_unique<std::byte[]>(blockSize);
+        slot.capacity = blockSize;
+    }
+    currentSlot = 0;
+}
+
+void FrameArena::beginFrame(uint32_t slot) {
+    currentSlot = slot;
+    Slot &frameSlot = slots[slot];
+    if (frameSlot.overflowSize > 0) {
+        // Room for the peak usage, with some margin so that a slowly growing workload doesn't overflow every frame
+        size_t peak = frameSlot.used + frameSlot.overflowSize;
+        size_t capacity = peak + peak / 2;
+        AllowAllocationScope allowAllocations;
+        freeOverflows(frameSlot);
+        frameSlot.block = std::make_unique<std::byte[]>(capacity);
+        frameSlot.capacity = capacity;
+        LOG_INFO("Frame arena slot {} grown to {} KiB", slot, capacity / 1024);
+    }
+    frameSlot.used = 0;
+}
+
+size_t FrameArena::getUsedSize() const {
+    return slots[currentSlot].used + slots[currentSlot].overflowSize;
+}
+
+void *FrameArena::do_allocate(size_t size, size_t alignment) {
+    Slot &slot = slots[currentSlot];
+    auto base = reinterpret_cast<uintptr_t>(slot.block.get());
+    uintptr_t address = (base + slot.used + alignment - 1) & ~uintptr_t(alignment - 1);
+    if (address + size <= base + slot.capacity) {
+        slot.used = address + size - base;
+        return reinterpret_cast<void *>(address);
+    }
+
+    // Exceptional: the block grows to fit the next time the slot is used
+    AllowAllocationScope allowAllocations;
+    void *pointer = std::pmr::new_delete_resource()->allocate(size, alignment);
+    slot.overflows.push_back({pointer, size, alignment});
+    slot.overflowSize += size;
+    return pointer;
+}
+
+void FrameArena::freeOverflows(Slot &slot) {
+    for (const Overflow &overflow : slot.overflows) {
+        std::pmr::new_delete_resource()->deallocate(overflow.pointer, overflow.size, overflow.alignment);
+    }
+    slot.overflows.clear();
+    slot.overflowSize = 0;
+}
+
+void FrameArena::cleanup() {
+    for (Slot &slot : slots) {
+        freeOverflows(slot);
+    }
+    slots.clear();
+}
@@ -0,0 +1,36 @@
+#include "core/frame_limiter.h"
+
+void FrameLimiter::setTargetFrameRate(double framesPerSecond) {
+    targetFrameRate = framesPerSecond > 0.0 ? framesPerSecond : 0.0;
+    if (targetFrameRate == 0.0) {
+        framePeriod = clock::duration::zero();
+    } else {
+        framePeriod = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / targetFrameRate));
+    }
+    // Start counting from the next frame
+    nextFrame = clock::time_point();
+}
+
+void FrameLimiter::wait() {
+    if (framePeriod == clock::duration::zero()) {
+        return;
+    }
+    auto now = clock::now();
+    if (nextFrame == clock::time_point()) {
+        nextFrame = now;
+    }
+
+    if (nextFrame - now > spinThreshold) {
+        std::this_thread::sleep_until(nextFrame - spinThreshold);
+    }
+    while (clock::now() < nextFrame) {
+        std::this_thread::yield();
+    }
+
+    nextFrame += framePeriod;
+    // After a long frame don't try to catch up by running the next ones back to back
+    now = clock::now();
+    if (now > nextFrame) {
+        nextFrame = now;
+    }
+}
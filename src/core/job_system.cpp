@@ -0,0 +1,168 @@
+#include "core/job_system.h"
+
+// Which job system and worker the current thread belongs to (nullptr for non-worker threads)
+static thread_local JobSystem *currentSystem = nullptr;
+static thread_local uint32_t currentWorker = 0;
+
+JobSystem &JobSystem::instance() {
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+JobSystem::JobSystem(uint32_t workerCount) {
+    if (workerCount == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    queues.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    // Queues must all exist before the first worker starts stealing
+    workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isRunning = false;
+    }
+    wakeCondition.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::run(Job job, JobCounter *counter) {
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    push({std::move(job), counter});
+}
+
+void JobSystem::runAfter(JobCounter &dependency, Job job, JobCounter *counter) {
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lock(dependency.continuationsMutex);
+        if (dependency.pending.load(std::memory_order_acquire) != 0) {
+            // The last job of 'dependency' pushes it once it's done
+            dependency.continuations.push_back({std::move(job), counter});
+            return;
+        }
+    }
+    push({std::move(job), counter});
+}
+
+void JobSystem::wait(JobCounter &counter) {
+    while (!counter.isDone()) {
+        if (!tryRunOne()) {
+            std::this_thread::yield();
+        }
+    }
+    // The job that brought the counter to zero might still be flushing its continuations
+    std::lock_guard<std::mutex> lock(counter.continuationsMutex);
+}
+
+void JobSystem::push(Task task) {
+    uint32_t queueIndex;
+    if (currentSystem == this) {
+        queueIndex = currentWorker;
+    } else {
+        queueIndex = nextExternalQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks.push_back(std::move(task));
+    }
+    queuedTasks.fetch_add(1);
+
+    if (sleepingWorkers.load() > 0) {
+        // Taking the lock makes sure that a worker that's about to sleep either sees the new task or gets notified
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wakeCondition.notify_one();
+    }
+}
+
+bool JobSystem::tryPop(uint32_t queueIndex, Task &task) {
+    WorkQueue &queue = *queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queuedTasks.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::trySteal(uint32_t thiefIndex, Task &task) {
+    const auto queueCount = static_cast<uint32_t>(queues.size());
+    for (uint32_t i = 1; i <= queueCount; ++i) {
+        WorkQueue &queue = *queues[(thiefIndex + i) % queueCount];
+        // Don't queue up behind the owner, just try the next victim
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || queue.tasks.empty()) {
+            continue;
+        }
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queuedTasks.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::tryRunOne() {
+    Task task;
+    bool found;
+    if (currentSystem == this) {
+        found = tryPop(currentWorker, task) || trySteal(currentWorker, task);
+    } else {
+        found = trySteal(nextExternalQueue.load(std::memory_order_relaxed), task);
+    }
+    if (found) {
+        execute(task);
+    }
+    return found;
+}
+
+void JobSystem::execute(Task &task) {
+    task.job();
+
+    JobCounter *counter = task.counter;
+    if (!counter) {
+        return;
+    }
+    std::vector<JobCounter::Continuation> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->continuationsMutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ready.swap(counter->continuations);
+        }
+    }
+    for (JobCounter::Continuation &continuation : ready) {
+        push({std::move(continuation.job), continuation.counter});
+    }
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex) {
+    currentSystem = this;
+    currentWorker = workerIndex;
+
+    while (isRunning) {
+        if (tryRunOne()) {
+            continue;
+        }
+        // Nothing left to pop or steal: sleep until something gets pushed
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        wakeCondition.wait(lock, [this]() { return !isRunning || queuedTasks.load() > 0; });
+        sleepingWorkers.fetch_sub(1);
+    }
+}
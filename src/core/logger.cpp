@@ -0,0 +1,329 @@
+#include "core/logger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+static const char *const levelNames[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+// Width of the centered messages
+static const size_t lineLength = 80;
+
+LogRateLimiter::LogRateLimiter(uint32_t intervalMilliseconds)
+        : interval(int64_t(intervalMilliseconds) * 1000000) {}
+
+bool LogRateLimiter::allow(uint32_t &suppressed) {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t next = nextTime.load(std::memory_order_relaxed);
+    // Only one of the threads racing past the deadline gets through
+    if (now < next || !nextTime.compare_exchange_strong(next, now + interval, std::memory_order_relaxed)) {
+        suppressedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    suppressed = suppressedCount.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+
+Logger &Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() : startTime(std::chrono::steady_clock::now()) {
+    const char *path = std::getenv("ASTERISM_LOG_FILE");
+    if (path && path[0] != '\0') {
+        output = fopen(path, "w");
+        isOutputOwned = output != nullptr;
+        if (!output) {
+            fprintf(stderr, "Failed to open the log file %s, logging to stdout\n", path);
+        }
+    }
+    if (!output) {
+        output = stdout;
+    }
+    batch.reserve(1024);
+    message.reserve(1024);
+    text.reserve(QUEUE_CAPACITY);
+    writer = std::thread(&Logger::writerLoop, this);
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        isStopping = true;
+    }
+    wakeCondition.notify_one();
+    // The writer drains everything before it exits
+    writer.join();
+    if (isOutputOwned) {
+        fclose(output);
+    }
+}
+
+Logger::QueueOwner::~QueueOwner() {
+    if (queue) {
+        queue->isOwned.store(false, std::memory_order_release);
+    }
+}
+
+Logger::ThreadQueue &Logger::getThreadQueue() {
+    static thread_local QueueOwner owner;
+    if (!owner.queue) {
+        owner.queue = acquireQueue();
+    }
+    return *owner.queue;
+}
+
+Logger::ThreadQueue *Logger::acquireQueue() {
+    AllowAllocationScope allowAllocations;
+    std::lock_guard<std::mutex> lock(queuesMutex);
+    uint32_t count = queueCount.load(std::memory_order_relaxed);
+    ThreadQueue *queue = nullptr;
+    // The ring of a thread that exited keeps going where it stopped, the records it still holds carry their thread
+    for (uint32_t i = 0; i < count && !queue; ++i) {
+        if (!queues[i]->isOwned.load(std::memory_order_acquire)) {
+            queue = queues[i].get();
+        }
+    }
+    if (!queue) {
+        if (count == MAX_THREADS) {
+            throw std::runtime_error("Too many threads logging");
+        }
+        queues[count] = std::make_unique<ThreadQueue>();
+        queues[count]->buffer = std::make_unique<char[]>(QUEUE_CAPACITY);
+        queue = queues[count].get();
+        queueCount.store(count + 1, std::memory_order_release);
+    }
+    queue->isOwned.store(true, std::memory_order_relaxed);
+    queue->threadIndex = nextThreadIndex++;
+    return queue;
+}
+
+char *Logger::reserve(ThreadQueue &queue, uint32_t size) {
+    uint64_t head = queue.head.load(std::memory_order_relaxed);
+    auto offset = static_cast<uint32_t>(head % QUEUE_CAPACITY);
+    // Records never wrap around: the end of the ring is skipped when the record doesn't fit there
+    uint32_t contiguous = QUEUE_CAPACITY - offset;
+    uint32_t skipped = contiguous < size ? contiguous : 0;
+    while (head + skipped + size - queue.tail.load(std::memory_order_acquire) > QUEUE_CAPACITY) {
+        wake();
+        std::this_thread::yield();
+    }
+    if (skipped > 0) {
+        // Too short for a header, the writer skips it the same way
+        if (skipped >= sizeof(RecordHeader)) {
+            auto *padding = new(queue.buffer.get() + offset) RecordHeader();
+            padding->size = skipped;
+            padding->format = nullptr;
+        }
+        head += skipped;
+        offset = 0;
+    }
+    queue.reservedHead = head;
+    return queue.buffer.get() + offset;
+}
+
+void Logger::commit(ThreadQueue &queue, uint32_t size) {
+    queue.head.store(queue.reservedHead + size, std::memory_order_release);
+}
+
+void Logger::writeNow(const char *record) {
+    // The messages this thread queued come first
+    flush();
+    AllowAllocationScope allowAllocations;
+    std::string recordMessage;
+    std::string recordText;
+    format(*reinterpret_cast<const RecordHeader *>(record), recordMessage, recordText);
+    std::lock_guard<std::mutex> lock(outputMutex);
+    fwrite(recordText.data(), 1, recordText.size(), output);
+    fflush(output);
+}
+
+void Logger::wake() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        isWakeRequested = true;
+    }
+    wakeCondition.notify_one();
+}
+
+void Logger::flush() {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    // A drain in progress may have missed the latest messages, the next one can't
+    uint64_t target = drainCount + (isDraining ? 2 : 1);
+    isWakeRequested = true;
+    wakeCondition.notify_one();
+    drainCondition.wait(lock, [this, target]() { return drainCount >= target || isStopping; });
+}
+
+void Logger::writerLoop() {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    while (true) {
+        wakeCondition.wait_for(lock, FLUSH_INTERVAL, [this]() { return isWakeRequested || isStopping; });
+        bool isLastDrain = isStopping;
+        isWakeRequested = false;
+        isDraining = true;
+        lock.unlock();
+
+        drain();
+
+        lock.lock();
+        isDraining = false;
+        drainCount++;
+        drainCondition.notify_all();
+        if (isLastDrain) {
+            return;
+        }
+    }
+}
+
+void Logger::drain() {
+    // Heads are read once: records committed in the meantime are left for the next drain
+    uint64_t heads[MAX_THREADS];
+    uint32_t count = queueCount.load(std::memory_order_acquire);
+    batch.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        const ThreadQueue &queue = *queues[i];
+        heads[i] = queue.head.load(std::memory_order_acquire);
+        uint64_t tail = queue.tail.load(std::memory_order_relaxed);
+        while (tail < heads[i]) {
+            auto offset = static_cast<uint32_t>(tail % QUEUE_CAPACITY);
+            if (QUEUE_CAPACITY - offset < sizeof(RecordHeader)) {
+                tail += QUEUE_CAPACITY - offset;
+                continue;
+            }
+            auto *header = reinterpret_cast<const RecordHeader *>(queue.buffer.get() + offset);
+            if (header->format) {
+                batch.push_back(header);
+            }
+            tail += header->size;
+        }
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    // Threads are interleaved in the order their messages were written
+    std::stable_sort(batch.begin(), batch.end(), [](const RecordHeader *a, const RecordHeader *b) {
+        return a->time < b->time;
+    });
+    text.clear();
+    for (const RecordHeader *header : batch) {
+        format(*header, message, text);
+    }
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        fwrite(text.data(), 1, text.size(), output);
+        fflush(output);
+    }
+
+    // The records can only be overwritten once they're out
+    for (uint32_t i = 0; i < count; ++i) {
+        queues[i]->tail.store(heads[i], std::memory_order_release);
+    }
+}
+
+void Logger::format(const RecordHeader &header, std::string &message, std::string &destination) {
+    const char *argument = reinterpret_cast<const char *>(&header) + sizeof(RecordHeader);
+    message.clear();
+    for (const char *character = header.format; *character != '\0'; ++character) {
+        if (*character != '{') {
+            message.push_back(*character);
+            continue;
+        }
+        // Placeholders are validated at compile time
+        const char *end = strchr(character, '}');
+        appendArgument(argument, std::string_view(character + 1, end - character - 1), message);
+        character = end;
+    }
+    if (header.suppressed > 0) {
+        message.append(" (").append(std::to_string(header.suppressed)).append(" similar messages suppressed)");
+    }
+
+    switch (header.style) {
+        case LOG_STYLE_RECORD: {
+            char prefix[64];
+            int length = snprintf(prefix, sizeof(prefix), "[%10.4f] [%-7s] [thread %u] ", double(header.time) * 1e-9,
+                                  levelNames[header.level], header.threadIndex);
+            destination.append(prefix, length).append(message).push_back('\n');
+            break;
+        }
+        case LOG_STYLE_PLAIN:
+            destination.append(message).push_back('\n');
+            break;
+        case LOG_STYLE_CENTERED:
+            appendCentered(message, destination);
+            break;
+        case LOG_STYLE_TITLE:
+            message.insert(0, "==========[ ").append(" ]==========");
+            appendCentered(message, destination);
+            break;
+    }
+}
+
+void Logger::appendArgument(const char *&argument, std::string_view specification, std::string &destination) {
+    auto type = static_cast<ArgumentType>(*argument++);
+    if (type == STRING_ARGUMENT) {
+        uint32_t length;
+        memcpy(&length, argument, sizeof(length));
+        argument += sizeof(length);
+        destination.append(argument, length);
+        argument += length;
+        return;
+    }
+
+    uint64_t bits;
+    memcpy(&bits, argument, sizeof(bits));
+    argument += sizeof(bits);
+    char buffer[64];
+    int length = 0;
+    switch (type) {
+        case INT_ARGUMENT: {
+            int64_t value;
+            memcpy(&value, &bits, sizeof(value));
+            length = snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+            break;
+        }
+        case UINT_ARGUMENT:
+            length = snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(bits));
+            break;
+        case DOUBLE_ARGUMENT: {
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            // "{:.N}": N decimals, same as std::to_string otherwise
+            int precision = 6;
+            if (specification.size() > 2 && specification[0] == ':' && specification[1] == '.') {
+                precision = std::atoi(std::string(specification.substr(2)).c_str());
+            }
+            length = snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+            break;
+        }
+        case BOOL_ARGUMENT:
+            destination.append(bits ? "true" : "false");
+            return;
+        case CHAR_ARGUMENT:
+            destination.push_back(static_cast<char>(bits));
+            return;
+        case POINTER_ARGUMENT:
+            length = snprintf(buffer, sizeof(buffer), "0x%llx", static_cast<unsigned long long>(bits));
+            break;
+        default:
+            return;
+    }
+    destination.append(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+}
+
+void Logger::appendCentered(std::string_view content, std::string &destination) {
+    // One line per 80 characters, each one centered
+    size_t linesNeeded = content.length() / lineLength + 1;
+    for (size_t i = 0; i < linesNeeded; i++) {
+        std::string_view line = content.substr(i * lineLength, lineLength);
+        destination.append((lineLength - line.length()) / 2, ' ').append(line).push_back('\n');
+    }
+}
+
+int64_t Logger::now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
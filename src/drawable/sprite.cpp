@@ -0,0 +1,55 @@
+#include "drawable/sprite.h"
+
+#include <algorithm>
+#include <cstddef>
+
+SpriteInstance SpriteInstance::fromSprite(const Sprite &sprite) {
+    SpriteInstance instance = {};
+    instance.position[0] = sprite.position.x;
+    instance.position[1] = sprite.position.y;
+    instance.size[0] = sprite.size.x;
+    instance.size[1] = sprite.size.y;
+    instance.rotation = sprite.rotation;
+    // Same packing as packUnorm4x8 in GLSL: red in the lowest byte
+    for (uint32_t channel = 0; channel < 4; ++channel) {
+        float value = std::min(std::max(sprite.color[channel], 0.0f), 1.0f);
+        instance.color |= uint32_t(value * 255.0f + 0.5f) << (8u * channel);
+    }
+    instance.textureLayer = sprite.textureLayer;
+    return instance;
+}
+
+VkVertexInputBindingDescription SpriteInstance::getBindingDescription() {
+    // One entry per sprite, the corners of the quad come from the vertex index
+    VkVertexInputBindingDescription bindingDescription = {};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(SpriteInstance);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 5> SpriteInstance::getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions = {};
+    for (uint32_t location = 0; location < attributeDescriptions.size(); ++location) {
+        attributeDescriptions[location].binding = 0;
+        attributeDescriptions[location].location = location;
+    }
+
+    attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(SpriteInstance, position);
+
+    attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(SpriteInstance, size);
+
+    attributeDescriptions[2].format = VK_FORMAT_R32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(SpriteInstance, rotation);
+
+    // Unpacked to a vec4 in [0, 1] by the input assembler
+    attributeDescriptions[3].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attributeDescriptions[3].offset = offsetof(SpriteInstance, color);
+
+    attributeDescriptions[4].format = VK_FORMAT_R32_UINT;
+    attributeDescriptions[4].offset = offsetof(SpriteInstance, textureLayer);
+
+    return attributeDescriptions;
+}
@@ -0,0 +1,221 @@
+#include "renderer/async_compute.h"
+
+void AsyncCompute::initialize(VkDevice vkDevice, QueueManager &queueManager, uint32_t slotCount, FrameArena &arena) {
+    device = vkDevice;
+    frameArena = &arena;
+    computeQueue = *queueManager.getQueue(COMPUTE_QUEUE);
+    computeFamily = queueManager.getFamilyIndex(COMPUTE_QUEUE);
+    graphicsFamily = queueManager.getFamilyIndex(GRAPHICS_QUEUE);
+    isOwnershipTransferred = queueManager.needsOwnershipTransfer(COMPUTE_QUEUE, GRAPHICS_QUEUE);
+
+    if (queueManager.hasAsyncCompute()) {
+        log(std::string("Async compute: ") + (isOwnershipTransferred ? "dedicated compute family" : "second queue of the graphics family"));
+    } else {
+        log("Async compute: not available, compute work shares the graphics queue");
+    }
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.queueFamilyIndex = computeFamily;
+    // Command buffers are re-recorded every frame
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VK_CHECK(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool), "Compute Command Pool Creation");
+
+    std::vector<VkCommandBuffer> commandBuffers(slotCount);
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.commandPool = commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = slotCount;
+    VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers.data()), "Compute Command Buffer Allocation");
+
+    slots.resize(slotCount);
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        slots[i].commandBuffer = commandBuffers[i];
+    }
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo = {};
+    semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeInfo.initialValue = 0;
+    VkSemaphoreCreateInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timelineInfo.pNext = &semaphoreTypeInfo;
+    VK_CHECK(vkCreateSemaphore(device, &timelineInfo, nullptr, &computeTimeline), "Compute Timeline Creation");
+}
+
+void AsyncCompute::addWork(RecordFunction record, uint32_t frameDistance) {
+    works.push_back(std::move(record));
+    graphicsFrameDistance = std::max(graphicsFrameDistance, frameDistance);
+}
+
+void AsyncCompute::addOutput(uint32_t slot, VkBuffer buffer, VkPipelineStageFlags graphicsStages,
+                             VkAccessFlags graphicsAccess, bool isReturned) {
+    size_t outputIndex = 0;
+    while (outputIndex < outputs.size() && outputs[outputIndex].buffer != buffer) {
+        outputIndex++;
+    }
+    if (outputIndex == outputs.size()) {
+        outputs.push_back({buffer, graphicsStages, graphicsAccess, isReturned, COMPUTE_OWNED, 0});
+    }
+    slots[slot].outputs.push_back(outputIndex);
+}
+
+VkBufferMemoryBarrier AsyncCompute::ownershipBarrier(VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+                                                     VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    return barrier;
+}
+
+void AsyncCompute::submit(uint64_t frameNumber, uint32_t slot, VkSemaphore frameTimeline) {
+    if (works.empty() || frameNumber < submittedFrames) {
+        return;
+    }
+    Slot &frameSlot = slots[slot];
+
+    VkCommandBuffer commandBuffer = frameSlot.commandBuffer;
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0), "Compute Command Buffer Reset");
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo), "Compute Command Buffer Begin");
+
+    // Take back the outputs that graphics released, and wait for the last graphics frame reading them
+    std::pmr::vector<VkBufferMemoryBarrier> barriers(frameArena);
+    uint64_t graphicsWaitValue = 0;
+    if (graphicsFrameDistance > 0 && frameNumber >= graphicsFrameDistance) {
+        graphicsWaitValue = frameNumber + 1 - graphicsFrameDistance;
+    }
+    for (size_t outputIndex : frameSlot.outputs) {
+        Output &output = outputs[outputIndex];
+        graphicsWaitValue = std::max(graphicsWaitValue, output.lastGraphicsUse);
+        if (output.ownership == RELEASED_TO_COMPUTE) {
+            if (isOwnershipTransferred) {
+                barriers.push_back(ownershipBarrier(output.buffer, graphicsFamily, computeFamily, 0,
+                                                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
+            }
+            output.ownership = COMPUTE_OWNED;
+        }
+    }
+    if (!barriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+
+    for (const RecordFunction &record : works) {
+        record(commandBuffer, slot);
+    }
+
+    // Hand the results over to graphics
+    barriers.clear();
+    for (size_t outputIndex : frameSlot.outputs) {
+        Output &output = outputs[outputIndex];
+        if (output.ownership == COMPUTE_OWNED) {
+            if (isOwnershipTransferred) {
+                barriers.push_back(ownershipBarrier(output.buffer, computeFamily, graphicsFamily,
+                                                    VK_ACCESS_SHADER_WRITE_BIT, 0));
+            }
+            output.ownership = RELEASED_TO_GRAPHICS;
+        }
+    }
+    if (!barriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer), "Compute Command Buffer End");
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    // Per slot outputs were last read by a frame that's already done (the frame slot is free), so only outputs
+    // shared between frames (and a frame distance larger than the frames in flight) actually make compute wait
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (graphicsWaitValue > 0) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &frameTimeline;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &computeTimeline;
+
+    uint64_t signalValue = frameNumber + 1;
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+    timelineSubmitInfo.pWaitSemaphoreValues = &graphicsWaitValue;
+    timelineSubmitInfo.signalSemaphoreValueCount = 1;
+    timelineSubmitInfo.pSignalSemaphoreValues = &signalValue;
+    submitInfo.pNext = &timelineSubmitInfo;
+
+    VK_CHECK(vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE), "Compute Queue Submission");
+    submittedFrames = frameNumber + 1;
+}
+
+void AsyncCompute::recordAcquire(VkCommandBuffer graphicsCommandBuffer, uint32_t slot) {
+    std::pmr::vector<VkBufferMemoryBarrier> barriers(frameArena);
+    VkPipelineStageFlags dstStages = 0;
+    for (size_t outputIndex : slots[slot].outputs) {
+        Output &output = outputs[outputIndex];
+        if (output.ownership != RELEASED_TO_GRAPHICS) {
+            continue;
+        }
+        if (isOwnershipTransferred) {
+            barriers.push_back(ownershipBarrier(output.buffer, computeFamily, graphicsFamily, 0, output.graphicsAccess));
+            dstStages |= output.graphicsStages;
+        }
+        output.ownership = GRAPHICS_OWNED;
+    }
+    if (!barriers.empty()) {
+        vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages,
+                             0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+}
+
+void AsyncCompute::recordRelease(VkCommandBuffer graphicsCommandBuffer, uint32_t slot, uint64_t frameNumber) {
+    std::pmr::vector<VkBufferMemoryBarrier> barriers(frameArena);
+    VkPipelineStageFlags srcStages = 0;
+    for (size_t outputIndex : slots[slot].outputs) {
+        Output &output = outputs[outputIndex];
+        output.lastGraphicsUse = frameNumber + 1;
+        if (output.ownership != GRAPHICS_OWNED || !output.isReturned) {
+            continue;
+        }
+        if (isOwnershipTransferred) {
+            // Graphics only reads the outputs, there are no writes to make available
+            barriers.push_back(ownershipBarrier(output.buffer, graphicsFamily, computeFamily, 0, 0));
+            srcStages |= output.graphicsStages;
+        }
+        output.ownership = RELEASED_TO_COMPUTE;
+    }
+    if (!barriers.empty()) {
+        vkCmdPipelineBarrier(graphicsCommandBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+}
+
+VkPipelineStageFlags AsyncCompute::getGraphicsWaitStages(uint32_t slot) const {
+    VkPipelineStageFlags stages = sharedWaitStages;
+    for (size_t outputIndex : slots[slot].outputs) {
+        stages |= outputs[outputIndex].graphicsStages;
+    }
+    // Without declared outputs, nothing of the frame may start before its compute work is done
+    return stages != 0 ? stages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+}
+
+void AsyncCompute::cleanup() {
+    vkDestroySemaphore(device, computeTimeline, nullptr);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    slots.clear();
+    outputs.clear();
+    works.clear();
+}
@@ -0,0 +1,128 @@
+#include "renderer/bindless_descriptors.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+void BindlessDescriptors::initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice) {
+    device = vkDevice;
+
+    VkPhysicalDeviceVulkan12Properties properties12 = {};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    textureCapacity = std::min({MAX_TEXTURES, properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                                properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                properties12.maxDescriptorSetUpdateAfterBindSamplers,
+                                properties12.maxPerStageDescriptorUpdateAfterBindSamplers});
+    storageBufferCapacity = std::min({MAX_STORAGE_BUFFERS,
+                                      properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                      properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+    //###################################################
+    // Layout:
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = textureCapacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = storageBufferCapacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+    // Elements that were never written must not be accessed, and unused elements can be written at any time
+    VkDescriptorBindingFlags bindingFlags[2];
+    bindingFlags[0] = bindingFlags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = 2;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout), "Bindless Descriptor Set Layout Creation");
+
+    //###################################################
+    // The one set:
+    VkDescriptorPoolSize poolSizes[2] = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = textureCapacity;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = storageBufferCapacity;
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = 1;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "Bindless Descriptor Pool Creation");
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &setLayout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet), "Bindless Descriptor Set Allocation");
+
+    log("Bindless descriptors: " + std::to_string(textureCapacity) + " textures, " +
+        std::to_string(storageBufferCapacity) + " storage buffers");
+}
+
+BindlessIndex BindlessDescriptors::addTexture(VkImageView imageView, VkSampler sampler) {
+    if (textureCount == textureCapacity) {
+        throw std::runtime_error("Bindless texture array is full");
+    }
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = textureCount;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return textureCount++;
+}
+
+BindlessIndex BindlessDescriptors::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    if (storageBufferCount == storageBufferCapacity) {
+        throw std::runtime_error("Bindless storage buffer array is full");
+    }
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = 1;
+    write.dstArrayElement = storageBufferCount;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return storageBufferCount++;
+}
+
+void BindlessDescriptors::cleanup() {
+    // The set goes with its pool
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    textureCount = 0;
+    storageBufferCount = 0;
+}
@@ -4,15 +4,30 @@
 Camera::Camera(ViewParams viewParams, PerspectiveParams perspectiveParams) {
     this->setupViewMatrix(viewParams);
     this->projType = perspective;
-
-//    this->setu
-    // ToDo: add setupProjectionMatrices
-
+    this->vFov = perspectiveParams.vFov;
+    this->screenSize = perspectiveParams.screensize;
+    this->nearPlane = perspectiveParams.nearPlane;
+    this->farPlane = perspectiveParams.farPlane;
+    this->updateProjectionMatrix();
 }
 
 Camera::Camera(ViewParams viewParams, OrthogonalParams orthogonalParams) {
     this->setupViewMatrix(viewParams);
     this->projType = orthogonal;
+    // The orthogonal projection spans [-aspect ratio, aspect ratio] x [-1, 1] world units
+    this->vFov = 0.0f;
+    this->screenSize = orthogonalParams.screensize;
+    this->nearPlane = orthogonalParams.nearPlane;
+    this->farPlane = orthogonalParams.farPlane;
+    this->updateProjectionMatrix();
+}
+
+void Camera::setScreenSize(glm::vec2 size) {
+    if (size == this->screenSize) {
+        return;
+    }
+    this->screenSize = size;
+    this->updateProjectionMatrix();
 }
 
 void Camera::setupViewMatrix(ViewParams viewParams) {
@@ -0,0 +1,202 @@
+#include "renderer/clustered_lighting.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ClusteredLighting::initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, MemoryBudget &budget,
+                                   QueueManager &queues, PipelineManager &pipelines, BindlessDescriptors &bindless,
+                                   const LightingSettings &lightingSettings, uint32_t slotCount) {
+    device = vkDevice;
+    memoryBudget = &budget;
+    pipelineManager = &pipelines;
+    settings = lightingSettings;
+    settings.maxLightsPerCluster = std::max(settings.maxLightsPerCluster, 1u);
+    capacity = settings.capacity;
+    if (capacity == 0) {
+        return;
+    }
+
+    //###################################################
+    // Buffers:
+    // Only used by the graphics queue
+    slots.resize(slotCount);
+    for (Slot &slot : slots) {
+        slot.lights = GpuBuffer::create(device, budget, VkDeviceSize(capacity) * sizeof(LightData),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+        slot.clusters = GpuBuffer::create(device, budget, getClusterBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          false);
+        slot.lightIndices = GpuBuffer::create(device, budget, getLightIndexBufferSize(),
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false);
+        // Read by the fragment shader through the bindless arrays
+        slot.bindlessBuffers = glm::uvec4(bindless.addStorageBuffer(slot.lights.buffer),
+                                          bindless.addStorageBuffer(slot.clusters.buffer),
+                                          bindless.addStorageBuffer(slot.lightIndices.buffer), 0);
+        slot.constants = {};
+        slot.isBinned = false;
+    }
+    log("Clustered lighting: " + std::to_string(capacity) + " lights, " + std::to_string(CLUSTER_COUNT) +
+        " clusters of up to " + std::to_string(settings.maxLightsPerCluster) + " lights");
+
+    //###################################################
+    // Pipeline:
+    binningShaderPath = getShaderPath();
+    pipelineManager->loadShaders({binningShaderPath});
+    pipelineLayout = pipelineManager->getPipelineLayout({binningShaderPath});
+    descriptorSetLayout = pipelineManager->getDescriptorSetLayout({binningShaderPath}, 0);
+    createDescriptorSets();
+    pipelineManager->getComputePipeline(binningShaderPath, pipelineLayout);
+
+    // The binning is timed on the graphics queue
+    timer.initialize(device, physicalDevice, queues.getFamilyIndex(GRAPHICS_QUEUE), slotCount);
+}
+
+std::string ClusteredLighting::getShaderPath() {
+    return std::string(SOURCE_DIR).append("/shaders/lighting/light_binning.comp");
+}
+
+VkDeviceSize ClusteredLighting::getClusterBufferSize() const {
+    return VkDeviceSize(CLUSTER_COUNT) * sizeof(glm::uvec2);
+}
+
+VkDeviceSize ClusteredLighting::getLightIndexBufferSize() const {
+    // Every cluster owns a fixed range, the binning doesn't need a global allocation
+    return VkDeviceSize(CLUSTER_COUNT) * settings.maxLightsPerCluster * sizeof(uint32_t);
+}
+
+void ClusteredLighting::createDescriptorSets() {
+    // Binding 0: lights, 1: cluster ranges, 2: light indices
+    auto setCount = static_cast<uint32_t>(slots.size());
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = setCount * 3;
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = setCount;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "Lighting Descriptor Pool Creation");
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+    std::vector<VkDescriptorSet> descriptorSets(setCount);
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = setCount;
+    allocateInfo.pSetLayouts = layouts.data();
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, descriptorSets.data()), "Lighting Descriptor Set Allocation");
+
+    for (size_t slotIndex = 0; slotIndex < slots.size(); ++slotIndex) {
+        Slot &slot = slots[slotIndex];
+        slot.descriptorSet = descriptorSets[slotIndex];
+
+        VkBuffer buffers[] = {slot.lights.buffer, slot.clusters.buffer, slot.lightIndices.buffer};
+        VkDescriptorBufferInfo bufferInfos[3] = {};
+        VkWriteDescriptorSet writes[3] = {};
+        for (uint32_t binding = 0; binding < 3; ++binding) {
+            bufferInfos[binding].buffer = buffers[binding];
+            bufferInfos[binding].offset = 0;
+            bufferInfos[binding].range = VK_WHOLE_SIZE;
+
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = slot.descriptorSet;
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = &bufferInfos[binding];
+        }
+        vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+    }
+}
+
+LightingUniforms ClusteredLighting::update(uint32_t slotIndex, const std::vector<Light> &frameLights,
+                                           const DirectionalLight &directionalLight, const Camera &camera,
+                                           VkExtent2D extent) {
+    Slot &slot = slots[slotIndex];
+    // The previous frame of this slot is done, otherwise its uniforms couldn't be written again
+    if (slot.isBinned) {
+        readStatistics(slotIndex);
+    }
+
+    // Binned in view space: the clusters are boxes there, and the shaders need no inverse matrix
+    const glm::mat4 &view = camera.getView();
+    lightCount = static_cast<uint32_t>(std::min<size_t>(frameLights.size(), capacity));
+    auto *lights = static_cast<LightData *>(slot.lights.data);
+    // Shadowed spot lights get the layers after the cascades, in the same order ShadowMaps assigns them
+    uint32_t shadowLayer = settings.shadows.getCascadeCount();
+    uint32_t shadowLayerEnd = shadowLayer + settings.shadows.getSpotLightCapacity();
+    for (uint32_t i = 0; i < lightCount; ++i) {
+        const Light &light = frameLights[i];
+        LightData &data = lights[i];
+        data.positionRange = glm::vec4(glm::vec3(view * glm::vec4(light.position, 1.0f)), light.range);
+        if (light.type == SPOT_LIGHT) {
+            glm::vec3 direction = glm::normalize(glm::mat3(view) * light.direction);
+            data.colorInner = glm::vec4(light.color * light.intensity, std::cos(light.innerConeAngle));
+            data.directionOuter = glm::vec4(direction, std::cos(light.outerConeAngle));
+        } else {
+            // The cone test always passes
+            data.colorInner = glm::vec4(light.color * light.intensity, -1.0f);
+            data.directionOuter = glm::vec4(0.0f, 0.0f, -1.0f, -2.0f);
+        }
+        bool isShadowed = light.type == SPOT_LIGHT && light.castsShadows && shadowLayer < shadowLayerEnd;
+        data.shadow = glm::vec4(isShadowed ? float(shadowLayer++) : -1.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    const glm::mat4 &projection = camera.getProjection();
+    float nearPlane = camera.getNearPlane();
+    float farPlane = camera.getFarPlane();
+    slot.constants.projection = glm::vec4(projection[0][0], projection[1][1], nearPlane, farPlane);
+    slot.constants.clusterCounts = glm::uvec4(CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z, lightCount);
+    slot.constants.maxLightsPerCluster = settings.maxLightsPerCluster;
+
+    // Slice k covers the depths [near * (far / near)^(k / Z), near * (far / near)^((k + 1) / Z)]
+    float sliceScale = float(CLUSTER_COUNT_Z) / std::log(farPlane / nearPlane);
+    LightingUniforms uniforms = {};
+    uniforms.clusterCounts = slot.constants.clusterCounts;
+    uniforms.clusterScale = glm::vec4(float(extent.width) / CLUSTER_COUNT_X, float(extent.height) / CLUSTER_COUNT_Y,
+                                      sliceScale, -sliceScale * std::log(nearPlane));
+    uniforms.ambient = glm::vec4(settings.ambient, 0.0f);
+    uniforms.buffers = slot.bindlessBuffers;
+    uniforms.directionalDirection = glm::vec4(glm::normalize(glm::mat3(view) * directionalLight.direction), 0.0f);
+    uniforms.directionalColor = glm::vec4(directionalLight.color * directionalLight.intensity, 0.0f);
+    return uniforms;
+}
+
+void ClusteredLighting::readStatistics(uint32_t slotIndex) {
+    timer.readTime(slotIndex, binningTime);
+}
+
+void ClusteredLighting::recordBinning(VkCommandBuffer commandBuffer, uint32_t slotIndex) {
+    Slot &slot = slots[slotIndex];
+    slot.isBinned = true;
+
+    timer.recordStart(commandBuffer, slotIndex);
+
+    // One work group per cluster, its invocations share the lights. Clusters without lights still write an empty
+    // range, so the buffers never need to be cleared
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      pipelineManager->getComputePipeline(binningShaderPath, pipelineLayout));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout,
+                            0, 1, &slot.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BinningConstants),
+                       &slot.constants);
+    vkCmdDispatch(commandBuffer, CLUSTER_COUNT, 1, 1);
+
+    timer.recordEnd(commandBuffer, slotIndex);
+    // The render graph makes the lists visible to the fragment shader of the main pass
+}
+
+void ClusteredLighting::cleanup() {
+    if (capacity == 0) {
+        return;
+    }
+    // Pipelines and layouts belong to the pipeline manager
+    timer.cleanup();
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    for (Slot &slot : slots) {
+        slot.lights.destroy(device, *memoryBudget);
+        slot.clusters.destroy(device, *memoryBudget);
+        slot.lightIndices.destroy(device, *memoryBudget);
+    }
+    slots.clear();
+    capacity = 0;
+}
@@ -0,0 +1,104 @@
+#include "renderer/deletion_queue.h"
+
+#include <algorithm>
+
+void DeletionQueue::initialize(VkDevice vkDevice, MemoryBudget &budget) {
+    device = vkDevice;
+    memoryBudget = &budget;
+    // A swapchain recreation retires a few dozen handles at once
+    retiredHandles.reserve(256);
+}
+
+void DeletionQueue::retireBuffer(VkBuffer buffer, uint64_t timelineValue) {
+    retire(BUFFER_HANDLE, (uint64_t) buffer, timelineValue);
+}
+
+void DeletionQueue::retireMemory(VkDeviceMemory memory, uint64_t timelineValue) {
+    retire(MEMORY_HANDLE, (uint64_t) memory, timelineValue);
+}
+
+void DeletionQueue::retireImage(VkImage image, uint64_t timelineValue) {
+    retire(IMAGE_HANDLE, (uint64_t) image, timelineValue);
+}
+
+void DeletionQueue::retireImageView(VkImageView imageView, uint64_t timelineValue) {
+    retire(IMAGE_VIEW_HANDLE, (uint64_t) imageView, timelineValue);
+}
+
+void DeletionQueue::retireFramebuffer(VkFramebuffer framebuffer, uint64_t timelineValue) {
+    retire(FRAMEBUFFER_HANDLE, (uint64_t) framebuffer, timelineValue);
+}
+
+void DeletionQueue::retireRenderPass(VkRenderPass renderPass, uint64_t timelineValue) {
+    retire(RENDER_PASS_HANDLE, (uint64_t) renderPass, timelineValue);
+}
+
+void DeletionQueue::retirePipeline(VkPipeline pipeline, uint64_t timelineValue) {
+    retire(PIPELINE_HANDLE, (uint64_t) pipeline, timelineValue);
+}
+
+void DeletionQueue::retireSemaphore(VkSemaphore semaphore, uint64_t timelineValue) {
+    retire(SEMAPHORE_HANDLE, (uint64_t) semaphore, timelineValue);
+}
+
+void DeletionQueue::retireSwapchain(VkSwapchainKHR swapchain, uint64_t timelineValue) {
+    retire(SWAPCHAIN_HANDLE, (uint64_t) swapchain, timelineValue);
+}
+
+void DeletionQueue::retire(HandleType type, uint64_t handle, uint64_t timelineValue) {
+    if (handle != 0) {
+        retiredHandles.push_back({type, handle, timelineValue});
+    }
+}
+
+void DeletionQueue::collect(uint64_t completedValue) {
+    auto isDone = [completedValue](const RetiredHandle &retired) {
+        return retired.timelineValue <= completedValue;
+    };
+    // Views and framebuffers are retired before what they reference, and destroyed in the same order
+    for (const RetiredHandle &retired : retiredHandles) {
+        if (isDone(retired)) {
+            destroy(retired);
+        }
+    }
+    retiredHandles.erase(std::remove_if(retiredHandles.begin(), retiredHandles.end(), isDone), retiredHandles.end());
+}
+
+void DeletionQueue::flush() {
+    for (const RetiredHandle &retired : retiredHandles) {
+        destroy(retired);
+    }
+    retiredHandles.clear();
+}
+
+void DeletionQueue::destroy(const RetiredHandle &retired) {
+    switch (retired.type) {
+        case BUFFER_HANDLE:
+            vkDestroyBuffer(device, (VkBuffer) retired.handle, nullptr);
+            break;
+        case MEMORY_HANDLE:
+            memoryBudget->free((VkDeviceMemory) retired.handle);
+            break;
+        case IMAGE_HANDLE:
+            vkDestroyImage(device, (VkImage) retired.handle, nullptr);
+            break;
+        case IMAGE_VIEW_HANDLE:
+            vkDestroyImageView(device, (VkImageView) retired.handle, nullptr);
+            break;
+        case FRAMEBUFFER_HANDLE:
+            vkDestroyFramebuffer(device, (VkFramebuffer) retired.handle, nullptr);
+            break;
+        case RENDER_PASS_HANDLE:
+            vkDestroyRenderPass(device, (VkRenderPass) retired.handle, nullptr);
+            break;
+        case PIPELINE_HANDLE:
+            vkDestroyPipeline(device, (VkPipeline) retired.handle, nullptr);
+            break;
+        case SEMAPHORE_HANDLE:
+            vkDestroySemaphore(device, (VkSemaphore) retired.handle, nullptr);
+            break;
+        case SWAPCHAIN_HANDLE:
+            vkDestroySwapchainKHR(device, (VkSwapchainKHR) retired.handle, nullptr);
+            break;
+    }
+}
@@ -0,0 +1,117 @@
+#include "renderer/dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, QueueManager &queues,
+                                   const DynamicResolutionSettings &resolutionSettings, uint32_t slotCount,
+                                   VkFormat swapchainFormat, VkImageUsageFlags swapchainUsage) {
+    settings = resolutionSettings;
+    settings.minScale = std::clamp(settings.minScale, 0.1f, 2.0f);
+    settings.maxScale = std::clamp(settings.maxScale, settings.minScale, 2.0f);
+    scale = settings.maxScale;
+    if (settings.targetFrameTime <= 0.0) {
+        return;
+    }
+
+    // The target has the format of the swapchain, so that the scene pipelines don't depend on the scaling
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, swapchainFormat, &formatProperties);
+    VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures ||
+        (swapchainUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0) {
+        log("Dynamic resolution disabled: the swapchain can't be blitted to");
+        return;
+    }
+
+    //###################################################
+    // Timestamps:
+    timer.initialize(vkDevice, physicalDevice, queues.getFamilyIndex(GRAPHICS_QUEUE), slotCount);
+    if (!timer.isAvailable()) {
+        log("Dynamic resolution disabled: the graphics queue doesn't support timestamps");
+        return;
+    }
+    slots.assign(slotCount, Slot{scale, false});
+
+    LOG_INFO("Dynamic resolution: {} ms budget, scale between {} and {}", settings.targetFrameTime,
+             settings.minScale, settings.maxScale);
+}
+
+VkExtent2D DynamicResolution::getTargetExtent(VkExtent2D swapchainExtent) const {
+    return {std::max(static_cast<uint32_t>(std::lround(float(swapchainExtent.width) * settings.maxScale)), 1u),
+            std::max(static_cast<uint32_t>(std::lround(float(swapchainExtent.height) * settings.maxScale)), 1u)};
+}
+
+VkExtent2D DynamicResolution::update(uint32_t slotIndex, VkExtent2D swapchainExtent) {
+    // The previous frame of this slot is done, its timestamps are available
+    Slot &slot = slots[slotIndex];
+    if (slot.isMeasured) {
+        slot.isMeasured = false;
+        double time;
+        if (timer.readTime(slotIndex, time) && slot.scale == scale) {
+            frameTime = settledFrames == 0 ? time : frameTime + SMOOTHING * (time - frameTime);
+            settledFrames++;
+            adjustScale();
+        }
+    }
+
+    VkExtent2D targetExtent = getTargetExtent(swapchainExtent);
+    renderExtent.width = std::clamp(static_cast<uint32_t>(std::lround(float(swapchainExtent.width) * scale)),
+                                    1u, targetExtent.width);
+    renderExtent.height = std::clamp(static_cast<uint32_t>(std::lround(float(swapchainExtent.height) * scale)),
+                                     1u, targetExtent.height);
+    return renderExtent;
+}
+
+void DynamicResolution::adjustScale() {
+    if (settledFrames < SETTLE_FRAMES) {
+        return;
+    }
+    double ratio = frameTime / settings.targetFrameTime;
+    if (std::abs(ratio - 1.0) <= BUDGET_MARGIN) {
+        return;
+    }
+
+    // Pixels, and so the time, go with the square of the scale. The fixed costs of the frame don't: the scale only
+    // goes half way up, so that it doesn't overshoot and drop again
+    float fittingScale = scale * float(std::sqrt(1.0 / ratio));
+    if (fittingScale > scale) {
+        fittingScale = scale + 0.5f * (fittingScale - scale);
+    }
+    fittingScale = std::round(fittingScale / SCALE_STEP) * SCALE_STEP;
+    fittingScale = std::clamp(fittingScale, settings.minScale, settings.maxScale);
+    if (fittingScale != scale) {
+        scale = fittingScale;
+        settledFrames = 0;
+    }
+}
+
+void DynamicResolution::recordStart(VkCommandBuffer commandBuffer, uint32_t slotIndex) {
+    Slot &slot = slots[slotIndex];
+    slot.scale = scale;
+    slot.isMeasured = true;
+    timer.recordStart(commandBuffer, slotIndex);
+}
+
+void DynamicResolution::recordEnd(VkCommandBuffer commandBuffer, uint32_t slotIndex) {
+    timer.recordEnd(commandBuffer, slotIndex);
+}
+
+void DynamicResolution::recordUpscale(VkCommandBuffer commandBuffer, VkImage target, VkImage swapchainImage,
+                                      VkExtent2D swapchainExtent) const {
+    // Bilinear filtering by the blit, which scales down as well above a scale of 1
+    VkImageBlit region = {};
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.srcOffsets[1] = {static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1};
+    region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.dstOffsets[1] = {static_cast<int32_t>(swapchainExtent.width), static_cast<int32_t>(swapchainExtent.height),
+                            1};
+    vkCmdBlitImage(commandBuffer, target, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+}
+
+void DynamicResolution::cleanup() {
+    timer.cleanup();
+    slots.clear();
+}
@@ -0,0 +1,38 @@
+#include "renderer/gpu_buffer.h"
+
+GpuBuffer GpuBuffer::create(VkDevice device, MemoryBudget &budget, VkDeviceSize size, VkBufferUsageFlags usage,
+                            bool isHostVisible, const std::vector<uint32_t> &queueFamilies) {
+    GpuBuffer buffer;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    if (queueFamilies.size() > 1) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+        bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+    } else {
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer), "Buffer Creation");
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, buffer.buffer, &memoryRequirements);
+    VkMemoryPropertyFlags properties = isHostVisible ?
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT :
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    buffer.memory = budget.allocate(memoryRequirements, properties, BUFFER_MEMORY);
+    VK_CHECK(vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0), "Buffer Binding");
+
+    if (isHostVisible) {
+        VK_CHECK(vkMapMemory(device, buffer.memory, 0, size, 0, &buffer.data), "Buffer Mapping");
+    }
+    return buffer;
+}
+
+void GpuBuffer::destroy(VkDevice device, MemoryBudget &budget) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    budget.free(memory);
+    *this = GpuBuffer();
+}
@@ -0,0 +1,58 @@
+#include "renderer/gpu_timer.h"
+
+#include <vector>
+
+void GpuTimer::initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                          uint32_t slotCount) {
+    device = vkDevice;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+    if (queueFamilyProperties[queueFamily].timestampValidBits == 0) {
+        return;
+    }
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    period = deviceProperties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * slotCount;
+    VK_CHECK(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool), "Timestamp Query Pool Creation");
+}
+
+void GpuTimer::recordStart(VkCommandBuffer commandBuffer, uint32_t slot) {
+    if (queryPool) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 2 * slot, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * slot);
+    }
+}
+
+void GpuTimer::recordEnd(VkCommandBuffer commandBuffer, uint32_t slot) {
+    if (queryPool) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * slot + 1);
+    }
+}
+
+bool GpuTimer::readTime(uint32_t slot, double &milliseconds) const {
+    if (!queryPool) {
+        return false;
+    }
+    uint64_t timestamps[2];
+    if (vkGetQueryPoolResults(device, queryPool, 2 * slot, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return false;
+    }
+    milliseconds = double(timestamps[1] - timestamps[0]) * period * 1e-6;
+    return true;
+}
+
+void GpuTimer::cleanup() {
+    if (queryPool) {
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        queryPool = VK_NULL_HANDLE;
+    }
+}
@@ -3,7 +3,13 @@
 // Global scope type qualifier
 InputManager *InputManager::eventHandlingInstance;
 
+void InputManager::recordEvent(InputEventType type, int code, int action, double x, double y) {
+    events.push_back({type, code, action, x, y, std::chrono::steady_clock::now()});
+}
+
 void InputManager::keyCallback(GLFWwindow *window, int key, int scanCode, int action, int mods) {
+    recordEvent(KEY_EVENT, key, action, 0.0, 0.0);
+
     if (key == GLFW_KEY_E && action == GLFW_PRESS) {
 //        print("Pressed E");
     } else if (key == GLFW_KEY_E && action == GLFW_RELEASE) {
@@ -43,12 +49,14 @@ void InputManager::toggleFullscreen(GLFWwindow *window) {
 
 void InputManager::mousePositionCallback(GLFWwindow *window, double _posX, double _posY) {
 //    std::cout << "Mouse pos: " << posX << " - " << posY << std::endl;
+    recordEvent(MOUSE_POSITION_EVENT, 0, 0, _posX, _posY);
     this->posX = _posX;
     this->posY = _posY;
 
 }
 
 void InputManager::mouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
+    recordEvent(MOUSE_BUTTON_EVENT, button, action, posX, posY);
 
     if (button == GLFW_MOUSE_BUTTON_LEFT) {
         if (action == GLFW_PRESS) {
@@ -79,6 +87,7 @@ void InputManager::mouseButtonCallback(GLFWwindow *window, int button, int actio
 
 void InputManager::mouseScrollCallback(GLFWwindow *window, double _offsetX, double _offsetY) {
 //    std::cout << "Mouse scroll: " << offsetX << " - " << offsetY << std::endl;
+    recordEvent(MOUSE_SCROLL_EVENT, 0, 0, _offsetX, _offsetY);
     this->offsetX = _offsetX;
     this->offsetY = _offsetY;
 
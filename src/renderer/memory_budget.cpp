@@ -0,0 +1,229 @@
+#include "renderer/memory_budget.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include "core/allocation_counter.h"
+#include "core/logger.h"
+
+static const char *const categoryNames[] = {"meshes", "textures", "render targets", "staging", "uniforms", "buffers"};
+
+static double toMebibytes(VkDeviceSize size) {
+    return double(size) / (1024.0 * 1024.0);
+}
+
+void MemoryBudget::initialize(VkPhysicalDevice vkPhysicalDevice, VkDevice vkDevice, bool hasBudgetExtension) {
+    physicalDevice = vkPhysicalDevice;
+    device = vkDevice;
+    isBudgetReported = hasBudgetExtension;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    heaps.resize(memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        heaps[i].size = memoryProperties.memoryHeaps[i].size;
+        heaps[i].isDeviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    const char *limit = std::getenv("ASTERISM_VRAM_LIMIT_MB");
+    if (limit && limit[0] != '\0') {
+        deviceLocalLimit = VkDeviceSize(std::strtoull(limit, nullptr, 10)) * 1024 * 1024;
+    }
+    updateBudgets();
+
+    LOG_INFO("Memory budget: {}{}", isBudgetReported ? "reported by the driver" : "80% of the heap sizes",
+             deviceLocalLimit > 0 ? ", hard limit of " + std::to_string(deviceLocalLimit / (1024 * 1024)) +
+                                    " MiB on device local memory" : std::string());
+}
+
+VkDeviceMemory MemoryBudget::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                      MemoryCategory category, VkMemoryPropertyFlags preferredProperties) {
+    // Preferred types first, the others after them, both in the order of the driver (which lists the fastest first)
+    uint32_t candidates[VK_MAX_MEMORY_TYPES];
+    uint32_t candidateCount = 0;
+    for (bool isPreferredPass : {true, false}) {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+            VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+            bool isPreferred = (flags & preferredProperties) == preferredProperties;
+            if ((requirements.memoryTypeBits & (1u << i)) && (flags & properties) == properties &&
+                isPreferred == isPreferredPass) {
+                candidates[candidateCount++] = i;
+            }
+        }
+    }
+    if (candidateCount == 0) {
+        throw std::runtime_error("Failed to find suitable memory type");
+    }
+
+    // Streaming systems get a chance to make room in the best heap before falling back to the others
+    uint32_t bestHeap = memoryProperties.memoryTypes[candidates[0]].heapIndex;
+    VkDeviceSize available = getAvailableSize(bestHeap);
+    if (available < requirements.size) {
+        relievePressure(bestHeap, requirements.size - available);
+    }
+    std::stable_partition(candidates, candidates + candidateCount, [&](uint32_t type) {
+        return getAvailableSize(memoryProperties.memoryTypes[type].heapIndex) >= requirements.size;
+    });
+
+    for (uint32_t c = 0; c < candidateCount; ++c) {
+        uint32_t type = candidates[c];
+        uint32_t heapIndex = memoryProperties.memoryTypes[type].heapIndex;
+        Heap &heap = heaps[heapIndex];
+        // Going over the budget is up to the driver (it may page to system memory), going over the limit isn't
+        if (heap.isDeviceLocal && deviceLocalLimit > 0 &&
+            getDeviceLocalUsage() + requirements.size > deviceLocalLimit + getReleasingDeviceLocalSize()) {
+            continue;
+        }
+
+        VkMemoryAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.allocationSize = requirements.size;
+        allocateInfo.memoryTypeIndex = type;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkResult result = vkAllocateMemory(device, &allocateInfo, nullptr, &memory);
+        if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+            continue;
+        }
+        VK_CHECK(result, "Memory Allocation");
+
+        allocations[memory] = {requirements.size, type, category};
+        heap.allocated += requirements.size;
+        heap.usage += requirements.size;
+        categoryUsage[category] += requirements.size;
+        if (getAvailableSize(heapIndex) == 0) {
+            LOG_EVERY(LOG_LEVEL_WARNING, 1000, "GPU memory heap {} is over its budget ({:.1} MiB used, {:.1} MiB budget)",
+                      heapIndex, toMebibytes(heap.usage), toMebibytes(heap.budget));
+        }
+        return memory;
+    }
+
+    report();
+    throw std::runtime_error("Out of GPU memory (" + std::to_string(requirements.size / 1024) + " KiB of " +
+                             categoryNames[category] + ")");
+}
+
+void MemoryBudget::free(VkDeviceMemory memory) {
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+    auto found = allocations.find(memory);
+    if (found == allocations.end()) {
+        throw std::runtime_error("Freeing memory that wasn't allocated by the memory budget");
+    }
+    const Allocation &allocation = found->second;
+    Heap &heap = heaps[memoryProperties.memoryTypes[allocation.memoryType].heapIndex];
+    heap.allocated -= allocation.size;
+    heap.usage -= std::min(heap.usage, allocation.size);
+    // Already accounted as freed if it was released under pressure
+    heap.releasing -= std::min(heap.releasing, allocation.size);
+    categoryUsage[allocation.category] -= allocation.size;
+    allocations.erase(found);
+
+    vkFreeMemory(device, memory, nullptr);
+}
+
+void MemoryBudget::update() {
+    updateBudgets();
+    VkDeviceSize deviceLocalUsage = getDeviceLocalUsage() - getReleasingDeviceLocalSize();
+    VkDeviceSize overLimit = deviceLocalLimit > 0 && deviceLocalUsage > deviceLocalLimit ?
+                             deviceLocalUsage - deviceLocalLimit : 0;
+    for (uint32_t i = 0; i < heaps.size(); ++i) {
+        const Heap &heap = heaps[i];
+        VkDeviceSize usage = heap.usage - std::min(heap.usage, heap.releasing);
+        VkDeviceSize overBudget = usage > heap.budget ? usage - heap.budget : 0;
+        VkDeviceSize excess = std::max(overBudget, heap.isDeviceLocal ? overLimit : 0);
+        if (excess > 0) {
+            // What this heap releases counts towards the limit of the others
+            overLimit -= std::min(overLimit, relievePressure(i, excess));
+        }
+    }
+}
+
+VkDeviceSize MemoryBudget::getDeviceLocalUsage() const {
+    VkDeviceSize usage = 0;
+    for (const Heap &heap : heaps) {
+        if (heap.isDeviceLocal) {
+            usage += heap.allocated;
+        }
+    }
+    return usage;
+}
+
+VkDeviceSize MemoryBudget::getReleasingDeviceLocalSize() const {
+    VkDeviceSize size = 0;
+    for (const Heap &heap : heaps) {
+        if (heap.isDeviceLocal) {
+            size += heap.releasing;
+        }
+    }
+    return size;
+}
+
+void MemoryBudget::report() const {
+    for (uint32_t i = 0; i < heaps.size(); ++i) {
+        const Heap &heap = heaps[i];
+        LOG_INFO("GPU memory heap {}{}: {:.1} MiB allocated, {:.1} MiB used of a {:.1} MiB budget ({:.1} MiB heap)",
+                 i, heap.isDeviceLocal ? " (device local)" : "", toMebibytes(heap.allocated), toMebibytes(heap.usage),
+                 toMebibytes(heap.budget), toMebibytes(heap.size));
+    }
+    std::string categories;
+    for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; ++category) {
+        char line[64];
+        snprintf(line, sizeof(line), "%s%s %.1f MiB", category > 0 ? ", " : "", categoryNames[category],
+                 toMebibytes(categoryUsage[category]));
+        categories.append(line);
+    }
+    LOG_INFO("GPU memory by category: {}", categories);
+}
+
+void MemoryBudget::updateBudgets() {
+    if (!isBudgetReported) {
+        // Without the driver's view, what the renderer allocated is all that's known
+        for (Heap &heap : heaps) {
+            heap.budget = heap.size / 10 * 8;
+            heap.usage = heap.allocated;
+        }
+        return;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+    for (uint32_t i = 0; i < heaps.size(); ++i) {
+        heaps[i].budget = budgetProperties.heapBudget[i];
+        heaps[i].usage = budgetProperties.heapUsage[i];
+    }
+}
+
+VkDeviceSize MemoryBudget::getAvailableSize(uint32_t heapIndex) const {
+    const Heap &heap = heaps[heapIndex];
+    VkDeviceSize usage = heap.usage - std::min(heap.usage, heap.releasing);
+    VkDeviceSize available = heap.budget > usage ? heap.budget - usage : 0;
+    if (heap.isDeviceLocal && deviceLocalLimit > 0) {
+        VkDeviceSize deviceLocalUsage = getDeviceLocalUsage() - getReleasingDeviceLocalSize();
+        available = std::min(available, deviceLocalLimit > deviceLocalUsage ? deviceLocalLimit - deviceLocalUsage : 0);
+    }
+    return available;
+}
+
+VkDeviceSize MemoryBudget::relievePressure(uint32_t heapIndex, VkDeviceSize size) {
+    // Exceptional, the callbacks retire and recreate resources
+    AllowAllocationScope allowAllocations;
+    VkDeviceSize released = 0;
+    for (const PressureCallback &callback : pressureCallbacks) {
+        if (released >= size) {
+            break;
+        }
+        released += callback(heapIndex, size - released);
+    }
+    heaps[heapIndex].releasing += released;
+    if (released > 0) {
+        LOG_INFO("GPU memory heap {} under pressure: {:.1} MiB released", heapIndex, toMebibytes(released));
+    }
+    return released;
+}
@@ -0,0 +1,359 @@
+#include "renderer/particle_system.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+void ParticleSystem::initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice,
+                                const DeviceFeatures &deviceFeatures, MemoryBudget &budget, QueueManager &queues,
+                                PipelineManager &pipelines, BindlessDescriptors &bindless,
+                                VkPipelineLayout scenePipelineLayout,
+                                VkRenderPass renderPass, const ParticleSystemSettings &particleSettings,
+                                uint32_t slotCount) {
+    device = vkDevice;
+    pipelineManager = &pipelines;
+    drawPipelineLayout = scenePipelineLayout;
+    settings = particleSettings;
+    memoryBudget = &budget;
+    hasDrawIndirectCount = deviceFeatures.hasDrawIndirectCount;
+
+    // The simulation is dispatched with one invocation per particle
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    uint64_t maxCapacity = uint64_t(deviceProperties.limits.maxComputeWorkGroupCount[0]) * SIMULATION_GROUP_SIZE;
+    capacity = uint32_t(std::min<uint64_t>(settings.capacity, maxCapacity));
+    if (capacity == 0) {
+        return;
+    }
+    // Frames never grow them past this
+    emitters.reserve(MAX_PARTICLE_EMITTERS);
+    emissionRemainders.reserve(MAX_PARTICLE_EMITTERS);
+
+    // The pools are written by the compute queue and read by the graphics queue, possibly of different families.
+    // Concurrent sharing avoids ownership transfers of buffers that are read by both queues at the same time
+    queueFamilies = {queues.getFamilyIndex(GRAPHICS_QUEUE)};
+    if (queues.needsOwnershipTransfer(COMPUTE_QUEUE, GRAPHICS_QUEUE)) {
+        queueFamilies.push_back(queues.getFamilyIndex(COMPUTE_QUEUE));
+    }
+
+    //###################################################
+    // Buffers:
+    for (uint32_t pool = 0; pool < 2; ++pool) {
+        positions[pool] = createBuffer(VkDeviceSize(capacity) * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false);
+        velocities[pool] = createBuffer(VkDeviceSize(capacity) * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false);
+        appearances[pool] = createBuffer(VkDeviceSize(capacity) * sizeof(glm::uvec2), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false);
+        // Drawn through the bindless arrays
+        bindlessPools[pool].positions = bindless.addStorageBuffer(positions[pool].buffer);
+        bindlessPools[pool].velocities = bindless.addStorageBuffer(velocities[pool].buffer);
+        bindlessPools[pool].appearances = bindless.addStorageBuffer(appearances[pool].buffer);
+    }
+    counters = createBuffer(sizeof(CounterData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+
+    slots.resize(slotCount);
+    for (Slot &slot : slots) {
+        slot.parameters = createBuffer(sizeof(ParameterData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, true);
+        // Host visible, so that the amount of live particles can be read back. Only 20 bytes read per draw
+        slot.drawCommand = createBuffer(sizeof(DrawData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                          VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, true);
+        memset(slot.drawCommand.data, 0, sizeof(DrawData));
+        slot.sourcePool = 0;
+        slot.isSimulated = false;
+    }
+    log("Particle system: " + std::to_string(capacity) + " particles, " +
+        std::to_string(2 * capacity * (2 * sizeof(glm::vec4) + sizeof(glm::uvec2)) / (1024 * 1024)) + " MiB");
+
+    //###################################################
+    // Pipelines:
+    std::vector<std::string> computeShaderPaths = getComputeShaderPaths();
+    emitShaderPath = computeShaderPaths[0];
+    prepareShaderPath = computeShaderPaths[1];
+    simulateShaderPath = computeShaderPaths[2];
+    finalizeShaderPath = computeShaderPaths[3];
+
+    std::vector<std::string> drawShaderPaths = getDrawShaderPaths();
+    drawPipelineKey.vertexShaderPath = drawShaderPaths[0];
+    drawPipelineKey.fragmentShaderPath = drawShaderPaths[1];
+
+    // All stages are compiled concurrently
+    pipelineManager->loadShaders(getShaderPaths());
+
+    // The compute passes have their own layout, reflected from their shaders, the draw uses the scene layout
+    pipelineLayout = pipelineManager->getPipelineLayout(computeShaderPaths);
+    descriptorSetLayout = pipelineManager->getDescriptorSetLayout(computeShaderPaths, 1);
+    createDescriptorSets(ShaderManager::instance().getSetLayoutBindings(computeShaderPaths, 1));
+
+    // Quads are generated from the vertex index, and read their particle from the pools
+    drawPipelineKey.vertexLayout = NO_VERTEX_LAYOUT;
+    drawPipelineKey.cullMode = VK_CULL_MODE_NONE;
+    drawPipelineKey.blendMode = ADDITIVE_BLENDING;
+    drawPipelineKey.isDepthTested = true;
+    drawPipelineKey.isDepthWritten = false;
+    drawPipelineKey.pipelineLayout = drawPipelineLayout;
+    drawPipelineKey.renderPass = renderPass;
+
+    for (const std::string &shaderPath : computeShaderPaths) {
+        pipelineManager->getComputePipeline(shaderPath, pipelineLayout);
+    }
+    pipelineManager->getPipeline(drawPipelineKey);
+
+    // The passes are timed on the compute queue
+    timer.initialize(device, physicalDevice, queues.getFamilyIndex(COMPUTE_QUEUE), slotCount);
+}
+
+std::vector<std::string> ParticleSystem::getDrawShaderPaths() {
+    std::string shaderDirectory = std::string(SOURCE_DIR).append("/shaders/particles/");
+    return {shaderDirectory + "particle.vert", shaderDirectory + "particle.frag"};
+}
+
+std::vector<std::string> ParticleSystem::getComputeShaderPaths() {
+    std::string shaderDirectory = std::string(SOURCE_DIR).append("/shaders/particles/");
+    return {shaderDirectory + "particle_emit.comp", shaderDirectory + "particle_prepare.comp",
+            shaderDirectory + "particle_simulate.comp", shaderDirectory + "particle_finalize.comp"};
+}
+
+std::vector<std::string> ParticleSystem::getShaderPaths() const {
+    return {emitShaderPath, prepareShaderPath, simulateShaderPath, finalizeShaderPath,
+            drawPipelineKey.vertexShaderPath, drawPipelineKey.fragmentShaderPath};
+}
+
+void ParticleSystem::createDescriptorSets(const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+    // Binding 0: parameters, 1-3: source pool, 4-6: destination pool, 7: counters, 8: draw command
+    auto setCount = static_cast<uint32_t>(2 * slots.size());
+    std::map<VkDescriptorType, uint32_t> descriptorCounts;
+    for (const VkDescriptorSetLayoutBinding &binding : bindings) {
+        descriptorCounts[binding.descriptorType] += binding.descriptorCount * setCount;
+    }
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto &[type, count] : descriptorCounts) {
+        poolSizes.push_back({type, count});
+    }
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "Particle Descriptor Pool Creation");
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+    std::vector<VkDescriptorSet> descriptorSets(setCount);
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = setCount;
+    allocateInfo.pSetLayouts = layouts.data();
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, descriptorSets.data()), "Particle Descriptor Set Allocation");
+
+    for (size_t slotIndex = 0; slotIndex < slots.size(); ++slotIndex) {
+        Slot &slot = slots[slotIndex];
+        for (uint32_t sourcePool = 0; sourcePool < 2; ++sourcePool) {
+            uint32_t destinationPool = 1 - sourcePool;
+            VkDescriptorSet descriptorSet = descriptorSets[2 * slotIndex + sourcePool];
+            slot.descriptorSets[sourcePool] = descriptorSet;
+
+            VkBuffer buffers[] = {slot.parameters.buffer,
+                                  positions[sourcePool].buffer, velocities[sourcePool].buffer, appearances[sourcePool].buffer,
+                                  positions[destinationPool].buffer, velocities[destinationPool].buffer, appearances[destinationPool].buffer,
+                                  counters.buffer, slot.drawCommand.buffer};
+            std::vector<VkDescriptorBufferInfo> bufferInfos(bindings.size());
+            std::vector<VkWriteDescriptorSet> writes(bindings.size());
+            for (size_t index = 0; index < bindings.size(); ++index) {
+                const VkDescriptorSetLayoutBinding &binding = bindings[index];
+                if (binding.binding >= std::size(buffers) || binding.descriptorCount != 1) {
+                    throw std::runtime_error("Particle shaders declare unexpected binding " + std::to_string(binding.binding) + " in set 1");
+                }
+                bufferInfos[index].buffer = buffers[binding.binding];
+                bufferInfos[index].offset = 0;
+                bufferInfos[index].range = VK_WHOLE_SIZE;
+
+                writes[index].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[index].dstSet = descriptorSet;
+                writes[index].dstBinding = binding.binding;
+                writes[index].descriptorCount = binding.descriptorCount;
+                writes[index].descriptorType = binding.descriptorType;
+                writes[index].pBufferInfo = &bufferInfos[index];
+            }
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+    }
+}
+
+void ParticleSystem::setEmitters(const std::vector<ParticleEmitter> &frameEmitters) {
+    // Fits in the storage reserved for MAX_PARTICLE_EMITTERS, the extra emitters aren't even copied
+    size_t count = std::min<size_t>(frameEmitters.size(), MAX_PARTICLE_EMITTERS);
+    emitters.assign(frameEmitters.begin(), frameEmitters.begin() + count);
+}
+
+void ParticleSystem::setRenderPass(VkRenderPass renderPass) {
+    drawPipelineKey.renderPass = renderPass;
+}
+
+uint32_t ParticleSystem::updateParameters(Slot &slot, uint32_t sourcePool) {
+    // Simulated with the wall clock time between frames, rather than the simulation tick: particles are purely visual
+    // and move smoothly at any frame rate. Long stalls are clamped so that particles don't jump
+    auto now = std::chrono::steady_clock::now();
+    float deltaTime = 0.0f;
+    if (simulatedFrames > 0) {
+        deltaTime = std::min(std::chrono::duration<float>(now - lastSimulation).count(), 0.1f);
+    }
+    lastSimulation = now;
+    elapsedTime += deltaTime;
+
+    auto *parameters = static_cast<ParameterData *>(slot.parameters.data);
+    parameters->gravity = glm::vec4(settings.gravity, settings.drag);
+    parameters->deltaTime = deltaTime;
+    parameters->time = float(elapsedTime);
+    parameters->capacity = capacity;
+    parameters->sourcePool = sourcePool;
+    parameters->seed = uint32_t(simulatedFrames);
+
+    // Emitted particles are numbered emitter after emitter, the emit shader finds its emitter from the first ones
+    emissionRemainders.resize(emitters.size(), 0.0);
+    uint32_t emitCount = 0;
+    for (size_t i = 0; i < emitters.size(); ++i) {
+        const ParticleEmitter &emitter = emitters[i];
+        double emitted = emitter.rate * deltaTime + emissionRemainders[i];
+        auto count = uint32_t(std::min(std::floor(emitted), double(capacity - emitCount)));
+        emissionRemainders[i] = emitted - count;
+
+        EmitterData &data = parameters->emitters[i];
+        data.position = glm::vec4(emitter.position, emitter.radius);
+        data.velocity = glm::vec4(emitter.velocity, emitter.spread);
+        data.color = emitter.color;
+        data.properties = glm::vec4(emitter.lifetime, emitter.lifetimeVariance, emitter.size, 0.0f);
+        data.emission = glm::uvec4(emitCount, count, 0, 0);
+        emitCount += count;
+    }
+    parameters->emitterCount = static_cast<uint32_t>(emitters.size());
+    parameters->emitCount = emitCount;
+    return emitCount;
+}
+
+void ParticleSystem::readStatistics(Slot &slot, uint32_t slotIndex) {
+    aliveCount = static_cast<const DrawData *>(slot.drawCommand.data)->command.instanceCount;
+
+    timer.readTime(slotIndex, simulationTime);
+}
+
+void ParticleSystem::computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages,
+                                    VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ParticleSystem::recordCompute(VkCommandBuffer commandBuffer, uint32_t slotIndex) {
+    Slot &slot = slots[slotIndex];
+    // The previous frame of this slot is done, otherwise its compute work couldn't be recorded again
+    if (slot.isSimulated) {
+        readStatistics(slot, slotIndex);
+    }
+
+    uint32_t sourcePool = simulatedFrames % 2;
+    uint32_t emitCount = updateParameters(slot, sourcePool);
+    slot.sourcePool = sourcePool;
+    slot.isSimulated = true;
+    simulatedFrames++;
+
+    timer.recordStart(commandBuffer, slotIndex);
+
+    if (!isCleared) {
+        // No particles yet
+        vkCmdFillBuffer(commandBuffer, counters.buffer, 0, VK_WHOLE_SIZE, 0);
+        computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        isCleared = true;
+    }
+    // The compaction of the previous frame must be done before its pool is appended to
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout,
+                            1, 1, &slot.descriptorSets[sourcePool], 0, nullptr);
+
+    // 1. Emission, appended after the live particles of the source pool
+    if (emitCount > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineManager->getComputePipeline(emitShaderPath, pipelineLayout));
+        vkCmdDispatch(commandBuffer, (emitCount + EMIT_GROUP_SIZE - 1) / EMIT_GROUP_SIZE, 1, 1);
+        computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    // 2. Counts the emitted particles and sizes the simulation dispatch
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      pipelineManager->getComputePipeline(prepareShaderPath, pipelineLayout));
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // 3. Simulation and compaction into the destination pool, one invocation per live particle
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      pipelineManager->getComputePipeline(simulateShaderPath, pipelineLayout));
+    vkCmdDispatchIndirect(commandBuffer, counters.buffer, offsetof(CounterData, dispatch));
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // 4. Draw arguments of the slot
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      pipelineManager->getComputePipeline(finalizeShaderPath, pipelineLayout));
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    // The amount of live particles is read back once the frame is done
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+    timer.recordEnd(commandBuffer, slotIndex);
+    // The graphics queue waits on the compute timeline, which makes all of the above visible to the draw
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer, uint32_t slotIndex) {
+    const Slot &slot = slots[slotIndex];
+    if (!slot.isSimulated) {
+        return;
+    }
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineManager->getPipeline(drawPipelineKey));
+    // The pool that was compacted into
+    const PoolIndices &pool = bindlessPools[1 - slot.sourcePool];
+    vkCmdPushConstants(commandBuffer, drawPipelineLayout, SCENE_PUSH_CONSTANT_STAGES, 0, sizeof(PoolIndices), &pool);
+    // The amount of particles is only known by the GPU, which also skips the draw when none is alive if it can
+    if (hasDrawIndirectCount) {
+        vkCmdDrawIndirectCount(commandBuffer, slot.drawCommand.buffer, offsetof(DrawData, command),
+                               slot.drawCommand.buffer, offsetof(DrawData, drawCount), 1, sizeof(DrawData));
+    } else {
+        vkCmdDrawIndirect(commandBuffer, slot.drawCommand.buffer, offsetof(DrawData, command), 1, sizeof(DrawData));
+    }
+}
+
+GpuBuffer ParticleSystem::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool isHostVisible) {
+    return GpuBuffer::create(device, *memoryBudget, size, usage, isHostVisible, queueFamilies);
+}
+
+void ParticleSystem::cleanup() {
+    if (capacity == 0) {
+        return;
+    }
+    // Pipelines and layouts belong to the pipeline manager
+    timer.cleanup();
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    for (uint32_t pool = 0; pool < 2; ++pool) {
+        positions[pool].destroy(device, *memoryBudget);
+        velocities[pool].destroy(device, *memoryBudget);
+        appearances[pool].destroy(device, *memoryBudget);
+    }
+    counters.destroy(device, *memoryBudget);
+    for (Slot &slot : slots) {
+        slot.parameters.destroy(device, *memoryBudget);
+        slot.drawCommand.destroy(device, *memoryBudget);
+    }
+    slots.clear();
+    capacity = 0;
+}
@@ -0,0 +1,621 @@
+#include "renderer/pipeline_manager.h"
+#include "drawable/sprite.h"
+
+#include <algorithm>
+#include <set>
+
+#include "core/allocation_counter.h"
+
+bool PipelineKey::operator==(const PipelineKey &other) const {
+    return vertexShaderPath == other.vertexShaderPath &&
+           fragmentShaderPath == other.fragmentShaderPath &&
+           specializationConstants == other.specializationConstants &&
+           vertexLayout == other.vertexLayout &&
+           topology == other.topology &&
+           cullMode == other.cullMode &&
+           blendMode == other.blendMode &&
+           isDepthTested == other.isDepthTested &&
+           isDepthWritten == other.isDepthWritten &&
+           hasDepthBias == other.hasDepthBias &&
+           pipelineLayout == other.pipelineLayout &&
+           renderPass == other.renderPass &&
+           subpass == other.subpass;
+}
+
+void PipelineKey::specialize(uint32_t constantId, uint32_t value) {
+    auto position = std::lower_bound(specializationConstants.begin(), specializationConstants.end(), constantId,
+                                     [](const SpecializationConstant &constant, uint32_t id) { return constant.id < id; });
+    if (position != specializationConstants.end() && position->id == constantId) {
+        position->value = value;
+    } else {
+        specializationConstants.insert(position, {constantId, value});
+    }
+}
+
+size_t PipelineKeyHash::operator()(const PipelineKey &key) const {
+    // boost::hash_combine
+    size_t seed = 0;
+    auto combine = [&seed](size_t value) {
+        seed ^= value + 0x9e3779b9 + (seed << 6u) + (seed >> 2u);
+    };
+    combine(std::hash<std::string>()(key.vertexShaderPath));
+    combine(std::hash<std::string>()(key.fragmentShaderPath));
+    for (const SpecializationConstant &constant : key.specializationConstants) {
+        combine(constant.id);
+        combine(constant.value);
+    }
+    combine(key.vertexLayout);
+    combine(key.topology);
+    combine(key.cullMode);
+    combine(key.blendMode);
+    combine(key.isDepthTested);
+    combine(key.isDepthWritten);
+    combine(key.hasDepthBias);
+    combine(std::hash<VkPipelineLayout>()(key.pipelineLayout));
+    combine(std::hash<VkRenderPass>()(key.renderPass));
+    combine(key.subpass);
+    return seed;
+}
+
+bool DescriptorSetLayoutKey::operator==(const DescriptorSetLayoutKey &other) const {
+    return std::equal(bindings.begin(), bindings.end(), other.bindings.begin(), other.bindings.end(),
+                      [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) {
+                          return a.binding == b.binding && a.descriptorType == b.descriptorType &&
+                                 a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags &&
+                                 a.pImmutableSamplers == b.pImmutableSamplers;
+                      });
+}
+
+size_t DescriptorSetLayoutKeyHash::operator()(const DescriptorSetLayoutKey &key) const {
+    size_t seed = 0;
+    auto combine = [&seed](size_t value) {
+        seed ^= value + 0x9e3779b9 + (seed << 6u) + (seed >> 2u);
+    };
+    for (const VkDescriptorSetLayoutBinding &binding : key.bindings) {
+        combine(binding.binding);
+        combine(binding.descriptorType);
+        combine(binding.descriptorCount);
+        combine(binding.stageFlags);
+    }
+    return seed;
+}
+
+bool PipelineLayoutKey::operator==(const PipelineLayoutKey &other) const {
+    return setLayouts == other.setLayouts &&
+           pushConstantRange.stageFlags == other.pushConstantRange.stageFlags &&
+           pushConstantRange.offset == other.pushConstantRange.offset &&
+           pushConstantRange.size == other.pushConstantRange.size;
+}
+
+size_t PipelineLayoutKeyHash::operator()(const PipelineLayoutKey &key) const {
+    size_t seed = 0;
+    auto combine = [&seed](size_t value) {
+        seed ^= value + 0x9e3779b9 + (seed << 6u) + (seed >> 2u);
+    };
+    for (VkDescriptorSetLayout setLayout : key.setLayouts) {
+        combine(std::hash<VkDescriptorSetLayout>()(setLayout));
+    }
+    combine(key.pushConstantRange.stageFlags);
+    combine(key.pushConstantRange.offset);
+    combine(key.pushConstantRange.size);
+    return seed;
+}
+
+
+void PipelineManager::initialize(VkDevice vkDevice) {
+    device = vkDevice;
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    VK_CHECK(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache), "Pipeline Cache Creation");
+}
+
+VkPipeline PipelineManager::getPipeline(const PipelineKey &key) {
+    auto found = pipelines.find(key);
+    if (found != pipelines.end()) {
+        return found->second;
+    }
+    AllowAllocationScope allowAllocations;
+    VkPipeline pipeline = createPipeline(key);
+    pipelines.emplace(key, pipeline);
+    return pipeline;
+}
+
+VkPipeline PipelineManager::getComputePipeline(const std::string &shaderPath, VkPipelineLayout pipelineLayout) {
+    auto key = std::make_pair(ShaderManager::normalizePath(shaderPath), pipelineLayout);
+    auto found = computePipelines.find(key);
+    if (found != computePipelines.end()) {
+        return found->second;
+    }
+    AllowAllocationScope allowAllocations;
+
+    VkComputePipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = getShaderModule(key.first);
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.layout = pipelineLayout;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline), "Compute Pipeline Creation");
+    computePipelines[key] = pipeline;
+    log("Compute pipeline created (" + key.first + ")");
+    return pipeline;
+}
+
+void PipelineManager::loadShaders(const std::vector<std::string> &shaderPaths) {
+    std::vector<std::string> missingShaders;
+    for (const std::string &shaderPath : shaderPaths) {
+        std::string normalizedPath = ShaderManager::normalizePath(shaderPath);
+        if (shaderModules.find(normalizedPath) == shaderModules.end() &&
+            std::find(missingShaders.begin(), missingShaders.end(), normalizedPath) == missingShaders.end()) {
+            missingShaders.push_back(normalizedPath);
+        }
+    }
+    if (missingShaders.empty()) {
+        return;
+    }
+    std::vector<std::future<VkShaderModule>> modules = ShaderManager::instance().createShaderModules(missingShaders, device);
+    for (size_t i = 0; i < missingShaders.size(); ++i) {
+        shaderModules[missingShaders[i]] = modules[i].get();
+    }
+}
+
+VkDescriptorSetLayout PipelineManager::getDescriptorSetLayout(const std::vector<std::string> &shaderPaths, uint32_t set) {
+    loadShaders(shaderPaths);
+    return getDescriptorSetLayout({ShaderManager::instance().getSetLayoutBindings(shaderPaths, set)});
+}
+
+VkDescriptorSetLayout PipelineManager::getDescriptorSetLayout(const DescriptorSetLayoutKey &key) {
+    auto found = setLayouts.find(key);
+    if (found != setLayouts.end()) {
+        return found->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+    layoutInfo.pBindings = key.bindings.data();
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout), "Descriptor Set Layout Creation");
+    setLayouts.emplace(key, setLayout);
+    return setLayout;
+}
+
+VkPipelineLayout PipelineManager::getPipelineLayout(const std::vector<std::string> &shaderPaths,
+                                                    const std::map<uint32_t, VkDescriptorSetLayout> &fixedSetLayouts,
+                                                    VkShaderStageFlags pushConstantStages) {
+    loadShaders(shaderPaths);
+
+    // Up to the last set used by a shader or provided
+    uint32_t setCount = fixedSetLayouts.empty() ? 0 : fixedSetLayouts.rbegin()->first + 1;
+    for (const std::string &shaderPath : shaderPaths) {
+        for (const ShaderBinding &binding : ShaderManager::instance().getReflection(shaderPath).bindings) {
+            setCount = std::max(setCount, binding.set + 1);
+        }
+    }
+
+    PipelineLayoutKey key;
+    for (uint32_t set = 0; set < setCount; ++set) {
+        auto fixedSetLayout = fixedSetLayouts.find(set);
+        key.setLayouts.push_back(fixedSetLayout != fixedSetLayouts.end() ? fixedSetLayout->second :
+                                 getDescriptorSetLayout(shaderPaths, set));
+    }
+    key.pushConstantRange = ShaderManager::instance().getPushConstantRange(shaderPaths);
+    if (key.pushConstantRange.size > 0) {
+        key.pushConstantRange.stageFlags |= pushConstantStages;
+    }
+
+    auto found = pipelineLayouts.find(key);
+    if (found != pipelineLayouts.end()) {
+        return found->second;
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(key.setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = key.setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = key.pushConstantRange.size > 0 ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &key.pushConstantRange;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout), "Pipeline Layout Creation");
+    pipelineLayouts.emplace(key, pipelineLayout);
+    log("Pipeline layout created (" + std::to_string(pipelineLayouts.size()) + " in total, " +
+        std::to_string(setLayouts.size()) + " set layouts)");
+    return pipelineLayout;
+}
+
+std::vector<VkVertexInputAttributeDescription> PipelineManager::getVertexAttributes(
+        const std::string &vertexShaderPath, const std::vector<VkVertexInputAttributeDescription> &layoutAttributes) {
+    // Numeric type of the data fed to the shader: normalized and float formats are read as floats
+    auto getNumericType = [](VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R32_UINT:
+            case VK_FORMAT_R32G32_UINT:
+            case VK_FORMAT_R32G32B32_UINT:
+            case VK_FORMAT_R32G32B32A32_UINT:
+            case VK_FORMAT_R8G8B8A8_UINT:
+            case VK_FORMAT_R16G16_UINT:
+                return 'u';
+            case VK_FORMAT_R32_SINT:
+            case VK_FORMAT_R32G32_SINT:
+            case VK_FORMAT_R32G32B32_SINT:
+            case VK_FORMAT_R32G32B32A32_SINT:
+            case VK_FORMAT_R8G8B8A8_SINT:
+            case VK_FORMAT_R16G16_SINT:
+                return 'i';
+            default:
+                return 'f';
+        }
+    };
+
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    for (const ShaderInput &input : ShaderManager::instance().getReflection(vertexShaderPath).inputs) {
+        auto attribute = std::find_if(layoutAttributes.begin(), layoutAttributes.end(),
+                                      [&input](const VkVertexInputAttributeDescription &layoutAttribute) {
+                                          return layoutAttribute.location == input.location;
+                                      });
+        std::string location = "location " + std::to_string(input.location) + " of " + vertexShaderPath;
+        if (attribute == layoutAttributes.end()) {
+            throw std::runtime_error("Vertex input not provided by the vertex layout: " + location);
+        }
+        if (getNumericType(attribute->format) != getNumericType(input.format)) {
+            throw std::runtime_error("Vertex input type doesn't match the vertex layout: " + location);
+        }
+        attributes.push_back(*attribute);
+    }
+    return attributes;
+}
+
+VkShaderModule PipelineManager::getShaderModule(const std::string &shaderPath) {
+    std::string normalizedPath = ShaderManager::normalizePath(shaderPath);
+    auto found = shaderModules.find(normalizedPath);
+    if (found != shaderModules.end()) {
+        return found->second;
+    }
+    VkShaderModule shaderModule = ShaderManager::instance().createShaderModule(normalizedPath, device);
+    shaderModules[normalizedPath] = shaderModule;
+    return shaderModule;
+}
+
+std::vector<VkPipeline> PipelineManager::reloadShader(const std::string &shaderPath, const std::vector<uint32_t> &spirv) {
+    std::string normalizedPath = ShaderManager::normalizePath(shaderPath);
+    auto found = shaderModules.find(normalizedPath);
+    if (found == shaderModules.end()) {
+        // Not used by any pipeline
+        return {};
+    }
+    // Modules are only needed while creating pipelines, so the old one can go right away
+    vkDestroyShaderModule(device, found->second, nullptr);
+    found->second = ShaderManager::createShaderModule(spirv, device);
+
+    // The variants using it are recreated lazily, the next time they're requested
+    std::vector<VkPipeline> released = releasePipelines([&normalizedPath](const PipelineKey &key) {
+        return ShaderManager::normalizePath(key.vertexShaderPath) == normalizedPath ||
+               ShaderManager::normalizePath(key.fragmentShaderPath) == normalizedPath;
+    });
+    for (auto iterator = computePipelines.begin(); iterator != computePipelines.end();) {
+        if (iterator->first.first == normalizedPath) {
+            released.push_back(iterator->second);
+            iterator = computePipelines.erase(iterator);
+        } else {
+            ++iterator;
+        }
+    }
+    return released;
+}
+
+std::vector<VkPipeline> PipelineManager::releaseRenderPass(VkRenderPass renderPass) {
+    return releasePipelines([renderPass](const PipelineKey &key) { return key.renderPass == renderPass; });
+}
+
+std::vector<VkPipeline> PipelineManager::releasePipelines(const std::function<bool(const PipelineKey &)> &predicate) {
+    std::vector<VkPipeline> released;
+    for (auto iterator = pipelines.begin(); iterator != pipelines.end();) {
+        if (predicate(iterator->first)) {
+            released.push_back(iterator->second);
+            iterator = pipelines.erase(iterator);
+        } else {
+            ++iterator;
+        }
+    }
+    // A released pipeline can't be the base of new derivatives anymore
+    std::set<VkPipeline> releasedSet(released.begin(), released.end());
+    for (auto iterator = basePipelines.begin(); iterator != basePipelines.end();) {
+        if (releasedSet.count(iterator->second)) {
+            iterator = basePipelines.erase(iterator);
+        } else {
+            ++iterator;
+        }
+    }
+    return released;
+}
+
+void PipelineManager::cleanup() {
+    for (auto &pipeline : pipelines) {
+        vkDestroyPipeline(device, pipeline.second, nullptr);
+    }
+    pipelines.clear();
+    basePipelines.clear();
+    for (auto &pipeline : computePipelines) {
+        vkDestroyPipeline(device, pipeline.second, nullptr);
+    }
+    computePipelines.clear();
+    for (auto &shaderModule : shaderModules) {
+        vkDestroyShaderModule(device, shaderModule.second, nullptr);
+    }
+    shaderModules.clear();
+    for (auto &pipelineLayout : pipelineLayouts) {
+        vkDestroyPipelineLayout(device, pipelineLayout.second, nullptr);
+    }
+    pipelineLayouts.clear();
+    for (auto &setLayout : setLayouts) {
+        vkDestroyDescriptorSetLayout(device, setLayout.second, nullptr);
+    }
+    setLayouts.clear();
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    pipelineCache = VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineManager::createPipeline(const PipelineKey &key) {
+    //###################################################
+    // Shader stages:
+    bool isDepthOnly = key.fragmentShaderPath.empty();
+    if (isDepthOnly) {
+        loadShaders({key.vertexShaderPath});
+    } else {
+        loadShaders({key.vertexShaderPath, key.fragmentShaderPath});
+    }
+
+    // Specialization constants: all of them are 32 bit, laid out one after the other
+    std::vector<VkSpecializationMapEntry> specializationMapEntries;
+    std::vector<uint32_t> specializationData;
+    for (const SpecializationConstant &constant : key.specializationConstants) {
+        VkSpecializationMapEntry entry = {};
+        entry.constantID = constant.id;
+        entry.offset = static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t));
+        entry.size = sizeof(uint32_t);
+        specializationMapEntries.push_back(entry);
+        specializationData.push_back(constant.value);
+    }
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationMapEntries.size());
+    specializationInfo.pMapEntries = specializationMapEntries.data();
+    specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+    specializationInfo.pData = specializationData.data();
+    const VkSpecializationInfo *pSpecializationInfo = specializationMapEntries.empty() ? nullptr : &specializationInfo;
+
+    VkPipelineShaderStageCreateInfo vertShaderStageCreateInfo = {};
+    vertShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageCreateInfo.module = getShaderModule(key.vertexShaderPath);
+    // Specify the entry point for the shader
+    // (can have for example different entry points for different shader behaviours in the same .spv)
+    vertShaderStageCreateInfo.pName = "main";
+    // Constants that don't appear in a stage are simply ignored by it
+    vertShaderStageCreateInfo.pSpecializationInfo = pSpecializationInfo;
+
+    VkPipelineShaderStageCreateInfo fragShaderStageCreateInfo = {};
+    fragShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageCreateInfo.module = isDepthOnly ? VK_NULL_HANDLE : getShaderModule(key.fragmentShaderPath);
+    fragShaderStageCreateInfo.pName = "main";
+    fragShaderStageCreateInfo.pSpecializationInfo = pSpecializationInfo;
+
+    VkPipelineShaderStageCreateInfo shaderStageCreateInfos[] = {vertShaderStageCreateInfo,
+                                                                fragShaderStageCreateInfo};
+
+    // Above here: Shaders are programmable functions
+    // Below here: Apply the correct parameters to the fixed function stages:
+
+    //###################################################
+    // Vertex shader input:
+    // The buffers are described by the vertex structs (offsets, packed formats), the shader's inputs select the
+    // attributes it reads
+    VkVertexInputBindingDescription bindingDescription = {};
+    std::vector<VkVertexInputAttributeDescription> layoutAttributes;
+    if (key.vertexLayout == VERTEX_LAYOUT) {
+        bindingDescription = Vertex::getBindingDescription();
+        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        layoutAttributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+    } else if (key.vertexLayout == SPRITE_INSTANCE_LAYOUT) {
+        bindingDescription = SpriteInstance::getBindingDescription();
+        auto attributeDescriptions = SpriteInstance::getAttributeDescriptions();
+        layoutAttributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+    }
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions =
+            getVertexAttributes(key.vertexShaderPath, layoutAttributes);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    if (key.vertexLayout != NO_VERTEX_LAYOUT) {
+        // Bindings indicate the spacing between data and whether the data is per-vertex or per-instance (instancing)
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    }
+    // Attribute descriptions: type of the attributes passed to the vertex shader
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+
+    //###################################################
+    // Input assembly:
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
+    inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    // Set what kind of geometry do the vertices represent
+    inputAssemblyStateCreateInfo.topology = key.topology;
+    // It's possible to break up lines and triangles having the '_STRIP' topology if this is set to true
+    inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    //###################################################
+    // Viewport and scissors:
+    // Viewport describes the region of the framebuffer that the output will be rendered to (usually the entire screen)
+    // Scissor rectangles define in which regions pixels will actually be stored
+    // (any pixel outside of the scissor rectangles will be discarded by the rasterizer)
+    // Both are dynamic state (set while recording), so that pipelines survive a window resize
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
+    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateCreateInfo.viewportCount = 1;
+    viewportStateCreateInfo.pViewports = nullptr;
+    viewportStateCreateInfo.scissorCount = 1;
+    viewportStateCreateInfo.pScissors = nullptr;
+
+    //###################################################
+    // Rasterizer:
+    // Takes the geometry and turns it into fragments. Also does depth testing, face culling and scissor testing.
+    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {};
+    rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    // If depthClampEnable is true, then fragments that are beyond the near and far planes are clamped to them
+    // as opposed as being discarded (useful for shadow maps)
+    rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;
+    // If rasterizerDiscardEnable is set to true, then geometry never passes through the rasterizer stage
+    // (basically disables any output to the framebuffer
+    rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+    // Polygon modes available: (using any mode other than fill requires enabling a GPU feature)
+    // VK_POLYGON_MODE_FILL : draw the whole triangle given vertices
+    // VK_POLYGON_MODE_LINE : draw only the edges of the triangles
+    // VK_POLYGON_MODE_POINT : draw only the vertices of the triangles
+    rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    // Line thickness: any value above 1.0 requires the 'widelines' GPU feature
+    rasterizationStateCreateInfo.lineWidth = 1.0f;
+    // Cull mode: can cull back-facing triangles, front-facing, both, or none
+    rasterizationStateCreateInfo.cullMode = key.cullMode;
+    // Front face: choose if front-face is going to be generated clockwise or counterclockwise
+    rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    // Depth bias: can alter the depth values by adding a constant value or biasing them based on a fragment's slope
+    // (Sometime used for shadow mapping)
+    rasterizationStateCreateInfo.depthBiasEnable = key.hasDepthBias ? VK_TRUE : VK_FALSE;
+    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f; // Optional
+    rasterizationStateCreateInfo.depthBiasClamp = 0.0f; // Optional
+    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f; // Optional
+
+    //###################################################
+    // Multisampling: (Enabling it requires a GPU feature)
+    VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
+    multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleStateCreateInfo.sampleShadingEnable = VK_FALSE;
+    multisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampleStateCreateInfo.minSampleShading = 1.0f; // Optional
+    multisampleStateCreateInfo.pSampleMask = nullptr; // Optional
+    multisampleStateCreateInfo.alphaToCoverageEnable = VK_FALSE; // Optional
+    multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE; // Optional
+
+    //###################################################
+    // Depth and stencil testing:
+    VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo = {};
+    depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilStateCreateInfo.depthTestEnable = key.isDepthTested ? VK_TRUE : VK_FALSE;
+    depthStencilStateCreateInfo.depthWriteEnable = key.isDepthWritten ? VK_TRUE : VK_FALSE;
+    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
+
+    //###################################################
+    // Color blending: (the fragment shader returns a color, how should this color replace what currently is in the frame buffer?)
+    VkPipelineColorBlendAttachmentState colorBlendAttachmentState = {};
+    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+                                               VK_COLOR_COMPONENT_G_BIT |
+                                               VK_COLOR_COMPONENT_B_BIT |
+                                               VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachmentState.blendEnable = VK_FALSE;
+    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
+    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD; // Optional
+    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
+    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
+    if (key.blendMode == ALPHA_BLENDING) {
+        colorBlendAttachmentState.blendEnable = VK_TRUE;
+        colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    } else if (key.blendMode == ADDITIVE_BLENDING) {
+        colorBlendAttachmentState.blendEnable = VK_TRUE;
+        colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    }
+
+    // The operations performed follow this pseudo-code: (for more see page 115/297 of the tutorial)
+    // if (blendEnable) {
+    //     finalColor.rgb = (srcColorBlendFactor * newColor.rgb)
+    //                        <colorBlendOp> (dstColorBlendFactor * oldColor.rgb);
+    //     finalColor.a = (srcAlphaBlendFactor * newColor.a)
+    //     <alphaBlendOp> (dstAlphaBlendFactor * oldColor.a);
+    //     } else {
+    //     finalColor = newColor;
+    //     }
+    // finalColor = finalColor & colorWriteMask;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {};
+    colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
+    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_COPY; // Optional
+    colorBlendStateCreateInfo.attachmentCount = isDepthOnly ? 0 : 1;
+    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
+    colorBlendStateCreateInfo.blendConstants[0] = 0.0f; // Optional
+    colorBlendStateCreateInfo.blendConstants[1] = 0.0f; // Optional
+    colorBlendStateCreateInfo.blendConstants[2] = 0.0f; // Optional
+    colorBlendStateCreateInfo.blendConstants[3] = 0.0f; // Optional
+
+    //###################################################
+    // Dynamic state:
+    // Some of the pipeline parameters can be updated without re-creating the whole pipeline.
+    // For doing so, the following structure needs to be filled, otherwise a nullptr can be passed to the pipeline
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                      VK_DYNAMIC_STATE_SCISSOR,
+                                      VK_DYNAMIC_STATE_DEPTH_BIAS};
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = key.hasDepthBias ? 3 : 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    //###################################################
+    // Pipeline:
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    // Depth-only pipelines have no fragment shader: the rasterizer writes the depth
+    pipelineCreateInfo.stageCount = isDepthOnly ? 1 : 2;
+    pipelineCreateInfo.pStages = shaderStageCreateInfos;
+    // Fixed function stages:
+    pipelineCreateInfo.pVertexInputState = &vertexInputInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
+    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
+    pipelineCreateInfo.pDynamicState = &dynamicState;
+    // pipelineLayout handle:
+    pipelineCreateInfo.layout = key.pipelineLayout;
+    // render pass and index of the graphics subpass where the graphics pipeline will be used
+    pipelineCreateInfo.renderPass = key.renderPass;
+    pipelineCreateInfo.subpass = key.subpass;
+    // Can create a new pipeline derived from an existing one with these two parameters
+    // These values are only used if the VK_PIPELINE_CREATE_DERIVATIVE_BIT flag is also specified
+    // Variants of the same shaders derive from the first one that was created, which drivers can use to create them faster
+    auto shaderPair = std::make_pair(ShaderManager::normalizePath(key.vertexShaderPath), ShaderManager::normalizePath(key.fragmentShaderPath));
+    auto basePipeline = basePipelines.find(shaderPair);
+    if (basePipeline != basePipelines.end()) {
+        pipelineCreateInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+        pipelineCreateInfo.basePipelineHandle = basePipeline->second;
+    } else {
+        pipelineCreateInfo.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+        pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    }
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline), "Graphics Pipeline Creation");
+
+    if (basePipeline == basePipelines.end()) {
+        basePipelines[shaderPair] = pipeline;
+    }
+    log("Pipeline variant created (" + std::to_string(pipelines.size() + 1) + " in total)");
+    return pipeline;
+}
@@ -7,6 +7,7 @@ QueueManager::QueueManager(const std::vector<QueueType> &flags) {
 
     numOfQueues = queueFlags.size();
     families.resize(numOfQueues);
+    queueIndices.resize(numOfQueues);
     vkQueues.resize(numOfQueues);
 }
 
@@ -18,48 +19,118 @@ void QueueManager::retrieveAvailableQueueIndices(VkPhysicalDevice physicalDevice
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
+    std::vector<VkBool32> presentSupport(queueFamilyCount, VK_FALSE);
+    for (uint32_t j = 0; j < queueFamilyCount; ++j) {
+        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, j, surface, &presentSupport[j]);
+    }
+
+    // Graphics: prefer a family that can also present, so that swapchain images never change family
+    uint32_t graphicsFamily = invalidQueueIndex;
+    for (uint32_t j = 0; j < queueFamilyCount; ++j) {
+        if (queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if (graphicsFamily == invalidQueueIndex || (presentSupport[j] && !presentSupport[graphicsFamily])) {
+                graphicsFamily = j;
+            }
+        }
+    }
+
+    // Compute: prefer a dedicated (async compute) family, whose queues run alongside the graphics ones. Otherwise any
+    // family other than the graphics one, and the graphics family as a last resort
+    uint32_t computeFamily = invalidQueueIndex;
+    int bestComputeScore = -1;
+    for (uint32_t j = 0; j < queueFamilyCount; ++j) {
+        if (!(queueFamilies[j].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            continue;
+        }
+        int score = !(queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) ? 2 : (j != graphicsFamily ? 1 : 0);
+        if (score > bestComputeScore) {
+            bestComputeScore = score;
+            computeFamily = j;
+        }
+    }
+
+    // Present: the graphics family if possible
+    uint32_t presentFamily = invalidQueueIndex;
+    if (graphicsFamily != invalidQueueIndex && presentSupport[graphicsFamily]) {
+        presentFamily = graphicsFamily;
+    } else {
+        for (uint32_t j = 0; j < queueFamilyCount; ++j) {
+            if (presentSupport[j]) {
+                presentFamily = j;
+                break;
+            }
+        }
+    }
+
     // Find all required queues:
     std::vector<uint32_t> indicesFound(numOfQueues, invalidQueueIndex);
-    for (unsigned long long i = 0; i < numOfQueues; i++) {
+    for (size_t i = 0; i < numOfQueues; i++) {
         if (queueFlags[i] == GRAPHICS_QUEUE) {
-            for (unsigned long long j = 0; j < queueFamilyCount; ++j) {
-                if (queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                    indicesFound[i] = j;
-                }
-            }
+            indicesFound[i] = graphicsFamily;
         } else if (queueFlags[i] == COMPUTE_QUEUE) {
-            for (unsigned long long j = 0; j < queueFamilyCount; ++j) {
-                if (queueFamilies[j].queueFlags & VK_QUEUE_COMPUTE_BIT) {
-                    indicesFound[i] = j;
-                }
-            }
+            indicesFound[i] = computeFamily;
         } else if (queueFlags[i] == PRESENT_QUEUE) {
-            VkBool32 presentSupport = false;
-            for (unsigned long long j = 0; j < queueFamilyCount; ++j) {
-                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, j, surface, &presentSupport);
-                if (presentSupport) {
-                    indicesFound[i] = j;
-                    break;
-                }
-            }
+            indicesFound[i] = presentFamily;
         }
     }
 
-    for (unsigned long long i = 0; i < numOfQueues; ++i) {
+    for (size_t i = 0; i < numOfQueues; ++i) {
         if (indicesFound[i] == invalidQueueIndex) {
             throw std::runtime_error("GPU doesn't support some necessary queues!");
         }
     }
     families = indicesFound;
+
+    // Assign queues within the families: graphics first, then compute gets the next free queue of its family (when
+    // it shares the graphics family, a second queue still lets the two overlap). Present reuses the graphics queue
+    familyQueueCounts.assign(queueFamilyCount, 0);
+    const QueueType assignmentOrder[] = {GRAPHICS_QUEUE, COMPUTE_QUEUE, PRESENT_QUEUE};
+    for (QueueType type : assignmentOrder) {
+        for (size_t i = 0; i < numOfQueues; ++i) {
+            if (queueFlags[i] != type) {
+                continue;
+            }
+            uint32_t family = families[i];
+            if (type == PRESENT_QUEUE && familyQueueCounts[family] > 0) {
+                queueIndices[i] = 0;
+            } else if (familyQueueCounts[family] < queueFamilies[family].queueCount) {
+                queueIndices[i] = familyQueueCounts[family]++;
+            } else {
+                // Out of queues: share the last one
+                queueIndices[i] = familyQueueCounts[family] - 1;
+            }
+        }
+    }
+
+    // All queues get the same priority, the array just needs to be as long as the largest family request
+    uint32_t maxQueueCount = 0;
+    for (uint32_t count : familyQueueCounts) {
+        maxQueueCount = std::max(maxQueueCount, count);
+    }
+    queuePriorities.assign(maxQueueCount, 1.0f);
+}
+
+std::vector<VkDeviceQueueCreateInfo> QueueManager::getQueueCreateInfos() const {
+    std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos;
+    for (uint32_t family = 0; family < familyQueueCounts.size(); ++family) {
+        if (familyQueueCounts[family] == 0) {
+            continue;
+        }
+        VkDeviceQueueCreateInfo deviceQueueCreateInfo = {};
+        deviceQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        deviceQueueCreateInfo.queueFamilyIndex = family;
+        deviceQueueCreateInfo.queueCount = familyQueueCounts[family];
+        deviceQueueCreateInfo.pQueuePriorities = queuePriorities.data();
+        deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
+    }
+    return deviceQueueCreateInfos;
 }
 
 
 // Setters:
 void QueueManager::setQueues(VkDevice device) {
-    for (unsigned long long i = 0; i < numOfQueues; ++i) {
-        VkQueue queue = VK_NULL_HANDLE;
-        vkGetDeviceQueue(device, families[i], 0, &queue);
-        vkQueues[i] = queue;
+    for (size_t i = 0; i < numOfQueues; ++i) {
+        vkGetDeviceQueue(device, families[i], queueIndices[i], &vkQueues[i]);
     }
     printQueueInfo();
 }
@@ -75,9 +146,19 @@ VkQueue *QueueManager::getQueue(QueueType flag) {
     return &vkQueues[i];
 }
 
+bool QueueManager::hasAsyncCompute() {
+    uint32_t graphics = getFlagIndex(GRAPHICS_QUEUE);
+    uint32_t compute = getFlagIndex(COMPUTE_QUEUE);
+    return families[graphics] != families[compute] || queueIndices[graphics] != queueIndices[compute];
+}
+
+bool QueueManager::needsOwnershipTransfer(QueueType source, QueueType destination) {
+    return getFamilyIndex(source) != getFamilyIndex(destination);
+}
+
 
 uint32_t QueueManager::getFlagIndex(QueueType flag) {
-    for (unsigned long long i = 0; i < queueFlags.size(); ++i) {
+    for (size_t i = 0; i < queueFlags.size(); ++i) {
         if (queueFlags[i] == flag) {
             return i;
         }
@@ -97,10 +178,10 @@ void QueueManager::printQueueInfo() {
         } else if (queueFlags[i] == PRESENT_QUEUE) {
             queuesString.append("Present:");
         }
-        queuesString.append(" - " + std::to_string(families[i]));
+        queuesString.append(" - " + std::to_string(families[i]) + " (queue " + std::to_string(queueIndices[i]) + ")");
         if(i != numOfQueues -1){
             queuesString.append("     ");
         }
     }
     log(queuesString);
-}
\ No newline at end of file
+}
@@ -0,0 +1,836 @@
+#include "renderer/render_graph.h"
+
+#include <algorithm>
+
+#include "core/allocation_counter.h"
+
+//###################################################
+// Pass declaration:
+
+RenderGraphPass &RenderGraphPass::writeColor(RenderResource texture) {
+    attachments.push_back({texture, false, false, {}});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::writeColor(RenderResource texture, VkClearColorValue clearColor) {
+    VkClearValue clearValue = {};
+    clearValue.color = clearColor;
+    attachments.push_back({texture, false, true, clearValue});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::writeDepth(RenderResource texture) {
+    attachments.push_back({texture, true, false, {}});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::writeDepth(RenderResource texture, float clearDepth) {
+    VkClearValue clearValue = {};
+    clearValue.depthStencil = {clearDepth, 0};
+    attachments.push_back({texture, true, true, clearValue});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::read(RenderResource resource, ResourceAccess access) {
+    accesses.push_back({resource, access, false});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::write(RenderResource resource, ResourceAccess access) {
+    accesses.push_back({resource, access, true});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::setSideEffects() {
+    hasSideEffects = true;
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::setRecord(std::function<void(VkCommandBuffer)> recordFunction) {
+    record = std::move(recordFunction);
+    return *this;
+}
+
+
+//###################################################
+// Graph declaration:
+
+void RenderGraph::initialize(VkDevice vkDevice, MemoryBudget &budget) {
+    device = vkDevice;
+    memoryBudget = &budget;
+}
+
+RenderResource RenderGraph::addResource(const Resource &resource) {
+    resources.push_back(resource);
+    return static_cast<RenderResource>(resources.size() - 1);
+}
+
+RenderResource RenderGraph::createTexture(const std::string &name, VkFormat format, VkExtent2D extent) {
+    Resource resource = {};
+    resource.name = name;
+    resource.isImage = true;
+    resource.format = format;
+    resource.extent = extent;
+    resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    return addResource(resource);
+}
+
+RenderResource RenderGraph::createBuffer(const std::string &name, VkDeviceSize size) {
+    Resource resource = {};
+    resource.name = name;
+    resource.isImage = false;
+    resource.size = size;
+    return addResource(resource);
+}
+
+RenderResource RenderGraph::importImage(const std::string &name, VkFormat format, VkExtent2D extent,
+                                        VkImageLayout initialLayout, VkImageLayout finalLayout) {
+    Resource resource = {};
+    resource.name = name;
+    resource.isImage = true;
+    resource.isImported = true;
+    resource.isOutput = true;
+    resource.format = format;
+    resource.extent = extent;
+    resource.initialLayout = initialLayout;
+    resource.finalLayout = finalLayout;
+    return addResource(resource);
+}
+
+RenderResource RenderGraph::importBuffer(const std::string &name, VkDeviceSize size) {
+    Resource resource = {};
+    resource.name = name;
+    resource.isImage = false;
+    resource.isImported = true;
+    resource.isOutput = true;
+    resource.size = size;
+    return addResource(resource);
+}
+
+void RenderGraph::setImportedImage(RenderResource resource, VkImage image, VkImageView imageView) {
+    resources[resource].image = image;
+    resources[resource].imageView = imageView;
+}
+
+void RenderGraph::setImportedBuffer(RenderResource resource, VkBuffer buffer) {
+    resources[resource].buffer = buffer;
+}
+
+void RenderGraph::setRenderArea(const std::string &passName, VkExtent2D extent) {
+    for (CompiledPass &compiledPass : compiledPasses) {
+        if (passes[compiledPass.pass]->name == passName) {
+            compiledPass.renderArea = {std::min(extent.width, compiledPass.extent.width),
+                                       std::min(extent.height, compiledPass.extent.height)};
+        }
+    }
+}
+
+void RenderGraph::markOutput(RenderResource resource) {
+    resources[resource].isOutput = true;
+}
+
+RenderGraphPass &RenderGraph::addPass(const std::string &name, PassType type) {
+    passes.push_back(std::unique_ptr<RenderGraphPass>(new RenderGraphPass(name, type)));
+    return *passes.back();
+}
+
+
+//###################################################
+// Compilation:
+
+void RenderGraph::compile() {
+    if (isCompiled) {
+        throw std::runtime_error("Render graph compiled twice, reset() it first");
+    }
+
+    std::vector<uint32_t> keptPasses = cullPasses();
+    compiledPasses.resize(keptPasses.size());
+    for (size_t i = 0; i < keptPasses.size(); ++i) {
+        compiledPasses[i] = {};
+        compiledPasses[i].pass = keptPasses[i];
+    }
+
+    // Lifetimes and usages:
+    for (Resource &resource : resources) {
+        resource.firstPass = -1;
+        resource.lastPass = -1;
+    }
+    auto use = [this](RenderResource handle, int32_t compiledIndex) {
+        Resource &resource = resources[handle];
+        if (resource.firstPass < 0) {
+            resource.firstPass = compiledIndex;
+        }
+        resource.lastPass = compiledIndex;
+    };
+    for (int32_t i = 0; i < static_cast<int32_t>(compiledPasses.size()); ++i) {
+        const RenderGraphPass &pass = *passes[compiledPasses[i].pass];
+        for (const RenderGraphPass::Attachment &attachment : pass.attachments) {
+            use(attachment.texture, i);
+            resources[attachment.texture].imageUsage |= attachment.isDepth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+                                                                           : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        }
+        for (const RenderGraphPass::Access &access : pass.accesses) {
+            use(access.resource, i);
+            Resource &resource = resources[access.resource];
+            switch (access.access) {
+                case SAMPLED_ACCESS:
+                    resource.imageUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+                    resource.bufferUsage |= VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
+                    break;
+                case STORAGE_ACCESS:
+                    resource.imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+                    resource.bufferUsage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+                    break;
+                case UNIFORM_ACCESS:
+                    resource.bufferUsage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+                    break;
+                case VERTEX_ACCESS:
+                    resource.bufferUsage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+                    break;
+                case INDEX_ACCESS:
+                    resource.bufferUsage |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+                    break;
+                case INDIRECT_ACCESS:
+                    resource.bufferUsage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+                    break;
+                case TRANSFER_ACCESS:
+                    resource.imageUsage |= access.isWrite ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                    resource.bufferUsage |= access.isWrite ? VK_BUFFER_USAGE_TRANSFER_DST_BIT : VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+                    break;
+                case DEPTH_READ_ACCESS:
+                    resource.imageUsage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                    break;
+            }
+        }
+    }
+
+    createTransientResources();
+    computeBarriers();
+    isCompiled = true;
+
+    log("Render graph compiled: " + std::to_string(compiledPasses.size()) + "/" + std::to_string(passes.size()) +
+        " passes, " + std::to_string(memoryBlocks.size()) + " transient memory blocks");
+}
+
+std::vector<uint32_t> RenderGraph::cullPasses() const {
+    // Walk the passes backwards, starting from the outputs: a pass is kept if it writes something that is needed
+    // later, and then everything it reads becomes needed
+    std::vector<bool> isNeeded(resources.size(), false);
+    for (size_t i = 0; i < resources.size(); ++i) {
+        isNeeded[i] = resources[i].isOutput;
+    }
+
+    std::vector<uint32_t> keptPasses;
+    for (auto i = static_cast<int32_t>(passes.size()) - 1; i >= 0; --i) {
+        const RenderGraphPass &pass = *passes[i];
+        bool isKept = pass.hasSideEffects;
+        for (const RenderGraphPass::Attachment &attachment : pass.attachments) {
+            isKept = isKept || isNeeded[attachment.texture];
+        }
+        for (const RenderGraphPass::Access &access : pass.accesses) {
+            isKept = isKept || (access.isWrite && isNeeded[access.resource]);
+        }
+        if (!isKept) {
+            log("Render graph: culled pass '" + pass.name + "'");
+            continue;
+        }
+        keptPasses.push_back(static_cast<uint32_t>(i));
+
+        // Cleared attachments are fully overwritten, earlier writes to them don't matter for the passes after this
+        // one (imported images stay needed, they're outputs)
+        for (const RenderGraphPass::Attachment &attachment : pass.attachments) {
+            if (attachment.isCleared && !resources[attachment.texture].isImported) {
+                isNeeded[attachment.texture] = false;
+            }
+        }
+        for (const RenderGraphPass::Attachment &attachment : pass.attachments) {
+            if (!attachment.isCleared) {
+                isNeeded[attachment.texture] = true;
+            }
+        }
+        for (const RenderGraphPass::Access &access : pass.accesses) {
+            if (!access.isWrite || access.access == STORAGE_ACCESS) {
+                isNeeded[access.resource] = true;
+            }
+        }
+    }
+    std::reverse(keptPasses.begin(), keptPasses.end());
+    return keptPasses;
+}
+
+void RenderGraph::createTransientResources() {
+    // Create the resources first, their memory requirements decide how they can be aliased
+    std::vector<RenderResource> transients;
+    std::vector<VkMemoryRequirements> requirements(resources.size());
+    for (RenderResource handle = 0; handle < resources.size(); ++handle) {
+        Resource &resource = resources[handle];
+        if (resource.isImported || resource.firstPass < 0) {
+            continue;
+        }
+        if (resource.isImage) {
+            VkImageCreateInfo imageCreateInfo = {};
+            imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = resource.format;
+            imageCreateInfo.extent = {resource.extent.width, resource.extent.height, 1};
+            imageCreateInfo.mipLevels = 1;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.usage = resource.imageUsage;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VK_CHECK(vkCreateImage(device, &imageCreateInfo, nullptr, &resource.image), "Transient Image Creation");
+            vkGetImageMemoryRequirements(device, resource.image, &requirements[handle]);
+        } else {
+            VkBufferCreateInfo bufferCreateInfo = {};
+            bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferCreateInfo.size = resource.size;
+            bufferCreateInfo.usage = resource.bufferUsage;
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &resource.buffer), "Transient Buffer Creation");
+            vkGetBufferMemoryRequirements(device, resource.buffer, &requirements[handle]);
+        }
+        transients.push_back(handle);
+    }
+
+    // Biggest resources first, each one goes into the first block whose resources are all dead or not yet alive
+    // during its lifetime. Resources are bound at the start of the block, so alignments are always satisfied
+    std::sort(transients.begin(), transients.end(), [&requirements](RenderResource a, RenderResource b) {
+        return requirements[a].size > requirements[b].size;
+    });
+    VkDeviceSize unaliasedSize = 0;
+    for (RenderResource handle : transients) {
+        Resource &resource = resources[handle];
+        const VkMemoryRequirements &requirement = requirements[handle];
+        unaliasedSize += requirement.size;
+
+        auto overlaps = [&](RenderResource other) {
+            return resources[other].firstPass <= resource.lastPass && resource.firstPass <= resources[other].lastPass;
+        };
+        bool isPlaced = false;
+        for (uint32_t i = 0; i < memoryBlocks.size() && !isPlaced; ++i) {
+            MemoryBlock &block = memoryBlocks[i];
+            if ((block.memoryTypeBits & requirement.memoryTypeBits) == 0 ||
+                std::any_of(block.resources.begin(), block.resources.end(), overlaps)) {
+                continue;
+            }
+            block.size = std::max(block.size, requirement.size);
+            block.memoryTypeBits &= requirement.memoryTypeBits;
+            block.resources.push_back(handle);
+            resource.memoryBlock = i;
+            isPlaced = true;
+        }
+        if (!isPlaced) {
+            MemoryBlock block = {};
+            block.size = requirement.size;
+            block.memoryTypeBits = requirement.memoryTypeBits;
+            block.resources.push_back(handle);
+            resource.memoryBlock = static_cast<uint32_t>(memoryBlocks.size());
+            memoryBlocks.push_back(block);
+        }
+    }
+
+    // Allocate the blocks and bind the resources
+    VkDeviceSize aliasedSize = 0;
+    for (MemoryBlock &block : memoryBlocks) {
+        VkMemoryRequirements requirements = {};
+        requirements.size = block.size;
+        requirements.memoryTypeBits = block.memoryTypeBits;
+        block.memory = memoryBudget->allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, RENDER_TARGET_MEMORY);
+        aliasedSize += block.size;
+
+        for (RenderResource handle : block.resources) {
+            Resource &resource = resources[handle];
+            if (resource.isImage) {
+                vkBindImageMemory(device, resource.image, block.memory, 0);
+
+                VkImageViewCreateInfo imageViewCreateInfo = {};
+                imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                imageViewCreateInfo.image = resource.image;
+                imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                imageViewCreateInfo.format = resource.format;
+                imageViewCreateInfo.subresourceRange.aspectMask = getAspectMask(resource.format);
+                imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+                imageViewCreateInfo.subresourceRange.levelCount = 1;
+                imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+                imageViewCreateInfo.subresourceRange.layerCount = 1;
+                VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &resource.imageView), "Transient Image View Creation");
+            } else {
+                vkBindBufferMemory(device, resource.buffer, block.memory, 0);
+            }
+        }
+    }
+    if (!transients.empty()) {
+        log("Render graph: " + std::to_string(transients.size()) + " transient resources use " +
+            std::to_string(aliasedSize / 1024) + " KiB instead of " + std::to_string(unaliasedSize / 1024) + " KiB");
+    }
+}
+
+void RenderGraph::computeBarriers() {
+    // Every use of a resource in a pass, attachments included
+    struct Use {
+        RenderResource resource;
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageLayout layout;
+        bool isWrite;
+    };
+    auto getUses = [this](const RenderGraphPass &pass) {
+        std::vector<Use> uses;
+        for (const RenderGraphPass::Attachment &attachment : pass.attachments) {
+            Use use = {attachment.texture, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, true};
+            if (attachment.isDepth) {
+                use.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                use.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                use.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            } else {
+                use.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                use.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                if (!attachment.isCleared) {
+                    use.access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+                }
+                use.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            }
+            uses.push_back(use);
+        }
+        for (const RenderGraphPass::Access &access : pass.accesses) {
+            Use use = {access.resource, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, access.isWrite};
+            getAccessInfo(access.access, access.isWrite, pass.type, resources[access.resource].isImage,
+                          use.stages, use.access, use.layout);
+            uses.push_back(use);
+        }
+        return uses;
+    };
+    const VkAccessFlags writeAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+                                          VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    // What each memory block is used for during the frame
+    for (const CompiledPass &compiledPass : compiledPasses) {
+        for (const Use &use : getUses(*passes[compiledPass.pass])) {
+            const Resource &resource = resources[use.resource];
+            if (!resource.isImported) {
+                memoryBlocks[resource.memoryBlock].stages |= use.stages;
+                memoryBlocks[resource.memoryBlock].writeAccess |= use.access & writeAccessMask;
+            }
+        }
+    }
+
+    std::vector<ResourceState> states(resources.size());
+    for (size_t i = 0; i < resources.size(); ++i) {
+        states[i] = {};
+        states[i].layout = resources[i].initialLayout;
+    }
+
+    for (int32_t i = 0; i < static_cast<int32_t>(compiledPasses.size()); ++i) {
+        CompiledPass &compiledPass = compiledPasses[i];
+        const RenderGraphPass &pass = *passes[compiledPass.pass];
+
+        // Load and store operations depend on the states before the barriers below
+        if (pass.type == GRAPHICS_PASS) {
+            compiledPass.renderPass = createRenderPass(pass, i, states);
+            const Resource &firstAttachment = resources[pass.attachments.empty() ? 0 : pass.attachments[0].texture];
+            compiledPass.extent = pass.attachments.empty() ? VkExtent2D{0, 0} : firstAttachment.extent;
+            compiledPass.renderArea = compiledPass.extent;
+            for (const RenderGraphPass::Attachment &attachment : pass.attachments) {
+                compiledPass.clearValues.push_back(attachment.clearValue);
+            }
+            // Read-only depth is attached too
+            for (const RenderGraphPass::Access &access : pass.accesses) {
+                if (access.access == DEPTH_READ_ACCESS) {
+                    compiledPass.clearValues.push_back({});
+                }
+            }
+        }
+
+        for (const Use &use : getUses(pass)) {
+            const Resource &resource = resources[use.resource];
+            ResourceState &state = states[use.resource];
+
+            VkPipelineStageFlags srcStages = 0;
+            VkAccessFlags srcAccess = 0;
+            VkAccessFlags dstAccess = 0;
+            VkImageLayout oldLayout = state.layout;
+            bool isNeeded = false;
+
+            if (!state.isUsed && !resource.isImported) {
+                // First use of a transient resource: its memory might still be in use by another resource of the same
+                // block (or by this resource in the previous frame). The content is discarded
+                srcStages = memoryBlocks[resource.memoryBlock].stages;
+                srcAccess = memoryBlocks[resource.memoryBlock].writeAccess;
+                dstAccess = use.access;
+                oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                isNeeded = true;
+            } else if (!state.isUsed) {
+                // First use of an imported resource: anything outside of the graph is synchronized by the caller (e.g.
+                // the swapchain acquire semaphore, waited on at the stage of the first use)
+                isNeeded = resource.isImage && use.layout != state.layout;
+                srcStages = use.stages;
+                dstAccess = use.access;
+            } else {
+                bool isLayoutChanged = resource.isImage && use.layout != state.layout;
+                bool isReadAfterWrite = state.writeAccess != 0 &&
+                                        ((use.stages & ~state.readStages) != 0 || (use.access & ~state.readAccess) != 0);
+                if (use.isWrite || isLayoutChanged) {
+                    // Write after write, write after read, or a layout transition (which is a write)
+                    srcStages = state.writeStages | state.readStages;
+                    srcAccess = state.writeAccess;
+                    dstAccess = use.access;
+                    isNeeded = true;
+                } else if (isReadAfterWrite) {
+                    // Reads already made visible to these stages by a previous barrier need nothing
+                    srcStages = state.writeStages;
+                    srcAccess = state.writeAccess;
+                    dstAccess = use.access;
+                    isNeeded = true;
+                }
+            }
+
+            if (isNeeded) {
+                compiledPass.srcStages |= srcStages;
+                compiledPass.dstStages |= use.stages;
+                if (resource.isImage) {
+                    VkImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.srcAccessMask = srcAccess;
+                    barrier.dstAccessMask = dstAccess;
+                    barrier.oldLayout = oldLayout;
+                    barrier.newLayout = use.layout;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.image = resource.image;
+                    barrier.subresourceRange = {getAspectMask(resource.format), 0, 1, 0, 1};
+                    compiledPass.imageBarriers.push_back(barrier);
+                    compiledPass.imageBarrierResources.push_back(use.resource);
+                } else if (srcAccess != 0) {
+                    // Write after read only needs the execution dependency
+                    compiledPass.memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    compiledPass.memoryBarrier.srcAccessMask |= srcAccess;
+                    compiledPass.memoryBarrier.dstAccessMask |= dstAccess;
+                    compiledPass.hasMemoryBarrier = true;
+                }
+            }
+
+            if (use.isWrite) {
+                state.writeStages = use.stages;
+                state.writeAccess = use.access & writeAccessMask;
+                state.readStages = 0;
+                state.readAccess = 0;
+            } else {
+                // Now visible to these stages (or nothing was written at all)
+                state.readStages |= use.stages;
+                state.readAccess |= use.access;
+            }
+            state.layout = use.layout;
+            state.isUsed = true;
+        }
+    }
+
+    // Hand the imported images over in the layout expected after the frame (e.g. for presentation)
+    for (RenderResource handle = 0; handle < resources.size(); ++handle) {
+        const Resource &resource = resources[handle];
+        const ResourceState &state = states[handle];
+        if (!resource.isImported || !resource.isImage || !state.isUsed ||
+            resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == state.layout) {
+            continue;
+        }
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = resource.finalLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = {getAspectMask(resource.format), 0, 1, 0, 1};
+        finalBarriers.push_back(barrier);
+        finalBarrierResources.push_back(handle);
+        finalSrcStages |= state.writeStages | state.readStages;
+    }
+}
+
+VkRenderPass RenderGraph::createRenderPass(const RenderGraphPass &pass, int32_t compiledIndex,
+                                           const std::vector<ResourceState> &states) {
+    std::vector<VkAttachmentDescription> attachmentDescriptions;
+    std::vector<VkAttachmentReference> colorReferences;
+    VkAttachmentReference depthReference = {};
+    bool hasDepth = false;
+
+    auto addAttachment = [&](RenderResource handle, bool isCleared, VkImageLayout layout) {
+        const Resource &resource = resources[handle];
+        const ResourceState &state = states[handle];
+        bool hasContent = state.isUsed || (resource.isImported && resource.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+        bool isReadLater = resource.isOutput || resource.lastPass > compiledIndex;
+
+        VkAttachmentDescription attachmentDescription = {};
+        attachmentDescription.format = resource.format;
+        attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+        // Don't load what's overwritten or undefined, and don't store what's never read again: on tiled GPUs this
+        // saves the whole round trip to memory
+        attachmentDescription.loadOp = isCleared ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+                                       hasContent ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachmentDescription.storeOp = isReadLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        // Layout transitions are done by the barriers of the graph, not by the render pass
+        attachmentDescription.initialLayout = layout;
+        attachmentDescription.finalLayout = layout;
+        attachmentDescriptions.push_back(attachmentDescription);
+        return VkAttachmentReference{static_cast<uint32_t>(attachmentDescriptions.size() - 1), layout};
+    };
+
+    for (const RenderGraphPass::Attachment &attachment : pass.attachments) {
+        if (attachment.isDepth) {
+            depthReference = addAttachment(attachment.texture, attachment.isCleared, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+            hasDepth = true;
+        } else {
+            colorReferences.push_back(addAttachment(attachment.texture, attachment.isCleared, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+        }
+    }
+    for (const RenderGraphPass::Access &access : pass.accesses) {
+        if (access.access == DEPTH_READ_ACCESS) {
+            depthReference = addAttachment(access.resource, false, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+            hasDepth = true;
+        }
+    }
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+    subpass.pColorAttachments = colorReferences.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+    VkRenderPassCreateInfo renderPassCreateInfo = {};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+    renderPassCreateInfo.pAttachments = attachmentDescriptions.data();
+    renderPassCreateInfo.subpassCount = 1;
+    renderPassCreateInfo.pSubpasses = &subpass;
+    // No subpass dependencies: the barriers recorded before the render pass already cover everything
+    renderPassCreateInfo.dependencyCount = 0;
+
+    VkRenderPass renderPass;
+    VK_CHECK(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass), "Render Pass Creation");
+    return renderPass;
+}
+
+
+//###################################################
+// Execution:
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+    for (CompiledPass &compiledPass : compiledPasses) {
+        const RenderGraphPass &pass = *passes[compiledPass.pass];
+
+        // A single batch of barriers per pass
+        if (compiledPass.dstStages != 0) {
+            for (size_t i = 0; i < compiledPass.imageBarriers.size(); ++i) {
+                compiledPass.imageBarriers[i].image = resources[compiledPass.imageBarrierResources[i]].image;
+            }
+            vkCmdPipelineBarrier(commandBuffer,
+                                 compiledPass.srcStages ? compiledPass.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 compiledPass.dstStages,
+                                 0,
+                                 compiledPass.hasMemoryBarrier ? 1 : 0, &compiledPass.memoryBarrier,
+                                 0, nullptr,
+                                 static_cast<uint32_t>(compiledPass.imageBarriers.size()), compiledPass.imageBarriers.data());
+        }
+
+        if (pass.type == COMPUTE_PASS) {
+            if (pass.record) {
+                pass.record(commandBuffer);
+            }
+            continue;
+        }
+
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = compiledPass.renderPass;
+        renderPassInfo.framebuffer = getFramebuffer(compiledPass);
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = compiledPass.renderArea;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(compiledPass.clearValues.size());
+        renderPassInfo.pClearValues = compiledPass.clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float) compiledPass.renderArea.width;
+        viewport.height = (float) compiledPass.renderArea.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        VkRect2D scissor = {{0, 0}, compiledPass.renderArea};
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        if (pass.record) {
+            pass.record(commandBuffer);
+        }
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    if (!finalBarriers.empty()) {
+        for (size_t i = 0; i < finalBarriers.size(); ++i) {
+            finalBarriers[i].image = resources[finalBarrierResources[i]].image;
+        }
+        vkCmdPipelineBarrier(commandBuffer,
+                             finalSrcStages ? finalSrcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr,
+                             static_cast<uint32_t>(finalBarriers.size()), finalBarriers.data());
+    }
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(const CompiledPass &compiledPass) {
+    const RenderGraphPass &pass = *passes[compiledPass.pass];
+    framebufferKey.first = compiledPass.renderPass;
+    std::vector<VkImageView> &imageViews = framebufferKey.second;
+    imageViews.clear();
+    for (const RenderGraphPass::Attachment &attachment : pass.attachments) {
+        imageViews.push_back(resources[attachment.texture].imageView);
+    }
+    for (const RenderGraphPass::Access &access : pass.accesses) {
+        if (access.access == DEPTH_READ_ACCESS) {
+            imageViews.push_back(resources[access.resource].imageView);
+        }
+    }
+
+    auto found = framebuffers.find(framebufferKey);
+    if (found != framebuffers.end()) {
+        return found->second;
+    }
+
+    // Created once per set of attachments
+    AllowAllocationScope allowAllocations;
+    VkFramebufferCreateInfo framebufferCreateInfo = {};
+    framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferCreateInfo.renderPass = compiledPass.renderPass;
+    framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(imageViews.size());
+    framebufferCreateInfo.pAttachments = imageViews.data();
+    framebufferCreateInfo.width = compiledPass.extent.width;
+    framebufferCreateInfo.height = compiledPass.extent.height;
+    framebufferCreateInfo.layers = 1;
+
+    VkFramebuffer framebuffer;
+    VK_CHECK(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer), "Frame Buffer Creation");
+    framebuffers[framebufferKey] = framebuffer;
+    return framebuffer;
+}
+
+VkRenderPass RenderGraph::getRenderPass(const std::string &passName) const {
+    for (const CompiledPass &compiledPass : compiledPasses) {
+        if (passes[compiledPass.pass]->name == passName) {
+            return compiledPass.renderPass;
+        }
+    }
+    return VK_NULL_HANDLE;
+}
+
+void RenderGraph::reset(DeletionQueue &deletionQueue, uint64_t timelineValue) {
+    // Framebuffers and views go first, they reference the rest
+    for (auto &framebuffer : framebuffers) {
+        deletionQueue.retireFramebuffer(framebuffer.second, timelineValue);
+    }
+    framebuffers.clear();
+    for (CompiledPass &compiledPass : compiledPasses) {
+        deletionQueue.retireRenderPass(compiledPass.renderPass, timelineValue);
+    }
+    compiledPasses.clear();
+
+    for (Resource &resource : resources) {
+        if (resource.isImported) {
+            continue;
+        }
+        deletionQueue.retireImageView(resource.imageView, timelineValue);
+        deletionQueue.retireImage(resource.image, timelineValue);
+        deletionQueue.retireBuffer(resource.buffer, timelineValue);
+    }
+    for (MemoryBlock &block : memoryBlocks) {
+        deletionQueue.retireMemory(block.memory, timelineValue);
+    }
+    memoryBlocks.clear();
+    finalBarriers.clear();
+    finalBarrierResources.clear();
+    finalSrcStages = 0;
+
+    resources.clear();
+    passes.clear();
+    isCompiled = false;
+}
+
+void RenderGraph::cleanup() {
+    DeletionQueue deletionQueue;
+    deletionQueue.initialize(device, *memoryBudget);
+    reset(deletionQueue, 0);
+    deletionQueue.flush();
+}
+
+
+//###################################################
+// Helpers:
+
+void RenderGraph::getAccessInfo(ResourceAccess access, bool isWrite, PassType passType, bool isImage,
+                                VkPipelineStageFlags &stages, VkAccessFlags &accessFlags, VkImageLayout &layout) {
+    VkPipelineStageFlags shaderStages = passType == COMPUTE_PASS ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                                                 : VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    switch (access) {
+        case SAMPLED_ACCESS:
+            stages = shaderStages;
+            accessFlags = VK_ACCESS_SHADER_READ_BIT;
+            layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            break;
+        case STORAGE_ACCESS:
+            stages = shaderStages;
+            accessFlags = isWrite ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+            layout = VK_IMAGE_LAYOUT_GENERAL;
+            break;
+        case UNIFORM_ACCESS:
+            stages = shaderStages;
+            accessFlags = VK_ACCESS_UNIFORM_READ_BIT;
+            break;
+        case VERTEX_ACCESS:
+            stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            accessFlags = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+            break;
+        case INDEX_ACCESS:
+            stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            accessFlags = VK_ACCESS_INDEX_READ_BIT;
+            break;
+        case INDIRECT_ACCESS:
+            stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+            accessFlags = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+            break;
+        case TRANSFER_ACCESS:
+            stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            accessFlags = isWrite ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_TRANSFER_READ_BIT;
+            layout = isWrite ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            break;
+        case DEPTH_READ_ACCESS:
+            stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            accessFlags = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+            layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            break;
+    }
+    if (!isImage) {
+        layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+}
+
+bool RenderGraph::isDepthFormat(VkFormat format) {
+    return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+           format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+VkImageAspectFlags RenderGraph::getAspectMask(VkFormat format) {
+    if (format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+        format == VK_FORMAT_D32_SFLOAT_S8_UINT) {
+        // Without separate depth/stencil layouts, both aspects are always transitioned together
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    return isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
@@ -1,13 +1,78 @@
 #include "renderer/renderer.h"
+#include "core/allocation_counter.h"
 #include "glm/gtx/string_cast.hpp"
 
 void Renderer::initializeRenderer() {
+    startupTime = std::chrono::steady_clock::now();
+    startupPhaseTime = startupTime;
+    startupPhases.clear();
+    startAssetLoading();
+
+    // The instance only needs the extensions of GLFW: the loader and the drivers come up while the window is created
+    glfwInit();
+    std::exception_ptr instanceError;
+    JobCounter instanceCreation;
+    JobSystem::instance().run([this, &instanceError]() {
+        try {
+            instance = VulkanCore::createInstance(asterismName, isDebug);
+        } catch (...) {
+            instanceError = std::current_exception();
+        }
+    }, &instanceCreation);
     initializeWindow();
+    JobSystem::instance().wait(instanceCreation);
+    if (instanceError) {
+        std::rethrow_exception(instanceError);
+    }
+    endStartupPhase("window and instance");
+
     initializeVulkan();
+
+    double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTime).count();
+    LOG_INFO("Renderer initialized in {:.2} ms", total);
+}
+
+void Renderer::startAssetLoading() {
+    // Shaders don't need a device, all the ones of the scene compile in the background from the very start
+    vertexShaderPath = std::string(SOURCE_DIR).append("/shaders/shader.vert");
+    fragmentShaderPath = std::string(SOURCE_DIR).append("/shaders/shader.frag");
+    ShaderManager::instance().precompile(getSceneShaderPaths());
+    if (particleSettings.capacity > 0) {
+        ShaderManager::instance().precompile(ParticleSystem::getComputeShaderPaths());
+    }
+    if (lightingSettings.capacity > 0) {
+        ShaderManager::instance().precompile({ClusteredLighting::getShaderPath()});
+        if (lightingSettings.shadows.resolution > 0) {
+            ShaderManager::instance().precompile({ShadowMaps::getShaderPath()});
+        }
+    }
+
+    // Checkerboard, its mips are generated on the GPU
+    JobSystem::instance().run([this]() {
+        const uint32_t size = 256;
+        const uint32_t squareSize = 32;
+        std::vector<uint8_t> pixels(size * size * 4);
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                uint8_t value = ((x / squareSize) + (y / squareSize)) % 2 == 0 ? 255 : 96;
+                uint8_t *pixel = &pixels[(y * size + x) * 4];
+                pixel[0] = pixel[1] = pixel[2] = value;
+                pixel[3] = 255;
+            }
+        }
+        meshTextureData = TextureLoader::fromPixels(pixels, size, size, true);
+    }, &assetLoads);
+}
+
+void Renderer::endStartupPhase(const char *name) {
+    auto now = std::chrono::steady_clock::now();
+    double duration = std::chrono::duration<double, std::milli>(now - startupPhaseTime).count();
+    startupPhases.push_back({name, duration});
+    startupPhaseTime = now;
+    LOG_INFO("Startup: {} in {:.2} ms", name, duration);
 }
 
 void Renderer::initializeWindow() {
-    glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // Tell GLFW not to create an OpenGL context.
     // glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Block window resize
 
@@ -57,24 +122,48 @@ VkSurfaceFormatKHR Renderer::chooseSwapSurfaceFormat(const std::vector<VkSurface
     return availableFormats[0];
 }
 
-VkPresentModeKHR Renderer::chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes) {
-    // VK_PRESENT_MODE_IMMEDIATE_KHR transfers images right away (can result in tearing) Also, only one to be always supported
-    // VK_PRESENT_MODE_FIFO_KHR swapchain becomes a queue and the display pops an image when it refreshes (V-Sync)
+VkPresentModeKHR Renderer::chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes) const {
+    // VK_PRESENT_MODE_IMMEDIATE_KHR transfers images right away (can result in tearing)
+    // VK_PRESENT_MODE_FIFO_KHR swapchain becomes a queue and the display pops an image when it refreshes (V-Sync) Also, only one to be always supported
     // VK_PRESENT_MODE_FIFO_RELAXED_KHR if queue is empty, then it transfers the image as soon as it arrives
     // VK_PRESENT_MODE_MAILBOX_KHR queued images are replaced with newer ones when queue is full
-    VkPresentModeKHR bestMode = VK_PRESENT_MODE_MAILBOX_KHR;
-    VkPresentModeKHR secondBestMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
-    VkPresentModeKHR fallbackMode = VK_PRESENT_MODE_FIFO_KHR;
-
-    for (const auto &availablePresentMode :availablePresentModes) {
-        if (availablePresentMode == bestMode) {
-            return availablePresentMode;
-        } else if (availablePresentMode == secondBestMode) {
-            fallbackMode = availablePresentMode;
+    std::vector<VkPresentModeKHR> preferredModes;
+    switch (presentPolicy) {
+        case VSYNC_PRESENT:
+            preferredModes = {VK_PRESENT_MODE_FIFO_KHR};
+            break;
+        case LOW_LATENCY_PRESENT:
+            preferredModes = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+            break;
+        case UNCAPPED_PRESENT:
+            preferredModes = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+            break;
+    }
+
+    for (VkPresentModeKHR preferredMode : preferredModes) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferredMode) != availablePresentModes.end()) {
+            return preferredMode;
         }
     }
-    return fallbackMode;
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
 
+uint32_t Renderer::chooseSwapImageCount(const VkSurfaceCapabilitiesKHR &capabilities, VkPresentModeKHR presentMode) const {
+    uint32_t imageCount;
+    if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+        // Mailbox needs one image on screen, one queued to be replaced and one to render to
+        imageCount = std::max(capabilities.minImageCount, 3u);
+    } else if (presentPolicy == LOW_LATENCY_PRESENT) {
+        // Every additional image is a frame that can queue up in front of the newest one
+        imageCount = capabilities.minImageCount;
+    } else {
+        // pick 1 image more than minimum to not have to wait on driver operations before rendering on next image
+        imageCount = capabilities.minImageCount + 1;
+    }
+    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+        imageCount = capabilities.maxImageCount;
+    }
+    return imageCount;
 }
 
 VkExtent2D Renderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
@@ -94,7 +183,7 @@ VkExtent2D Renderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabiliti
     }
 }
 
-void Renderer::createSwapchain() {
+void Renderer::createSwapchain(VkSwapchainKHR oldSwapchain) {
     // Check that picked device supports a swapchain
     // If it supports queues, then it also probably supports a swapchain, but checking just to be sure
     uint32_t extensionCount;
@@ -131,12 +220,8 @@ void Renderer::createSwapchain() {
     // Choose swap extent (resolution of images in the swapchain)
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    // pick 1 image more than minimum to not have to wait on driver operations before rendering on next image
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-    if (swapChainSupport.capabilities.maxImageCount > 0 &&
-        imageCount > swapChainSupport.capabilities.maxImageCount) {
-        imageCount = swapChainSupport.capabilities.maxImageCount;
-    }
+    // Choose the amount of images (depth of the presentation queue)
+    uint32_t imageCount = chooseSwapImageCount(swapChainSupport.capabilities, presentMode);
 
     VkSwapchainCreateInfoKHR swapchainCreateInfo = {};
     swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -148,6 +233,11 @@ void Renderer::createSwapchain() {
     swapchainCreateInfo.imageArrayLayers = 1; // more than 1 if creating a stereoscopic view application. (e.g. VR)
     // If first want to render and then apply post-processing to the image, then need to use VK_IMAGE_USAGE_TRANSFER_DST_BIT as imageUsage
     swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // Dynamic resolution blits the scene into the swapchain images
+    if (resolutionSettings.targetFrameTime > 0.0 &&
+        (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        swapchainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
     if (queues.getFamilyIndex(GRAPHICS_QUEUE) != queues.getFamilyIndex(PRESENT_QUEUE)) {
         // In VK_SHARING_MODE_CONCURRENT images can be used across multiple queue families without explicit ownership transfer.
         swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
@@ -168,10 +258,12 @@ void Renderer::createSwapchain() {
     swapchainCreateInfo.presentMode = presentMode;
     // 'clipped' specifies if pixels that are obscured by another window need to be ignored
     swapchainCreateInfo.clipped = VK_TRUE;
-    // If a new swapchain is created store a reference to the old one here
-    swapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+    // The old swapchain hands its resources over, and can still present the images it already acquired
+    swapchainCreateInfo.oldSwapchain = oldSwapchain;
     log("Creating swapchain with size [" + std::to_string(extent.width) + "x" + std::to_string(extent.height) + "]");
     VK_CHECK(vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &swapchain), "Swapchain Creation");
+    const char *presentModeNames[] = {"IMMEDIATE", "MAILBOX", "FIFO", "FIFO_RELAXED"};
+    log(std::string("Present mode: ") + (presentMode <= VK_PRESENT_MODE_FIFO_RELAXED_KHR ? presentModeNames[presentMode] : "OTHER"));
     log("Amount of swapchain images: " + std::to_string(imageCount));
 
     // Retrieve swapchain images handles:
@@ -182,6 +274,7 @@ void Renderer::createSwapchain() {
     // Save format and extent of the created swapchain:
     swapchainImageFormat = surfaceFormat.format;
     swapchainExtent = extent;
+    swapchainImageUsage = swapchainCreateInfo.imageUsage;
 
 
 }
@@ -215,342 +308,145 @@ void Renderer::createImageViews() {
 
 }
 
-void Renderer::createRenderPass() {
-
-    //###################################################
-    // Attachment description:
-    VkAttachmentDescription attachmentDescription = {};
-    // Format should match that of the swapchain
-    attachmentDescription.format = swapchainImageFormat;
-    // Increase if multi-sampling is needed
-    attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    // loadOp: what to do before rendering
-    // VK_ATTACHMENT_LOAD_OP_CLEAR clears the values to a constant at the start
-    // VK_ATTACHMENT_LOAD_OP_LOAD preserves the existing contents of the attachment
-    // VK_ATTACHMENT_LOAD_OP_DONT_CARE is self explanatory
-    attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    // storeOp: what to do after rendering
-    // VK_ATTACHMENT_STORE_OP_STORE contents of the attachment are stored in memory to read later (e.g for displaying them on the screen)
-    // VK_ATTACHMENT_STORE_OP_DONT_CARE contents of the attachment will be undefined after rendering
-    attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    // Don't do anything with stencil, so don't care
-    attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    // The layout of the images in memory can change based on the purpose of the images
-    // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL Images used as color attachment
-    // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR Images to be presented in the swap chain
-    // VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: Images to be used as destination for a memory copy operation
-    attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    //###################################################
-    // Subpasses and attachment references:
-    // Every subpass of a render pass references to one or more attachments.
-    VkAttachmentReference attachmentRef = {};
-    // the reference is specified by the index of the attachment into an attachment descriptions array
-    attachmentRef.attachment = 0;
-    attachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass = {};
-    // Specify for what should the subpass be used:
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &attachmentRef;
-
-    //###################################################
-    // Subpass dependencies:
-    // Basically ensures that the render passes can't begin until the image is available
-    VkSubpassDependency subpassDependency = {};
-    // VK_SUBPASS_EXTERNAL refers to the implicit subpass before or after the render pass
-    subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpassDependency.dstSubpass = 0;
-    // Specify the operations that need to wait in the stages that these operations occur
-    subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.srcAccessMask = 0;
-    subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+VkFormat Renderer::findDepthFormat() {
+    // D32_SFLOAT gives the best precision, the others are fallbacks (at least one of them is always supported)
+    const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT};
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return format;
+        }
+    }
+    throw std::runtime_error("No supported depth format");
+}
 
+void Renderer::createRenderGraph() {
+    // The render passes, framebuffers, depth buffer and barriers of the frame all follow from this description
+    // The swapchain image is acquired in an undefined layout and must be presentable at the end of the frame
+    swapchainResource = renderGraph.importImage("swapchain", swapchainImageFormat, swapchainExtent,
+                                                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    // With dynamic resolution, the scene goes to a target sized for the maximum scale. It has the format of the
+    // swapchain, so that the scene pipelines are compatible with both render passes
+    VkExtent2D sceneExtent = swapchainExtent;
+    RenderResource sceneColor = swapchainResource;
+    if (dynamicResolution.isEnabled()) {
+        sceneExtent = dynamicResolution.getTargetExtent(swapchainExtent);
+        sceneColorResource = renderGraph.createTexture("scene color", swapchainImageFormat, sceneExtent);
+        sceneColor = sceneColorResource;
+    }
+    RenderResource depth = renderGraph.createTexture("depth", depthFormat, sceneExtent);
+
+    // The light lists of the frame slot, read by the fragment shader of the main pass
+    if (lighting.isEnabled()) {
+        clusterResource = renderGraph.importBuffer("clusters", lighting.getClusterBufferSize());
+        lightIndexResource = renderGraph.importBuffer("light indices", lighting.getLightIndexBufferSize());
+        renderGraph.addPass("light binning", COMPUTE_PASS)
+                .write(clusterResource, STORAGE_ACCESS)
+                .write(lightIndexResource, STORAGE_ACCESS)
+                .setRecord([this](VkCommandBuffer commandBuffer) {
+                    lighting.recordBinning(commandBuffer, frameNumber % framesInFlight);
+                });
+    }
 
-    //###################################################
-    // Render pass:
-    VkRenderPassCreateInfo renderPassCreateInfo = {};
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &attachmentDescription;
-    renderPassCreateInfo.subpassCount = 1;
-    renderPassCreateInfo.pSubpasses = &subpass;
-    renderPassCreateInfo.dependencyCount = 1;
-    renderPassCreateInfo.pDependencies = &subpassDependency;
+    // Its own render passes and barriers: only the layers that changed are rendered, which the graph can't know
+    if (shadowMaps.isEnabled()) {
+        renderGraph.addPass("shadows", COMPUTE_PASS)
+                .setSideEffects()
+                .setRecord([this](VkCommandBuffer commandBuffer) { shadowMaps.record(commandBuffer); });
+    }
 
-    VK_CHECK(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass), "Render Pass Creation");
+    RenderGraphPass &mainPass = renderGraph.addPass("main", GRAPHICS_PASS)
+            .writeColor(sceneColor, {{0.0f, 0.0f, 0.0f, 1.0f}})
+            .writeDepth(depth, 1.0f)
+            .setRecord([this](VkCommandBuffer commandBuffer) { recordMainPass(commandBuffer); });
+    if (lighting.isEnabled()) {
+        mainPass.read(clusterResource, STORAGE_ACCESS).read(lightIndexResource, STORAGE_ACCESS);
+    }
 
+    // The first use of the swapchain image is then a transfer, which is where the acquire semaphore is waited on
+    if (dynamicResolution.isEnabled()) {
+        renderGraph.addPass("upscale", COMPUTE_PASS)
+                .read(sceneColorResource, TRANSFER_ACCESS)
+                .write(swapchainResource, TRANSFER_ACCESS)
+                .setRecord([this](VkCommandBuffer commandBuffer) {
+                    dynamicResolution.recordUpscale(commandBuffer, renderGraph.getImage(sceneColorResource),
+                                                    renderGraph.getImage(swapchainResource), swapchainExtent);
+                });
+    }
 
+    renderGraph.compile();
+    renderPass = renderGraph.getRenderPass("main");
 }
 
-void Renderer::createDescriptorSetLayout() {
-    VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-    uboLayoutBinding.binding = 0;
-    // Type of the binding:
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    // 'descriptorCount' specifies the amount of uniforms that we want to bind
-    uboLayoutBinding.descriptorCount = 1;
-    // 'stageFlags' specifies in which stage the uniform(s) need to be bound
-    // the flag can be a combination of VkShaderStageFlagBits or it can simply be VK_SHADER_STAGE_ALL_GRAPHICS
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    // 'pImmutableSamplers' is only relevant to image sampling descriptors
-    uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
-
-    // Create the set layout
-    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {};
-    setLayoutCreateInfo.sType =
-            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    setLayoutCreateInfo.bindingCount = 1;
-    setLayoutCreateInfo.pBindings = &uboLayoutBinding;
-
-    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayout), "Descriptor Set Layout Creation");
+std::vector<std::string> Renderer::getSceneShaderPaths() const {
+    std::vector<std::string> sceneShaderPaths = {vertexShaderPath, fragmentShaderPath};
+    for (const std::vector<std::string> &shaderPaths : {SpriteBatch::getShaderPaths(), ParticleSystem::getDrawShaderPaths()}) {
+        sceneShaderPaths.insert(sceneShaderPaths.end(), shaderPaths.begin(), shaderPaths.end());
+    }
+    return sceneShaderPaths;
 }
 
-void Renderer::createGraphicsPipeline() {
-    //###################################################
-    // Shader modules:
-
-    ShaderManager shaderManager;
-    std::string vertexShaderPath = std::string(SOURCE_DIR).append("/shaders/shader.vert");
-    std::string fragmentShaderPath = std::string(SOURCE_DIR).append("/shaders/shader.frag");
-
-    VkShaderModule vertShaderModule = shaderManager.createShaderModule(vertexShaderPath, device);
-    VkShaderModule fragShaderModule = shaderManager.createShaderModule(fragmentShaderPath, device);
-
-    VkPipelineShaderStageCreateInfo vertShaderStageCreateInfo = {};
-    vertShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageCreateInfo.module = vertShaderModule;
-    // Specify the entry point for the shader
-    // (can have for example different entry points for different shader behaviours in the same .spv)
-    vertShaderStageCreateInfo.pName = "main";
-    // (Optional)
-    vertShaderStageCreateInfo.pSpecializationInfo = nullptr;
-
-    VkPipelineShaderStageCreateInfo fragShaderStageCreateInfo = {};
-    fragShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageCreateInfo.module = fragShaderModule;
-    // Specify the entry point for the shader
-    // (can have for example different entry points for different shader behaviours in the same .spv)
-    fragShaderStageCreateInfo.pName = "main";
-    // (Optional)
-    fragShaderStageCreateInfo.pSpecializationInfo = nullptr;
-
-    VkPipelineShaderStageCreateInfo shaderStageCreateInfos[] = {vertShaderStageCreateInfo,
-                                                                fragShaderStageCreateInfo};
-
-    // Above here: Shaders are programmable functions
-    // Below here: Apply the correct parameters to the fixed function stages:
-
-    //###################################################
-    // Vertex shader input:
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    // Bindings indicate the spacing between data and whether the data is per-vertex or per-instance (instancing)
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    // Attribute descriptions: type of the attributes passed to the vertex shader
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-
-    //###################################################
-    // Input assembly:
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
-    inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    // Set what kind of geometry do the vertices represent
-    inputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    // It's possible to break up lines and triangles having the '_STRIP' topology if this is set to true
-    inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-    //###################################################
-    // Viewport and scissors:
-    // Viewport describes the region of the framebuffer that the output will be rendered to (usually the entire screen)
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) swapchainExtent.width;
-    viewport.height = (float) swapchainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    // Scissor rectangles define in which regions pixels will actually be stored
-    // (any pixel outside of the scissor rectangles will be discarded by the rasterizer)
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = swapchainExtent;
-
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports = &viewport;
-    viewportStateCreateInfo.scissorCount = 1;
-    viewportStateCreateInfo.pScissors = &scissor;
-
-    //###################################################
-    // Rasterizer:
-    // Takes the geometry and turns it into fragments. Also does depth testing, face culling and scissor testing.
-    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {};
-    rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    // If depthClampEnable is true, then fragments that are beyond the near and far planes are clamped to them
-    // as opposed as being discarded (useful for shadow maps)
-    rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;
-    // If rasterizerDiscardEnable is set to true, then geometry never passes through the rasterizer stage
-    // (basically disables any output to the framebuffer
-    rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-    // Polygon modes available: (using any mode other than fill requires enabling a GPU feature)
-    // VK_POLYGON_MODE_FILL : draw the whole triangle given vertices
-    // VK_POLYGON_MODE_LINE : draw only the edges of the triangles
-    // VK_POLYGON_MODE_POINT : draw only the vertices of the triangles
-    rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    // Line thickness: any value above 1.0 requires the 'widelines' GPU feature
-    rasterizationStateCreateInfo.lineWidth = 1.0f;
-    // Cull mode: can cull back-facing triangles, front-facing, both, or none
-    rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    // Front face: choose if front-face is going to be generated clockwise or counterclockwise
-    rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    // Depth bias: can alter the depth values by adding a constant value or biasing them based on a fragment's slope
-    // (Sometime used for shadow mapping)
-    rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE;
-    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f; // Optional
-    rasterizationStateCreateInfo.depthBiasClamp = 0.0f; // Optional
-    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f; // Optional
-
-    //###################################################
-    // Multisampling: (Enabling it requires a GPU feature)
-    VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
-    multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleStateCreateInfo.sampleShadingEnable = VK_FALSE;
-    multisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampleStateCreateInfo.minSampleShading = 1.0f; // Optional
-    multisampleStateCreateInfo.pSampleMask = nullptr; // Optional
-    multisampleStateCreateInfo.alphaToCoverageEnable = VK_FALSE; // Optional
-    multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE; // Optional
-
-    //###################################################
-    // Depth and stencil testing:
-    // (not used at the moment, so pass a nullptr)
-
-    //###################################################
-    // Color blending: (the fragment shader returns a color, how should this color replace what currently is in the frame buffer?)
-    VkPipelineColorBlendAttachmentState colorBlendAttachmentState = {};
-    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-                                               VK_COLOR_COMPONENT_G_BIT |
-                                               VK_COLOR_COMPONENT_B_BIT |
-                                               VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachmentState.blendEnable = VK_FALSE;
-    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-
-    // The operations performed follow this pseudo-code: (for more see page 115/297 of the tutorial)
-    // if (blendEnable) {
-    //     finalColor.rgb = (srcColorBlendFactor * newColor.rgb)
-    //                        <colorBlendOp> (dstColorBlendFactor * oldColor.rgb);
-    //     finalColor.a = (srcAlphaBlendFactor * newColor.a)
-    //     <alphaBlendOp> (dstAlphaBlendFactor * oldColor.a);
-    //     } else {
-    //     finalColor = newColor;
-    //     }
-    // finalColor = finalColor & colorWriteMask;
-
-    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {};
-    colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
-    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_COPY; // Optional
-    colorBlendStateCreateInfo.attachmentCount = 1;
-    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
-    colorBlendStateCreateInfo.blendConstants[0] = 0.0f; // Optional
-    colorBlendStateCreateInfo.blendConstants[1] = 0.0f; // Optional
-    colorBlendStateCreateInfo.blendConstants[2] = 0.0f; // Optional
-    colorBlendStateCreateInfo.blendConstants[3] = 0.0f; // Optional
-
-    //###################################################
-    // Dynamic state:
-    // Some of the pipeline parameters can be updated without re-creating the whole pipeline.
-    // For doing so, the following structure needs to be filled, otherwise a nullptr can be passed to the pipeline
-
-    // VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
-    //                                   VK_DYNAMIC_STATE_LINE_WIDTH};
-    // VkPipelineDynamicStateCreateInfo dynamicState = {};
-    // dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    // dynamicState.dynamicStateCount = 2;
-    // dynamicState.pDynamicStates = dynamicStates;
-
+void Renderer::createPipelineLayout() {
     //###################################################
     // Pipeline layout: (pass variables to shaders at draw time (uniforms))
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout; // Inform the pipeline of the descriptors (e.g VBO) required during rendering
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout), "Pipeline Layout Creation");
-
-    //###################################################
-    // Pipeline:
-    // ToDo: get shader create_infos here from shaderManager
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStageCreateInfos;
-    // Fixed function stages:
-    pipelineCreateInfo.pVertexInputState = &vertexInputInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = nullptr; // Optional
-    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = nullptr;
-    // pipelineLayout handle:
-    pipelineCreateInfo.layout = pipelineLayout;
-    // render pass and index of the graphics subpass where the graphics pipeline will be used
-    pipelineCreateInfo.renderPass = renderPass;
-    pipelineCreateInfo.subpass = 0;
-    // Can create a new pipeline derived from an existing one with these two parameters
-    //These values are only used if the VK_PIPELINE_CREATE_DERIVATIVE_BIT flag is also specified
-    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-    pipelineCreateInfo.basePipelineIndex = -1; // Optional
-
-    // vkCreateGraphicsPipelines is actually designed to handle multiple pipelineCreateInfos and
-    // consequently it can create multiple pipelines
-    VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline), "Graphics Pipeline Creation");
-
-    // Shader modules can be destroyed as soon as the pipeline is created
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
-
+    // It doesn't depend on the swapchain, so it's shared by all pipeline variants and survives window resizes.
+    // Both the layout and its set 0 (camera uniforms) are reflected from the shaders of every scene pipeline, compiled
+    // concurrently here. Set 1 (bindless resources) has runtime arrays, its layout comes from BindlessDescriptors
+    std::vector<std::string> sceneShaderPaths = getSceneShaderPaths();
+    descriptorSetLayout = pipelineManager.getDescriptorSetLayout(sceneShaderPaths, 0);
+    // Per-draw data. A single range for all pipelines: layouts with different ranges wouldn't be compatible, and
+    // switching between them would disturb the bound sets
+    VkPushConstantRange pushConstantRange = ShaderManager::instance().getPushConstantRange(sceneShaderPaths);
+    if ((pushConstantRange.stageFlags & ~SCENE_PUSH_CONSTANT_STAGES) != 0) {
+        throw std::runtime_error("Scene shaders use push constants outside of the vertex and fragment stages");
+    }
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if (pushConstantRange.size > properties.limits.maxPushConstantsSize) {
+        throw std::runtime_error("Scene push constants exceed the device limit: " + std::to_string(pushConstantRange.size) +
+                                 " bytes");
+    }
+    // Owned by the PipelineManager
+    pipelineLayout = pipelineManager.getPipelineLayout(sceneShaderPaths, {{1, bindless.getSetLayout()}},
+                                                       SCENE_PUSH_CONSTANT_STAGES);
+}
 
+void Renderer::createGraphicsPipeline() {
+    // Both stages are compiled concurrently on the JobSystem
+    pipelineManager.loadShaders({vertexShaderPath, fragmentShaderPath});
+
+    mainPipelineKey.vertexShaderPath = vertexShaderPath;
+    mainPipelineKey.fragmentShaderPath = fragmentShaderPath;
+    // USE_VERTEX_COLOR
+    mainPipelineKey.specialize(0, VK_TRUE);
+    // USE_CLUSTERED_LIGHTING
+    mainPipelineKey.specialize(1, lighting.isEnabled() ? VK_TRUE : VK_FALSE);
+    mainPipelineKey.isDepthTested = true;
+    mainPipelineKey.isDepthWritten = true;
+    mainPipelineKey.pipelineLayout = pipelineLayout;
+    mainPipelineKey.renderPass = renderPass;
+
+    // Variants are created lazily, but the main one is needed by the very first frame
+    pipelineManager.getPipeline(mainPipelineKey);
 }
 
-void Renderer::createFramebuffers() {
-    // resize the container to hold all the framebuffers
-    swapchainFrameBuffers.resize(swapchainImageViews.size());
-    // Create a framebuffer for each image view:
-    for (size_t i = 0; i < swapchainImageViews.size(); ++i) {
-        VkFramebufferCreateInfo framebufferCreateInfo = {};
-        framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferCreateInfo.renderPass = renderPass;
-        framebufferCreateInfo.attachmentCount = 1;
-        framebufferCreateInfo.pAttachments = &swapchainImageViews[i];
-        framebufferCreateInfo.width = swapchainExtent.width;
-        framebufferCreateInfo.height = swapchainExtent.height;
-        framebufferCreateInfo.layers = 1;
-
-        VK_CHECK(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &swapchainFrameBuffers[i]), "Frame Buffer Creation");
+void Renderer::reloadShaders() {
+    std::vector<ReloadedShader> reloadedShaders = shaderWatcher->takeReloadedShaders();
+    if (reloadedShaders.empty()) {
+        return;
+    }
+    // Exceptional, the pipelines are created again
+    AllowAllocationScope allowAllocations;
+
+    // Only the variants using a changed stage are dropped, they are recreated the next time they're requested.
+    // Frames that are still in flight keep using the old pipelines, so those are only destroyed once they are done
+    for (const ReloadedShader &shader : reloadedShaders) {
+        for (VkPipeline pipeline : pipelineManager.reloadShader(shader.filePath, shader.spirv)) {
+            deletionQueue.retirePipeline(pipeline, frameNumber);
+        }
     }
+    logTitle("Pipelines reloaded");
 }
 
 void Renderer::createCommandPool() {
@@ -560,31 +456,19 @@ void Renderer::createCommandPool() {
     // Possible flags:
     // VK_COMMAND_POOL_CREATE_TRANSIENT_BIT: Hint that command buffers are rerecorded with new commands very often (may change memory allocation behavior)
     // VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT: Allow command buffers to be rerecorded individually, without this flag they all have to be reset together
-    commandPoolCreateInfo.flags = 0; // Optional (none of the above are used)
+    // Command buffers are re-recorded every frame, one at a time
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     VK_CHECK(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool), "Command Pool Creation");
 }
 
 
-uint32_t Renderer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if (typeFilter & ((uint32_t) 1 << i) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-
-    throw std::runtime_error("failed to find suitable memory type!");
-}
-
 void Renderer::createBuffer(VkDeviceSize size,
                             VkBufferUsageFlags usage,
                             VkMemoryPropertyFlags properties,
                             VkBuffer &buffer,
-                            VkDeviceMemory &bufferMemory) {
+                            VkDeviceMemory &bufferMemory,
+                            MemoryCategory category) {
 
     // Buffer Creation:
     VkBufferCreateInfo bufferCreateInfo = {};
@@ -604,13 +488,9 @@ void Renderer::createBuffer(VkDeviceSize size,
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
 
-    VkMemoryAllocateInfo memoryAllocateInfo = {};
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.allocationSize = memRequirements.size;
-    // VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ensures that memory used by CPU and GPU is coherent
-    memoryAllocateInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    VK_CHECK(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &bufferMemory), "Memory Allocation");
+    // VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ensures that memory used by CPU and GPU is coherent.
+    // The budget picks the memory type, and accounts the allocation in 'category'
+    bufferMemory = memoryBudget.allocate(memRequirements, properties, category);
 
     // If allocation is successful, then the memory can be associated with the buffer.
     // The fourth parameter is the offset within the region of memory. If the offset is non-zero, then it is
@@ -620,43 +500,33 @@ void Renderer::createBuffer(VkDeviceSize size,
 
 }
 
-void Renderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    // Memory transfer operations are executed using command buffers, therefore a temporary command buffer allocation is needed.
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandPool = commandPool;
-    commandBufferAllocateInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer);
-
-    // Record the temporary command buffer:
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // command buffer is only used once
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    VkBufferCopy copyRegion = {};
-    copyRegion.srcOffset = 0; // Optional
-    copyRegion.dstOffset = 0; // Optional
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    // This command buffer only contains the copy command, so can stop recording after it.
-    vkEndCommandBuffer(commandBuffer);
-
-    // Now, submit it for execution:
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(*queues.getQueue(GRAPHICS_QUEUE), 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(*queues.getQueue(GRAPHICS_QUEUE));
+void Renderer::copyBuffer(VkBuffer stagingBuffer, VkDeviceMemory stagingMemory, VkBuffer dstBuffer, VkDeviceSize size) {
+    // Rather than a one-off submission the CPU would have to wait for, the copy goes in the command buffer of the next
+    // frame: the frame timeline then tells when the staging buffer can be destroyed
+    pendingCopies.push_back({stagingBuffer, stagingMemory, dstBuffer, size});
+}
 
-    // Clean up the command buffer used for transfer operation
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+void Renderer::recordPendingCopies(VkCommandBuffer commandBuffer) {
+    if (pendingCopies.empty()) {
+        return;
+    }
+    for (const PendingCopy &copy : pendingCopies) {
+        VkBufferCopy copyRegion = {};
+        copyRegion.size = copy.size;
+        vkCmdCopyBuffer(commandBuffer, copy.stagingBuffer, copy.buffer, 1, &copyRegion);
+        // Recorded in the current frame, which is done once the timeline reaches frameNumber + 1
+        deletionQueue.retireBuffer(copy.stagingBuffer, frameNumber + 1);
+        deletionQueue.retireMemory(copy.stagingMemory, frameNumber + 1);
+    }
+    pendingCopies.clear();
+
+    // The copied buffers are vertex and index buffers
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
 }
 
 void Renderer::createVertexBuffer() {
@@ -678,7 +548,8 @@ void Renderer::createVertexBuffer() {
                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                  stagingBuffer,
-                 stagingBufferMemory);
+                 stagingBufferMemory,
+                 STAGING_MEMORY);
 
     // Filling the Staging Buffer:
     void *data;
@@ -691,13 +562,11 @@ void Renderer::createVertexBuffer() {
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                  vertexBuffer,
-                 vertexBufferMemory);
+                 vertexBufferMemory,
+                 MESH_MEMORY);
 
-    // Copy the content from one buffer to the other:
-    copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    // Copy the content from one buffer to the other, the staging buffer is destroyed once the copy is done
+    copyBuffer(stagingBuffer, stagingBufferMemory, vertexBuffer, bufferSize);
 }
 
 void Renderer::createIndexBuffer() {
@@ -711,7 +580,8 @@ void Renderer::createIndexBuffer() {
     createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                  stagingBuffer,
-                 stagingBufferMemory);
+                 stagingBufferMemory,
+                 STAGING_MEMORY);
 
     void *data;
     vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0,
@@ -723,65 +593,67 @@ void Renderer::createIndexBuffer() {
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                  indexBuffer,
-                 indexBufferMemory);
-
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+                 indexBufferMemory,
+                 MESH_MEMORY);
 
+    copyBuffer(stagingBuffer, stagingBufferMemory, indexBuffer, bufferSize);
 }
 
 void Renderer::createUniformBuffers() {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-    uniformBuffers.resize(swapchainImages.size());
-    uniformBuffersMemory.resize(swapchainImages.size());
-    for (size_t i = 0; i < swapchainImages.size(); i++) {
+    // One uniform buffer per frame slot: the CPU writes the one of the frame it's recording while the GPU may still
+    // be reading the others
+    VkDeviceSize bufferSize = sizeof(FrameUniforms);
+    for (FrameSlot &frameSlot : frameSlots) {
         createBuffer(bufferSize,
                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     uniformBuffers[i],
-                     uniformBuffersMemory[i]);
+                     frameSlot.uniformBuffer,
+                     frameSlot.uniformBufferMemory,
+                     UNIFORM_MEMORY);
+        // Host coherent memory can stay mapped for the lifetime of the buffer
+        vkMapMemory(device, frameSlot.uniformBufferMemory, 0, bufferSize, 0, &frameSlot.uniformData);
     }
 }
 
 void Renderer::createDescriptorPool() {
     // First, specify the descriptor pool size
-    // There are as many descriptors as there are swapchain images
+    // There are as many descriptors as there are frame slots
     VkDescriptorPoolSize poolSize = {};
     poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(swapchainImages.size());
+    poolSize.descriptorCount = MAX_FRAMES_IN_FLIGHT;
 
     VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
     descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     descriptorPoolCreateInfo.poolSizeCount = 1;
     descriptorPoolCreateInfo.pPoolSizes = &poolSize;
     // 'maxSets' specifies the maximum amount of descriptor sets that may be allocated
-    descriptorPoolCreateInfo.maxSets = static_cast<uint32_t>(swapchainImages.size());
+    descriptorPoolCreateInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
 
     VK_CHECK(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool), "Descriptor Pool Creation");
 }
 
 void Renderer::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(swapchainImages.size(), descriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
     VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
     descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     descriptorSetAllocateInfo.descriptorPool = descriptorPool;
-    descriptorSetAllocateInfo.descriptorSetCount = static_cast<uint32_t>(swapchainImages.size());
+    descriptorSetAllocateInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
     descriptorSetAllocateInfo.pSetLayouts = layouts.data();
 
 
     // Allocate descriptor sets:
-    descriptorSets.resize(swapchainImages.size());
+    std::vector<VkDescriptorSet> descriptorSets(MAX_FRAMES_IN_FLIGHT);
     VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, descriptorSets.data()), "Descriptor Sets Allocation");
 
     // The set has been allocated, but the descriptors within it still need to be configured:
-    for (size_t i = 0; i < swapchainImages.size(); i++) {
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        frameSlots[i].descriptorSet = descriptorSets[i];
+
         VkDescriptorBufferInfo descriptorBufferInfo = {};
-        descriptorBufferInfo.buffer = uniformBuffers[i];
+        descriptorBufferInfo.buffer = frameSlots[i].uniformBuffer;
         descriptorBufferInfo.offset = 0;
         // If the whole buffer is overwritten, then can also use the flag VK_WHOLE_SIZE for the 'range'
-        descriptorBufferInfo.range = sizeof(UniformBufferObject);
+        descriptorBufferInfo.range = sizeof(FrameUniforms);
 
         VkWriteDescriptorSet writeDescriptorSet = {};
         writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -808,7 +680,9 @@ void Renderer::createDescriptorSets() {
 }
 
 void Renderer::createCommandBuffers() {
-    commandBuffers.resize(swapchainFrameBuffers.size());
+    // One command buffer per frame slot, re-recorded every frame. This way the recorded pipeline and resources can
+    // change from one frame to the next (e.g. after a shader reload) without waiting for the whole GPU.
+    std::vector<VkCommandBuffer> commandBuffers(MAX_FRAMES_IN_FLIGHT);
 
     // Command buffer allocation:
     VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
@@ -820,131 +694,305 @@ void Renderer::createCommandBuffers() {
     commandBufferAllocateInfo.commandBufferCount = (uint32_t) commandBuffers.size();
 
     VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers.data()), "Command Buffer Allocation");
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        frameSlots[i].commandBuffer = commandBuffers[i];
+    }
+}
+
+void Renderer::recordCommandBuffer(const FrameSlot &frameSlot, uint32_t imageIndex) {
+    VkCommandBuffer commandBuffer = frameSlot.commandBuffer;
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0), "Command Buffer Reset");
+
+    // Starting command buffer recording:
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // Flags specify how the command buffer is going to be used
+    // VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: The command buffer will be rerecorded right after executing it once.
+    // VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: This is a secondary command buffer that will be entirely within a single render pass.
+    // VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: The command buffer can be resubmitted while it is also already pending execution.
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr; // Optional
+
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo), "Command Buffer Begin");
+    uint32_t slot = frameNumber % framesInFlight;
+    if (dynamicResolution.isEnabled()) {
+        dynamicResolution.recordStart(commandBuffer, slot);
+    }
+    recordPendingCopies(commandBuffer);
+
+    // Take ownership of the compute results of this frame
+    asyncCompute.recordAcquire(commandBuffer, slot);
+
+    // The passes, and the barriers between them:
+    renderGraph.setImportedImage(swapchainResource, swapchainImages[imageIndex], swapchainImageViews[imageIndex]);
+    if (lighting.isEnabled()) {
+        renderGraph.setImportedBuffer(clusterResource, lighting.getClusterBuffer(slot));
+        renderGraph.setImportedBuffer(lightIndexResource, lighting.getLightIndexBuffer(slot));
+    }
+    renderGraph.setRenderArea("main", renderExtent);
+    renderGraph.execute(commandBuffer);
+
+    // And give back the ones that compute writes again
+    asyncCompute.recordRelease(commandBuffer, slot, frameNumber);
+
+    // Finished recording the command buffer:
+    VK_CHECK(vkEndCommandBuffer(commandBuffer), "Command Buffer End");
+}
+
+void Renderer::recordMainPass(VkCommandBuffer commandBuffer) {
+    // Recorded for the frame slot of the current frame
+    const FrameSlot &frameSlot = frameSlots[frameNumber % framesInFlight];
+
+    // Bound once for the whole pass: all the scene pipelines share the layout, draws only push indices
+    VkDescriptorSet descriptorSets[] = {frameSlot.descriptorSet, bindless.getSet()};
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS, // unlike vertex and index buffers, descriptor sets are not unique to graphics pipelines, thus need to specify
+                            pipelineLayout, // layout that the descriptor is based on
+                            0, // index of the first descriptor set
+                            2, // number of sets to bind
+                            descriptorSets, // the array of sets to bind
+                            0, // index in the array of offsets
+                            nullptr); // array of offsets
+
+    if (isMeshDrawn) {
+        recordMesh(commandBuffer);
+    }
+
+    // Sprites are blended in submission order, over the mesh
+    if (spriteBatch.isEnabled()) {
+        spriteBatch.recordDraw(commandBuffer, frameNumber % framesInFlight);
+    }
+
+    // Particles go last, they are blended over the opaque geometry
+    if (particleSystem.isEnabled()) {
+        particleSystem.recordDraw(commandBuffer, frameNumber % framesInFlight);
+    }
 
-    for (size_t i = 0; i < commandBuffers.size(); i++) {
-        // Starting command buffer recording:
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        // Flags specify how the command buffer is going to be used
-        // VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: The command buffer will be rerecorded right after executing it once.
-        // VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: This is a secondary command buffer that will be entirely within a single render pass.
-        // VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: The command buffer can be resubmitted while it is also already pending execution.
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-        beginInfo.pInheritanceInfo = nullptr; // Optional
-
-        VK_CHECK(vkBeginCommandBuffer(commandBuffers[i], &beginInfo), "Command Buffer Begin");
-
-        // Starting a render pass:
-        VkRenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapchainFrameBuffers[i];
-        // Render area defines where shader loads and stores will take place (match size of attachment for best performance)
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapchainExtent;
-        // Clear color for the VK_ATTACHMENT_LOAD_OP_CLEAR
-        VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
-
-        // VK_SUBPASS_CONTENTS_INLINE: The render pass commands will be embedded in the primary command buffer itself and no secondary command buffers will be executed.
-        // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: The render pass commands will be executed from secondary command buffers.
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        // Can now bind the graphics pipeline:
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-        // Also, can bind the vertex buffer:
-        VkBuffer vertexBuffers[] = {vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-
-        // Also, the index buffer: (index type must be specified accordingly)
-        vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-
-        // Also, the uniform buffer:
-        vkCmdBindDescriptorSets(commandBuffers[i],
-                                VK_PIPELINE_BIND_POINT_GRAPHICS, // unlike vertex and index buffers, descriptor sets are not unique to graphics pipelines, thus need to specify
-                                pipelineLayout, // layout that the descriptor is based on
-                                0, // index of the first descriptor set
-                                1, // number of sets to bind
-                                &descriptorSets[i], // the array of sets to bind
-                                0, // index in the array of offsets
-                                nullptr); // array of offsets
-
-
-        // Draw command:
-        // Inputs are: (in order)
-        // vertexCount defines how many vertices need to be drawn
-        // instanceCount used for instance rendering, 1 if instance rendering isn't used
-        // firstVertex defines the lowest value of gl_VertexIndex
-        // firstInstance defines the lowest value of gl_InstanceIndex
-        vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(vertexIndices.size()), 1, 0, 0, 0);
-//        vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-        // End render pass:
-        vkCmdEndRenderPass(commandBuffers[i]);
-
-        // Finished recording the command buffer:
-        VK_CHECK(vkEndCommandBuffer(commandBuffers[i]), "Command Buffer End");
+    // The scene is done: what follows (the upscale) doesn't depend on the render scale
+    if (dynamicResolution.isEnabled()) {
+        dynamicResolution.recordEnd(commandBuffer, frameNumber % framesInFlight);
     }
 }
 
+void Renderer::recordMesh(VkCommandBuffer commandBuffer) {
+    // Can now bind the graphics pipeline:
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineManager.getPipeline(mainPipelineKey));
+    // (viewport and scissor, which are dynamic state of the pipeline, are set by the render graph)
+
+    // Also, can bind the vertex buffer:
+    VkBuffer vertexBuffers[] = {vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+    // Also, the index buffer: (index type must be specified accordingly)
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+    // And the per-draw data: the transform and the texture (white while it's uploading). The camera is in the
+    // uniform buffer, bound for the whole pass
+    MeshConstants constants = {meshModel, textureManager.getBindlessIndex(meshTexture)};
+    vkCmdPushConstants(commandBuffer, pipelineLayout, SCENE_PUSH_CONSTANT_STAGES, 0, MeshConstants::SIZE, &constants);
+
+
+    // Draw command:
+    // Inputs are: (in order)
+    // vertexCount defines how many vertices need to be drawn
+    // instanceCount used for instance rendering, 1 if instance rendering isn't used
+    // firstVertex defines the lowest value of gl_VertexIndex
+    // firstInstance defines the lowest value of gl_InstanceIndex
+    vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(vertexIndices.size()), 1, 0, 0, 0);
+    // The other instances only differ by their transform
+    for (const glm::mat4 &model : instanceModels) {
+        constants.model = model;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, SCENE_PUSH_CONSTANT_STAGES, 0, MeshConstants::SIZE,
+                           &constants);
+        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(vertexIndices.size()), 1, 0, 0, 0);
+    }
+//    vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+}
+
 
 void Renderer::createSyncObjects() {
     // Semaphores are best used for GPU <--> GPU synchronization
-    // Fences are best used for CPU <--> GPU synchronization
-    // Each frame should have its own semaphore and fence
+    // A timeline semaphore also covers CPU <--> GPU synchronization: the CPU can wait for (or query) any value, so a
+    // single one replaces a fence per frame
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for (FrameSlot &frameSlot : frameSlots) {
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frameSlot.imageAvailableSemaphore), "Semaphore Creation");
+    }
 
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo = {};
+    semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeInfo.initialValue = 0;
+    VkSemaphoreCreateInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timelineInfo.pNext = &semaphoreTypeInfo;
+    VK_CHECK(vkCreateSemaphore(device, &timelineInfo, nullptr, &frameTimeline), "Timeline Semaphore Creation");
 
+    createRenderFinishedSemaphores();
+}
+
+void Renderer::createRenderFinishedSemaphores() {
     VkSemaphoreCreateInfo semaphoreInfo = {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    // Start up the fence in a signaled state, so that the first frame can be directly drawn
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    renderFinishedSemaphores.resize(swapchainImages.size());
+    for (VkSemaphore &semaphore : renderFinishedSemaphores) {
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore), "Semaphore Creation");
+    }
+}
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]), "Semaphore Creation");
-        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]), "Semaphore Creation");
-        VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]), "Fence Creation");
+uint64_t Renderer::getCompletedFrames() {
+    uint64_t completedFrames = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, frameTimeline, &completedFrames), "Timeline Semaphore Query");
+    return completedFrames;
+}
+
+void Renderer::waitForCompletedFrames(uint64_t completedFrames) {
+    if (completedFrames == 0) {
+        return;
     }
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &frameTimeline;
+    waitInfo.pValues = &completedFrames;
+    // Setting the timeout to the maximum 64-bit unsigned int disables it
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max()), "Timeline Semaphore Wait");
+}
+
+void Renderer::waitForFrameSlot() {
+    // The frame that last used the slot of the next one must be done
+    if (frameNumber >= framesInFlight) {
+        waitForCompletedFrames(frameNumber + 1 - framesInFlight);
+    }
+}
+
+void Renderer::waitForFrame() {
+    if (isLowLatencyMode) {
+        // Wait until the GPU has caught up with everything submitted: the frame about to be recorded then uses the
+        // freshest input, and doesn't sit in a queue behind older frames
+        waitForCompletedFrames(frameNumber);
+    } else {
+        waitForFrameSlot();
+    }
+    // Sleeping here rather than after presenting also keeps the input of the next frame fresh
+    frameLimiter.wait();
+}
+
+void Renderer::setPresentPolicy(PresentPolicy policy) {
+    presentPolicy = policy;
+    isLowLatencyMode = policy == LOW_LATENCY_PRESENT;
+    if (swapchain) {
+        // Picked up at the end of the next frame
+        frameBufferResized = true;
+    }
+}
+
+void Renderer::recordPresentLatency() {
+    using namespace std::chrono;
+    auto presentTime = steady_clock::now();
+    lastFrameLatency.inputSampleToPresent = duration<double, std::milli>(presentTime - inputSampleTime).count();
+    lastFrameLatency.oldestEventToPresent = oldestEventTime < inputSampleTime ?
+                                            duration<double, std::milli>(presentTime - oldestEventTime).count() : 0.0;
+
+    if (!isLatencyReported) {
+        return;
+    }
+    if (latencyReport.frameCount == 0) {
+        latencyReport.start = presentTime;
+    }
+    latencyReport.frameCount++;
+    latencyReport.inputSampleToPresentSum += lastFrameLatency.inputSampleToPresent;
+    latencyReport.inputSampleToPresentMax = std::max(latencyReport.inputSampleToPresentMax, lastFrameLatency.inputSampleToPresent);
+    latencyReport.oldestEventToPresentMax = std::max(latencyReport.oldestEventToPresentMax, lastFrameLatency.oldestEventToPresent);
+
+    if (presentTime - latencyReport.start >= seconds(1)) {
+        LOG_INFO("Input to present latency: avg {} ms, max {} ms, oldest event max {} ms ({} frames)",
+                 latencyReport.inputSampleToPresentSum / latencyReport.frameCount, latencyReport.inputSampleToPresentMax,
+                 latencyReport.oldestEventToPresentMax, latencyReport.frameCount);
+        latencyReport = LatencyReport();
+    }
+}
+
+void Renderer::setFramesInFlight(uint32_t count) {
+    count = std::max(1u, std::min(count, MAX_FRAMES_IN_FLIGHT));
+    if (count == framesInFlight) {
+        return;
+    }
+    // Frames map to different slots afterwards, so every slot must be free
+    if (frameTimeline) {
+        waitForCompletedFrames(frameNumber);
+    }
+    framesInFlight = count;
+    log("Frames in flight: " + std::to_string(framesInFlight));
 }
 
 void Renderer::initializeVulkan() {
-    // Vulkan core:
-    instance = VulkanCore::createInstance(asterismName, isDebug);
+    // Vulkan core (the instance is created by initializeRenderer(), concurrently with the window):
     surface = VulkanCore::createSurface(instance, window);
-    physicalDevice = VulkanCore::createPhysicalDevice(instance);
+    physicalDevice = VulkanCore::createPhysicalDevice(instance, surface, deviceExtensions, deviceFeatures);
 
     queues.retrieveAvailableQueueIndices(physicalDevice, surface);
 
-    device = VulkanCore::createLogicalDevice(physicalDevice, deviceExtensions, queues);
+    device = VulkanCore::createLogicalDevice(physicalDevice, deviceFeatures, queues);
     // Store queue handles as soon as the device is created
     queues.setQueues(device);
-
+    memoryBudget.initialize(physicalDevice, device, deviceFeatures.hasMemoryBudget);
+    deletionQueue.initialize(device, memoryBudget);
+    endStartupPhase("device");
 
     // Vulkan Pipeline:
     createSwapchain();
     createImageViews();
-    createRenderPass();
+    depthFormat = findDepthFormat();
+    // The scene looks at the origin from above, the extent is only known now
+    camera = std::make_unique<Camera>(ViewParams{glm::vec3(0.0f, 2.0f, 2.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)},
+                                      PerspectiveParams{glm::radians(45.0f),
+                                                        glm::vec2(swapchainExtent.width, swapchainExtent.height),
+                                                        0.1f, 10.0f});
+
+    bindless.initialize(device, physicalDevice);
+    textureManager.initialize(device, physicalDevice, deviceFeatures, queues, bindless, memoryBudget);
+    pipelineManager.initialize(device);
+    // Before the render graph, which imports its light lists and records the shadows
+    createClusteredLighting();
+    dynamicResolution.initialize(device, physicalDevice, queues, resolutionSettings, MAX_FRAMES_IN_FLIGHT,
+                                 swapchainImageFormat, swapchainImageUsage);
+
+    renderGraph.initialize(device, memoryBudget);
+    createRenderGraph();
+    endStartupPhase("swapchain and render graph");
+
+    // Takes the precompiled shaders, waiting for the ones that are still compiling
+    createPipelineLayout();
+    createGraphicsPipeline();
 
-//  Buffer
-    createDescriptorSetLayout();
+    if (enableShaderHotReload) {
+        shaderWatcher = std::make_unique<ShaderWatcher>(std::string(SOURCE_DIR).append("/shaders"));
+        shaderWatcher->track(vertexShaderPath);
+        shaderWatcher->track(fragmentShaderPath);
+        if (lighting.isEnabled()) {
+            shaderWatcher->track(ClusteredLighting::getShaderPath());
+        }
+        if (shadowMaps.isEnabled()) {
+            shaderWatcher->track(ShadowMaps::getShaderPath());
+        }
+    }
 
-    createGraphicsPipeline();
+    endStartupPhase("scene pipelines");
 
-//   Buffer
-    createFramebuffers();
-//
     createCommandPool();
 
+    // Per frame slot resources are allocated for the maximum depth, so that it can be changed at runtime
+    frameSlots.resize(MAX_FRAMES_IN_FLIGHT);
+
 //   Buffer
     createVertexBuffer();
     createIndexBuffer();
+    shadowMaps.setMesh(vertexBuffer, indexBuffer, static_cast<uint32_t>(vertexIndices.size()));
     createUniformBuffers();
 //
     createDescriptorPool();
@@ -952,9 +1000,63 @@ void Renderer::initializeVulkan() {
     createCommandBuffers();
 
     createSyncObjects();
+    createTextures();
+    endStartupPhase("buffers and descriptors");
+
+    frameArena.initialize(MAX_FRAMES_IN_FLIGHT, 256 * 1024);
+    asyncCompute.initialize(device, queues, MAX_FRAMES_IN_FLIGHT, frameArena);
+    createParticleSystem();
+    createSpriteBatch();
+    endStartupPhase("particles and sprites");
+    memoryBudget.report();
+}
+
+void Renderer::createTextures() {
+    // Uploaded with the first frames: the mesh is drawn white until then
+    JobSystem::instance().wait(assetLoads);
+    meshTexture = textureManager.create(std::move(meshTextureData));
+}
+
+void Renderer::createSpriteBatch() {
+    spriteBatch.initialize(device, memoryBudget, pipelineManager, textureManager, frameArena, pipelineLayout, renderPass,
+                           spriteCapacity, MAX_FRAMES_IN_FLIGHT);
+    if (spriteBatch.isEnabled() && shaderWatcher) {
+        for (const std::string &shaderPath : spriteBatch.getShaderPaths()) {
+            shaderWatcher->track(shaderPath);
+        }
+    }
+}
+
+void Renderer::createClusteredLighting() {
+    lighting.initialize(device, physicalDevice, memoryBudget, queues, pipelineManager, bindless, lightingSettings,
+                        MAX_FRAMES_IN_FLIGHT);
+    if (lighting.isEnabled()) {
+        shadowMaps.initialize(device, physicalDevice, memoryBudget, pipelineManager, bindless, lightingSettings);
+    }
+}
+
+void Renderer::createParticleSystem() {
+    particleSystem.initialize(device, physicalDevice, deviceFeatures, memoryBudget, queues, pipelineManager, bindless, pipelineLayout, renderPass, particleSettings, MAX_FRAMES_IN_FLIGHT);
+    if (!particleSystem.isEnabled()) {
+        return;
+    }
+    // Frame N simulates into the pool that frame N - 2 drew
+    asyncCompute.addWork([this](VkCommandBuffer commandBuffer, uint32_t slot) {
+        particleSystem.recordCompute(commandBuffer, slot);
+    }, 2);
+    asyncCompute.addGraphicsWaitStages(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+
+    if (shaderWatcher) {
+        for (const std::string &shaderPath : particleSystem.getShaderPaths()) {
+            shaderWatcher->track(shaderPath);
+        }
+    }
 }
 
 void Renderer::recreateSwapchain() {
+    // Exceptional, everything that depends on the swapchain is allocated again
+    AllowAllocationScope allowAllocations;
+
     // Handle minimization:
     int width = 0;
     int height = 0;
@@ -963,83 +1065,94 @@ void Renderer::recreateSwapchain() {
         glfwWaitEvents();
     }
 
-    // Wait for resources to be available
-    vkDeviceWaitIdle(device);
-
-    // Destroy all VK entities that have to do with the current swapchain
+    // Nothing waits for the GPU: everything that has to do with the current swapchain is retired, and destroyed once
+    // the frames in flight that use it are done.
+    // The pipelines only depend on the render pass of the graph (viewport and scissor are dynamic)
+    for (VkPipeline pipeline : pipelineManager.releaseRenderPass(renderPass)) {
+        deletionQueue.retirePipeline(pipeline, frameNumber);
+    }
+    VkSwapchainKHR oldSwapchain = swapchain;
     cleanupSwapchain();
 
     // Create them with the correct values again
-    createSwapchain();
+    createSwapchain(oldSwapchain);
     createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
-    createFramebuffers();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
+    createRenderGraph();
+    mainPipelineKey.renderPass = renderPass;
+    particleSystem.setRenderPass(renderPass);
+    spriteBatch.setRenderPass(renderPass);
+    createRenderFinishedSemaphores();
 }
 
 void Renderer::cleanupSwapchain() {
-    for (VkFramebuffer frameBuffer : swapchainFrameBuffers) {
-        vkDestroyFramebuffer(device, frameBuffer, nullptr);
-    }
-
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
+    // Render passes, framebuffers and transient attachments
+    renderGraph.reset(deletionQueue, frameNumber);
 
     for (VkImageView imageView : swapchainImageViews) {
-        vkDestroyImageView(device, imageView, nullptr);
+        deletionQueue.retireImageView(imageView, frameNumber);
     }
 
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
-
-    for (size_t i = 0; i < swapchainImages.size(); i++) {
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+    // Presentation isn't tracked by the frame timeline: the presentations queued by the frames in flight are done
+    // once as many frames after them are
+    uint64_t presentedFrames = frameNumber + framesInFlight;
+    deletionQueue.retireSwapchain(swapchain, presentedFrames);
+    for (VkSemaphore semaphore : renderFinishedSemaphores) {
+        deletionQueue.retireSemaphore(semaphore, presentedFrames);
     }
-
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 }
 
 
-void Renderer::updateUniformBuffer(uint32_t currentImageIndex) {
-    static auto startTime = std::chrono::high_resolution_clock::now();
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+void Renderer::updateUniformBuffer(const FrameSlot &frameSlot, const FrameState &frameState) {
+    // The model transform comes from the latest simulation snapshot, and is pushed with the draw
+    meshModel = frameState.model;
+    instanceModels.clear();
+    for (const MeshInstance &instance : frameState.meshInstances) {
+        instanceModels.push_back(instance.model);
+    }
 
-    UniformBufferObject ubo = {};
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(45.0f), glm::vec3(0.0f, 1.0f, .0f));
-    ubo.view = glm::lookAt(glm::vec3(0.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     // It is important to use the current swapchain extent to calculate the aspect ratio
-    ubo.proj = glm::perspectiveFov<float>(glm::radians(45.0f), // vertical field of view
-                                          float(swapchainExtent.width),
-                                          float(swapchainExtent.height),
-                                          0.1f, // near plane distance
-                                          10.0f); // far plane distance
-
-    // glm was designed with OpenGL in mind, where the y coordinate of the clip coordinates is inverted.
-    ubo.proj[1][1] *= -1;
+    camera->setScreenSize(glm::vec2(swapchainExtent.width, swapchainExtent.height));
+
+    FrameUniforms ubo = {};
+    ubo.view = camera->getView();
+    ubo.proj = camera->getProjection();
+    ubo.viewProjection = camera->getViewProjection();
+    if (lighting.isEnabled()) {
+        ubo.lighting = lighting.update(frameNumber % framesInFlight, frameState.lights, frameState.directionalLight,
+                                       *camera, renderExtent);
+    }
+    if (shadowMaps.isEnabled()) {
+        ubo.shadows = shadowMaps.update(frameState, *camera);
+    }
 
     // Once the uniforms have been computed, need to copy the data into the actual buffer
     // In this case, a staging buffer is not the best option since the uniforms might change at each frame
-
-    void *data;
-    vkMapMemory(device, uniformBuffersMemory[currentImageIndex], 0, sizeof(ubo), 0, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(device, uniformBuffersMemory[currentImageIndex]);
+    memcpy(frameSlot.uniformData, &ubo, sizeof(ubo));
 }
 
 
-void Renderer::drawFrame() {
-    // Wait for the frame to be finished:
-    // The VK_TRUE passed here indicates that all fences need to be signaled before continuing
-    // (in this case we have a single one so it doesn't really matter)
-    // The last parameter is a timeout for the next frame to become available and setting it to the maximum 64-bit
-    // unsigned int disables the timeout
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+void Renderer::drawFrame(const FrameState &frameState) {
+    // Recording the frame must not touch the heap, exceptional work opens AllowAllocationScopes. The first frames fill
+    // the caches and grow the arena
+    NoAllocationScope noAllocation("drawFrame", frameNumber >= 2 * MAX_FRAMES_IN_FLIGHT);
+
+    // Wait for the frame that last used this slot to be finished (usually already done by waitForFrame())
+    waitForFrameSlot();
+    uint32_t slot = frameNumber % framesInFlight;
+    const FrameSlot &frameSlot = frameSlots[slot];
+    frameArena.beginFrame(slot);
+
+    // Frame boundary: swap in recompiled shaders, and destroy the retired handles that no frame in flight uses anymore
+    if (shaderWatcher) {
+        reloadShaders();
+    }
+    deletionQueue.collect(getCompletedFrames());
+    memoryBudget.update();
+    textureManager.update();
+
+    // Compute goes first: its queue can start on this frame while graphics is still busy with the previous one
+    particleSystem.setEmitters(frameState.particleEmitters);
+    asyncCompute.submit(frameNumber, slot, frameTimeline);
 
     //###################################################
     // 1. Acquire an image from the swapchain (swapchain is an extension, so we require the vk*KHR naming convention)
@@ -1047,7 +1160,7 @@ void Renderer::drawFrame() {
     // The third parameter specifies a timeout in nanoseconds for an image to become available,
     // using the maximum value of 64 bit unsigned integer disables the timeout.
     VkResult acquireNextImageResult = vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(),
-                                                            imageAvailableSemaphores[currentFrame],
+                                                            frameSlot.imageAvailableSemaphore,
                                                             VK_NULL_HANDLE, &imageIndex);
 
     if (acquireNextImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -1058,8 +1171,12 @@ void Renderer::drawFrame() {
     }
 
     //###################################################
-    // 2. Update the uniform buffers since we now know which image is going to be used
-    updateUniformBuffer(imageIndex);
+    // 2. Update the uniform buffer and record the command buffer of this frame slot, the GPU is done with both
+    renderExtent = dynamicResolution.isEnabled() ? dynamicResolution.update(slot, swapchainExtent) : swapchainExtent;
+    updateUniformBuffer(frameSlot, frameState);
+    spriteBatch.upload(slot);
+
+    recordCommandBuffer(frameSlot, imageIndex);
 
 
     //###################################################
@@ -1067,26 +1184,40 @@ void Renderer::drawFrame() {
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    // Need to wait with writing colors to the image until it's available
-    submitInfo.waitSemaphoreCount = 1;
+    // Need to wait with writing colors to the image until it's available, and with consuming the compute results
+    // until they are written
+    VkSemaphore waitSemaphores[] = {frameSlot.imageAvailableSemaphore, asyncCompute.getTimeline()};
+    // (at the stage of its first use: the upscale with dynamic resolution, so that the scene doesn't wait)
+    VkPipelineStageFlags imageWaitStage = dynamicResolution.isEnabled() ? VK_PIPELINE_STAGE_TRANSFER_BIT
+                                                                        : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkPipelineStageFlags waitStages[] = {imageWaitStage, asyncCompute.getGraphicsWaitStages(slot)};
+    submitInfo.waitSemaphoreCount = asyncCompute.hasWork() ? 2 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     // Specify which command buffers to actually submit for execution
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-    // pSignalSemaphores specifies which semaphore to signal when the command buffers have finished execution
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pCommandBuffers = &frameSlot.commandBuffer;
+    // pSignalSemaphores specifies which semaphores to signal when the command buffers have finished execution:
+    // the binary one for presentation and the frame timeline
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[imageIndex], frameTimeline};
+    submitInfo.signalSemaphoreCount = 2;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    // Submit commands to the queue: (last parameter defines an optional fence to be signaled when the command buffer finishes execution)
-    // This fence corresponds to the inFlightFence that is used to synchronise the CPU with the GPU
-
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
-
-    VK_CHECK(vkQueueSubmit(*queues.getQueue(GRAPHICS_QUEUE), 1, &submitInfo, inFlightFences[currentFrame]), "Queue Submission");
+    // Values for the timeline semaphores (ignored for binary ones)
+    uint64_t waitValues[] = {0, frameNumber + 1};
+    uint64_t signalValues[] = {0, frameNumber + 1};
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+    timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+    timelineSubmitInfo.signalSemaphoreValueCount = 2;
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineSubmitInfo;
+
+    // Submit commands to the queue (no fence needed, the CPU waits on the timeline instead)
+    VK_CHECK(vkQueueSubmit(*queues.getQueue(GRAPHICS_QUEUE), 1, &submitInfo, VK_NULL_HANDLE), "Queue Submission");
+    // The frame is submitted even if the presentation below fails, which keeps the timeline consistent
+    frameNumber++;
 
     //###################################################
     // 4. Return the image to the swapchain for presentation
@@ -1094,7 +1225,6 @@ void Renderer::drawFrame() {
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     // Specify which semaphores to wait on before presentation can happen
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
     // Specify which swapchains to present images to and the index of the image for each swapchain
     VkSwapchainKHR swapChains[] = {swapchain};
     presentInfo.swapchainCount = 1;
@@ -1104,22 +1234,26 @@ void Renderer::drawFrame() {
     // which is not really necessary for a single swapchain, since the return value of the present function can be used
     presentInfo.pResults = nullptr; // Optional
 
+    VkSemaphore presentWaitSemaphores[] = {renderFinishedSemaphores[imageIndex]};
+    presentInfo.pWaitSemaphores = presentWaitSemaphores;
+
     VkResult queuePresentResult = vkQueuePresentKHR(*queues.getQueue(PRESENT_QUEUE), &presentInfo);
+    recordPresentLatency();
+    if (timeToFirstFrame == 0.0) {
+        timeToFirstFrame = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTime).count();
+        LOG_INFO("First frame presented {:.2} ms after startup", timeToFirstFrame);
+    }
 
     if (queuePresentResult == VK_ERROR_OUT_OF_DATE_KHR || queuePresentResult == VK_SUBOPTIMAL_KHR || frameBufferResized) {
 
         frameBufferResized = false;
+        AllowAllocationScope allowAllocations;
 //        logTitle("Window has been resized (" + std::to_string(width) + "x" + std::to_string(height) + ")");
         logTitle("Window has been resized");
         recreateSwapchain();
     } else if (queuePresentResult != VK_SUCCESS) {
         throw std::runtime_error("Failed to present swap chain image");
     }
-
-    // If the CPU is submitting work faster than the GPU can keep up, the queue will slowly fill up with work.
-    // To avoid this, allow a certain amount of frames to be 'in-flight' while still bounding the amount
-    // of work that piles up.
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 bool Renderer::checkLoop() {
@@ -1127,12 +1261,18 @@ bool Renderer::checkLoop() {
 }
 
 void Renderer::rendererPollEvents() {
+    inputManager->clearEvents();
     glfwPollEvents();
+
+    // Input is considered sampled once all pending events have been processed
+    inputSampleTime = std::chrono::steady_clock::now();
+    const std::vector<InputEvent> &events = inputManager->getEvents();
+    oldestEventTime = events.empty() ? inputSampleTime : events.front().timestamp;
 }
 
 void Renderer::afterLoop() {
     // When the window is closed, there might still be operations going on. Need to wait until all operations are done
-    // before cleaning up resources
+    // before cleaning up resources. The only place the whole device is drained, resizes and reloads retire instead
     vkDeviceWaitIdle(device);
 }
 
@@ -1145,22 +1285,36 @@ void Renderer::afterLoop() {
 //}
 
 void Renderer::cleanup() {
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
+    shaderWatcher.reset();
+
+    for (FrameSlot &frameSlot : frameSlots) {
+        vkDestroySemaphore(device, frameSlot.imageAvailableSemaphore, nullptr);
+        vkDestroyBuffer(device, frameSlot.uniformBuffer, nullptr);
+        memoryBudget.free(frameSlot.uniformBufferMemory);
     }
+    vkDestroySemaphore(device, frameTimeline, nullptr);
+    asyncCompute.cleanup();
+    frameArena.cleanup();
+    particleSystem.cleanup();
+    shadowMaps.cleanup();
+    lighting.cleanup();
+    dynamicResolution.cleanup();
+    spriteBatch.cleanup();
+    textureManager.cleanup();
+    bindless.cleanup();
     vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
+    pipelineManager.cleanup();
     cleanupSwapchain();
-
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    // The device is idle since afterLoop()
+    deletionQueue.cleanup();
 
     vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    memoryBudget.free(vertexBufferMemory);
 
     vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
+    memoryBudget.free(indexBufferMemory);
 
     vkDestroyDevice(device, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
@@ -16,53 +16,28 @@ void VK_CHECK(VkResult result, const char *message) {
 
 // Prints standard text
 void print(const char *message) {
-    std::cout << message << std::endl;
+    Logger::instance().write(LOG_LEVEL_INFO, LOG_STYLE_PLAIN, "{}", 0, message);
 }
 
 void print(const std::string& message) {
-    std::cout << message << std::endl;
+    Logger::instance().write(LOG_LEVEL_INFO, LOG_STYLE_PLAIN, "{}", 0, message);
 }
 
 // Prints centered text
 void log(const std::string& message) {
-    int lineLength = 80;
-
-    int messageLength = message.length();
-    int linesNeeded = (int) messageLength / lineLength + 1;
-
-    for (int i = 0; i < linesNeeded; i++) {
-        std::string paddedText;
-        if (i == (linesNeeded - 1)) {
-            int remaining = messageLength - i * lineLength;
-            paddedText = padText(message.substr(i * lineLength, remaining), lineLength);
-        } else {
-            paddedText = padText(message.substr(i * lineLength, lineLength), lineLength);
-        }
-        print(paddedText);
-    }
+    Logger::instance().write(LOG_LEVEL_INFO, LOG_STYLE_CENTERED, "{}", 0, message);
 }
 
 void log(const char *message) {
-    // Convert message to std::string
-    std::string text = std::string(message);
-    log(std::string(text));
+    Logger::instance().write(LOG_LEVEL_INFO, LOG_STYLE_CENTERED, "{}", 0, message);
 }
 
 void logTitle(std::string message) {
-    std::string newText = std::move(message);
-    int n = 10;
-    newText.insert(newText.begin(), 1, ' ');
-    newText.insert(newText.begin(), 1, '[');
-    newText.insert(newText.begin(), n, '=');
-    newText.insert(newText.end(), 1, ' ');
-    newText.insert(newText.end(), 1, ']');
-    newText.insert(newText.end(), n, '=');
-    log(newText);
+    Logger::instance().write(LOG_LEVEL_INFO, LOG_STYLE_TITLE, "{}", 0, message);
 }
 
 void logTitle(const char *message) {
-    std::string text = std::string(message);
-    logTitle(std::string(text));
+    Logger::instance().write(LOG_LEVEL_INFO, LOG_STYLE_TITLE, "{}", 0, message);
 }
 
 
@@ -1,14 +1,44 @@
 #include "renderer/shader_manager.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
 
-VkShaderModule ShaderManager::createShaderModule(const std::string &filePath, VkDevice device) {
+DirStackFileIncluder::IncludeResult *DependencyIncluder::includeLocal(const char *headerName, const char *includerName, size_t inclusionDepth) {
+    return record(DirStackFileIncluder::includeLocal(headerName, includerName, inclusionDepth));
+}
 
-    // TODO: Best put this into a constructor for shaderManager
-    if (!glslangInitialized) {
-        glslang::InitializeProcess();
-        glslangInitialized = true;
+DirStackFileIncluder::IncludeResult *DependencyIncluder::includeSystem(const char *headerName, const char *includerName, size_t inclusionDepth) {
+    return record(DirStackFileIncluder::includeSystem(headerName, includerName, inclusionDepth));
+}
+
+DirStackFileIncluder::IncludeResult *DependencyIncluder::record(IncludeResult *result) {
+    if (result) {
+        includedFiles.push_back(ShaderManager::normalizePath(result->headerName));
     }
+    return result;
+}
+
+ShaderManager &ShaderManager::instance() {
+    static ShaderManager shaderManager;
+    return shaderManager;
+}
+
+ShaderManager::ShaderManager() {
+    // Make sure the JobSystem outlives the shader manager, compilations might still be queued on it
+    JobSystem::instance();
+    glslang::InitializeProcess();
+}
 
+ShaderManager::~ShaderManager() {
+    // Precompiled shaders that were never used may still be compiling
+    for (auto &precompiled : precompiledShaders) {
+        JobSystem::instance().wait(precompiled.second->compilation);
+    }
+    glslang::FinalizeProcess();
+}
+
+std::vector<uint32_t> ShaderManager::compileToSpirv(const std::string &filePath) {
     // Load glsl source into a string:
     std::string shaderString = readShaderFile((filePath));
     const char *shaderSource = shaderString.c_str();
@@ -41,8 +71,9 @@ VkShaderModule ShaderManager::createShaderModule(const std::string &filePath, Vk
 
     //####################################
     // Preprocess:
-    DirStackFileIncluder fileIncluder;
-    fileIncluder.pushExternalLocalDirectory(filePath);
+    DependencyIncluder fileIncluder;
+    // Includes are resolved relative to the directory of the shader
+    fileIncluder.pushExternalLocalDirectory(std::filesystem::path(filePath).parent_path().string());
 
     std::string preprocessedGLSL;
 
@@ -50,7 +81,31 @@ VkShaderModule ShaderManager::createShaderModule(const std::string &filePath, Vk
         log("GLSL Preprocessing Failed for: " + filePath);
         print(shader.getInfoLog());
         print(shader.getInfoDebugLog());
+        throw std::runtime_error("failed to preprocess shader: " + filePath);
+    }
+
+    // Remember what was included, so that a change in any of those files triggers a recompilation
+    {
+        std::lock_guard<std::mutex> lock(dependenciesMutex);
+        dependencies[normalizePath(filePath)] = fileIncluder.getIncludedFiles();
+    }
+
+    //####################################
+    // Cache:
+    // The preprocessed source already contains all the includes, so if it didn't change neither did the binary nor
+    // its interface. Parsing, linking, reflection, code generation and optimization are skipped
+    std::string cachePath = getCachePath(filePath);
+    uint64_t cacheKey = getCacheKey(filePath, preprocessedGLSL);
+    {
+        ShaderReflection cachedReflection;
+        std::vector<uint32_t> cachedSPIR_V;
+        if (readCache(cachePath, cacheKey, cachedReflection, cachedSPIR_V)) {
+            std::lock_guard<std::mutex> lock(dependenciesMutex);
+            reflections[normalizePath(filePath)] = cachedReflection;
+            return cachedSPIR_V;
+        }
     }
+
     // Store the preprocessed string into the shader and overwrite the previous one
     const char *preprocessedCStr = preprocessedGLSL.c_str();
     shader.setStrings(&preprocessedCStr, 1);
@@ -62,6 +117,7 @@ VkShaderModule ShaderManager::createShaderModule(const std::string &filePath, Vk
         log("GLSL Parsing Failed for: " + filePath);
         print(shader.getInfoLog());
         print(shader.getInfoDebugLog());
+        throw std::runtime_error("failed to parse shader: " + filePath);
     }
 
     // Then, add the parsed shader to a glslang::TProgram and link the program:
@@ -70,30 +126,497 @@ VkShaderModule ShaderManager::createShaderModule(const std::string &filePath, Vk
 
     if (!program.link(messages)) {
         log("GLSL Linking Failed for: " + filePath);
-        print(shader.getInfoLog());
-        print(shader.getInfoDebugLog());
+        print(program.getInfoLog());
+        print(program.getInfoDebugLog());
+        throw std::runtime_error("failed to link shader: " + filePath);
+    }
+
+    // Pipeline layouts are generated from the interface
+    ShaderReflection reflection = reflect(program, shaderType);
+    {
+        std::lock_guard<std::mutex> lock(dependenciesMutex);
+        reflections[normalizePath(filePath)] = reflection;
     }
+
     // If no errors occurred: return the SpirV:
-    std::vector<unsigned int> shaderSPIR_V;
+    std::vector<uint32_t> shaderSPIR_V;
     spv::SpvBuildLogger logger;
     glslang::SpvOptions spvOptions;
+    // Line information is only useful for debugging tools, and it's stripped again in release anyway
+    spvOptions.generateDebugInfo = !stripDebugInfo;
+    // Optimization is done explicitly below, so that it can be measured
+    spvOptions.disableOptimizer = true;
     glslang::GlslangToSpv(*program.getIntermediate(shaderType), shaderSPIR_V, &logger, &spvOptions);
 
+    //####################################
+    // Optimize and persist:
+    shaderSPIR_V = optimizeSpirv(filePath, std::move(shaderSPIR_V));
+    writeCache(cachePath, cacheKey, reflection, shaderSPIR_V);
+
+    return shaderSPIR_V;
+}
+
+VkShaderModule ShaderManager::createShaderModule(const std::string &filePath, VkDevice device) {
+    std::vector<uint32_t> spirv;
+    if (!takePrecompiled(filePath, spirv)) {
+        spirv = compileToSpirv(filePath);
+    }
+    VkShaderModule shaderModule = createShaderModule(spirv, device);
+
+    log("Shader Loaded: " + filePath);
+
+    return shaderModule;
+}
 
+VkShaderModule ShaderManager::createShaderModule(const std::vector<uint32_t> &spirv, VkDevice device) {
     // need to wrap the code in a VkShaderModule before passing it to the pipeline.
     VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
     shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderModuleCreateInfo.codeSize = shaderSPIR_V.size() * sizeof(unsigned int);
-    shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(shaderSPIR_V.data());
+    shaderModuleCreateInfo.codeSize = spirv.size() * sizeof(uint32_t);
+    shaderModuleCreateInfo.pCode = spirv.data();
 
     VkShaderModule shaderModule = {};
     VK_CHECK(vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule), "Shader Module Creation");
 
-    log("Shader Loaded: " + filePath);
-
     return shaderModule;
 }
 
+std::future<VkShaderModule> ShaderManager::createShaderModuleAsync(const std::string &filePath, VkDevice device) {
+    // Jobs need to be copyable, so the promise is shared with the job
+    auto promise = std::make_shared<std::promise<VkShaderModule>>();
+    std::future<VkShaderModule> future = promise->get_future();
+
+    JobSystem::instance().run([this, promise, filePath, device]() {
+        try {
+            promise->set_value(createShaderModule(filePath, device));
+        } catch (...) {
+            // Rethrown by future.get() on the thread that needs the module
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
+
+std::vector<std::future<VkShaderModule>> ShaderManager::createShaderModules(const std::vector<std::string> &filePaths, VkDevice device) {
+    std::vector<std::future<VkShaderModule>> futures;
+    futures.reserve(filePaths.size());
+    for (const std::string &filePath : filePaths) {
+        futures.push_back(createShaderModuleAsync(filePath, device));
+    }
+    return futures;
+}
+
+void ShaderManager::precompile(const std::vector<std::string> &filePaths) {
+    std::lock_guard<std::mutex> lock(precompiledMutex);
+    for (const std::string &filePath : filePaths) {
+        std::string normalizedPath = normalizePath(filePath);
+        if (precompiledShaders.find(normalizedPath) != precompiledShaders.end()) {
+            continue;
+        }
+        // Owned by the map until taken, the taker waits for the job before destroying it
+        precompiledShaders[normalizedPath] = std::make_unique<PrecompiledShader>();
+        PrecompiledShader *precompiled = precompiledShaders[normalizedPath].get();
+        JobSystem::instance().run([this, precompiled, normalizedPath]() {
+            try {
+                precompiled->spirv = compileToSpirv(normalizedPath);
+            } catch (...) {
+                precompiled->error = std::current_exception();
+            }
+        }, &precompiled->compilation);
+    }
+}
+
+bool ShaderManager::takePrecompiled(const std::string &filePath, std::vector<uint32_t> &spirv) {
+    std::unique_ptr<PrecompiledShader> precompiled;
+    {
+        std::lock_guard<std::mutex> lock(precompiledMutex);
+        auto found = precompiledShaders.find(normalizePath(filePath));
+        if (found == precompiledShaders.end()) {
+            return false;
+        }
+        precompiled = std::move(found->second);
+        precompiledShaders.erase(found);
+    }
+    // May be called from a job: a blocking wait could starve the workers of the compilation it waits for
+    JobSystem::instance().wait(precompiled->compilation);
+    if (precompiled->error) {
+        std::rethrow_exception(precompiled->error);
+    }
+    spirv = std::move(precompiled->spirv);
+    return true;
+}
+
+std::vector<std::string> ShaderManager::getDependencies(const std::string &filePath) {
+    std::lock_guard<std::mutex> lock(dependenciesMutex);
+    auto found = dependencies.find(normalizePath(filePath));
+    if (found == dependencies.end()) {
+        return {};
+    }
+    return found->second;
+}
+
+ShaderReflection ShaderManager::getReflection(const std::string &filePath) {
+    std::lock_guard<std::mutex> lock(dependenciesMutex);
+    auto found = reflections.find(normalizePath(filePath));
+    if (found == reflections.end()) {
+        throw std::runtime_error("Shader not compiled, no reflection: " + filePath);
+    }
+    return found->second;
+}
+
+VkPushConstantRange ShaderManager::getPushConstantRange(const std::vector<std::string> &filePaths) {
+    VkPushConstantRange range = {};
+    for (const std::string &filePath : filePaths) {
+        ShaderReflection reflection = getReflection(filePath);
+        if (reflection.pushConstantSize > 0) {
+            range.stageFlags |= reflection.stage;
+            range.size = std::max(range.size, reflection.pushConstantSize);
+        }
+    }
+    return range;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> ShaderManager::getSetLayoutBindings(const std::vector<std::string> &filePaths,
+                                                                              uint32_t set) {
+    std::map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+    for (const std::string &filePath : filePaths) {
+        ShaderReflection reflection = getReflection(filePath);
+        for (const ShaderBinding &shaderBinding : reflection.bindings) {
+            if (shaderBinding.set != set) {
+                continue;
+            }
+            std::string location = "set " + std::to_string(set) + ", binding " + std::to_string(shaderBinding.binding) +
+                                   " of " + filePath;
+            if (shaderBinding.count == 0) {
+                throw std::runtime_error("Runtime sized array at " + location + ", its layout must be provided");
+            }
+            auto found = bindings.find(shaderBinding.binding);
+            if (found == bindings.end()) {
+                VkDescriptorSetLayoutBinding binding = {};
+                binding.binding = shaderBinding.binding;
+                binding.descriptorType = shaderBinding.type;
+                binding.descriptorCount = shaderBinding.count;
+                binding.stageFlags = reflection.stage;
+                bindings[shaderBinding.binding] = binding;
+                continue;
+            }
+            // Shared by several stages or shaders, which must declare the same descriptor
+            if (found->second.descriptorType != shaderBinding.type) {
+                throw std::runtime_error("Descriptor type mismatch at " + location);
+            }
+            found->second.descriptorCount = std::max(found->second.descriptorCount, shaderBinding.count);
+            found->second.stageFlags |= reflection.stage;
+        }
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> sortedBindings;
+    for (const auto &binding : bindings) {
+        sortedBindings.push_back(binding.second);
+    }
+    return sortedBindings;
+}
+
+ShaderReflection ShaderManager::reflect(glslang::TProgram &program, EShLanguage shaderType) {
+    ShaderReflection reflection;
+    reflection.stage = static_cast<VkShaderStageFlagBits>(getVulkanStage(shaderType));
+
+    program.buildReflection();
+    // Push constant blocks are listed with the uniform blocks
+    for (int index = 0; index < program.getNumUniformBlocks(); ++index) {
+        const glslang::TObjectReflection &block = program.getUniformBlock(index);
+        if (block.getType() && block.getType()->getQualifier().isPushConstant()) {
+            reflection.pushConstantSize = std::max(reflection.pushConstantSize, static_cast<uint32_t>(block.size));
+        } else {
+            addBinding(reflection, block, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+        }
+    }
+    for (int index = 0; index < program.getNumBufferBlocks(); ++index) {
+        addBinding(reflection, program.getBufferBlock(index), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    }
+    // Opaque uniforms, the other ones are members of the blocks above
+    for (int index = 0; index < program.getNumUniformVariables(); ++index) {
+        const glslang::TObjectReflection &uniform = program.getUniform(index);
+        const glslang::TType *type = uniform.getType();
+        if (!type || type->getBasicType() != glslang::EbtSampler) {
+            continue;
+        }
+        const glslang::TSampler &sampler = type->getSampler();
+        if (sampler.isImage()) {
+            addBinding(reflection, uniform, sampler.dim == glslang::EsdBuffer ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER :
+                                            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        } else if (sampler.isPureSampler()) {
+            addBinding(reflection, uniform, VK_DESCRIPTOR_TYPE_SAMPLER);
+        } else if (sampler.dim == glslang::EsdBuffer) {
+            addBinding(reflection, uniform, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+        } else if (sampler.isCombined()) {
+            addBinding(reflection, uniform, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        } else {
+            addBinding(reflection, uniform, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+        }
+    }
+
+    if (shaderType == EShLangVertex) {
+        for (int index = 0; index < program.getNumPipeInputs(); ++index) {
+            const glslang::TType *type = program.getPipeInput(index).getType();
+            // gl_VertexIndex, gl_InstanceIndex, ... aren't fed by vertex buffers
+            if (!type || type->isBuiltIn()) {
+                continue;
+            }
+            if (!type->getQualifier().hasLocation()) {
+                throw std::runtime_error("Vertex input without location: " + program.getPipeInput(index).name);
+            }
+            reflection.inputs.push_back({type->getQualifier().layoutLocation, getInputFormat(*type)});
+        }
+        std::sort(reflection.inputs.begin(), reflection.inputs.end(),
+                  [](const ShaderInput &a, const ShaderInput &b) { return a.location < b.location; });
+    }
+    return reflection;
+}
+
+void ShaderManager::addBinding(ShaderReflection &reflection, const glslang::TObjectReflection &object,
+                               VkDescriptorType type) {
+    const glslang::TType *objectType = object.getType();
+    if (!objectType) {
+        return;
+    }
+    const glslang::TQualifier &qualifier = objectType->getQualifier();
+    ShaderBinding binding = {};
+    binding.set = qualifier.hasSet() ? qualifier.layoutSet : 0;
+    binding.binding = qualifier.hasBinding() ? qualifier.layoutBinding : 0;
+    binding.type = type;
+    binding.count = objectType->isUnsizedArray() ? 0 :
+                    objectType->isArray() ? static_cast<uint32_t>(objectType->getOuterArraySize()) : 1;
+
+    // Arrays of blocks may be listed once per element
+    for (ShaderBinding &existing : reflection.bindings) {
+        if (existing.set == binding.set && existing.binding == binding.binding) {
+            existing.count = existing.count == 0 || binding.count == 0 ? 0 : std::max(existing.count, binding.count);
+            return;
+        }
+    }
+    reflection.bindings.push_back(binding);
+}
+
+VkFormat ShaderManager::getInputFormat(const glslang::TType &type) {
+    static const VkFormat floatFormats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+                                            VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+    static const VkFormat intFormats[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+                                          VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+    static const VkFormat uintFormats[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+                                           VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+    int componentCount = type.getVectorSize();
+    if (type.isMatrix() || type.isArray() || componentCount < 1 || componentCount > 4) {
+        throw std::runtime_error("Unsupported vertex input type: " + std::string(type.getCompleteString().c_str()));
+    }
+    switch (type.getBasicType()) {
+        case glslang::EbtFloat:
+            return floatFormats[componentCount - 1];
+        case glslang::EbtInt:
+            return intFormats[componentCount - 1];
+        case glslang::EbtUint:
+            return uintFormats[componentCount - 1];
+        default:
+            throw std::runtime_error("Unsupported vertex input type: " + std::string(type.getCompleteString().c_str()));
+    }
+}
+
+std::string ShaderManager::normalizePath(const std::string &path) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if (error) {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+    return canonical.generic_string();
+}
+
+void ShaderManager::setOptimization(ShaderOptimization shaderOptimization, bool isStrippingDebugInfo) {
+    optimization = shaderOptimization;
+    stripDebugInfo = isStrippingDebugInfo;
+}
+
+std::vector<uint32_t> ShaderManager::optimizeSpirv(const std::string &filePath, std::vector<uint32_t> spirv) const {
+    if (optimization == NO_OPTIMIZATION && !stripDebugInfo) {
+        return spirv;
+    }
+    size_t instructionsBefore = countInstructions(spirv);
+    size_t bytesBefore = spirv.size() * sizeof(uint32_t);
+
+#ifdef ASTERISM_SPIRV_OPTIMIZER
+    if (optimization != NO_OPTIMIZATION) {
+        spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_1);
+        optimizer.SetMessageConsumer([&filePath](spv_message_level_t level, const char *, const spv_position_t &, const char *message) {
+            if (level <= SPV_MSG_ERROR) {
+                log("SPIR-V optimizer error in " + filePath + ": " + message);
+            }
+        });
+        if (optimization == SIZE_OPTIMIZATION) {
+            optimizer.RegisterSizePasses();
+        } else {
+            optimizer.RegisterPerformancePasses();
+        }
+
+        std::vector<uint32_t> optimized;
+        if (optimizer.Run(spirv.data(), spirv.size(), &optimized)) {
+            spirv = std::move(optimized);
+        } else {
+            // The unoptimized binary is still valid
+            log("SPIR-V optimization failed, using the unoptimized binary: " + filePath);
+        }
+    }
+#else
+    if (optimization != NO_OPTIMIZATION) {
+        log("SPIR-V optimizer not available (SPIRV-Tools not found), only stripping debug info");
+    }
+#endif
+
+    if (stripDebugInfo) {
+        spirv = removeDebugInstructions(spirv);
+    }
+
+    log("Shader " + std::filesystem::path(filePath).filename().string() + ": " +
+        std::to_string(instructionsBefore) + " -> " + std::to_string(countInstructions(spirv)) + " instructions, " +
+        std::to_string(bytesBefore) + " -> " + std::to_string(spirv.size() * sizeof(uint32_t)) + " bytes");
+    return spirv;
+}
+
+size_t ShaderManager::countInstructions(const std::vector<uint32_t> &spirv) {
+    // The first 5 words are the header, then every instruction stores its length in words in the upper 16 bits
+    size_t count = 0;
+    size_t word = 5;
+    while (word < spirv.size()) {
+        uint32_t wordCount = spirv[word] >> 16u;
+        if (wordCount == 0) {
+            break;
+        }
+        word += wordCount;
+        count++;
+    }
+    return count;
+}
+
+std::vector<uint32_t> ShaderManager::removeDebugInstructions(const std::vector<uint32_t> &spirv) {
+    if (spirv.size() < 5) {
+        return spirv;
+    }
+    std::vector<uint32_t> stripped(spirv.begin(), spirv.begin() + 5);
+    stripped.reserve(spirv.size());
+
+    size_t word = 5;
+    while (word < spirv.size()) {
+        uint32_t wordCount = spirv[word] >> 16u;
+        uint32_t opcode = spirv[word] & 0xFFFFu;
+        if (wordCount == 0 || word + wordCount > spirv.size()) {
+            // Malformed, don't touch it
+            return spirv;
+        }
+        // OpSourceContinued, OpSource, OpSourceExtension, OpName, OpMemberName, OpString, OpLine, OpNoLine, OpModuleProcessed
+        bool isDebugInstruction = opcode == 2 || opcode == 3 || opcode == 4 || opcode == 5 || opcode == 6 ||
+                                  opcode == 7 || opcode == 8 || opcode == 317 || opcode == 330;
+        if (!isDebugInstruction) {
+            stripped.insert(stripped.end(), spirv.begin() + word, spirv.begin() + word + wordCount);
+        }
+        word += wordCount;
+    }
+    return stripped;
+}
+
+uint64_t ShaderManager::hashBytes(const std::string &bytes, uint64_t hash) {
+    for (unsigned char byte : bytes) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string ShaderManager::getCachePath(const std::string &filePath) {
+    // Shaders with the same name in different directories don't share a file
+    char pathHash[17];
+    snprintf(pathHash, sizeof(pathHash), "%016llx", static_cast<unsigned long long>(hashBytes(normalizePath(filePath))));
+
+    std::filesystem::path path(filePath);
+    return std::string(SHADER_CACHE_DIR) + "/" + path.stem().string() + "." + getSuffix(filePath) + "." + pathHash + ".cache";
+}
+
+uint64_t ShaderManager::getCacheKey(const std::string &filePath, const std::string &preprocessedGLSL) const {
+    uint64_t hash = hashBytes(preprocessedGLSL);
+    hash = hashBytes(getSuffix(filePath), hash);
+    return hashBytes(std::to_string(optimization) + "/" + std::to_string(stripDebugInfo) + "/" + std::to_string(shaderCacheVersion), hash);
+}
+
+// Cache file layout, in 32 bit words: key (2 words), stage, push constant size, binding count, input count, the
+// bindings (set, binding, type, count), the inputs (location, format), then the SPIR-V up to the end of the file
+bool ShaderManager::readCache(const std::string &cachePath, uint64_t key, ShaderReflection &reflection,
+                              std::vector<uint32_t> &spirv) {
+    std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::streamsize size = file.tellg();
+    if (size <= 0 || size % sizeof(uint32_t) != 0) {
+        return false;
+    }
+    file.seekg(0);
+    std::vector<uint32_t> words(size / sizeof(uint32_t));
+    if (!file.read(reinterpret_cast<char *>(words.data()), size) || words.size() < 6 ||
+        (uint64_t(words[1]) << 32u | words[0]) != key) {
+        return false;
+    }
+
+    size_t bindingCount = words[4];
+    size_t inputCount = words[5];
+    size_t spirvOffset = 6 + 4 * bindingCount + 2 * inputCount;
+    if (spirvOffset >= words.size()) {
+        return false;
+    }
+    reflection.stage = static_cast<VkShaderStageFlagBits>(words[2]);
+    reflection.pushConstantSize = words[3];
+    reflection.bindings.resize(bindingCount);
+    for (size_t i = 0; i < bindingCount; ++i) {
+        const uint32_t *binding = &words[6 + 4 * i];
+        reflection.bindings[i] = {binding[0], binding[1], static_cast<VkDescriptorType>(binding[2]), binding[3]};
+    }
+    reflection.inputs.resize(inputCount);
+    for (size_t i = 0; i < inputCount; ++i) {
+        const uint32_t *input = &words[6 + 4 * bindingCount + 2 * i];
+        reflection.inputs[i] = {input[0], static_cast<VkFormat>(input[1])};
+    }
+    spirv.assign(words.begin() + static_cast<std::ptrdiff_t>(spirvOffset), words.end());
+    return true;
+}
+
+void ShaderManager::writeCache(const std::string &cachePath, uint64_t key, const ShaderReflection &reflection,
+                               const std::vector<uint32_t> &spirv) {
+    std::vector<uint32_t> words = {uint32_t(key), uint32_t(key >> 32u), uint32_t(reflection.stage),
+                                   reflection.pushConstantSize, uint32_t(reflection.bindings.size()),
+                                   uint32_t(reflection.inputs.size())};
+    for (const ShaderBinding &binding : reflection.bindings) {
+        words.insert(words.end(), {binding.set, binding.binding, uint32_t(binding.type), binding.count});
+    }
+    for (const ShaderInput &input : reflection.inputs) {
+        words.insert(words.end(), {input.location, uint32_t(input.format)});
+    }
+    words.insert(words.end(), spirv.begin(), spirv.end());
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+
+    // Write to a temporary file first, so that a concurrent reader never sees a half written binary. Renaming replaces
+    // the entry of the previous source, hot reload edits don't pile up stale binaries
+    std::string temporaryPath = cachePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            log("Failed to write shader cache: " + cachePath);
+            return;
+        }
+        file.write(reinterpret_cast<const char *>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(uint32_t)));
+    }
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
+
 std::string ShaderManager::readShaderFile(const std::string &filename) {
     std::ifstream file(filename);
 
@@ -110,6 +633,23 @@ std::string ShaderManager::getSuffix(const std::string &name) {
     return (pos == std::string::npos) ? "" : name.substr(name.rfind('.') + 1);
 }
 
+ShaderType ShaderManager::getVulkanStage(EShLanguage shaderType) {
+    switch (shaderType) {
+        case EShLangVertex:
+            return VERTEX_SHADER;
+        case EShLangTessControl:
+            return TESSELLATION_CONTROL_SHADER;
+        case EShLangTessEvaluation:
+            return TESSELLATION_EVALUATION_SHADER;
+        case EShLangGeometry:
+            return GEOMETRY_SHADER;
+        case EShLangFragment:
+            return FRAGMENT_SHADER;
+        default:
+            return COMPUTE_SHADER;
+    }
+}
+
 EShLanguage ShaderManager::getShaderStage(const std::string &stage) {
     if (stage == "vert") {
         return EShLangVertex;
@@ -0,0 +1,194 @@
+#include "renderer/shader_watcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+ShaderWatcher::ShaderWatcher(const std::string &directory) : directory(ShaderManager::normalizePath(directory)) {
+#ifdef __linux__
+    inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyDescriptor < 0) {
+        log("Shader hot-reload unavailable: inotify could not be initialized");
+        isWatching = false;
+        return;
+    }
+    watchDirectory(this->directory);
+#endif
+    watcherThread = std::thread(&ShaderWatcher::watchLoop, this);
+    log("Watching shaders in " + this->directory);
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    isWatching = false;
+    if (watcherThread.joinable()) {
+        watcherThread.join();
+    }
+    // Recompilations still reference this watcher
+    JobSystem::instance().wait(compilations);
+#ifdef __linux__
+    if (inotifyDescriptor >= 0) {
+        close(inotifyDescriptor);
+    }
+#endif
+}
+
+void ShaderWatcher::track(const std::string &shaderPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    trackedShaders.insert(ShaderManager::normalizePath(shaderPath));
+    updateDependents();
+}
+
+std::vector<ReloadedShader> ShaderWatcher::takeReloadedShaders() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<ReloadedShader> reloaded;
+    reloaded.reserve(reloadedShaders.size());
+    for (auto &shader : reloadedShaders) {
+        reloaded.push_back({shader.first, std::move(shader.second)});
+    }
+    reloadedShaders.clear();
+    return reloaded;
+}
+
+void ShaderWatcher::updateDependents() {
+    dependents.clear();
+    for (const std::string &shader : trackedShaders) {
+        dependents[shader].insert(shader);
+        for (const std::string &dependency : ShaderManager::instance().getDependencies(shader)) {
+            dependents[dependency].insert(shader);
+        }
+    }
+
+#ifdef __linux__
+    // Includes can live outside of the shaders directory
+    for (const auto &dependent : dependents) {
+        watchDirectory(std::filesystem::path(dependent.first).parent_path().generic_string());
+    }
+#else
+    for (const auto &dependent : dependents) {
+        if (modificationTimes.find(dependent.first) == modificationTimes.end()) {
+            std::error_code error;
+            modificationTimes[dependent.first] = std::filesystem::last_write_time(dependent.first, error);
+        }
+    }
+#endif
+}
+
+void ShaderWatcher::onFilesChanged(const std::set<std::string> &changedFiles) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::string &file : changedFiles) {
+        auto found = dependents.find(file);
+        if (found == dependents.end()) {
+            continue;
+        }
+        for (const std::string &shader : found->second) {
+            if (compilingShaders.count(shader)) {
+                // Picked up again as soon as the running compilation is done
+                outdatedShaders.insert(shader);
+                continue;
+            }
+            compilingShaders.insert(shader);
+            JobSystem::instance().run([this, shader]() { recompile(shader); }, &compilations);
+        }
+    }
+}
+
+void ShaderWatcher::recompile(const std::string &shaderPath) {
+    std::vector<uint32_t> spirv;
+    bool isCompiled = false;
+    try {
+        spirv = ShaderManager::instance().compileToSpirv(shaderPath);
+        isCompiled = true;
+    } catch (const std::exception &e) {
+        log("Shader reload failed, keeping the previous version: " + std::string(e.what()));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (isCompiled) {
+        reloadedShaders[shaderPath] = std::move(spirv);
+        log("Shader Reloaded: " + shaderPath);
+    }
+    // The includes might have changed
+    updateDependents();
+
+    if (outdatedShaders.erase(shaderPath) && isWatching) {
+        JobSystem::instance().run([this, shaderPath]() { recompile(shaderPath); }, &compilations);
+    } else {
+        compilingShaders.erase(shaderPath);
+    }
+}
+
+#ifdef __linux__
+
+void ShaderWatcher::watchDirectory(const std::string &path) {
+    for (const auto &watched : watchedDirectories) {
+        if (watched.second == path) {
+            return;
+        }
+    }
+    // Editors either write files in place or write a temporary file and move it over the original
+    int watchDescriptor = inotify_add_watch(inotifyDescriptor, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watchDescriptor < 0) {
+        log("Failed to watch shader directory: " + path);
+        return;
+    }
+    watchedDirectories[watchDescriptor] = path;
+}
+
+void ShaderWatcher::watchLoop() {
+    alignas(inotify_event) char buffer[4096];
+
+    while (isWatching) {
+        // Wake up regularly to notice when the watcher is destroyed
+        pollfd pollDescriptor = {inotifyDescriptor, POLLIN, 0};
+        if (poll(&pollDescriptor, 1, 100) <= 0) {
+            continue;
+        }
+        // A single save often produces a burst of events, give it a moment to settle and handle them all at once
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::set<std::string> changedFiles;
+        ssize_t length;
+        while ((length = read(inotifyDescriptor, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (char *pointer = buffer; pointer < buffer + length;) {
+                auto *event = reinterpret_cast<inotify_event *>(pointer);
+                auto watched = watchedDirectories.find(event->wd);
+                if (event->len > 0 && watched != watchedDirectories.end()) {
+                    changedFiles.insert(ShaderManager::normalizePath(watched->second + "/" + event->name));
+                }
+                pointer += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (!changedFiles.empty()) {
+            onFilesChanged(changedFiles);
+        }
+    }
+}
+
+#else
+
+void ShaderWatcher::watchLoop() {
+    while (isWatching) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+        std::set<std::string> changedFiles;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &file : modificationTimes) {
+                std::error_code error;
+                std::filesystem::file_time_type modificationTime = std::filesystem::last_write_time(file.first, error);
+                if (!error && modificationTime != file.second) {
+                    file.second = modificationTime;
+                    changedFiles.insert(file.first);
+                }
+            }
+        }
+        if (!changedFiles.empty()) {
+            onFilesChanged(changedFiles);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,526 @@
+#include "renderer/shadow_maps.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ShadowMaps::initialize(VkDevice vkDevice, VkPhysicalDevice physicalDevice, MemoryBudget &budget,
+                            PipelineManager &pipelines, BindlessDescriptors &bindless,
+                            const LightingSettings &lightingSettings) {
+    device = vkDevice;
+    memoryBudget = &budget;
+    pipelineManager = &pipelines;
+    settings = lightingSettings.shadows;
+    lightCapacity = lightingSettings.capacity;
+    if (lightCapacity == 0 || settings.resolution == 0) {
+        return;
+    }
+    cascadeCount = settings.getCascadeCount();
+    spotLightCapacity = settings.getSpotLightCapacity();
+    layerCount = cascadeCount + spotLightCapacity;
+    if (layerCount == 0) {
+        return;
+    }
+
+    //###################################################
+    // Images:
+    bool isFilterable = false;
+    format = findFormat(physicalDevice, isFilterable);
+    cache = createImage(VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    shadows = createImage(VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                          VK_IMAGE_USAGE_SAMPLED_BIT);
+    shadowArrayView = createView(shadows.image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, layerCount);
+
+    // Comparisons are done by the sampler: with linear filtering, 4 of them are blended (2x2 percentage closer
+    // filtering). Outside of the map, the border is lit
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = isFilterable ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    samplerInfo.minFilter = samplerInfo.magFilter;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.maxLod = 0.0f;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &sampler), "Shadow Sampler Creation");
+    bindlessShadows = bindless.addTexture(shadowArrayView, sampler);
+
+    //###################################################
+    // Passes:
+    clearRenderPass = createRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR);
+    loadRenderPass = createRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD);
+    layers.resize(layerCount);
+    for (uint32_t i = 0; i < layerCount; ++i) {
+        Layer &layer = layers[i];
+        layer = {};
+        layer.cacheView = createView(cache.image, VK_IMAGE_VIEW_TYPE_2D, i, 1);
+        layer.shadowView = createView(shadows.image, VK_IMAGE_VIEW_TYPE_2D, i, 1);
+        layer.cacheFramebuffer = createFramebuffer(clearRenderPass, layer.cacheView);
+        layer.shadowFramebuffer = createFramebuffer(loadRenderPass, layer.shadowView);
+    }
+
+    // Casters are two-sided, the depth bias keeps them from shadowing themselves
+    pipelineManager->loadShaders({getShaderPath()});
+    pipelineLayout = pipelineManager->getPipelineLayout({getShaderPath()});
+    pipelineKey.vertexShaderPath = getShaderPath();
+    pipelineKey.cullMode = VK_CULL_MODE_NONE;
+    pipelineKey.isDepthTested = true;
+    pipelineKey.isDepthWritten = true;
+    pipelineKey.hasDepthBias = true;
+    pipelineKey.pipelineLayout = pipelineLayout;
+    pipelineKey.renderPass = clearRenderPass;
+    pipelineManager->getPipeline(pipelineKey);
+
+    log("Shadow maps: " + std::to_string(cascadeCount) + " cascades and " + std::to_string(spotLightCapacity) +
+        " spot lights, " + std::to_string(settings.resolution) + "x" + std::to_string(settings.resolution) + " texels");
+}
+
+std::string ShadowMaps::getShaderPath() {
+    return std::string(SOURCE_DIR).append("/shaders/lighting/shadow.vert");
+}
+
+void ShadowMaps::setMesh(VkBuffer meshVertexBuffer, VkBuffer meshIndexBuffer, uint32_t meshIndexCount) {
+    vertexBuffer = meshVertexBuffer;
+    indexBuffer = meshIndexBuffer;
+    indexCount = meshIndexCount;
+}
+
+VkFormat ShadowMaps::findFormat(VkPhysicalDevice physicalDevice, bool &isFilterable) {
+    // Without stencil, so that the depth can be copied and sampled as a whole
+    for (VkFormat candidate : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, candidate, &properties);
+        VkFormatFeatureFlags features = properties.optimalTilingFeatures;
+        if ((features & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) &&
+            (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+            isFilterable = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+            return candidate;
+        }
+    }
+    throw std::runtime_error("No supported shadow map format");
+}
+
+ShadowMaps::Image ShadowMaps::createImage(VkImageUsageFlags usage) {
+    Image image;
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = {settings.resolution, settings.resolution, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = layerCount;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &image.image), "Shadow Map Creation");
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image.image, &memoryRequirements);
+    image.memory = memoryBudget->allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                          RENDER_TARGET_MEMORY);
+    VK_CHECK(vkBindImageMemory(device, image.image, image.memory, 0), "Shadow Map Binding");
+    return image;
+}
+
+VkImageView ShadowMaps::createView(VkImage image, VkImageViewType type, uint32_t firstLayer, uint32_t count) {
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = type;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, firstLayer, count};
+    VkImageView view = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view), "Shadow Map View Creation");
+    return view;
+}
+
+VkRenderPass ShadowMaps::createRenderPass(VkAttachmentLoadOp loadOp) {
+    // Layouts are handled by the barriers of record(), the attachment stays in its layout
+    VkAttachmentDescription attachment = {};
+    attachment.format = format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = loadOp;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthReference = {0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depthReference;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &attachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass), "Shadow Render Pass Creation");
+    return renderPass;
+}
+
+VkFramebuffer ShadowMaps::createFramebuffer(VkRenderPass renderPass, VkImageView view) {
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &view;
+    framebufferInfo.width = settings.resolution;
+    framebufferInfo.height = settings.resolution;
+    framebufferInfo.layers = 1;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer), "Shadow Framebuffer Creation");
+    return framebuffer;
+}
+
+void ShadowMaps::updateCasters(const std::vector<MeshInstance> &instances) {
+    // Compared in place, the storage is reused once the amount of casters is stable
+    bool isChanged = false;
+    size_t staticCount = 0;
+    dynamicCasters.clear();
+    for (const MeshInstance &instance : instances) {
+        if (!instance.castsShadows) {
+            continue;
+        }
+        if (!instance.isStatic) {
+            dynamicCasters.push_back(instance.model);
+        } else if (staticCount < staticCasters.size()) {
+            if (staticCasters[staticCount] != instance.model) {
+                staticCasters[staticCount] = instance.model;
+                isChanged = true;
+            }
+            staticCount++;
+        } else {
+            staticCasters.push_back(instance.model);
+            staticCount++;
+            isChanged = true;
+        }
+    }
+    if (staticCount != staticCasters.size()) {
+        staticCasters.resize(staticCount);
+        isChanged = true;
+    }
+    if (isChanged) {
+        staticVersion++;
+    }
+}
+
+// glm produces depths in [-1, 1], Vulkan expects them in [0, 1]
+static glm::mat4 remapDepth(const glm::mat4 &projection) {
+    glm::mat4 remap(1.0f);
+    remap[2][2] = 0.5f;
+    remap[3][2] = 0.5f;
+    return remap * projection;
+}
+
+static glm::vec3 getUpVector(const glm::vec3 &direction) {
+    return std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+glm::mat4 ShadowMaps::fitCascade(const Camera &camera, const glm::vec3 &direction, float nearDepth,
+                                 float farDepth) const {
+    // Corners of the slice, from the projection of the camera
+    const glm::mat4 &projection = camera.getProjection();
+    glm::mat4 inverseView = glm::inverse(camera.getView());
+    glm::vec3 corners[8];
+    glm::vec3 center(0.0f);
+    for (uint32_t i = 0; i < 8; ++i) {
+        float depth = i < 4 ? nearDepth : farDepth;
+        glm::vec2 ndc((i & 1u) ? 1.0f : -1.0f, (i & 2u) ? 1.0f : -1.0f);
+        glm::vec4 viewCorner(ndc.x * depth / projection[0][0], ndc.y * depth / projection[1][1], -depth, 1.0f);
+        corners[i] = glm::vec3(inverseView * viewCorner);
+        center += corners[i] / 8.0f;
+    }
+    // A sphere doesn't change size when the camera turns, rounded so that the float error doesn't either
+    float radius = 0.0f;
+    for (const glm::vec3 &corner : corners) {
+        radius = std::max(radius, glm::length(corner - center));
+    }
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    // Orthographic view around the sphere, moved by whole texels. Casters up to the far plane of the camera in front
+    // of the sphere, towards the light, are included
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, getUpVector(direction));
+    glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+    float texelSize = 2.0f * radius / float(settings.resolution);
+    lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+    lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+    glm::mat4 projectionMatrix = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+                                            lightCenter.y - radius, lightCenter.y + radius,
+                                            -lightCenter.z - radius - camera.getFarPlane(), -lightCenter.z + radius);
+    return remapDepth(projectionMatrix) * lightView;
+}
+
+ShadowUniforms ShadowMaps::update(const FrameState &frameState, const Camera &camera) {
+    updateCasters(frameState.meshInstances);
+    for (Layer &layer : layers) {
+        layer.isActive = false;
+    }
+
+    ShadowUniforms uniforms = {};
+    uniforms.info.x = bindlessShadows;
+
+    // Cascades, split between the near and far planes of the camera: logarithmic splits give every cascade the same
+    // depth ratio, blended with uniform ones so that the first cascades aren't too thin
+    const DirectionalLight &directional = frameState.directionalLight;
+    if (cascadeCount > 0 && directional.intensity > 0.0f && directional.castsShadows) {
+        glm::vec3 direction = glm::normalize(directional.direction);
+        float nearPlane = camera.getNearPlane();
+        float farPlane = camera.getFarPlane();
+        float splitStart = nearPlane;
+        for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade) {
+            float ratio = float(cascade + 1) / float(cascadeCount);
+            float logarithmicSplit = nearPlane * std::pow(farPlane / nearPlane, ratio);
+            float uniformSplit = nearPlane + (farPlane - nearPlane) * ratio;
+            float splitEnd = settings.cascadeSplitLambda * logarithmicSplit +
+                             (1.0f - settings.cascadeSplitLambda) * uniformSplit;
+
+            layers[cascade].lightMatrix = fitCascade(camera, direction, splitStart, splitEnd);
+            layers[cascade].isActive = true;
+            uniforms.cascadeSplits[cascade] = splitEnd;
+            splitStart = splitEnd;
+        }
+        uniforms.info.y = cascadeCount;
+    }
+
+    // Spot lights, in the order of the lights: the same order the clustered lighting assigns their layers in
+    uint32_t spotLight = 0;
+    size_t lightCount = std::min<size_t>(frameState.lights.size(), lightCapacity);
+    for (size_t i = 0; i < lightCount && spotLight < spotLightCapacity; ++i) {
+        const Light &light = frameState.lights[i];
+        if (light.type != SPOT_LIGHT || !light.castsShadows) {
+            continue;
+        }
+        glm::vec3 direction = glm::normalize(light.direction);
+        glm::mat4 lightView = glm::lookAt(light.position, light.position + direction, getUpVector(direction));
+        glm::mat4 projection = glm::perspective(2.0f * light.outerConeAngle, 1.0f, std::max(light.range * 0.01f, 0.01f),
+                                                light.range);
+        Layer &layer = layers[cascadeCount + spotLight];
+        layer.lightMatrix = remapDepth(projection) * lightView;
+        layer.isActive = true;
+        spotLight++;
+    }
+
+    // Shaders go from the view space of the camera
+    glm::mat4 inverseView = glm::inverse(camera.getView());
+    for (uint32_t i = 0; i < layerCount; ++i) {
+        Layer &layer = layers[i];
+        if (!layer.isActive) {
+            layer.needsCachedRender = false;
+            layer.needsComposite = false;
+            continue;
+        }
+        uniforms.matrices[i] = layer.lightMatrix * inverseView;
+        layer.needsCachedRender = !layer.isCached || layer.cachedMatrix != layer.lightMatrix ||
+                                  layer.cachedVersion != staticVersion;
+        layer.needsComposite = layer.needsCachedRender || !layer.isCacheCopied || !dynamicCasters.empty();
+    }
+    return uniforms;
+}
+
+void ShadowMaps::imageBarrier(VkImageMemoryBarrier &barrier, VkImage image, uint32_t layer, VkImageLayout oldLayout,
+                              VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess) const {
+    barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, layer, 1};
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+}
+
+void ShadowMaps::renderCasters(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer,
+                               const glm::mat4 &lightMatrix, const std::vector<glm::mat4> &casters) {
+    VkClearValue clearValue = {};
+    clearValue.depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    beginInfo.renderPass = renderPass;
+    beginInfo.framebuffer = framebuffer;
+    beginInfo.renderArea = {{0, 0}, {settings.resolution, settings.resolution}};
+    beginInfo.clearValueCount = 1;
+    beginInfo.pClearValues = &clearValue;
+    vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    if (!casters.empty()) {
+        VkViewport viewport = {0.0f, 0.0f, float(settings.resolution), float(settings.resolution), 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, {settings.resolution, settings.resolution}};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        vkCmdSetDepthBias(commandBuffer, settings.depthBiasConstant, 0.0f, settings.depthBiasSlope);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineManager->getPipeline(pipelineKey));
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+        for (const glm::mat4 &model : casters) {
+            glm::mat4 modelLightMatrix = lightMatrix * model;
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4),
+                               &modelLightMatrix);
+            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+        }
+    }
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void ShadowMaps::record(VkCommandBuffer commandBuffer) {
+    cachedRenderCount = 0;
+    compositeCount = 0;
+    VkImageMemoryBarrier barriers[2 * MAX_SHADOW_LAYERS];
+
+    // Every layer gets its resting layout once: the cache is a copy source, the array is sampled
+    if (!isInitialized) {
+        uint32_t barrierCount = 0;
+        for (uint32_t i = 0; i < layerCount; ++i) {
+            imageBarrier(barriers[barrierCount++], cache.image, i, VK_IMAGE_LAYOUT_UNDEFINED,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, 0);
+            imageBarrier(barriers[barrierCount++], shadows.image, i, VK_IMAGE_LAYOUT_UNDEFINED,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 0);
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, barrierCount, barriers);
+        isInitialized = true;
+    }
+
+    for (const Layer &layer : layers) {
+        cachedRenderCount += layer.needsCachedRender ? 1 : 0;
+        compositeCount += layer.needsComposite ? 1 : 0;
+    }
+    if (compositeCount == 0) {
+        // Nothing moved: the array still holds the shadows of the previous frame
+        return;
+    }
+
+    //###################################################
+    // 1. Static casters into the outdated layers of the cache
+    if (cachedRenderCount > 0) {
+        uint32_t barrierCount = 0;
+        for (uint32_t i = 0; i < layerCount; ++i) {
+            if (layers[i].needsCachedRender) {
+                // Cleared, the previous content doesn't matter
+                imageBarrier(barriers[barrierCount++], cache.image, i, VK_IMAGE_LAYOUT_UNDEFINED,
+                             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 0,
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+            }
+        }
+        // After the copies of the previous frames
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             0, 0, nullptr, 0, nullptr, barrierCount, barriers);
+        for (Layer &layer : layers) {
+            if (layer.needsCachedRender) {
+                renderCasters(commandBuffer, clearRenderPass, layer.cacheFramebuffer, layer.lightMatrix, staticCasters);
+                layer.isCached = true;
+                layer.cachedMatrix = layer.lightMatrix;
+                layer.cachedVersion = staticVersion;
+            }
+        }
+    }
+
+    //###################################################
+    // 2. Cache into the sampled array
+    uint32_t barrierCount = 0;
+    for (uint32_t i = 0; i < layerCount; ++i) {
+        if (layers[i].needsCachedRender) {
+            imageBarrier(barriers[barrierCount++], cache.image, i, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                         VK_ACCESS_TRANSFER_READ_BIT);
+        }
+        if (layers[i].needsComposite) {
+            // Overwritten, after the fragment shaders of the previous frames are done with it
+            imageBarrier(barriers[barrierCount++], shadows.image, i, VK_IMAGE_LAYOUT_UNDEFINED,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+        }
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, barrierCount, barriers);
+
+    VkImageCopy regions[MAX_SHADOW_LAYERS];
+    uint32_t regionCount = 0;
+    for (uint32_t i = 0; i < layerCount; ++i) {
+        if (layers[i].needsComposite) {
+            VkImageCopy &region = regions[regionCount++];
+            region = {};
+            region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1};
+            region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1};
+            region.extent = {settings.resolution, settings.resolution, 1};
+        }
+    }
+    vkCmdCopyImage(commandBuffer, cache.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   shadows.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions);
+
+    //###################################################
+    // 3. Dynamic casters over the copies
+    bool hasDynamicCasters = !dynamicCasters.empty();
+    if (hasDynamicCasters) {
+        barrierCount = 0;
+        for (uint32_t i = 0; i < layerCount; ++i) {
+            if (layers[i].needsComposite) {
+                imageBarrier(barriers[barrierCount++], shadows.image, i, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+            }
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             0, 0, nullptr, 0, nullptr, barrierCount, barriers);
+        for (const Layer &layer : layers) {
+            if (layer.needsComposite) {
+                renderCasters(commandBuffer, loadRenderPass, layer.shadowFramebuffer, layer.lightMatrix, dynamicCasters);
+            }
+        }
+    }
+
+    //###################################################
+    // 4. Ready to be sampled by the main pass
+    barrierCount = 0;
+    for (uint32_t i = 0; i < layerCount; ++i) {
+        Layer &layer = layers[i];
+        if (layer.needsComposite) {
+            imageBarrier(barriers[barrierCount++], shadows.image, i,
+                         hasDynamicCasters ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                           : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         hasDynamicCasters ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : VK_ACCESS_TRANSFER_WRITE_BIT,
+                         VK_ACCESS_SHADER_READ_BIT);
+            layer.isCacheCopied = !hasDynamicCasters;
+        }
+    }
+    vkCmdPipelineBarrier(commandBuffer, hasDynamicCasters ? VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+                                                          : VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, barrierCount, barriers);
+}
+
+void ShadowMaps::cleanup() {
+    if (layerCount == 0) {
+        return;
+    }
+    // The pipeline and its layout belong to the pipeline manager
+    for (Layer &layer : layers) {
+        vkDestroyFramebuffer(device, layer.cacheFramebuffer, nullptr);
+        vkDestroyFramebuffer(device, layer.shadowFramebuffer, nullptr);
+        vkDestroyImageView(device, layer.cacheView, nullptr);
+        vkDestroyImageView(device, layer.shadowView, nullptr);
+    }
+    layers.clear();
+    vkDestroyRenderPass(device, clearRenderPass, nullptr);
+    vkDestroyRenderPass(device, loadRenderPass, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyImageView(device, shadowArrayView, nullptr);
+    for (Image *image : {&cache, &shadows}) {
+        vkDestroyImage(device, image->image, nullptr);
+        memoryBudget->free(image->memory);
+        *image = Image();
+    }
+    layerCount = 0;
+}
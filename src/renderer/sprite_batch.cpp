@@ -0,0 +1,216 @@
+#include "renderer/sprite_batch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "core/job_system.h"
+
+void SpriteBatch::initialize(VkDevice vkDevice, MemoryBudget &budget, PipelineManager &pipelines,
+                             TextureManager &textures, FrameArena &arena, VkPipelineLayout scenePipelineLayout,
+                             VkRenderPass renderPass, uint32_t spriteCapacity, uint32_t slotCount) {
+    device = vkDevice;
+    frameArena = &arena;
+    pipelineLayout = scenePipelineLayout;
+    pipelineManager = &pipelines;
+    textureManager = &textures;
+    capacity = spriteCapacity;
+    memoryBudget = &budget;
+    if (capacity == 0) {
+        return;
+    }
+
+    //###################################################
+    // Instance buffers:
+    // One per frame slot, written by the CPU every frame and read once by the GPU: host visible memory, persistently
+    // mapped. Device local host visible memory (resizable BAR) is preferred when there is some
+    VkDeviceSize bufferSize = VkDeviceSize(capacity) * sizeof(SpriteInstance);
+    slots.resize(slotCount);
+    for (Slot &slot : slots) {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = bufferSize;
+        bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &slot.instanceBuffer), "Sprite Buffer Creation");
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetBufferMemoryRequirements(device, slot.instanceBuffer, &memoryRequirements);
+        // The device local heap may be missing, or too small for the instances (256 MiB BAR): the budget then falls
+        // back to plain host visible memory
+        slot.instanceMemory = memoryBudget->allocate(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                     BUFFER_MEMORY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_CHECK(vkBindBufferMemory(device, slot.instanceBuffer, slot.instanceMemory, 0), "Sprite Buffer Binding");
+        VK_CHECK(vkMapMemory(device, slot.instanceMemory, 0, bufferSize, 0, &slot.instanceData), "Sprite Buffer Mapping");
+    }
+    instances.reset(new SpriteInstance[capacity]);
+    log("Sprite batch: " + std::to_string(capacity) + " sprites, " +
+        std::to_string(slotCount * bufferSize / (1024 * 1024)) + " MiB of instance buffers");
+
+    //###################################################
+    // Pipelines:
+    // The camera and the texture of the batch are push constants
+    std::vector<std::string> shaderPaths = getShaderPaths();
+    pipelineKey.vertexShaderPath = shaderPaths[0];
+    pipelineKey.fragmentShaderPath = shaderPaths[1];
+    pipelineKey.vertexLayout = SPRITE_INSTANCE_LAYOUT;
+    pipelineKey.cullMode = VK_CULL_MODE_NONE;
+    // Sprites are ordered by submission, not by depth
+    pipelineKey.isDepthTested = false;
+    pipelineKey.isDepthWritten = false;
+    pipelineKey.pipelineLayout = pipelineLayout;
+    pipelineKey.renderPass = renderPass;
+
+    // The blend modes share the same shaders, only the most common one is created upfront
+    pipelineManager->loadShaders(shaderPaths);
+    pipelineKey.blendMode = ALPHA_BLENDING;
+    pipelineManager->getPipeline(pipelineKey);
+}
+
+std::vector<std::string> SpriteBatch::getShaderPaths() {
+    std::string shaderDirectory = std::string(SOURCE_DIR).append("/shaders/sprites/");
+    return {shaderDirectory + "sprite.vert", shaderDirectory + "sprite.frag"};
+}
+
+void SpriteBatch::setRenderPass(VkRenderPass renderPass) {
+    pipelineKey.renderPass = renderPass;
+}
+
+void SpriteBatch::begin(const Camera &camera) {
+    viewProjection = camera.getViewProjection();
+    instanceCount = 0;
+    runs.clear();
+    states.clear();
+}
+
+uint32_t SpriteBatch::findState(uint32_t texture, BlendMode blendMode) {
+    State state = {blendMode, texture};
+    // Consecutive sprites usually share their state
+    if (!runs.empty() && states[runs.back().state] == state) {
+        return runs.back().state;
+    }
+    // Few distinct states per frame, a linear search is the fastest
+    for (uint32_t index = 0; index < states.size(); ++index) {
+        if (states[index] == state) {
+            return index;
+        }
+    }
+    states.push_back(state);
+    return static_cast<uint32_t>(states.size() - 1);
+}
+
+void SpriteBatch::draw(const Sprite &sprite) {
+    uint32_t count = 1;
+    SpriteInstance *instance = allocate(count, sprite.texture, sprite.blendMode);
+    if (count == 1) {
+        *instance = SpriteInstance::fromSprite(sprite);
+    }
+}
+
+SpriteInstance *SpriteBatch::allocate(uint32_t &count, uint32_t texture, BlendMode blendMode) {
+    uint32_t first = instanceCount;
+    count = std::min(count, capacity - first);
+    if (count == 0) {
+        if (capacity > 0) {
+            LOG_EVERY(LOG_LEVEL_WARNING, 1000, "Sprite batch capacity ({}) reached, sprites are dropped", capacity);
+        }
+        return nullptr;
+    }
+
+    uint32_t state = findState(texture, blendMode);
+    if (!runs.empty() && runs.back().state == state) {
+        runs.back().count += count;
+    } else {
+        runs.push_back({state, first, count});
+    }
+    instanceCount = first + count;
+    return instances.get() + first;
+}
+
+void SpriteBatch::upload(uint32_t slot) {
+    uploadedViewProjection = viewProjection;
+    uploadedCount = instanceCount;
+    batches.clear();
+    if (instanceCount == 0) {
+        return;
+    }
+
+    // Counting sort of the runs: count the sprites of each state, then place the states in draw order
+    std::pmr::vector<uint32_t> stateOrder(states.size(), frameArena);
+    for (uint32_t index = 0; index < states.size(); ++index) {
+        stateOrder[index] = index;
+    }
+    std::sort(stateOrder.begin(), stateOrder.end(), [this](uint32_t a, uint32_t b) { return states[a] < states[b]; });
+
+    std::pmr::vector<uint32_t> stateCounts(states.size(), 0, frameArena);
+    for (const Run &run : runs) {
+        stateCounts[run.state] += run.count;
+    }
+    std::pmr::vector<uint32_t> stateOffsets(states.size(), 0, frameArena);
+    uint32_t offset = 0;
+    for (uint32_t state : stateOrder) {
+        if (stateCounts[state] == 0) {
+            continue;
+        }
+        stateOffsets[state] = offset;
+        batches.push_back({states[state], offset, stateCounts[state]});
+        offset += stateCounts[state];
+    }
+
+    // Mapped memory is write-combined: it's only written, sequentially, in big copies
+    auto *destination = static_cast<SpriteInstance *>(slots[slot].instanceData);
+    for (const Run &run : runs) {
+        SpriteInstance *runDestination = destination + stateOffsets[run.state];
+        const SpriteInstance *runSource = instances.get() + run.first;
+        JobSystem::instance().parallelFor(run.count, COPY_GRAIN_SIZE, [=](uint32_t begin, uint32_t end) {
+            memcpy(runDestination + begin, runSource + begin, (end - begin) * sizeof(SpriteInstance));
+        });
+        stateOffsets[run.state] += run.count;
+    }
+
+}
+
+void SpriteBatch::recordDraw(VkCommandBuffer commandBuffer, uint32_t slot) {
+    if (batches.empty()) {
+        return;
+    }
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &slots[slot].instanceBuffer, &offset);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, SCENE_PUSH_CONSTANT_STAGES, offsetof(PushConstants, viewProjection),
+                       sizeof(glm::mat4), &uploadedViewProjection);
+
+    BlendMode boundBlendMode = OPAQUE_BLENDING;
+    bool isPipelineBound = false;
+    for (const Batch &batch : batches) {
+        // States are sorted by blend mode first, so each pipeline is bound once
+        if (!isPipelineBound || batch.state.blendMode != boundBlendMode) {
+            pipelineKey.blendMode = batch.state.blendMode;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineManager->getPipeline(pipelineKey));
+            boundBlendMode = batch.state.blendMode;
+            isPipelineBound = true;
+        }
+        // Textures that are still loading use the white texture's index
+        BindlessIndex textureIndex = textureManager->getBindlessIndex(batch.state.texture);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, SCENE_PUSH_CONSTANT_STAGES,
+                           offsetof(PushConstants, textureIndex), sizeof(BindlessIndex), &textureIndex);
+        // Six vertices per sprite, the corners come from the vertex index
+        vkCmdDraw(commandBuffer, 6, batch.instanceCount, 0, batch.firstInstance);
+    }
+}
+
+void SpriteBatch::cleanup() {
+    if (capacity == 0) {
+        return;
+    }
+    // Pipelines belong to the pipeline manager
+    for (Slot &slot : slots) {
+        vkDestroyBuffer(device, slot.instanceBuffer, nullptr);
+        memoryBudget->free(slot.instanceMemory);
+    }
+    slots.clear();
+    instances.reset();
+    instanceCount = 0;
+    capacity = 0;
+}
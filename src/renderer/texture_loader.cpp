@@ -0,0 +1,383 @@
+#include "renderer/texture_loader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    // DDS layout, see the DirectX documentation of DDS_HEADER and DDS_HEADER_DXT10
+    const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDPF_RGB = 0x40;
+    const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+    struct DDSPixelFormat {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t rBitMask;
+        uint32_t gBitMask;
+        uint32_t bBitMask;
+        uint32_t aBitMask;
+    };
+
+    struct DDSHeader {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DDSPixelFormat pixelFormat;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct DDSHeaderDX10 {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    constexpr uint32_t fourCC(char a, char b, char c, char d) {
+        return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8u) | (uint32_t(uint8_t(c)) << 16u) |
+               (uint32_t(uint8_t(d)) << 24u);
+    }
+
+    VkFormat fromFourCC(uint32_t code) {
+        switch (code) {
+            case fourCC('D', 'X', 'T', '1'): return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case fourCC('D', 'X', 'T', '3'): return VK_FORMAT_BC2_UNORM_BLOCK;
+            case fourCC('D', 'X', 'T', '5'): return VK_FORMAT_BC3_UNORM_BLOCK;
+            case fourCC('A', 'T', 'I', '1'):
+            case fourCC('B', 'C', '4', 'U'): return VK_FORMAT_BC4_UNORM_BLOCK;
+            case fourCC('B', 'C', '4', 'S'): return VK_FORMAT_BC4_SNORM_BLOCK;
+            case fourCC('A', 'T', 'I', '2'):
+            case fourCC('B', 'C', '5', 'U'): return VK_FORMAT_BC5_UNORM_BLOCK;
+            case fourCC('B', 'C', '5', 'S'): return VK_FORMAT_BC5_SNORM_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    VkFormat fromDXGI(uint32_t dxgiFormat) {
+        switch (dxgiFormat) {
+            case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+            case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+            case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+            case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+            case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+            case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+            case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+            case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+            case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+            case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+            case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+            case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+            case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+            case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+            case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+            case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    //###################################################
+    // BC decoding:
+    void decodeColor565(uint16_t color, uint8_t *rgb) {
+        rgb[0] = uint8_t(((color >> 11u) & 0x1fu) * 255 / 31);
+        rgb[1] = uint8_t(((color >> 5u) & 0x3fu) * 255 / 63);
+        rgb[2] = uint8_t((color & 0x1fu) * 255 / 31);
+    }
+
+    // Color part of BC1-BC3 blocks into 16 RGBA texels, 'hasPunchThrough' for the 3 color mode of BC1
+    void decodeColorBlock(const uint8_t *block, uint8_t *texels, bool hasPunchThrough) {
+        uint16_t color0 = uint16_t(block[0] | (block[1] << 8u));
+        uint16_t color1 = uint16_t(block[2] | (block[3] << 8u));
+        uint8_t palette[4][4];
+        decodeColor565(color0, palette[0]);
+        decodeColor565(color1, palette[1]);
+        palette[0][3] = palette[1][3] = 255;
+        bool isFourColors = color0 > color1 || !hasPunchThrough;
+        for (uint32_t channel = 0; channel < 3; ++channel) {
+            if (isFourColors) {
+                palette[2][channel] = uint8_t((2 * palette[0][channel] + palette[1][channel]) / 3);
+                palette[3][channel] = uint8_t((palette[0][channel] + 2 * palette[1][channel]) / 3);
+            } else {
+                palette[2][channel] = uint8_t((palette[0][channel] + palette[1][channel]) / 2);
+                palette[3][channel] = 0;
+            }
+        }
+        palette[2][3] = 255;
+        palette[3][3] = isFourColors ? 255 : 0;
+
+        uint32_t indices = uint32_t(block[4]) | (uint32_t(block[5]) << 8u) | (uint32_t(block[6]) << 16u) |
+                           (uint32_t(block[7]) << 24u);
+        for (uint32_t texel = 0; texel < 16; ++texel) {
+            memcpy(texels + 4 * texel, palette[(indices >> (2 * texel)) & 0x3u], 4);
+        }
+    }
+
+    // BC3 alpha and BC4/BC5 channel blocks, into one channel of 16 RGBA texels
+    void decodeChannelBlock(const uint8_t *block, uint8_t *texels, uint32_t channel, bool isSigned) {
+        int32_t values[8];
+        values[0] = isSigned ? int8_t(block[0]) : block[0];
+        values[1] = isSigned ? int8_t(block[1]) : block[1];
+        if (values[0] > values[1]) {
+            for (int32_t i = 1; i < 7; ++i) {
+                values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+            }
+        } else {
+            for (int32_t i = 1; i < 5; ++i) {
+                values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+            }
+            values[6] = isSigned ? -127 : 0;
+            values[7] = isSigned ? 127 : 255;
+        }
+
+        uint64_t indices = 0;
+        for (uint32_t i = 0; i < 6; ++i) {
+            indices |= uint64_t(block[2 + i]) << (8u * i);
+        }
+        for (uint32_t texel = 0; texel < 16; ++texel) {
+            int32_t value = values[(indices >> (3 * texel)) & 0x7u];
+            // Signed values are remapped to [0, 255], the decoded texture is UNORM
+            texels[4 * texel + channel] = uint8_t(isSigned ? (std::max(value, -127) + 127) * 255 / 254 : value);
+        }
+    }
+
+    // BC2 explicit 4 bit alpha
+    void decodeExplicitAlphaBlock(const uint8_t *block, uint8_t *texels) {
+        for (uint32_t texel = 0; texel < 16; ++texel) {
+            uint8_t alpha = uint8_t((block[texel / 2] >> (4 * (texel % 2))) & 0xfu);
+            texels[4 * texel + 3] = uint8_t(alpha * 17);
+        }
+    }
+}
+
+size_t TextureData::getOffset(uint32_t layer, uint32_t mipLevel) const {
+    size_t offset = 0;
+    for (uint32_t currentLayer = 0; currentLayer <= layer; ++currentLayer) {
+        for (uint32_t level = 0; level < mipLevels; ++level) {
+            if (currentLayer == layer && level == mipLevel) {
+                return offset;
+            }
+            offset += TextureLoader::getLevelSize(format, std::max(width >> level, 1u), std::max(height >> level, 1u));
+        }
+    }
+    return offset;
+}
+
+TextureData TextureLoader::loadDDS(const std::string &path, bool isSrgb) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open texture " + path);
+    }
+    auto fileSize = size_t(file.tellg());
+    file.seekg(0);
+
+    uint32_t magic = 0;
+    DDSHeader header = {};
+    if (fileSize < sizeof(magic) + sizeof(header) ||
+        !file.read(reinterpret_cast<char *>(&magic), sizeof(magic)) ||
+        !file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        magic != DDS_MAGIC || header.size != sizeof(DDSHeader)) {
+        throw std::runtime_error("Not a DDS file: " + path);
+    }
+
+    TextureData data;
+    data.width = header.width;
+    data.height = header.height;
+    data.mipLevels = std::max(header.mipMapCount, 1u);
+    const DDSPixelFormat &pixelFormat = header.pixelFormat;
+    if ((pixelFormat.flags & DDPF_FOURCC) && pixelFormat.fourCC == fourCC('D', 'X', '1', '0')) {
+        DDSHeaderDX10 headerDX10 = {};
+        if (!file.read(reinterpret_cast<char *>(&headerDX10), sizeof(headerDX10))) {
+            throw std::runtime_error("Truncated DDS file: " + path);
+        }
+        if (headerDX10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) {
+            throw std::runtime_error("Cube maps are not supported: " + path);
+        }
+        data.format = fromDXGI(headerDX10.dxgiFormat);
+        data.layerCount = std::max(headerDX10.arraySize, 1u);
+    } else {
+        // Legacy headers don't tell the color space, the caller does. DX10 formats are kept as declared
+        if (pixelFormat.flags & DDPF_FOURCC) {
+            data.format = fromFourCC(pixelFormat.fourCC);
+        } else if ((pixelFormat.flags & DDPF_RGB) && pixelFormat.rgbBitCount == 32) {
+            if (pixelFormat.rBitMask == 0x000000ffu) {
+                data.format = VK_FORMAT_R8G8B8A8_UNORM;
+            } else if (pixelFormat.rBitMask == 0x00ff0000u) {
+                data.format = VK_FORMAT_B8G8R8A8_UNORM;
+            }
+        }
+        if (isSrgb) {
+            data.format = toSrgb(data.format);
+        }
+    }
+    if (data.format == VK_FORMAT_UNDEFINED || data.width == 0 || data.height == 0) {
+        throw std::runtime_error("Unsupported DDS format: " + path);
+    }
+
+    size_t dataSize = data.getOffset(data.layerCount, 0);
+    auto headerSize = size_t(file.tellg());
+    if (fileSize - headerSize < dataSize) {
+        throw std::runtime_error("Truncated DDS file: " + path);
+    }
+    data.bytes.resize(dataSize);
+    file.read(reinterpret_cast<char *>(data.bytes.data()), std::streamsize(dataSize));
+    return data;
+}
+
+TextureData TextureLoader::fromPixels(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height,
+                                      bool isSrgb) {
+    if (pixels.size() != size_t(width) * height * 4) {
+        throw std::runtime_error("Pixel data doesn't match the texture size");
+    }
+    TextureData data;
+    data.format = isSrgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    data.width = width;
+    data.height = height;
+    data.bytes = pixels;
+    return data;
+}
+
+TextureData TextureLoader::stackLayers(const std::vector<TextureData> &layers) {
+    if (layers.empty()) {
+        throw std::runtime_error("Texture arrays need at least one layer");
+    }
+    TextureData data = layers[0];
+    data.layerCount = 0;
+    data.bytes.clear();
+    for (const TextureData &layer : layers) {
+        if (layer.format != data.format || layer.width != data.width || layer.height != data.height ||
+            layer.mipLevels != data.mipLevels) {
+            throw std::runtime_error("The layers of a texture array must share their format, size and mips");
+        }
+        data.bytes.insert(data.bytes.end(), layer.bytes.begin(), layer.bytes.end());
+        data.layerCount += layer.layerCount;
+    }
+    return data;
+}
+
+TextureData TextureLoader::decompress(const TextureData &data) {
+    if (!isBlockCompressed(data.format)) {
+        return data;
+    }
+
+    TextureData decoded;
+    decoded.width = data.width;
+    decoded.height = data.height;
+    decoded.layerCount = data.layerCount;
+    decoded.mipLevels = data.mipLevels;
+    bool isSrgb = data.format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK || data.format == VK_FORMAT_BC2_SRGB_BLOCK ||
+                  data.format == VK_FORMAT_BC3_SRGB_BLOCK;
+    decoded.format = isSrgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    decoded.bytes.resize(decoded.getOffset(decoded.layerCount, 0));
+
+    uint32_t blockSize = getBlockSize(data.format);
+    for (uint32_t layer = 0; layer < data.layerCount; ++layer) {
+        for (uint32_t level = 0; level < data.mipLevels; ++level) {
+            uint32_t width = std::max(data.width >> level, 1u);
+            uint32_t height = std::max(data.height >> level, 1u);
+            const uint8_t *source = data.bytes.data() + data.getOffset(layer, level);
+            uint8_t *destination = decoded.bytes.data() + decoded.getOffset(layer, level);
+
+            for (uint32_t blockY = 0; blockY < (height + 3) / 4; ++blockY) {
+                for (uint32_t blockX = 0; blockX < (width + 3) / 4; ++blockX, source += blockSize) {
+                    uint8_t texels[16 * 4] = {};
+                    switch (data.format) {
+                        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                            decodeColorBlock(source, texels, true);
+                            break;
+                        case VK_FORMAT_BC2_UNORM_BLOCK:
+                        case VK_FORMAT_BC2_SRGB_BLOCK:
+                            decodeColorBlock(source + 8, texels, false);
+                            decodeExplicitAlphaBlock(source, texels);
+                            break;
+                        case VK_FORMAT_BC3_UNORM_BLOCK:
+                        case VK_FORMAT_BC3_SRGB_BLOCK:
+                            decodeColorBlock(source + 8, texels, false);
+                            decodeChannelBlock(source, texels, 3, false);
+                            break;
+                        case VK_FORMAT_BC4_UNORM_BLOCK:
+                        case VK_FORMAT_BC4_SNORM_BLOCK:
+                            decodeChannelBlock(source, texels, 0, data.format == VK_FORMAT_BC4_SNORM_BLOCK);
+                            for (uint32_t texel = 0; texel < 16; ++texel) {
+                                texels[4 * texel + 3] = 255;
+                            }
+                            break;
+                        case VK_FORMAT_BC5_UNORM_BLOCK:
+                        case VK_FORMAT_BC5_SNORM_BLOCK:
+                            decodeChannelBlock(source, texels, 0, data.format == VK_FORMAT_BC5_SNORM_BLOCK);
+                            decodeChannelBlock(source + 8, texels, 1, data.format == VK_FORMAT_BC5_SNORM_BLOCK);
+                            for (uint32_t texel = 0; texel < 16; ++texel) {
+                                texels[4 * texel + 3] = 255;
+                            }
+                            break;
+                        default:
+                            throw std::runtime_error("BC6H and BC7 textures need a device supporting them");
+                    }
+
+                    // Blocks at the edges of small mips are only partially inside the image
+                    for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y) {
+                        uint32_t columns = std::min(4u, width - blockX * 4);
+                        memcpy(destination + (size_t(blockY * 4 + y) * width + blockX * 4) * 4, texels + y * 16,
+                               columns * 4);
+                    }
+                }
+            }
+        }
+    }
+    return decoded;
+}
+
+bool TextureLoader::isBlockCompressed(VkFormat format) {
+    return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+size_t TextureLoader::getLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+    if (isBlockCompressed(format)) {
+        return size_t((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+    }
+    return size_t(width) * height * getBlockSize(format);
+}
+
+uint32_t TextureLoader::getBlockSize(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return 8;
+        default:
+            // Other BC formats use 16 bytes per block, the uncompressed ones 4 bytes per pixel
+            return isBlockCompressed(format) ? 16 : 4;
+    }
+}
+
+VkFormat TextureLoader::toSrgb(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM: return VK_FORMAT_R8G8B8A8_SRGB;
+        case VK_FORMAT_B8G8R8A8_UNORM: return VK_FORMAT_B8G8R8A8_SRGB;
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case VK_FORMAT_BC2_UNORM_BLOCK: return VK_FORMAT_BC2_SRGB_BLOCK;
+        case VK_FORMAT_BC3_UNORM_BLOCK: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case VK_FORMAT_BC7_UNORM_BLOCK: return VK_FORMAT_BC7_SRGB_BLOCK;
+        // Data formats (BC4, BC5, BC6H) have no sRGB variant
+        default: return format;
+    }
+}
@@ -0,0 +1,381 @@
+#include "renderer/texture_manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "core/allocation_counter.h"
+
+void TextureManager::initialize(VkDevice vkDevice, VkPhysicalDevice vkPhysicalDevice,
+                                const DeviceFeatures &deviceFeatures, QueueManager &queues,
+                                BindlessDescriptors &bindlessDescriptors, MemoryBudget &budget) {
+    device = vkDevice;
+    physicalDevice = vkPhysicalDevice;
+    bindless = &bindlessDescriptors;
+    memoryBudget = &budget;
+    // Uploads go through the graphics queue: mips are generated with blits, which need a graphics capable queue
+    queue = *queues.getQueue(GRAPHICS_QUEUE);
+
+    // Both are enabled at device creation whenever they're supported
+    hasTextureCompressionBC = deviceFeatures.hasTextureCompressionBC;
+    if (deviceFeatures.hasSamplerAnisotropy) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        maxAnisotropy = std::min(properties.limits.maxSamplerAnisotropy, 16.0f);
+    }
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queues.getFamilyIndex(GRAPHICS_QUEUE);
+    VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool), "Texture Command Pool Creation");
+
+    // The white texture stands in for every texture that isn't ready, so it must be ready before the first frame
+    TextureSettings whiteSettings;
+    whiteSettings.generateMips = false;
+    create(TextureLoader::fromPixels({255, 255, 255, 255}, 1, 1, false), whiteSettings);
+    update();
+    VK_CHECK(vkWaitForFences(device, 1, &uploads.back().fence, VK_TRUE, UINT64_MAX), "White Texture Upload");
+    update();
+}
+
+TextureHandle TextureManager::addTexture(const TextureSettings &settings) {
+    Texture texture;
+    texture.settings = settings;
+    textures.push_back(texture);
+    return static_cast<TextureHandle>(textures.size() - 1);
+}
+
+TextureHandle TextureManager::load(const std::string &path, const TextureSettings &settings) {
+    return loadArray({path}, settings);
+}
+
+TextureHandle TextureManager::loadArray(const std::vector<std::string> &layerPaths, const TextureSettings &settings) {
+    TextureHandle texture = addTexture(settings);
+    JobSystem::instance().run([this, texture, layerPaths, settings]() {
+        try {
+            std::vector<TextureData> layers;
+            for (const std::string &path : layerPaths) {
+                layers.push_back(TextureLoader::loadDDS(path, settings.isSrgb));
+            }
+            TextureData data = prepare(layers.size() == 1 ? std::move(layers[0]) : TextureLoader::stackLayers(layers));
+
+            std::lock_guard<std::mutex> lock(loadedMutex);
+            loadedTextures.push_back({texture, std::move(data)});
+        } catch (const std::exception &e) {
+            log("Texture " + layerPaths[0] + " not loaded: " + e.what());
+        }
+    }, &loads);
+    return texture;
+}
+
+TextureHandle TextureManager::create(TextureData data, const TextureSettings &settings) {
+    TextureHandle texture = addTexture(settings);
+    data = prepare(std::move(data));
+    std::lock_guard<std::mutex> lock(loadedMutex);
+    loadedTextures.push_back({texture, std::move(data)});
+    return texture;
+}
+
+TextureData TextureManager::prepare(TextureData data) const {
+    // Compressed textures are kept compressed whenever possible: 4 to 8 times less memory and bandwidth than RGBA8
+    if (TextureLoader::isBlockCompressed(data.format) && !(hasTextureCompressionBC && isFormatSampled(data.format))) {
+        return TextureLoader::decompress(data);
+    }
+    return data;
+}
+
+bool TextureManager::isFormatSampled(VkFormat format) const {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+bool TextureManager::canGenerateMips(VkFormat format) const {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+void TextureManager::update() {
+    // Publish the textures whose upload is done
+    for (auto upload = uploads.begin(); upload != uploads.end();) {
+        if (vkGetFenceStatus(device, upload->fence) != VK_SUCCESS) {
+            ++upload;
+            continue;
+        }
+        // Samplers are created on a cache miss
+        AllowAllocationScope allowAllocations;
+        for (TextureHandle texture : upload->textures) {
+            publish(texture);
+        }
+        destroyUpload(*upload);
+        upload = uploads.erase(upload);
+    }
+
+    std::vector<LoadedTexture> loaded;
+    {
+        std::lock_guard<std::mutex> lock(loadedMutex);
+        loaded.swap(loadedTextures);
+    }
+    if (loaded.empty()) {
+        return;
+    }
+    // Only when textures finished loading
+    AllowAllocationScope allowAllocations;
+
+    //###################################################
+    // Everything loaded since the last update goes through one staging buffer and one submission
+    Upload upload = {};
+    std::vector<VkDeviceSize> stagingOffsets;
+    VkDeviceSize stagingSize = 0;
+    for (const LoadedTexture &loadedTexture : loaded) {
+        // Copy offsets must be multiples of the texel block size (16 bytes at most)
+        stagingSize = (stagingSize + 15) & ~VkDeviceSize(15);
+        stagingOffsets.push_back(stagingSize);
+        stagingSize += loadedTexture.data.bytes.size();
+    }
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = stagingSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &upload.stagingBuffer), "Texture Staging Buffer Creation");
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, upload.stagingBuffer, &memoryRequirements);
+    upload.stagingMemory = memoryBudget->allocate(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                  STAGING_MEMORY);
+    VK_CHECK(vkBindBufferMemory(device, upload.stagingBuffer, upload.stagingMemory, 0), "Texture Staging Buffer Binding");
+
+    void *stagingData;
+    VK_CHECK(vkMapMemory(device, upload.stagingMemory, 0, stagingSize, 0, &stagingData), "Texture Staging Buffer Mapping");
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        memcpy(static_cast<uint8_t *>(stagingData) + stagingOffsets[i], loaded[i].data.bytes.data(),
+               loaded[i].data.bytes.size());
+    }
+    vkUnmapMemory(device, upload.stagingMemory);
+
+    VkCommandBufferAllocateInfo commandBufferInfo = {};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = commandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+    VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferInfo, &upload.commandBuffer), "Texture Command Buffer Allocation");
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(upload.commandBuffer, &beginInfo), "Texture Command Buffer Begin");
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        recordUpload(upload.commandBuffer, textures[loaded[i].texture], loaded[i].data, upload.stagingBuffer,
+                     stagingOffsets[i]);
+        upload.textures.push_back(loaded[i].texture);
+    }
+    VK_CHECK(vkEndCommandBuffer(upload.commandBuffer), "Texture Command Buffer End");
+
+    // Polled by the next updates, frames never wait on the upload: they draw the white texture meanwhile
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &upload.fence), "Texture Fence Creation");
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &upload.commandBuffer;
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, upload.fence), "Texture Upload Submission");
+    uploads.push_back(upload);
+}
+
+void TextureManager::recordUpload(VkCommandBuffer commandBuffer, Texture &texture, const TextureData &data,
+                                  VkBuffer stagingBuffer, VkDeviceSize stagingOffset) {
+    // Compressed formats can't be blitted, their mips come with the file
+    bool isGeneratingMips = data.mipLevels == 1 && texture.settings.generateMips &&
+                            !TextureLoader::isBlockCompressed(data.format) && canGenerateMips(data.format);
+    texture.format = data.format;
+    texture.layerCount = data.layerCount;
+    texture.mipLevels = isGeneratingMips ?
+                        uint32_t(std::floor(std::log2(std::max(data.width, data.height)))) + 1 : data.mipLevels;
+
+    //###################################################
+    // Image:
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = data.format;
+    imageInfo.extent = {data.width, data.height, 1};
+    imageInfo.mipLevels = texture.mipLevels;
+    imageInfo.arrayLayers = data.layerCount;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                      (isGeneratingMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &texture.image), "Texture Image Creation");
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, texture.image, &memoryRequirements);
+    texture.memory = memoryBudget->allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, TEXTURE_MEMORY);
+    VK_CHECK(vkBindImageMemory(device, texture.image, texture.memory, 0), "Texture Image Binding");
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = texture.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, data.layerCount};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    //###################################################
+    // Copy of the levels in the data:
+    std::vector<VkBufferImageCopy> regions;
+    for (uint32_t layer = 0; layer < data.layerCount; ++layer) {
+        for (uint32_t level = 0; level < data.mipLevels; ++level) {
+            VkBufferImageCopy region = {};
+            region.bufferOffset = stagingOffset + data.getOffset(layer, level);
+            // Tightly packed
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, layer, 1};
+            region.imageExtent = {std::max(data.width >> level, 1u), std::max(data.height >> level, 1u), 1};
+            regions.push_back(region);
+        }
+    }
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(regions.size()), regions.data());
+
+    //###################################################
+    // Mip chain: each level is blitted from the previous one, all layers at once. A level becomes a blit source once
+    // written, and is ready for sampling once read
+    barrier.subresourceRange.levelCount = 1;
+    int32_t width = int32_t(data.width);
+    int32_t height = int32_t(data.height);
+    for (uint32_t level = 1; level < (isGeneratingMips ? texture.mipLevels : 0); ++level) {
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkImageBlit blit = {};
+        blit.srcOffsets[1] = {width, height, 1};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, data.layerCount};
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        blit.dstOffsets[1] = {width, height, 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, data.layerCount};
+        vkCmdBlitImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // The levels that were only written: the last one of a generated chain, or all of them
+    barrier.subresourceRange.baseMipLevel = isGeneratingMips ? texture.mipLevels - 1 : 0;
+    barrier.subresourceRange.levelCount = isGeneratingMips ? 1 : texture.mipLevels;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void TextureManager::publish(TextureHandle handle) {
+    Texture &texture = textures[handle];
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = texture.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = texture.format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, texture.layerCount};
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &texture.view), "Texture Image View Creation");
+
+    // Registered once the texture is ready: draws recorded before keep the index of the white texture
+    texture.bindlessIndex = bindless->addTexture(texture.view, getSampler(texture.settings.sampler));
+
+    texture.isReady = true;
+}
+
+bool TextureManager::isReady(TextureHandle texture) const {
+    return texture < textures.size() && textures[texture].isReady;
+}
+
+BindlessIndex TextureManager::getBindlessIndex(TextureHandle texture) const {
+    return isReady(texture) ? textures[texture].bindlessIndex : textures[WHITE_TEXTURE].bindlessIndex;
+}
+
+VkSampler TextureManager::getSampler(const SamplerSettings &settings) {
+    auto found = samplers.find(settings);
+    if (found != samplers.end()) {
+        return found->second;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = settings.filter;
+    samplerInfo.minFilter = settings.filter;
+    samplerInfo.mipmapMode = settings.filter == VK_FILTER_NEAREST ? VK_SAMPLER_MIPMAP_MODE_NEAREST :
+                             VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = settings.addressMode;
+    samplerInfo.addressModeV = settings.addressMode;
+    samplerInfo.addressModeW = settings.addressMode;
+    samplerInfo.anisotropyEnable = settings.isAnisotropic && maxAnisotropy > 0.0f ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = samplerInfo.anisotropyEnable ? maxAnisotropy : 1.0f;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+    VkSampler sampler;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &sampler), "Sampler Creation");
+    samplers[settings] = sampler;
+    return sampler;
+}
+
+void TextureManager::destroyUpload(Upload &upload) {
+    vkDestroyFence(device, upload.fence, nullptr);
+    vkFreeCommandBuffers(device, commandPool, 1, &upload.commandBuffer);
+    vkDestroyBuffer(device, upload.stagingBuffer, nullptr);
+    memoryBudget->free(upload.stagingMemory);
+}
+
+void TextureManager::cleanup() {
+    // The loader jobs reference the manager
+    JobSystem::instance().wait(loads);
+    loadedTextures.clear();
+    for (Upload &upload : uploads) {
+        vkWaitForFences(device, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+        destroyUpload(upload);
+    }
+    uploads.clear();
+
+    for (Texture &texture : textures) {
+        vkDestroyImageView(device, texture.view, nullptr);
+        vkDestroyImage(device, texture.image, nullptr);
+        memoryBudget->free(texture.memory);
+    }
+    textures.clear();
+    for (auto &sampler : samplers) {
+        vkDestroySampler(device, sampler.second, nullptr);
+    }
+    samplers.clear();
+    vkDestroyCommandPool(device, commandPool, nullptr);
+}
@@ -1,5 +1,11 @@
 #include "renderer/vulkan_core.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include "renderer/swapchain_support_details.h"
+
 VkInstance VulkanCore::createInstance(std::string asterismName, bool isDebug) {
     std::string mode = isDebug ? "DEBUG" : "RELEASE";
     logTitle("Running " + std::string(asterismName) + " in " + mode + " mode");
@@ -8,7 +14,8 @@ VkInstance VulkanCore::createInstance(std::string asterismName, bool isDebug) {
     VkApplicationInfo applicationInfo = {};
     applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     applicationInfo.pApplicationName = asterismName.c_str();
-    applicationInfo.apiVersion = VK_VERSION_1_2;
+    // Timeline semaphores are core since Vulkan 1.2
+    applicationInfo.apiVersion = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo instanceCreateInfo = {};
     instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -61,9 +68,9 @@ VkSurfaceKHR VulkanCore::createSurface(VkInstance instance, GLFWwindow *window)
 }
 
 
-VkPhysicalDevice VulkanCore::createPhysicalDevice(VkInstance instance) {
-    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-
+VkPhysicalDevice VulkanCore::createPhysicalDevice(VkInstance instance, VkSurfaceKHR surface,
+                                                  const std::vector<const char *> &requiredExtensions,
+                                                  DeviceFeatures &features) {
     // Retrieve available physical devices
     uint32_t physicalDevicesCount = 0;
     vkEnumeratePhysicalDevices(instance, &physicalDevicesCount, nullptr);
@@ -75,26 +82,55 @@ VkPhysicalDevice VulkanCore::createPhysicalDevice(VkInstance instance) {
     std::vector<VkPhysicalDevice> physicalDevices(physicalDevicesCount);
     vkEnumeratePhysicalDevices(instance, &physicalDevicesCount, physicalDevices.data());
 
-    // First look for a discrete GPU
-    for (const VkPhysicalDevice &possibleDevice : physicalDevices) {
-        if (isDiscreteGPU(possibleDevice)) {
-            physicalDevice = possibleDevice;
-            break;
+    const char *overrideVariable = std::getenv("ASTERISM_DEVICE");
+    std::string override = overrideVariable ? overrideVariable : "";
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    int64_t bestScore = -1;
+    std::string overrideRejection;
+    bool isOverridden = false;
+    for (uint32_t i = 0; i < physicalDevicesCount; ++i) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevices[i], &properties);
+        DeviceFeatures candidateFeatures;
+        std::string rejection;
+        int64_t score = scorePhysicalDevice(physicalDevices[i], surface, requiredExtensions, candidateFeatures,
+                                            rejection);
+        if (score < 0) {
+            LOG_INFO("GPU {}: {} ({}), rejected: {}", i, properties.deviceName, getDeviceUuid(physicalDevices[i]),
+                     rejection);
+        } else {
+            LOG_INFO("GPU {}: {} ({}), score {}", i, properties.deviceName, getDeviceUuid(physicalDevices[i]), score);
         }
-    }
 
-//     If a discrete GPU is not available, pick the first one
-    if (physicalDevice == VK_NULL_HANDLE) {
-        for (const VkPhysicalDevice &possibleDevice : physicalDevices) {
-            if (isIntegratedGPU(possibleDevice)) {
-                physicalDevice = possibleDevice;
-                break;
+        if (isOverridden) {
+            continue;
+        }
+        if (!override.empty() && matchesDeviceOverride(physicalDevices[i], i, override)) {
+            // The first device matching the override is the one, if it can run the renderer
+            isOverridden = true;
+            if (score < 0) {
+                overrideRejection = std::string(properties.deviceName) + ": " + rejection;
+                continue;
             }
+            bestScore = score;
+            physicalDevice = physicalDevices[i];
+            features = candidateFeatures;
+        } else if (score > bestScore) {
+            bestScore = score;
+            physicalDevice = physicalDevices[i];
+            features = candidateFeatures;
         }
     }
 
+    if (!overrideRejection.empty()) {
+        throw std::runtime_error("GPU selected by ASTERISM_DEVICE can't be used (" + overrideRejection + ")");
+    }
+    if (!override.empty() && !isOverridden) {
+        LOG_WARNING("No GPU matches ASTERISM_DEVICE={}, picking the best one", override);
+    }
     if (physicalDevice == VK_NULL_HANDLE) {
-        throw std::runtime_error("No GPU found");
+        throw std::runtime_error("No suitable GPU found");
     }
 
     // Once the device is chosen can print more information about it:
@@ -106,58 +142,231 @@ VkPhysicalDevice VulkanCore::createPhysicalDevice(VkInstance instance) {
     uint32_t minor = VK_VERSION_MINOR(apiVersion);
     uint32_t patch = VK_VERSION_PATCH(apiVersion);
 
+    log(std::string("Using GPU: ") + properties.deviceName + (isOverridden ? " (ASTERISM_DEVICE)" : ""));
     log("Device supports Vulkan API version " + std::to_string(major) + '.' + std::to_string(minor) + "." + std::to_string(patch));
+    LOG_INFO("Device features: draw indirect count {}, anisotropy {}, BC textures {}, memory budget {}, "
+             "dedicated compute {}, dedicated transfer {}", features.hasDrawIndirectCount,
+             features.hasSamplerAnisotropy, features.hasTextureCompressionBC, features.hasMemoryBudget,
+             features.hasDedicatedCompute, features.hasDedicatedTransfer);
     return physicalDevice;
 }
 
 
-bool VulkanCore::isDiscreteGPU(VkPhysicalDevice device) {
+int64_t VulkanCore::scorePhysicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                        const std::vector<const char *> &requiredExtensions, DeviceFeatures &features,
+                                        std::string &rejection) {
     VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(device, &properties);
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        rejection = "Vulkan 1.2 not supported";
+        return -1;
+    }
+    for (const char *extension : requiredExtensions) {
+        if (!isDeviceExtensionSupported(physicalDevice, extension)) {
+            rejection = std::string(extension) + " not supported";
+            return -1;
+        }
+    }
 
-    if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
-        log(std::string("Using discrete GPU: ") + properties.deviceName);
-        return true;
+    VkPhysicalDeviceVulkan12Features supportedFeatures12 = {};
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures = {};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supportedFeatures12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+    // The renderer paces its frames with a timeline semaphore
+    features.hasTimelineSemaphores = supportedFeatures12.timelineSemaphore;
+    // Draws index the bindless descriptor arrays with push constants (see BindlessDescriptors)
+    features.hasDescriptorIndexing = supportedFeatures.features.shaderSampledImageArrayDynamicIndexing &&
+                                     supportedFeatures.features.shaderStorageBufferArrayDynamicIndexing &&
+                                     supportedFeatures12.runtimeDescriptorArray &&
+                                     supportedFeatures12.descriptorBindingPartiallyBound &&
+                                     supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind &&
+                                     supportedFeatures12.descriptorBindingStorageBufferUpdateAfterBind &&
+                                     supportedFeatures12.descriptorBindingUpdateUnusedWhilePending;
+    if (!features.hasTimelineSemaphores) {
+        rejection = "timeline semaphores not supported";
+        return -1;
     }
-    return false;
+    if (!features.hasDescriptorIndexing) {
+        rejection = "descriptor indexing not supported";
+        return -1;
+    }
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    bool hasGraphics = false;
+    bool hasPresent = false;
+    for (uint32_t i = 0; i < familyCount; ++i) {
+        VkQueueFlags flags = families[i].queueFlags;
+        hasGraphics |= (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        features.hasDedicatedCompute |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+        features.hasDedicatedTransfer |= (flags & VK_QUEUE_TRANSFER_BIT) &&
+                                         !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+        VkBool32 presentSupport = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+        hasPresent |= presentSupport == VK_TRUE;
+    }
+    if (!hasGraphics) {
+        rejection = "no graphics queue";
+        return -1;
+    }
+    if (!hasPresent) {
+        rejection = "can't present to the window";
+        return -1;
+    }
+    SwapchainSupportDetails swapchainSupport = SwapchainSupportDetails::querySwapchainSupport(physicalDevice, surface);
+    if (swapchainSupport.formats.empty() || swapchainSupport.presentModes.empty()) {
+        rejection = "no swapchain format or present mode for the window";
+        return -1;
+    }
+
+    features.hasDrawIndirectCount = supportedFeatures12.drawIndirectCount;
+    features.hasSamplerAnisotropy = supportedFeatures.features.samplerAnisotropy;
+    features.hasTextureCompressionBC = supportedFeatures.features.textureCompressionBC;
+    // Budgets reported by the driver when it can, estimated from the heap sizes otherwise
+    features.hasMemoryBudget = isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    features.extensions = requiredExtensions;
+    if (features.hasMemoryBudget) {
+        features.extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            features.deviceLocalMemory += memoryProperties.memoryHeaps[i].size;
+        }
+    }
+
+    // The type comes first: a discrete GPU wins over an integrated one whatever else they support. Integrated GPUs
+    // report system memory as device local, hence the cap on what memory counts for
+    int64_t score = 0;
+    switch (properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            score += 100000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            score += 50000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            score += 20000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            score += 10000;
+            break;
+        default:
+            break;
+    }
+    score += int64_t(std::min<VkDeviceSize>(features.deviceLocalMemory / (1024 * 1024), 32 * 1024) / 16);
+    score += features.hasDedicatedCompute ? 2000 : 0;
+    score += features.hasDedicatedTransfer ? 1000 : 0;
+    for (bool hasFeature : {features.hasDrawIndirectCount, features.hasSamplerAnisotropy,
+                            features.hasTextureCompressionBC, features.hasMemoryBudget}) {
+        score += hasFeature ? 500 : 0;
+    }
+    score += properties.limits.maxImageDimension2D / 1024;
+    score += properties.limits.maxPushConstantsSize >= 256 ? 100 : 0;
+    return score;
 }
 
-bool VulkanCore::isIntegratedGPU(VkPhysicalDevice device) {
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(device, &properties);
 
-    if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) {
-        log(std::string("Using integrated GPU: ") + properties.deviceName);
+bool VulkanCore::matchesDeviceOverride(VkPhysicalDevice physicalDevice, uint32_t index, const std::string &override) {
+    // Short numbers are indices, a UUID can be made of digits only
+    if (override.size() <= 4 &&
+        std::all_of(override.begin(), override.end(), [](char c) { return std::isdigit((unsigned char) c); })) {
+        return std::stoul(override) == index;
+    }
+
+    // UUIDs are compared without their dashes, whatever the case
+    auto normalize = [](const std::string &text, bool isUuid) {
+        std::string normalized;
+        for (char c : text) {
+            if (!isUuid || c != '-') {
+                normalized.push_back(char(std::tolower((unsigned char) c)));
+            }
+        }
+        return normalized;
+    };
+    std::string uuid = normalize(getDeviceUuid(physicalDevice), true);
+    if (normalize(override, true) == uuid) {
         return true;
     }
-    return false;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    return normalize(properties.deviceName, false).find(normalize(override, false)) != std::string::npos;
 }
 
 
-VkDevice VulkanCore::createLogicalDevice(VkPhysicalDevice physicalDevice,
-                                         std::vector<const char *> deviceExtensions,
-                                         QueueManager queues) {
-    std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {queues.getFamilyIndex(GRAPHICS_QUEUE), queues.getFamilyIndex(PRESENT_QUEUE)};
+std::string VulkanCore::getDeviceUuid(VkPhysicalDevice physicalDevice) {
+    // Stable across runs and driver updates, unlike the index
+    VkPhysicalDeviceIDProperties idProperties = {};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    std::string uuid;
+    char digits[3];
+    for (uint32_t i = 0; i < VK_UUID_SIZE; ++i) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            uuid.push_back('-');
+        }
+        snprintf(digits, sizeof(digits), "%02x", idProperties.deviceUUID[i]);
+        uuid.append(digits);
+    }
+    return uuid;
+}
+
 
-    float queuePriority = 1.0f;
-    for (uint32_t queueFamily: uniqueQueueFamilies) {
-        VkDeviceQueueCreateInfo deviceQueueCreateInfo = {};
-        deviceQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        deviceQueueCreateInfo.queueFamilyIndex = queueFamily;
-        deviceQueueCreateInfo.queueCount = 1;
-        deviceQueueCreateInfo.pQueuePriorities = &queuePriority;
-        deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
+bool VulkanCore::isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char *extensionName) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    for (const VkExtensionProperties &extension : extensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
     }
+    return false;
+}
+
+VkDevice VulkanCore::createLogicalDevice(VkPhysicalDevice physicalDevice, const DeviceFeatures &features,
+                                         const QueueManager &queues) {
+    // Graphics, compute (possibly a dedicated family) and present queues, several per family when requested
+    std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos = queues.getQueueCreateInfos();
 
+    // Required features were checked when the device was selected
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+    // Optional features, enabled whenever they're supported: their users check DeviceFeatures
+    deviceFeatures.samplerAnisotropy = features.hasSamplerAnisotropy;
+    deviceFeatures.textureCompressionBC = features.hasTextureCompressionBC;
+
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.timelineSemaphore = VK_TRUE;
+    features12.runtimeDescriptorArray = VK_TRUE;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features12.drawIndirectCount = features.hasDrawIndirectCount;
 
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size());
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.pNext = &features12;
     deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfos.data();
-    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(features.extensions.size());
+    deviceCreateInfo.ppEnabledExtensionNames = features.extensions.data();
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
     VkDevice device;
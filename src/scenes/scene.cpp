@@ -3,7 +3,7 @@
 
 void Scene::run() {
     this->frameCount = 0;
-    this->dt = 0.0;
+    this->dt = 1.0 / this->tickRate;
 
     this->setup();
     this->initializeCore();
@@ -12,25 +12,61 @@ void Scene::run() {
 
 
 void Scene::core() {
+    // Publish whatever setup() produced, so that the first frames have something to draw
+    this->frameStates.back() = this->simulationState;
+    this->frameStates.publish();
+
+    // The simulation runs on its own thread, rendering stays on the main thread (GLFW needs events polled there)
+    this->isSimulating = true;
+    this->simulationThread = std::thread(&Scene::simulationLoop, this);
 
     while (this->renderer->checkLoop()) {
+        // Wait for the GPU first, so that the input polled below is as fresh as possible once the frame is recorded
+        this->renderer->waitForFrame();
         this->renderer->rendererPollEvents();
 
-        auto start = std::chrono::high_resolution_clock::now();
 //        logTitle("NEW FRAME");
+        // Pick up the newest snapshot. If the simulation hasn't produced a new one since the last frame, the previous
+        // one is simply drawn again
+        this->renderState = this->frameStates.acquire();
 
-        this->update();
         this->draw();
 
-        auto end = std::chrono::high_resolution_clock::now();
-        this->dt = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
-//        log("dt: " + std::to_string(this->dt));
 //        log("frameCount: " + std::to_string(this->frameCount));
-
         this->frameCount++;
     }
+
+    this->isSimulating = false;
+    this->simulationThread.join();
+
     this->renderer->afterLoop();
 
     this->terminateCore();
 }
 
+void Scene::simulationLoop() {
+    using clock = std::chrono::steady_clock;
+    const auto tickDuration = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(this->dt));
+    // If the simulation falls behind by more than this, stop trying to catch up and drop the missed ticks
+    const auto maxLag = tickDuration * 5;
+
+    auto nextTick = clock::now();
+    while (this->isSimulating) {
+        this->update();
+
+        this->simulationState.tick++;
+        this->simulationState.simulationTime += this->dt;
+
+        // The snapshot is a copy: update() keeps working on simulationState while the renderer reads the published one
+        this->frameStates.back() = this->simulationState;
+        this->frameStates.publish();
+
+        nextTick += tickDuration;
+        auto now = clock::now();
+        if (now - nextTick > maxLag) {
+            nextTick = now;
+        }
+        // Returns immediately when behind schedule, so late ticks are run back to back
+        std::this_thread::sleep_until(nextTick);
+    }
+}
@@ -1,14 +1,29 @@
 # include "scenes/scene_2D.h"
 
 void Scene2D::initializeCore() {
-    // ToDo: Initialize static cam and 2D renderer (quad or triangle) here
     this->renderer = std::make_shared<Renderer>();
+    renderer->setSpriteCapacity(this->spriteCapacity);
+    renderer->setMeshDrawing(false);
     renderer->initializeRenderer();
+
+    VkExtent2D extent = renderer->getExtent();
+    ViewParams viewParams = {glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)};
+    OrthogonalParams orthogonalParams = {glm::vec2(float(extent.width), float(extent.height)), 0.1f, 10.0f};
+    this->camera = std::make_unique<Camera>(viewParams, orthogonalParams);
+}
+
+SpriteBatch &Scene2D::beginSprites() {
+    // Follows window resizes
+    VkExtent2D extent = renderer->getExtent();
+    camera->setScreenSize(glm::vec2(float(extent.width), float(extent.height)));
+
+    SpriteBatch &sprites = renderer->getSpriteBatch();
+    sprites.begin(*camera);
+    return sprites;
 }
 
 
 void Scene2D::terminateCore() {
-    // ToDo: Terminate renderer and static cam here
     this->renderer->cleanup();
-
-}
\ No newline at end of file
+    this->camera.reset();
+}
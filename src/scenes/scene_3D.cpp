@@ -4,6 +4,9 @@
 void Scene3D::initializeCore() {
     // ToDo: Initialize dynamic cam and 3D renderer
     this->renderer = std::make_shared<Renderer>();
+    renderer->setParticleSettings(this->particleSettings);
+    renderer->setLightingSettings(this->lightingSettings);
+    renderer->setDynamicResolutionSettings(this->resolutionSettings);
     renderer->initializeRenderer();
 }
 
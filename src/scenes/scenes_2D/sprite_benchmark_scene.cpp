@@ -0,0 +1,91 @@
+#include "scenes/scenes_2D/sprite_benchmark_scene.h"
+
+#include <cmath>
+
+#include "core/job_system.h"
+
+namespace {
+    // Deterministic random value in [0, 1) per sprite and property
+    float hashToUnit(uint32_t value) {
+        value ^= value >> 16u;
+        value *= 0x7feb352du;
+        value ^= value >> 15u;
+        value *= 0x846ca68bu;
+        value ^= value >> 16u;
+        return float(value >> 8u) * (1.0f / 16777216.0f);
+    }
+
+    // Bounces 'x' between -bound and bound
+    float bounce(float x, float bound) {
+        float period = 4.0f * bound;
+        float u = std::fmod(x + bound, period);
+        if (u < 0.0f) {
+            u += period;
+        }
+        return u < 2.0f * bound ? u - bound : 3.0f * bound - u;
+    }
+}
+
+void SpriteBenchmarkScene::setup() {
+    logTitle("Sprite benchmark setup");
+    this->spriteCapacity = steps.back();
+}
+
+void SpriteBenchmarkScene::update() {
+    // Everything happens in draw()
+}
+
+void SpriteBenchmarkScene::draw() {
+    using namespace std::chrono;
+    auto now = steady_clock::now();
+    if (this->frameCount == 0) {
+        this->renderer->setPresentPolicy(UNCAPPED_PRESENT);
+        start = now;
+        reportStart = now;
+    }
+    double time = duration<double>(now - start).count();
+    auto step = std::min<size_t>(size_t(time / STEP_DURATION), steps.size() - 1);
+    float seconds = float(time);
+
+    VkExtent2D extent = this->renderer->getExtent();
+    float aspectRatio = float(extent.width) / float(extent.height);
+
+    // All the sprites of a frame share one state: a single run, drawn with a single instanced draw
+    SpriteBatch &sprites = beginSprites();
+    uint32_t count = steps[step];
+    SpriteInstance *instances = sprites.allocate(count, 0, ALPHA_BLENDING);
+    JobSystem::instance().parallelFor(count, 1u << 14u, [=](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            float startX = hashToUnit(4 * i) * 2.0f - 1.0f;
+            float startY = hashToUnit(4 * i + 1) * 2.0f - 1.0f;
+            float angle = hashToUnit(4 * i + 2) * 6.2831853f;
+            float speed = 0.05f + 0.3f * hashToUnit(4 * i + 3);
+
+            SpriteInstance &instance = instances[i];
+            instance.position[0] = bounce(startX * aspectRatio + std::cos(angle) * speed * seconds, aspectRatio);
+            instance.position[1] = bounce(startY + std::sin(angle) * speed * seconds, 1.0f);
+            instance.size[0] = 0.006f;
+            instance.size[1] = 0.006f;
+            instance.rotation = angle + seconds * 2.0f;
+            // Color from the direction, half transparent
+            instance.color = (uint32_t(127.5f + 127.5f * std::cos(angle))) |
+                             (uint32_t(127.5f + 127.5f * std::sin(angle)) << 8u) |
+                             (200u << 16u) | (128u << 24u);
+            instance.textureLayer = 0;
+        }
+    });
+    double writeTime = duration<double, std::milli>(steady_clock::now() - now).count();
+
+    this->renderer->drawFrame(this->renderState);
+
+    reportFrames++;
+    reportWriteTime += writeTime;
+    double elapsed = duration<double>(steady_clock::now() - reportStart).count();
+    if (elapsed >= 1.0) {
+        LOG_INFO("{} sprites in {} draws: frame {} ms, sprite writing {} ms", sprites.getSpriteCount(),
+                 sprites.getDrawCount(), elapsed * 1000.0 / reportFrames, reportWriteTime / reportFrames);
+        reportStart = steady_clock::now();
+        reportFrames = 0;
+        reportWriteTime = 0.0;
+    }
+}
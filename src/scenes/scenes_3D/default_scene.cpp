@@ -9,17 +9,31 @@ void DefaultScene::setup() {
     Quad quad = Quad();
     // Initialize quad
     // Initialize shaders for quad, then set the shader to the quad
+
+    // A small fountain above the quad
+    this->particleSettings.capacity = 1u << 16u;
+    ParticleEmitter fountain;
+    fountain.position = glm::vec3(0.0f, 0.05f, 0.0f);
+    fountain.radius = 0.02f;
+    fountain.velocity = glm::vec3(0.0f, 2.5f, 0.0f);
+    fountain.spread = 0.6f;
+    fountain.color = glm::vec4(0.3f, 0.6f, 1.0f, 0.8f);
+    fountain.rate = 8000.0f;
+    fountain.lifetime = 1.0f;
+    fountain.lifetimeVariance = 0.3f;
+    this->simulationState.particleEmitters = {fountain};
 }
 
 void DefaultScene::update() {
     // Update cam stuff (e.g position)
 
     // Update quad stuff (e.g rotation)
-
+    float time = float(this->simulationState.simulationTime);
+    this->simulationState.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 }
 
 void DefaultScene::draw() {
     // Call draws here
-    this->renderer->drawFrame();
+    this->renderer->drawFrame(this->renderState);
     // e.g this->quad->draw(camera)
 }
\ No newline at end of file
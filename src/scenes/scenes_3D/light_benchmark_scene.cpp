@@ -0,0 +1,61 @@
+#include "scenes/scenes_3D/light_benchmark_scene.h"
+
+#include <cmath>
+
+void LightBenchmarkScene::setup() {
+    logTitle("Light benchmark setup");
+    this->lightingSettings.capacity = steps.back();
+    this->lightingSettings.ambient = glm::vec3(0.02f);
+    // The demo quad becomes the floor
+    this->simulationState.model = glm::scale(glm::mat4(1.0f), glm::vec3(2.0f * floorExtent, 1.0f, 2.0f * floorExtent));
+    this->simulationState.lights.reserve(steps.back());
+}
+
+void LightBenchmarkScene::update() {
+    auto step = std::min<size_t>(size_t(this->simulationState.simulationTime / STEP_DURATION), steps.size() - 1);
+    float time = float(this->simulationState.simulationTime);
+
+    // Spread evenly over the floor (golden angle spiral), each light circling around its spot. The density grows with
+    // the steps, and so do the lights per cluster
+    std::vector<Light> &lights = this->simulationState.lights;
+    lights.resize(steps[step]);
+    for (uint32_t i = 0; i < lights.size(); ++i) {
+        Light &light = lights[i];
+        float radius = floorExtent * std::sqrt((float(i) + 0.5f) / float(lights.size()));
+        float angle = float(i) * 2.39996f;
+        float orbit = time + float(i);
+        light.type = i % 4 == 0 ? SPOT_LIGHT : POINT_LIGHT;
+        light.position = glm::vec3(radius * std::cos(angle) + 0.05f * std::cos(orbit), 0.1f,
+                                   radius * std::sin(angle) + 0.05f * std::sin(orbit));
+        light.range = lightRange;
+        light.color = glm::vec3(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::cos(angle + 2.1f),
+                                0.5f + 0.5f * std::cos(angle + 4.2f));
+        light.intensity = 0.5f;
+        light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    }
+}
+
+void LightBenchmarkScene::draw() {
+    using namespace std::chrono;
+    if (this->frameCount == 0) {
+        this->renderer->setPresentPolicy(UNCAPPED_PRESENT);
+        reportStart = steady_clock::now();
+    }
+
+    this->renderer->drawFrame(this->renderState);
+
+    const ClusteredLighting &lighting = this->renderer->getLighting();
+    reportFrames++;
+    reportBinningTime += lighting.getBinningTime();
+
+    auto now = steady_clock::now();
+    double elapsed = duration<double>(now - reportStart).count();
+    if (elapsed >= 1.0) {
+        double frameTime = elapsed * 1000.0 / reportFrames;
+        double binningTime = reportBinningTime / reportFrames;
+        LOG_INFO("{} lights: frame {} ms, GPU binning {} ms", lighting.getLightCount(), frameTime, binningTime);
+        reportStart = now;
+        reportFrames = 0;
+        reportBinningTime = 0.0;
+    }
+}
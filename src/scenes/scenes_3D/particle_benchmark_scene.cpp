@@ -0,0 +1,59 @@
+#include "scenes/scenes_3D/particle_benchmark_scene.h"
+
+#include <cmath>
+
+void ParticleBenchmarkScene::setup() {
+    logTitle("Particle benchmark setup");
+    this->particleSettings.capacity = steps.back();
+    // Keep the particles around the emitters
+    this->particleSettings.gravity = glm::vec3(0.0f, -2.0f, 0.0f);
+    this->particleSettings.drag = 0.5f;
+    this->simulationState.particleEmitters.resize(EMITTER_COUNT);
+}
+
+void ParticleBenchmarkScene::update() {
+    auto step = std::min<size_t>(size_t(this->simulationState.simulationTime / STEP_DURATION), steps.size() - 1);
+    float time = float(this->simulationState.simulationTime);
+
+    // The emitters circle around the origin, with enough rate to keep the target amount of particles alive
+    for (uint32_t i = 0; i < EMITTER_COUNT; ++i) {
+        ParticleEmitter &emitter = this->simulationState.particleEmitters[i];
+        float angle = time * 0.5f + float(i) * glm::radians(360.0f / EMITTER_COUNT);
+        emitter.position = glm::vec3(std::cos(angle), 0.2f, std::sin(angle)) * 0.6f;
+        emitter.radius = 0.05f;
+        emitter.velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+        emitter.spread = 0.8f;
+        emitter.color = glm::vec4(0.5f + 0.5f * std::cos(angle), 0.4f, 0.5f + 0.5f * std::sin(angle), 0.2f);
+        emitter.rate = float(steps[step]) / (particleLifetime * EMITTER_COUNT);
+        emitter.lifetime = particleLifetime;
+        emitter.lifetimeVariance = 0.0f;
+        emitter.size = 0.004f;
+    }
+}
+
+void ParticleBenchmarkScene::draw() {
+    using namespace std::chrono;
+    if (this->frameCount == 0) {
+        this->renderer->setPresentPolicy(UNCAPPED_PRESENT);
+        reportStart = steady_clock::now();
+    }
+
+    this->renderer->drawFrame(this->renderState);
+
+    const ParticleSystem &particles = this->renderer->getParticleSystem();
+    reportFrames++;
+    reportSimulationTime += particles.getSimulationTime();
+
+    auto now = steady_clock::now();
+    double elapsed = duration<double>(now - reportStart).count();
+    if (elapsed >= 1.0) {
+        double frameTime = elapsed * 1000.0 / reportFrames;
+        double simulationTime = reportSimulationTime / reportFrames;
+        double throughput = simulationTime > 0.0 ? particles.getAliveCount() / simulationTime / 1000.0 : 0.0;
+        LOG_INFO("{} particles: frame {} ms, GPU simulation {} ms ({} M particles/s)", particles.getAliveCount(),
+                 frameTime, simulationTime, throughput);
+        reportStart = now;
+        reportFrames = 0;
+        reportSimulationTime = 0.0;
+    }
+}
@@ -0,0 +1,56 @@
+#include "scenes/scenes_3D/resolution_benchmark_scene.h"
+
+#include <cmath>
+
+void ResolutionBenchmarkScene::setup() {
+    logTitle("Resolution benchmark setup");
+    this->resolutionSettings.targetFrameTime = TARGET_FRAME_TIME;
+    this->resolutionSettings.minScale = 0.25f;
+    this->resolutionSettings.maxScale = 1.0f;
+    this->lightingSettings.capacity = lightCount;
+    this->lightingSettings.ambient = glm::vec3(0.02f);
+    // The demo quad becomes the floor
+    this->simulationState.model = glm::scale(glm::mat4(1.0f), glm::vec3(2.0f * floorExtent, 1.0f, 2.0f * floorExtent));
+    this->simulationState.lights.resize(lightCount);
+}
+
+void ResolutionBenchmarkScene::update() {
+    auto step = std::min<size_t>(size_t(this->simulationState.simulationTime / STEP_DURATION), steps.size() - 1);
+
+    // Spread evenly over the floor (golden angle spiral): larger ranges overlap more, every pixel shades more lights
+    std::vector<Light> &lights = this->simulationState.lights;
+    for (uint32_t i = 0; i < lights.size(); ++i) {
+        Light &light = lights[i];
+        float radius = floorExtent * std::sqrt((float(i) + 0.5f) / float(lights.size()));
+        float angle = float(i) * 2.39996f;
+        light.position = glm::vec3(radius * std::cos(angle), 0.1f, radius * std::sin(angle));
+        light.range = steps[step];
+        light.color = glm::vec3(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::cos(angle + 2.1f),
+                                0.5f + 0.5f * std::cos(angle + 4.2f));
+        light.intensity = 0.2f;
+    }
+}
+
+void ResolutionBenchmarkScene::draw() {
+    using namespace std::chrono;
+    if (this->frameCount == 0) {
+        this->renderer->setPresentPolicy(UNCAPPED_PRESENT);
+        reportStart = steady_clock::now();
+    }
+
+    this->renderer->drawFrame(this->renderState);
+    reportFrames++;
+
+    auto now = steady_clock::now();
+    double elapsed = duration<double>(now - reportStart).count();
+    if (elapsed >= 1.0) {
+        const DynamicResolution &resolution = this->renderer->getDynamicResolution();
+        double frameTime = elapsed * 1000.0 / reportFrames;
+        VkExtent2D extent = resolution.getRenderExtent();
+        LOG_INFO("Light range {}: frame {} ms, GPU {} ms, scale {} ({}x{})",
+                 this->renderState.lights.empty() ? 0.0f : this->renderState.lights[0].range, frameTime,
+                 resolution.getFrameTime(), resolution.getScale(), extent.width, extent.height);
+        reportStart = now;
+        reportFrames = 0;
+    }
+}
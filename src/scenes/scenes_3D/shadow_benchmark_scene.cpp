@@ -0,0 +1,102 @@
+#include "scenes/scenes_3D/shadow_benchmark_scene.h"
+
+#include <cmath>
+
+#include "core/job_system.h"
+
+void ShadowBenchmarkScene::setup() {
+    logTitle("Shadow benchmark setup");
+    this->lightingSettings.capacity = 64;
+    this->lightingSettings.ambient = glm::vec3(0.05f);
+    this->lightingSettings.shadows.resolution = 2048;
+    this->lightingSettings.shadows.maxShadowedSpotLights = spotLightCount;
+
+    // The demo quad becomes the floor, a low sun lights it
+    this->simulationState.model = glm::scale(glm::mat4(1.0f), glm::vec3(2.0f * floorExtent, 1.0f, 2.0f * floorExtent));
+    DirectionalLight &sun = this->simulationState.directionalLight;
+    sun.direction = glm::normalize(glm::vec3(0.6f, -1.0f, 0.4f));
+    sun.color = glm::vec3(1.0f, 0.95f, 0.85f);
+    sun.intensity = 1.0f;
+
+    // Standing quads spread over the floor (golden angle spiral), they never move
+    std::vector<MeshInstance> &instances = this->simulationState.meshInstances;
+    instances.resize(staticCasterCount + dynamicCasterCount);
+    for (uint32_t i = 0; i < staticCasterCount; ++i) {
+        float radius = floorExtent * std::sqrt((float(i) + 0.5f) / float(staticCasterCount));
+        float angle = float(i) * 2.39996f;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(radius * std::cos(angle), 0.08f,
+                                                                    radius * std::sin(angle)));
+        model = glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        instances[i].model = glm::scale(model, glm::vec3(0.16f));
+        instances[i].isStatic = true;
+    }
+    for (uint32_t i = staticCasterCount; i < instances.size(); ++i) {
+        instances[i].isStatic = false;
+    }
+
+    // Spot lights in the corners, pointing at the center
+    std::vector<Light> &lights = this->simulationState.lights;
+    lights.resize(spotLightCount);
+    for (uint32_t i = 0; i < spotLightCount; ++i) {
+        float angle = glm::radians(45.0f) + float(i) * glm::radians(90.0f);
+        Light &light = lights[i];
+        light.type = SPOT_LIGHT;
+        light.position = glm::vec3(1.5f * std::cos(angle), 1.0f, 1.5f * std::sin(angle));
+        light.direction = glm::normalize(-light.position);
+        light.range = 4.0f;
+        light.intensity = 2.0f;
+        light.color = glm::vec3(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::cos(angle + 2.1f),
+                                0.5f + 0.5f * std::cos(angle + 4.2f));
+        light.castsShadows = true;
+    }
+}
+
+void ShadowBenchmarkScene::update() {
+    auto phase = uint64_t(this->simulationState.simulationTime / PHASE_DURATION);
+    float time = float(this->simulationState.simulationTime);
+    bool hasMovingCasters = phase % 2 == 1;
+
+    // Spinning quads circling the center. Out of the way and casting nothing during the static phases. Their
+    // transforms are computed on the JobSystem, in chunks big enough to outweigh the scheduling
+    MeshInstance *dynamicCasters = this->simulationState.meshInstances.data() + staticCasterCount;
+    uint32_t count = dynamicCasterCount;
+    JobSystem::instance().parallelFor(count, 1u << 10u, [=](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            float angle = time + float(i) * 2.0f * glm::pi<float>() / float(count);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(std::cos(angle), 0.5f, std::sin(angle)));
+            model = glm::rotate(model, 2.0f * time, glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+            dynamicCasters[i].model = glm::scale(model, glm::vec3(hasMovingCasters ? 0.3f : 0.0f));
+            dynamicCasters[i].castsShadows = hasMovingCasters;
+        }
+    });
+}
+
+void ShadowBenchmarkScene::draw() {
+    using namespace std::chrono;
+    if (this->frameCount == 0) {
+        this->renderer->setPresentPolicy(UNCAPPED_PRESENT);
+        reportStart = steady_clock::now();
+    }
+
+    this->renderer->drawFrame(this->renderState);
+
+    const ShadowMaps &shadowMaps = this->renderer->getShadowMaps();
+    reportFrames++;
+    reportCachedRenders += shadowMaps.getCachedRenderCount();
+    reportComposites += shadowMaps.getCompositeCount();
+
+    auto now = steady_clock::now();
+    double elapsed = duration<double>(now - reportStart).count();
+    if (elapsed >= 1.0) {
+        double frameTime = elapsed * 1000.0 / reportFrames;
+        uint32_t movingCasters = this->renderState.meshInstances.back().castsShadows ? dynamicCasterCount : 0;
+        LOG_INFO("{} moving casters: frame {} ms, {} cached and {} composited layers per frame", movingCasters,
+                 frameTime, double(reportCachedRenders) / reportFrames, double(reportComposites) / reportFrames);
+        reportStart = now;
+        reportFrames = 0;
+        reportCachedRenders = 0;
+        reportComposites = 0;
+    }
+}
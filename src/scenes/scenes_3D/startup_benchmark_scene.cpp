@@ -0,0 +1,26 @@
+#include "scenes/scenes_3D/startup_benchmark_scene.h"
+
+void StartupBenchmarkScene::setup() {
+    logTitle("Startup benchmark setup");
+}
+
+void StartupBenchmarkScene::update() {
+    // Nothing moves, only the first frame matters
+}
+
+void StartupBenchmarkScene::draw() {
+    this->renderer->drawFrame(this->renderState);
+    if (this->frameCount > 0) {
+        return;
+    }
+
+    double initialization = 0.0;
+    for (const StartupPhase &phase : this->renderer->getStartupPhases()) {
+        LOG_INFO("{}: {:.2} ms", phase.name, phase.duration);
+        initialization += phase.duration;
+    }
+    double timeToFirstFrame = this->renderer->getTimeToFirstFrame();
+    LOG_INFO("Initialization {:.2} ms, first frame {:.2} ms, time to first frame {:.2} ms", initialization,
+             timeToFirstFrame - initialization, timeToFirstFrame);
+    this->renderer->requestClose();
+}